@@ -1,6 +1,8 @@
 #!/usr/bin/env python3
 
 import sys
+import os
+import hashlib
 import CompileInstruction
 
 #List of already inserted libraries. 
@@ -17,87 +19,17 @@ BDOSprogram = False
 #Global offset of program in memory
 programOffset = 0
 
+#If we have to assemble a relocatable BDOS user program (reloc)
+relocatable = False
+
 #Remove unreachable code
 optimizeSize = False
 
+#Write code.map with the function and source line of each address (-g)
+debugMap = False
 
-def removeFunctionFromCode(parsedLines, toRemove):
-    returnList = []
-
-    start = -1
-    end = -1
-
-    belowCodeSection = False
-
-    for idx, line in enumerate(parsedLines):
-        if line[1][0] == "Int:":
-            belowCodeSection = True
-        if start == -1:
-            if line[1][0] == toRemove + ":":
-                start = idx
-                #print (start)
-                #print(parsedLines[start])
-        elif end == -1:
-            # continue until next function found
-            if (line[1][0][-1] == ':'):
-                if not belowCodeSection:
-                    if ("Label_" not in line[1][0]):
-                        end = idx
-                        #print (end)
-                        #print(parsedLines[end])
-                # when we are below the code section, stop at any new label
-                else:
-                    end = idx
-
-    returnList = returnList + parsedLines[0:start]
-    returnList = returnList + parsedLines[end:]
-
-    return returnList
-
-
-def removeUnreachebleCode(parsedLines):
-    #print("orig len:", len(parsedLines))
-    returnList = parsedLines
-
-    asm = [x[1] for x in parsedLines]
-    functionNames = []
-    jumps = []
-
-    for x in asm:
-
-        if len(x) > 0:
-            if (x[0][-1] == ':'):
-                if ("Label_" not in x[0]):
-                    functionNames.append(x[0][:-1])
-            if (x[0] == "addr2reg"):
-                if ("Label_" not in x[1]):
-                    jumps.append(x[1])
-
-            if (x[0] == "jump"):
-                if ("Label_" not in x[1]):
-                    jumps.append(x[1])
-
-    #for f in functionNames:
-    #    print(f)
-    
-    #for j in jumps:
-    #    print(j)
-
-    unusedFunctions = list((set(functionNames).difference(jumps)).difference(["Main", "Int", "Syscall"]))
-
-    foundUnusedFunctions = len(unusedFunctions)
-
-    for u in unusedFunctions:
-        #print(u)
-        returnList = removeFunctionFromCode(returnList, u)
-
-    # recursive check
-    if foundUnusedFunctions > 0:
-        returnList = removeUnreachebleCode(returnList)
-
-    #print("after len:", len(returnList))
-
-    return returnList
+#Print the symbols that -O removes and their size (-v)
+verbose = False
 
 
 def parseLines(fileName):
@@ -107,6 +39,9 @@ def parseLines(fileName):
             # do something special in case of a .ds instruction
             if (len(line) > 4 and line.split(" ",maxsplit=1)[0] == ".ds"):
                 parsedLines.append((i, ['.ds', line.split(" ",maxsplit=1)[1].rstrip('\n')]))
+            # the ;@func and ;@line comments of bcc -g become debug lines
+            elif debugMap and line.split(" ",maxsplit=1)[0] in [";@func", ";@line"]:
+                parsedLines.append((i, ['.' + line[2:6]] + line[7:].rstrip('\n').rsplit(" ",maxsplit=1)))
             else:
                 parsedLine = line.strip().split(";",maxsplit=1)[0].split()
                 if (parsedLine != []):
@@ -115,48 +50,28 @@ def parseLines(fileName):
     parsedLines.append((0, ['.EOF'])) # add end of file token
     return parsedLines
 
-def moveDataDown(parsedLines):
-    for idx, line in enumerate(parsedLines):
-        if (line[1][0] == ".EOF"): # return when gone through entire file
-            return parsedLines
-        if (line[1][0] == ".data"): # when we found the start of a .data segment
-            while (parsedLines[idx][1][0] != ".code" and parsedLines[idx][1][0] != ".rdata" and parsedLines[idx][1][0] != ".bss" and parsedLines[idx][1][0] != ".EOF"): # move all lines to the end until .code, .rdata or .EOF
-                parsedLines.append(parsedLines.pop(idx))
-
-    # should not get here
-    print("SHOULD NOT GET HERE")
-    sys.exit(1)
-    return None
+#splits the lines into the .code, .data, .rdata and .bss sections, each in the original order
+#lines before the first directive are code
+def splitSections(parsedLines):
+    sections = {".code": [], ".data": [], ".rdata": [], ".bss": []}
+    current = sections[".code"]
 
-def moveRDataDown(parsedLines):
-    for idx, line in enumerate(parsedLines):
-        if (line[1][0] == ".EOF"): # return when gone through entire file
-            return parsedLines
-        if (line[1][0] == ".rdata"): # when we found the start of a .rdata segment
-            while (parsedLines[idx][1][0] != ".code" and parsedLines[idx][1][0] != ".data" and parsedLines[idx][1][0] != ".bss" and parsedLines[idx][1][0] != ".EOF"): # move all lines to the end until .code, .data or .EOF
-                parsedLines.append(parsedLines.pop(idx))
-
-    # should not get here
-    print("SHOULD NOT GET HERE")
-    sys.exit(1)
-    return None
+    for line in parsedLines:
+        if line[1][0] == ".EOF":
+            break
+        if line[1][0] in sections:
+            current = sections[line[1][0]]
+        current.append(line)
 
-def moveBssDown(parsedLines):
-    for idx, line in enumerate(parsedLines):
-        if (line[1][0] == ".EOF"): # return when gone through entire file
-            return parsedLines
-        if (line[1][0] == ".bss"): # when we found the start of a .rdata segment
-            while (parsedLines[idx][1][0] != ".code" and parsedLines[idx][1][0] != ".data" and parsedLines[idx][1][0] != ".rdata" and parsedLines[idx][1][0] != ".EOF"): # move all lines to the end until .code, .data or .EOF
-                parsedLines.append(parsedLines.pop(idx))
-
-    # should not get here
-    print("SHOULD NOT GET HERE")
-    sys.exit(1)
-    return None
+    return sections[".code"], sections[".data"], sections[".rdata"], sections[".bss"]
+
+#puts the labels Bss_Start and Bss_End around the .bss sections, for the startup code that clears them
+def addBssLabels(bss):
+    return [(0, ["Bss_Start:"])] + bss + [(0, ["Bss_End:"]), (0, [".space", "0"])]
 
 
 def removeAssemblerDirectives(parsedLines):
-    return [line for line in parsedLines if line[1][0] not in [".code", ".rdata", ".data", ".bss", ".EOF"]]
+    return [line for line in parsedLines if line[1][0] not in [".code", ".rdata", ".data", ".bss", ".EOF", ".globl"]]
 
 
 
@@ -169,13 +84,125 @@ def insertLibraries(parsedLines):
             if (line[1][0]) == "`include":
                 if (line[1][1] not in libraryList):
                     libraryList.append(line[1][1])
-                    insertList = insertLibraries(parseLines(line[1][1])) #recursion to include libraries within libraries
+                    insertList = insertLibraries(libraryLines(line[1][1])) #recursion to include libraries within libraries
                     for i in range(len(insertList)): 
                         returnList.insert(i, insertList[i]) 
 
     return returnList
 
 
+#Library cache
+#The result of pass one for each `include'd library is stored in .libcache, by the hash of the library
+#and of the assembler. Such a unit also holds the includes and defines of the library. Lines with labels
+#are left for pass two as usual, so the library only has to be put in place and its labels get their
+#address like any other. A unit is not used when a define from another file replaces one of its words.
+
+libraryCacheDir = ".libcache"
+libraryHeader = ";B32P library"
+libraryUnits = []
+assemblerHash = None
+
+#whether a parsed line of a library is kept in the unit as it is, instead of compiled
+def isLibraryHead(line):
+    return (line[1][0] == "`include" and len(line[1]) == 2) or line[1][0].lower() == "define"
+
+#compiles a library on its own, returns None if it needs anything from other files to compile
+def buildLibraryUnit(fileName):
+    parsedLines = parseLines(fileName)
+    head = [line for line in parsedLines if isLibraryHead(line)]
+    body = [line for line in parsedLines if not isLibraryHead(line)]
+
+    defines = {}
+    for line in head:
+        if line[1][0].lower() == "define":
+            if len(line[1]) != 4 or line[1][2] != "=" or line[1][1] in defines:
+                return None
+            defines[line[1][1]] = line[1][3]
+
+    try:
+        lines = [(0, text) for line in processDefines(defines, body) for text in passOneLine(line[1])]
+    except Exception:
+        return None
+
+    #the words a define from another file could replace, .ds strings with spaces can't be one
+    words = set([word for line in body for word in line[1] if len(word.split()) == 1])
+    return {"head": [" ".join(line[1]) for line in head], "words": words, "lines": lines}
+
+def writeLibraryUnit(path, unit):
+    try:
+        os.makedirs(libraryCacheDir, exist_ok=True)
+        with open(path + ".tmp", 'w') as f:
+            f.write(libraryHeader + "\n")
+            for line in unit["head"]:
+                f.write(line + "\n")
+            f.write(" ".join([".words"] + sorted(unit["words"])) + "\n")
+            for line in unit["lines"]:
+                f.write(line[1] + "\n")
+        os.replace(path + ".tmp", path)
+    except OSError:
+        pass #without a cache, the library is compiled again next time
+
+def readLibraryUnit(path):
+    try:
+        with open(path, 'r') as f:
+            lines = f.read().split("\n")[:-1]
+    except OSError:
+        return None
+    if not lines or lines[0] != libraryHeader:
+        return None
+
+    unit = {"head": [], "words": set(), "lines": []}
+    for n, line in enumerate(lines[1:], start=1):
+        if line.split(" ")[0] == ".words":
+            unit["words"] = set(line.split()[1:])
+            unit["lines"] = [(0, text) for text in lines[n+1:]]
+            return unit
+        unit["head"].append(line)
+    return None
+
+#the parsed lines to insert for a library: its includes and defines, followed by a .library line for the
+#unit from the cache (made if it is not there yet), or the whole library if it can't be compiled on its own
+def libraryLines(fileName):
+    global assemblerHash
+    if assemblerHash is None:
+        assemblerHash = hashlib.sha1()
+        for name in [os.path.abspath(__file__), CompileInstruction.__file__]:
+            with open(name, 'rb') as f:
+                assemblerHash.update(f.read())
+
+    with open(fileName, 'rb') as f:
+        key = assemblerHash.copy()
+        key.update(b"-g" if debugMap else b"")
+        key.update(f.read())
+    path = os.path.join(libraryCacheDir, key.hexdigest())
+
+    unit = readLibraryUnit(path)
+    if unit is None:
+        unit = buildLibraryUnit(fileName)
+        if unit is None:
+            return parseLines(fileName)
+        writeLibraryUnit(path, unit)
+
+    unit["name"] = fileName
+    unit["defines"] = set([line.split()[1] for line in unit["head"] if line.split()[0].lower() == "define"])
+    libraryUnits.append(unit)
+    return [(0, line.split()) for line in unit["head"]] + [(0, [".library", str(len(libraryUnits) - 1)])]
+
+#puts the lines of a library back in place of its unit when a define from another file replaces one of its words
+def checkLibraryUnits(defines, parsedLines):
+    returnList = []
+
+    for line in parsedLines:
+        if line[1][0] == ".library":
+            unit = libraryUnits[int(line[1][1])]
+            if any([word in defines and word not in unit["defines"] for word in unit["words"]]):
+                returnList.extend([l for l in parseLines(unit["name"]) if not isLibraryHead(l)])
+                continue
+        returnList.append(line)
+
+    return returnList
+
+
 def compileLine(line):
     compiledLine = ""
 
@@ -228,6 +255,10 @@ def compileLine(line):
         ".db"       : CompileInstruction.compileDb,
         ".ds"       : CompileInstruction.compileDs,
         ".dl"       : CompileInstruction.compileDl,
+        ".space"    : CompileInstruction.compileSpace,
+        ".func"     : CompileInstruction.compileDebug,
+        ".line"     : CompileInstruction.compileDebug,
+        ".globl"    : CompileInstruction.compileNothing,
         "loadlabellow" : CompileInstruction.compileLoadLabelLow,
         "loadlabelhigh" : CompileInstruction.compileLoadLabelHigh,
         "`include" : CompileInstruction.compileNothing,
@@ -250,29 +281,40 @@ def compileLine(line):
     return compiledLine
 
 #compiles lines that can be compiled directly
-def passOne(parsedLines):
+#compiles a line into the lines of pass one
+def passOneLine(line):
     passOneResult = []
+    compiledLine = compileLine(line)
 
-    for line in parsedLines:
-        try:
-            compiledLine = compileLine(line[1])
+    #fix instructions that have multiple lines
 
-            #fix instructions that have multiple lines
+    if compiledLine.split()[0] == "loadBoth":
+        passOneResult.append(compileLine(["load", compiledLine.split()[2], compiledLine.split()[3]]))
+        compiledLine = compileLine(["loadhi", compiledLine.split()[1], compiledLine.split()[3]])
 
-            if compiledLine.split()[0] == "loadBoth":
-                passOneResult.append((line[0], compileLine(["load", compiledLine.split()[2], compiledLine.split()[3]])))
-                compiledLine = compileLine(["loadhi", compiledLine.split()[1], compiledLine.split()[3]])
+    if compiledLine.split()[0] == "loadLabelHigh":
+        passOneResult.append("loadLabelLow " + " ".join(compiledLine.split()[1:]))
 
-            if compiledLine.split()[0] == "loadLabelHigh":
-                passOneResult.append((line[0], "loadLabelLow " + " ".join(compiledLine.split()[1:])))
+    if compiledLine.split()[0] == "data":
+        for i in compiledLine.split():
+            if i != "data":
+                passOneResult.append(i + " //data")
+    else:
+        if (compiledLine != "ignore"):
+            passOneResult.append(compiledLine)
 
-            if compiledLine.split()[0] == "data":
-                for i in compiledLine.split():
-                    if i != "data":
-                        passOneResult.append((line[0], i + " //data"))
-            else:
-                if (compiledLine != "ignore"):
-                    passOneResult.append((line[0], compiledLine))
+    return passOneResult
+
+def passOne(parsedLines):
+    passOneResult = []
+
+    for line in parsedLines:
+        #a library from the cache has been through pass one already
+        if line[1][0] == ".library":
+            passOneResult.extend(libraryUnits[int(line[1][1])]["lines"])
+            continue
+        try:
+            passOneResult.extend([(line[0], text) for text in passOneLine(line[1])])
         except Exception as e:
             print("Error in line " + str(line[0]) + ": " + " ".join(line[1]))
             print("The error is: {0}".format(e))
@@ -339,6 +381,46 @@ def addHeaderCode(parsedLines):
     
     return header + parsedLines
 
+#removes the debug lines, returns the remaining lines and the debug lines by the index of the line below them
+#this is done for objects made with -g as well, so they can be linked without it
+def takeDebugLines(parsedLines):
+    returnList = []
+    debugLines = {}
+
+    for line in parsedLines:
+        if line[1].split()[0] == "Debug":
+            debugLines.setdefault(len(returnList), []).append(line[1].split(" ",maxsplit=2)[1:])
+        else:
+            returnList.append(line)
+
+    return returnList, debugLines
+
+#writes code.map, a line with the address, function and source line for each address where one of them changes
+#labels that are no Label_ labels start a function or data without a source line, until the next debug line
+#labelLines are the lines before moveLabels, numberedLines the lines with their address after redoLineNumbering
+def writeDebugMap(labelLines, debugLines, numberedLines):
+    function = "-"
+    source = "-"
+    last = None
+    idx = 0
+
+    with open("code.map", "w") as f:
+        for n, line in enumerate(labelLines + [(0, "end")]):
+            for debug in debugLines.get(n, []):
+                if debug[0] == "func":
+                    function = debug[1]
+                else:
+                    source = ":".join(debug[1].rsplit(" ",maxsplit=1))
+            if line[1].split()[0] == "Label":
+                if "Label_" not in line[1].split()[1]:
+                    function = line[1].split()[1][:-1]
+                    source = "-"
+            elif idx < len(numberedLines):
+                if (function, source) != last:
+                    f.write("{0:08X} {1} {2}\n".format(numberedLines[idx][0], function, source))
+                    last = (function, source)
+                idx += 1
+
 #move labels to the next line
 def moveLabels(parsedLines):
     returnList = []
@@ -358,7 +440,7 @@ def moveLabels(parsedLines):
                     # if we have a label directly below, insert the label in the first non-label line
                     i = 2
                     labelDone = False
-                    while idx+i < len(parsedLines) - 1 and not labelDone:
+                    while idx+i < len(parsedLines) and not labelDone:
                         if parsedLines[idx+i][1].lower().split()[0] != "label":
                             labelDone = True
                             parsedLines[idx+i] = (parsedLines[idx+i][0], "$*" + line[1].split()[1] + "*$ " + parsedLines[idx+i][1])
@@ -388,11 +470,39 @@ def moveLabels(parsedLines):
 
 
 #renumbers each line
+#a .space line takes as many addresses as the words it reserves
 def redoLineNumbering(parsedLines):
     returnList = []
 
-    for idx, line in enumerate(parsedLines):
-        returnList.append((idx + programOffset, line[1]))
+    address = programOffset
+    for line in parsedLines:
+        returnList.append((address, line[1]))
+        address += spaceSize(line[1])
+
+    return returnList
+
+#returns the number of words reserved by a .space line, 1 for other lines
+def spaceSize(line):
+    words = line.split("*$ ")[-1].split()
+    if words[0] == "space":
+        return int(words[1])
+    return 1
+
+#replaces the .space lines by zero words, apart from the ones at the end of the program (.bss)
+#those are not written to the output, the program clears them when it starts
+def expandSpace(parsedLines):
+    returnList = []
+
+    end = len(parsedLines)
+    while end > 0 and parsedLines[end-1][1].split()[0] == "space":
+        end -= 1
+
+    for line in parsedLines[:end]:
+        if line[1].split()[0] == "space":
+            for i in range(spaceSize(line[1])):
+                returnList.append((line[0] + i, "00000000000000000000000000000000 //data"))
+        else:
+            returnList.append(line)
 
     return returnList
 
@@ -425,19 +535,71 @@ def getLabelMap(parsedLines):
 def passTwo(parsedLines, labelMap):
     #lines that start with these names should be compiled
     toCompileList = ["jump", "beq", "bgt", "bgts", "bge", "bges", "bne", "blt", "blts", "ble", "bles", "loadlabellow" ,"loadlabelhigh", ".dl"]
+    branchList = ["beq", "bgt", "bgts", "bge", "bges", "bne", "blt", "blts", "ble", "bles"]
 
     for idx, line in enumerate(parsedLines):
         if line[1].lower().split()[0] in toCompileList:
             for idx2, word in enumerate(line[1].split()):              
                 if word in labelMap:
                     x = line[1].split()
-                    x[idx2] = str(labelMap.get(word))
+                    if x[0].lower() in branchList:
+                        #branches take the offset to the label
+                        x[idx2] = str(labelMap.get(word) - line[0])
+                    else:
+                        x[idx2] = str(labelMap.get(word))
                     y = compileLine(x)
                     parsedLines[idx] = (parsedLines[idx][0], y)
                  
 
     return parsedLines
 
+#Relocatable programs
+#A relocatable BDOS user program is assembled for address 0 and starts with a header of three words: the magic
+#number, the length of the program and the number of relocations. The relocations follow the program, one word
+#each, with the kind in the highest two bits and the address in the program below it. The loader of BDOS adds the
+#address it puts the program at to each relocation.
+
+relocMagic = 0x52454C4F
+relocKinds = {"jump": 0, ".dl": 1, "loadlabellow": 2} #loadLabelLow also relocates the loadLabelHigh below it
+
+#returns the relocations of the lines that use the address of a label, before pass two compiles them
+def findRelocations(parsedLines, labelMap):
+    relocations = []
+
+    for idx, line in enumerate(parsedLines):
+        words = line[1].split()
+        kind = words[0].lower()
+        if kind not in ["jump", ".dl", "loadlabellow", "loadlabelhigh"] or not any([word in labelMap for word in words]):
+            continue
+
+        #the loader needs both halves of an address to add to it
+        if kind == "loadlabellow":
+            below = parsedLines[idx+1][1].split() if idx+1 < len(parsedLines) else []
+            paired = below[:2] == ["loadLabelHigh", words[1]]
+        elif kind == "loadlabelhigh":
+            above = parsedLines[idx-1][1].split() if idx > 0 else []
+            paired = above[:2] == ["loadLabelLow", words[1]]
+        else:
+            paired = True
+        if not paired:
+            print("Error: " + line[1] + " can not be relocated without " + ("loadLabelHigh" if kind == "loadlabellow" else "loadLabelLow"))
+            print("Assembler will now exit")
+            sys.exit(1)
+
+        if kind in relocKinds:
+            relocations.append((relocKinds[kind] << 30) | line[0])
+
+    return relocations
+
+#the header and the relocations around a relocatable program
+def addRelocations(parsedLines, relocations):
+    names = {0: "jump", 1: ".dl", 2: "addr2reg"}
+    header = [(0, '{0:032b}'.format(relocMagic) + " //Relocatable program"),
+              (0, '{0:032b}'.format(len(parsedLines)) + " //Length of program"),
+              (0, '{0:032b}'.format(len(relocations)) + " //Number of relocations")]
+    table = [(0, '{0:032b}'.format(r) + " //Relocate " + names[r >> 30] + " at " + str(r & 0x3FFFFFFF)) for r in relocations]
+    return header + parsedLines + table
+
 #check if all labels are compiled
 def checkNoLabels(parsedLines):
     toCompileList = ["jump", "beq", "bgt", "bgts", "bge", "bges", "bne", "blt", "blts", "ble", "bles", "loadlabellow" ,"loadlabelhigh", ".dl"]
@@ -460,12 +622,237 @@ def checkNoLabels(parsedLines):
         
 
 
+#the steps of the assembly process before pass one
+#returns the code and the data (.data, .rdata and .bss) apart, for -O
+def prepareLines(parsedLines):
+    #move .data, .rdata and .bss sections down, in that order, so the .code section becomes one part at the top
+    code, data, rdata, bss = splitSections(parsedLines)
+
+    #remove all .code, .data, .rdata, .bss, .globl and .EOF lines
+    data = removeAssemblerDirectives(data + rdata + addBssLabels(bss))
+    parsedLines = removeAssemblerDirectives(code) + data
+
+    #insert libraries, they go above everything so the data stays at the end
+    parsedLines = insertLibraries(parsedLines)
+    dataLength = len([line for line in data if line[1][0].lower() != "define"])
+
+    #obtain and remove the define statements
+    defines, parsedLines = obtainDefines(parsedLines)
+    parsedLines = checkLibraryUnits(defines, parsedLines)
+
+    #replace defined words with their value
+    parsedLines = processDefines(defines, parsedLines)
+    return parsedLines[:len(parsedLines) - dataLength], parsedLines[len(parsedLines) - dataLength:]
+
+
+#Objects and linking
+#An object (mode obj) holds the result of pass one for each section of a file, so only
+#the lines with labels are left to be compiled, and the labels other objects may use (.globl).
+#All other labels are local to the object. An archive (.a) is a number of objects after
+#each other (cat a.o b.o > lib.a), of which only the ones that are needed are linked.
+
+objectHeader = ";B32P object"
+objectSections = [".code", ".data", ".rdata", ".bss"]
+
+#lines of pass one that refer to labels
+labelInstructions = ["jump", "beq", "bgt", "bgts", "bge", "bges", "bne", "blt", "blts", "ble", "bles", "loadlabellow" ,"loadlabelhigh", ".dl"]
+
+#assembles a file into an object and prints it
+def assembleObject(fileName):
+    code, data, rdata, bss = splitSections(parseLines(fileName))
+    code = insertLibraries(code)
+
+    globalLabels = [line[1][1] for line in code + data + rdata + bss if line[1][0] == ".globl" and len(line[1]) == 2]
+
+    sections = [removeAssemblerDirectives(lines) for lines in [code, data, rdata, bss]]
+    defines, _ = obtainDefines([line for lines in sections for line in lines])
+
+    print(objectHeader)
+    for label in globalLabels:
+        print(".globl " + label)
+    for name, lines in zip(objectSections, sections):
+        lines = checkLibraryUnits(defines, [line for line in lines if line[1][0].lower() != "define"])
+        print(name)
+        for line in passOne(processDefines(defines, lines)):
+            print(line[1])
+
+#reads the objects in an object file or archive
+def readObjects(fileName):
+    objects = []
+    lines = None
+
+    with open(fileName, 'r') as f:
+        for line in f:
+            line = line.rstrip('\n')
+            if line == objectHeader:
+                objects.append({"globals": set(), ".code": [], ".data": [], ".rdata": [], ".bss": []})
+                lines = objects[-1][".code"]
+            elif not objects:
+                print("Error: " + fileName + " is not an object file")
+                print("Assembler will now exit")
+                sys.exit(1)
+            elif line.split(" ")[0] == ".globl":
+                objects[-1]["globals"].add(line.split(" ")[1])
+            elif line in objectSections:
+                lines = objects[-1][line]
+            elif line != "":
+                lines.append((0, line))
+
+    return objects
+
+#adds the sets of labels an object defines and uses
+def findObjectLabels(obj):
+    obj["defined"] = set()
+    obj["used"] = set()
+    for name in objectSections:
+        for line in obj[name]:
+            words = line[1].split()
+            if words[0] == "Label":
+                obj["defined"].add(words[1][:-1])
+            elif words[0].lower() in labelInstructions:
+                obj["used"].update(words[1:])
+    obj["exported"] = obj["globals"] & obj["defined"]
+
+#renames the labels in a line of pass one
+def renameLabels(line, names):
+    words = line.split()
+    if words[0] == "Label":
+        return "Label " + names.get(words[1][:-1], words[1][:-1]) + ":"
+    if words[0].lower() in labelInstructions:
+        return " ".join([names.get(word, word) for word in words])
+    return line
+
+#links objects and archives into the lines of pass one for the whole program
+def linkObjects(fileNames):
+    objects = []
+    members = []
+    for fileName in fileNames:
+        if fileName.endswith(".a"):
+            members.extend(readObjects(fileName))
+        else:
+            objects.extend(readObjects(fileName))
+
+    for obj in objects + members:
+        findObjectLabels(obj)
+        obj["linked"] = False
+
+    #add the archive members that define labels that are still needed, until none is left
+    exported = set()
+    needed = set()
+    for obj in objects:
+        obj["linked"] = True
+        exported |= obj["exported"]
+        needed |= obj["used"] - obj["defined"]
+    added = True
+    while added:
+        added = False
+        for obj in members:
+            if not obj["linked"] and obj["exported"] & (needed - exported):
+                obj["linked"] = True
+                objects.append(obj)
+                exported |= obj["exported"]
+                needed |= obj["used"] - obj["defined"]
+                added = True
+
+    #local labels get the number of their object, the sections of all objects are put after each other
+    sections = {name: [] for name in objectSections}
+    for n, obj in enumerate(objects):
+        local = {label: label + "@" + str(n) for label in obj["defined"] - obj["globals"]}
+        for name in objectSections:
+            sections[name].extend([(0, renameLabels(line[1], local)) for line in obj[name]])
+
+    code = sections[".code"]
+    data = sections[".data"] + sections[".rdata"] + [(0, "Label Bss_Start:")] + sections[".bss"] + [(0, "Label Bss_End:"), (0, "space 0")]
+
+    if optimizeSize:
+        return removeUnreachableBlocks(code, data)
+
+    return code + data
+
+#whether a line of pass one never goes on to the line below it (jump, jumpo, jumpr, jumpro, reti and halt)
+def endsFlow(line):
+    comment = line.split(" //", maxsplit=1)[-1]
+    return line.split()[0].lower() == "jump" or comment.startswith("Jump to") or comment in ["Return from interrupt", "Halt"]
+
+#removes the functions and data that can't be reached from Main, Int and Syscall (-O)
+#code is split into blocks at the labels that are no Label_ labels, data at every label.
+#A block is reached when a reached block uses one of its labels (jump, branch, addr2reg, .dl),
+#or, for code, when the block above it is reached and does not end with a jump.
+#The data from GlobalPtr_Base on (bcc --gp) is addressed from that label, so it stays as a whole.
+def removeUnreachableBlocks(code, data):
+    blocks = []
+    roots = []
+
+    for part, isCode in [(code, True), (data, False)]:
+        block = None
+        globalPtrData = False
+        for line in part:
+            words = line[1].split()
+            if words[0] == "Label" and not globalPtrData and (not isCode or "Label_" not in words[1]):
+                #labels right after each other in code belong to the same block
+                if block is None or not isCode or block["lines"][-1][1].split()[0] != "Label":
+                    block = {"labels": [], "lines": [], "used": set(), "reached": False, "code": isCode}
+                    blocks.append(block)
+                if words[1] == "GlobalPtr_Base:":
+                    globalPtrData = True
+                    roots.append(block)
+            elif block is None:
+                block = {"labels": [], "lines": [], "used": set(), "reached": False, "code": isCode}
+                blocks.append(block)
+                roots.append(block)
+            if words[0] == "Label":
+                block["labels"].append(words[1][:-1])
+            elif words[0].lower() in labelInstructions:
+                block["used"].update(words[1:])
+            block["lines"].append(line)
+
+    owner = {}
+    for n, block in enumerate(blocks):
+        for label in block["labels"]:
+            owner[label] = block
+        instructions = [line[1] for line in block["lines"] if line[1].split()[0] not in ["Label", "Debug"]]
+        block["next"] = None
+        if block["code"] and n + 1 < len(blocks) and blocks[n+1]["code"] and not (instructions and endsFlow(instructions[-1])):
+            block["next"] = blocks[n+1]
+
+    todo = roots + [owner[label] for label in ["Main", "Int", "Syscall"] if label in owner]
+    while todo:
+        block = todo.pop()
+        if not block["reached"]:
+            block["reached"] = True
+            todo.extend([owner[label] for label in block["used"] if label in owner])
+            if block["next"]:
+                todo.append(block["next"])
+
+    if verbose:
+        removedWords = 0
+        removed = [block for block in blocks if not block["reached"]]
+        for block in removed:
+            size = sum([spaceSize(line[1]) for line in block["lines"] if line[1].split()[0] not in ["Label", "Debug"]])
+            removedWords += size
+            print("Removed " + block["labels"][0] + ": " + str(size) + " words", file=sys.stderr)
+        print("Removed " + str(len(removed)) + " symbols, " + str(removedWords) + " words", file=sys.stderr)
+
+    return [line for block in blocks if block["reached"] for line in block["lines"]]
+
+
 def main():
     #check assemble mode and offset
     global BDOSos
     global BDOSprogram
     global programOffset
     global optimizeSize
+    global debugMap
+    global verbose
+    global relocatable
+
+    #-g and -v can be given anywhere
+    if "-g" in sys.argv:
+        debugMap = True
+        sys.argv.remove("-g")
+    if "-v" in sys.argv:
+        verbose = True
+        sys.argv.remove("-v")
 
     if len(sys.argv) >= 3:
         BDOSprogram = (sys.argv[1].lower() == "bdos")
@@ -473,42 +860,36 @@ def main():
             programOffset = CompileInstruction.getNumber(sys.argv[2])
     if len(sys.argv) >= 2:
         BDOSos = (sys.argv[1].lower() == "os")
+        relocatable = (sys.argv[1].lower() == "reloc")
+        if relocatable:
+            BDOSprogram = True
     if sys.argv[len(sys.argv)-1] == "-O":
         optimizeSize = True
 
-    #parse lines from file
-    parsedLines = parseLines("code.asm")
-
-    #move .data sections down
-    parsedLines = moveDataDown(parsedLines)
-
-    #move .rdata sections down
-    parsedLines = moveRDataDown(parsedLines)
+    #assemble code.asm (or the given file) into an object
+    if len(sys.argv) >= 2 and sys.argv[1].lower() == "obj":
+        assembleObject(sys.argv[2] if len(sys.argv) >= 3 else "code.asm")
+        return
 
-    #move .bss sections down
-    parsedLines = moveBssDown(parsedLines)
+    objectFiles = [arg for arg in sys.argv[1:] if arg.endswith(".o") or arg.endswith(".a")]
 
-    #remove all .code, .data, .rdata, .bss and .EOF lines
-    parsedLines = removeAssemblerDirectives(parsedLines)
-
-    #insert libraries
-    parsedLines = insertLibraries(parsedLines)
-
-    if optimizeSize:
-        parsedLines = removeUnreachebleCode(parsedLines)
-
-    #obtain and remove the define statements
-    defines, parsedLines = obtainDefines(parsedLines)
-
-    #replace defined words with their value
-    parsedLines = processDefines(defines, parsedLines) 
-
-    #do pass one
-    passOneResult = passOne(parsedLines)
+    if objectFiles:
+        #link objects instead of assembling code.asm, pass one was done for them already
+        passOneResult = linkObjects(objectFiles)
+    else:
+        code, data = prepareLines(parseLines("code.asm"))
+        if optimizeSize:
+            passOneResult = removeUnreachableBlocks(passOne(code), passOne(data))
+        else:
+            passOneResult = passOne(code + data)
 
     #add interrupt code and jumps
     passOneResult = addHeaderCode(passOneResult)
 
+    #take out the debug lines, they are kept apart for the address map
+    passOneResult, debugLines = takeDebugLines(passOneResult)
+    labelLines = list(passOneResult)
+
     #move labels to the next line
     passOneResult = moveLabels(passOneResult)
 
@@ -520,18 +901,30 @@ def main():
     #removes label prefixes and creates mapping from label to line
     passOneResult, labelMap = getLabelMap(passOneResult) 
 
+    if debugMap:
+        writeDebugMap(labelLines, debugLines, passOneResult)
+
+    if relocatable:
+        relocations = findRelocations(passOneResult, labelMap)
+
     #do pass two
     passTwoResult = passTwo(passOneResult, labelMap)
 
     #check if all labels are processed
     checkNoLabels(passTwoResult)
 
+    #leave out the .bss words
+    passTwoResult = expandSpace(passTwoResult)
+
     #only add length of program if not BDOS user program
     if not BDOSprogram:
         lenString = '{0:032b}'.format(len(passTwoResult)) + " //Length of program"
         #calculate length of program
         passTwoResult[2] = (2, lenString)
 
+    if relocatable:
+        passTwoResult = addRelocations(passTwoResult, relocations)
+
     #print result without line numbers
     for line in passTwoResult:
         print(line[1])
@@ -336,11 +336,19 @@ def compileJumpro(line):
 #should have 3 arguments
 #arg1 should be a valid register
 #arg2 should be a valid register
-#arg3 should be a positive number that is within 16 bits signed
+#arg3 should be a number that is within 16 bits signed, or a label
 def compileBranch(line, opcode, signed):
     if len(line) != 4:
         raise Exception("Incorrect number of arguments. Expected 3, but got " + str(len(line)-1))
 
+    #if a label is given, process it later (after checking the registers)
+    try:
+        getNumber(line[3])
+    except:
+        getReg(line[1])
+        getReg(line[2])
+        return " ".join(line)
+
     const16 = ""
 
     #convert arg1 to number
@@ -908,6 +916,18 @@ def compileDs(line):
     return compileDb(dbList)
 
 
+#compiles .space instruction
+#should have 1 argument: the number of zero words to reserve
+#the words get addresses, but are only written to the output when data follows them
+def compileSpace(line):
+    if len(line) != 2:
+        raise Exception("Incorrect number of arguments. Expected 1, but got " + str(len(line)-1))
+
+    arg1Int = getNumber(line[1], False)
+
+    return "space " + str(arg1Int)
+
+
 #compiles .dl
 #should have 1 argument or a label
 #arg1 should be a positive number that is within 27 bits unsigned
@@ -946,6 +966,11 @@ def compileDl(line):
     return instruction
 
 
+#debug line of bcc -g (.func name or .line file number), kept for the address map
+def compileDebug(line):
+    return "Debug " + line[0][1:] + " " + " ".join(line[1:])
+
+
 #compile nothing
 def compileNothing(line):
     return "ignore"
\ No newline at end of file
@@ -0,0 +1,1698 @@
+/*****************************************************************************/
+/*                                                                           */
+/*                        ASM (B32P host assembler)                          */
+/*                                                                           */
+/*          Compiled version of Assembler.py for the host computer           */
+/*          Same input, modes and output, written directly to code.bin       */
+/*                                                                           */
+/*****************************************************************************/
+
+/* Notes:
+- follows the steps of Assembler.py (the functions have the same names), so the words
+    and the listing are identical to what Assembler.py prints
+- every step is one pass over the lines, labels, defines, libraries and the blocks
+    removed by -O are looked up in hash tables, so the time grows linearly with the program
+- usage: asm [os | bdos {offset} | reloc] [-O] [-g] [-v] [-l]
+    assembles code.asm into code.bin, -l also prints the listing to stdout
+- assembling objects (obj) and linking .o and .a files is only done by Assembler.py
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+
+// A line of assembly code split into words, with its line number in the source file
+typedef struct
+{
+  int no;
+  int cnt;
+  char** tok;
+} Line;
+
+typedef struct
+{
+  Line* line;
+  int cnt;
+  int cap;
+} LineList;
+
+// The result of pass one for a line: a compiled word, a label, a .space, a line with a label
+// that is compiled in pass two, the length of the program or a debug line of bcc -g
+enum
+{
+  ItemWord,
+  ItemLabel,
+  ItemSpace,
+  ItemPending,
+  ItemLength,
+  ItemDebug
+};
+
+typedef struct
+{
+  int kind;
+  unsigned word;
+  char* text; // comment after the word (" //..."), label name without ':' or debug text
+  Line* pend; // words of the line to compile in pass two
+  long count; // number of words of a .space
+  long addr;  // address, set by moveLabels()
+} Item;
+
+typedef struct
+{
+  Item* item;
+  int cnt;
+  int cap;
+} ItemList;
+
+// Hash table from strings to numbers
+typedef struct
+{
+  char** key;
+  long* val;
+  int cap;
+  int cnt;
+} Map;
+
+int BDOSos;          // assembling the BDOS operating system
+int BDOSprogram;     // assembling a BDOS user program
+long programOffset;  // address of the program in memory
+int relocatable;     // reloc: a BDOS user program with relocations, for address 0
+int optimizeSize;    // -O: remove unreachable code
+int debugMap;        // -g: write code.map
+int verbose;         // -v: print the symbols that -O removes and their size
+int listing;         // -l: print the listing
+
+Line* curLine;       // line that is being compiled, for errors
+ItemList* out;       // where the compile functions put their items
+Map libraryList;     // libraries that are inserted already
+
+/*
+------------------HELPERS---------------------
+*/
+
+char* format(const char* fmt, ...);
+
+void* xmalloc(size_t size)
+{
+  void* p = malloc(size ? size : 1);
+  if (!p)
+  {
+    fprintf(stderr, "Error: out of memory\n");
+    exit(1);
+  }
+  return p;
+}
+
+char* xstrdup(const char* s)
+{
+  return strcpy(xmalloc(strlen(s) + 1), s);
+}
+
+// prints an error, for the line that is being compiled if there is one, and exits
+void fail(const char* fmt, ...)
+{
+  va_list args;
+  int i;
+
+  if (curLine)
+  {
+    fprintf(stderr, "Error in line %d:", curLine->no);
+    for (i = 0; i < curLine->cnt; i++)
+      fprintf(stderr, " %s", curLine->tok[i]);
+    fprintf(stderr, "\nThe error is: ");
+  }
+  else
+    fprintf(stderr, "Error: ");
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  fprintf(stderr, "\nAssembler will now exit\n");
+  exit(1);
+}
+
+void pushLine(LineList* list, Line* l)
+{
+  if (list->cnt == list->cap)
+  {
+    list->cap = list->cap ? list->cap * 2 : 1024;
+    list->line = realloc(list->line, list->cap * sizeof(Line));
+    if (!list->line)
+      fail("out of memory");
+  }
+  list->line[list->cnt++] = *l;
+}
+
+Line* addLine(LineList* list, int no, int cnt)
+{
+  Line l;
+  l.no = no;
+  l.cnt = cnt;
+  l.tok = xmalloc(cnt * sizeof(char*));
+  pushLine(list, &l);
+  return &list->line[list->cnt - 1];
+}
+
+void appendLines(LineList* list, LineList* from)
+{
+  int i;
+  for (i = 0; i < from->cnt; i++)
+    pushLine(list, &from->line[i]);
+}
+
+// a line made of the given words
+Line* makeLine(int no, int cnt, ...)
+{
+  va_list args;
+  Line* l = xmalloc(sizeof(Line));
+  int i;
+
+  l->no = no;
+  l->cnt = cnt;
+  l->tok = xmalloc(cnt * sizeof(char*));
+  va_start(args, cnt);
+  for (i = 0; i < cnt; i++)
+    l->tok[i] = va_arg(args, char*);
+  va_end(args);
+  return l;
+}
+
+Item* addItem(ItemList* list, int kind)
+{
+  Item* it;
+  if (list->cnt == list->cap)
+  {
+    list->cap = list->cap ? list->cap * 2 : 1024;
+    list->item = realloc(list->item, list->cap * sizeof(Item));
+    if (!list->item)
+      fail("out of memory");
+  }
+  it = &list->item[list->cnt++];
+  memset(it, 0, sizeof(Item));
+  it->kind = kind;
+  return it;
+}
+
+unsigned hashString(const char* s)
+{
+  unsigned h = 2166136261u;
+  while (*s)
+    h = (h ^ (unsigned char)*s++) * 16777619u;
+  return h;
+}
+
+// returns the slot of the key in the map, an empty one if it is not in there
+int mapSlot(Map* m, const char* key)
+{
+  int i = hashString(key) & (m->cap - 1);
+  while (m->key[i] && strcmp(m->key[i], key))
+    i = (i + 1) & (m->cap - 1);
+  return i;
+}
+
+int mapGet(Map* m, const char* key, long* val)
+{
+  int i;
+  if (!m->cap)
+    return 0;
+  i = mapSlot(m, key);
+  if (!m->key[i])
+    return 0;
+  if (val)
+    *val = m->val[i];
+  return 1;
+}
+
+void mapPut(Map* m, const char* key, long val)
+{
+  int i;
+
+  if (2 * (m->cnt + 1) > m->cap)
+  {
+    Map old = *m;
+    m->cap = m->cap ? m->cap * 2 : 1024;
+    m->cnt = 0;
+    m->key = calloc(m->cap, sizeof(char*));
+    m->val = calloc(m->cap, sizeof(long));
+    if (!m->key || !m->val)
+      fail("out of memory");
+    for (i = 0; i < old.cap; i++)
+      if (old.key[i])
+        mapPut(m, old.key[i], old.val[i]);
+    free(old.key);
+    free(old.val);
+  }
+
+  i = mapSlot(m, key);
+  if (!m->key[i])
+  {
+    m->key[i] = (char*)key;
+    m->cnt++;
+  }
+  m->val[i] = val;
+}
+
+// whitespace as Python's str.split() sees it in ASCII
+int isSpace(int c)
+{
+  return c == ' ' || (c >= '\t' && c <= '\r') || (c >= 0x1C && c <= 0x1F);
+}
+
+/*
+------------------PARSING---------------------
+*/
+
+// adds a line made of the words of text, if there are any
+void addWords(LineList* list, int no, char* text)
+{
+  char* words[4096];
+  int cnt = 0, i;
+  char* p = text;
+
+  for (;;)
+  {
+    while (isSpace((unsigned char)*p))
+      p++;
+    if (!*p)
+      break;
+    if (cnt == 4096)
+      fail("too many words in line %d", no);
+    words[cnt++] = p;
+    while (*p && !isSpace((unsigned char)*p))
+      p++;
+    if (*p)
+      *p++ = '\0';
+  }
+
+  if (cnt)
+  {
+    Line* l = addLine(list, no, cnt);
+    for (i = 0; i < cnt; i++)
+      l->tok[i] = xstrdup(words[i]);
+  }
+}
+
+//reads the file into a list of lines split into words, without comments
+//lines end with \n, \r\n or \r, like when Python reads a text file
+LineList parseLines(const char* fileName)
+{
+  LineList list = {0};
+  FILE* f = fopen(fileName, "rb");
+  char* buf;
+  long size, pos = 0;
+  int no = 0;
+
+  if (!f)
+    fail("can not open %s", fileName);
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  buf = xmalloc(size + 1);
+  if (fread(buf, 1, size, f) != (size_t)size)
+    fail("can not read %s", fileName);
+  buf[size] = '\0';
+  fclose(f);
+
+  while (pos < size)
+  {
+    char* line = buf + pos;
+    long len = 0, pyLen;
+    char* semi;
+
+    while (pos + len < size && buf[pos + len] != '\n' && buf[pos + len] != '\r')
+      len++;
+    pyLen = len + (pos + len < size); // length with the newline
+    pos += len;
+    if (pos < size && buf[pos] == '\r' && pos + 1 < size && buf[pos + 1] == '\n')
+      pos++;
+    if (pos < size)
+      pos++;
+    line[len] = '\0';
+    no++;
+
+    // do something special in case of a .ds instruction
+    if (pyLen > 4 && !strncmp(line, ".ds ", 4))
+    {
+      Line* l = addLine(&list, no, 2);
+      l->tok[0] = ".ds";
+      l->tok[1] = xstrdup(line + 4);
+    }
+    // the ;@func and ;@line comments of bcc -g become debug lines
+    else if (debugMap && (!strncmp(line, ";@func ", 7) || !strncmp(line, ";@line ", 7) ||
+                          !strcmp(line, ";@func") || !strcmp(line, ";@line")))
+    {
+      char* rest = len > 7 ? line + 7 : "";
+      char* sp = strrchr(rest, ' ');
+      Line* l = addLine(&list, no, sp ? 3 : 2);
+      l->tok[0] = line[2] == 'f' ? ".func" : ".line";
+      if (sp)
+      {
+        *sp = '\0';
+        l->tok[2] = xstrdup(sp + 1);
+      }
+      l->tok[1] = xstrdup(rest);
+    }
+    else
+    {
+      if ((semi = strchr(line, ';')) != NULL)
+        *semi = '\0';
+      addWords(&list, no, line);
+    }
+  }
+
+  addLine(&list, 0, 1)->tok[0] = ".EOF"; // add end of file token
+  free(buf);
+  return list;
+}
+
+int isSection(const char* word)
+{
+  return !strcmp(word, ".code") || !strcmp(word, ".data") || !strcmp(word, ".rdata") || !strcmp(word, ".bss");
+}
+
+//moves all .data, .rdata and .bss sections down, in that order, so the .code section becomes one part at the top
+//the labels Bss_Start and Bss_End are put around the .bss sections
+//dataLength is set to the number of lines below the code that stay after the directives and defines are removed
+LineList moveSectionsDown(LineList* parsed, int* dataLength)
+{
+  LineList sections[4] = {{0}};
+  LineList result = {0};
+  int current = 0, i;
+
+  for (i = 0; i < parsed->cnt; i++)
+  {
+    Line* l = &parsed->line[i];
+    if (!strcmp(l->tok[0], ".EOF"))
+      break;
+    if (isSection(l->tok[0]))
+      current = !strcmp(l->tok[0], ".code") ? 0 : !strcmp(l->tok[0], ".data") ? 1 : !strcmp(l->tok[0], ".rdata") ? 2 : 3;
+    pushLine(&sections[current], l);
+    if (current && !isSection(l->tok[0]) && strcmp(l->tok[0], ".globl") && strcasecmp(l->tok[0], "define"))
+      (*dataLength)++;
+  }
+  *dataLength += 3;
+
+  appendLines(&result, &sections[0]);
+  appendLines(&result, &sections[1]);
+  appendLines(&result, &sections[2]);
+  addLine(&result, 0, 1)->tok[0] = "Bss_Start:";
+  appendLines(&result, &sections[3]);
+  addLine(&result, 0, 1)->tok[0] = "Bss_End:";
+  addLine(&result, 0, 2)->tok[0] = ".space";
+  result.line[result.cnt - 1].tok[1] = "0";
+  return result;
+}
+
+LineList removeAssemblerDirectives(LineList* parsed)
+{
+  LineList result = {0};
+  int i;
+
+  for (i = 0; i < parsed->cnt; i++)
+  {
+    char* w = parsed->line[i].tok[0];
+    if (!isSection(w) && strcmp(w, ".EOF") && strcmp(w, ".globl"))
+      pushLine(&result, &parsed->line[i]);
+  }
+  return result;
+}
+
+//puts the libraries (recursively) in front of the lines, the last included library first
+LineList insertLibraries(LineList* parsed)
+{
+  LineList* inserted = xmalloc(parsed->cnt * sizeof(LineList));
+  LineList result = {0};
+  int cnt = 0, i;
+
+  for (i = 0; i < parsed->cnt; i++)
+  {
+    Line* l = &parsed->line[i];
+    if (l->cnt == 2 && !strcmp(l->tok[0], "`include") && !mapGet(&libraryList, l->tok[1], NULL))
+    {
+      LineList lib;
+      mapPut(&libraryList, l->tok[1], 1);
+      lib = parseLines(l->tok[1]);
+      inserted[cnt++] = insertLibraries(&lib); //recursion to include libraries within libraries
+    }
+  }
+
+  while (cnt > 0)
+    appendLines(&result, &inserted[--cnt]);
+  appendLines(&result, parsed);
+  free(inserted);
+  return result;
+}
+
+//reads and removes the define statements, and replaces the defined words with their value
+LineList processDefines(LineList* content)
+{
+  Map defines = {0};
+  LineList result = {0};
+  int i, j;
+  long k;
+
+  for (i = 0; i < content->cnt; i++)
+  {
+    Line* l = &content->line[i];
+    if (strlen(l->tok[0]) == 6 && !strncasecmp(l->tok[0], "define", 6))
+    {
+      if (l->cnt != 4 || strcmp(l->tok[2], "="))
+      {
+        curLine = l;
+        fail("Invalid define statement");
+      }
+    }
+  }
+
+  for (i = 0; i < content->cnt; i++)
+  {
+    Line* l = &content->line[i];
+    if (strlen(l->tok[0]) == 6 && !strncasecmp(l->tok[0], "define", 6))
+    {
+      if (mapGet(&defines, l->tok[1], NULL))
+        fail("define %s is already defined", l->tok[1]);
+      mapPut(&defines, l->tok[1], (long)l->tok[3]);
+    }
+  }
+
+  for (i = 0; i < content->cnt; i++)
+  {
+    Line* l = &content->line[i];
+    if (strlen(l->tok[0]) == 6 && !strncasecmp(l->tok[0], "define", 6))
+      continue;
+    if (defines.cnt)
+      for (j = 0; j < l->cnt; j++)
+        if (mapGet(&defines, l->tok[j], &k))
+          l->tok[j] = (char*)k;
+    pushLine(&result, l);
+  }
+  return result;
+}
+
+/*
+------------------LINE COMPILING FUNCTIONS---------------------
+*/
+
+#define BIG_NUMBER (1LL << 62) // numbers do not get larger, they don't fit in any instruction anyway
+
+//reads the digits of a number like Python's int(): digits with single underscores between them
+int readDigits(const char* s, int base, long long* value)
+{
+  long long v = 0;
+  int digits = 0;
+
+  for (; *s; s++)
+  {
+    int d;
+    if (*s == '_' && digits && s[1] && s[1] != '_')
+      continue;
+    if (*s >= '0' && *s <= '9')
+      d = *s - '0';
+    else if (*s >= 'a' && *s <= 'f')
+      d = *s - 'a' + 10;
+    else if (*s >= 'A' && *s <= 'F')
+      d = *s - 'A' + 10;
+    else
+      return 0;
+    if (d >= base)
+      return 0;
+    v = v < BIG_NUMBER ? v * base + d : BIG_NUMBER;
+    digits++;
+  }
+  *value = v < BIG_NUMBER ? v : BIG_NUMBER;
+  return digits > 0;
+}
+
+//converts string to int, string can be binary (0b), hex (0x) or decimal
+//returns 0 and sets the error if it is no valid number
+char numberError[4200];
+
+int tryNumber(const char* word, int allowNeg, long long* value)
+{
+  long long v = 0;
+  size_t len = strlen(word);
+
+  if (len > 2 && !strncmp(word, "0b", 2))
+  {
+    if (!readDigits(word + 2 + (word[2] == '_'), 2, &v))
+    {
+      snprintf(numberError, sizeof numberError, "%s is not a valid binary number", word);
+      return 0;
+    }
+  }
+  else if (len > 2 && !strncmp(word, "0x", 2))
+  {
+    if (!readDigits(word + 2 + (word[2] == '_'), 16, &v))
+    {
+      snprintf(numberError, sizeof numberError, "%s is not a valid hex number", word);
+      return 0;
+    }
+  }
+  else
+  {
+    const char* p = word + (*word == '+' || *word == '-');
+    if (!readDigits(p, 10, &v))
+    {
+      snprintf(numberError, sizeof numberError, "%s is not a valid decimal number", word);
+      return 0;
+    }
+    if (*word == '-')
+      v = -v;
+  }
+
+  if (v < 0 && !allowNeg)
+  {
+    snprintf(numberError, sizeof numberError, "%s is a negative number (which are not allowed)", word);
+    return 0;
+  }
+  *value = v;
+  return 1;
+}
+
+long long getNumber(const char* word, int allowNeg)
+{
+  long long v;
+  if (!tryNumber(word, allowNeg, &v))
+    fail("%s", numberError);
+  return v;
+}
+
+//converts string to int, representing the register
+int getReg(const char* word)
+{
+  long long v;
+
+  if (word[0] != 'r' && word[0] != 'R')
+    fail("Register %s does not start with 'r'", word);
+  if (!strcasecmp(word, "rbp"))
+    return 14;
+  if (!strcasecmp(word, "rsp"))
+    return 15;
+  if (!readDigits(word + 1 + (word[1] == '+' || word[1] == '-'), 10, &v))
+    fail("Register%s is not a valid register", word);
+  if (word[1] == '-')
+    v = -v;
+  if (v < 0 || v > 15)
+    fail("Register %s is not a valid register", word);
+  return (int)v;
+}
+
+//checks if the given value fits in the given number of bits (signed numbers have one bit less)
+void checkFitsInBits(long long value, int bits, int isSigned)
+{
+  unsigned long long a = value < 0 ? -(unsigned long long)value : (unsigned long long)value;
+  int len = 0;
+
+  if (isSigned)
+    bits--;
+  while (a)
+  {
+    len++;
+    a >>= 1;
+  }
+  if (len > bits)
+    fail("Value %lld does not fit in %d bits", value, bits);
+}
+
+void checkArgs(Line* l, int expected)
+{
+  if (l->cnt != expected + 1)
+    fail("Incorrect number of arguments. Expected %d, but got %d", expected, l->cnt - 1);
+}
+
+char* format(const char* fmt, ...)
+{
+  char buf[8400];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buf, sizeof buf, fmt, args);
+  va_end(args);
+  return xstrdup(buf);
+}
+
+void emitWord(unsigned word, char* comment)
+{
+  Item* it = addItem(out, ItemWord);
+  it->word = word;
+  it->text = comment;
+}
+
+void emitPending(Line* l)
+{
+  addItem(out, ItemPending)->pend = l;
+}
+
+void compileHalt(Line* l)
+{
+  checkArgs(l, 0);
+  emitWord(0xFFFFFFFF, " //Halt");
+}
+
+void compileRead(Line* l)
+{
+  long long c;
+  int a, d;
+  checkArgs(l, 3);
+  c = getNumber(l->tok[1], 1);
+  checkFitsInBits(c, 16, 1);
+  a = getReg(l->tok[2]);
+  d = getReg(l->tok[3]);
+  emitWord(0xEu << 28 | (unsigned)(c & 0xFFFF) << 12 | a << 8 | d,
+           format(" //Read at address in %s with offset %s to %s", l->tok[2], l->tok[1], l->tok[3]));
+}
+
+void compileWrite(Line* l)
+{
+  long long c;
+  int a, b;
+  checkArgs(l, 3);
+  c = getNumber(l->tok[1], 1);
+  checkFitsInBits(c, 16, 1);
+  a = getReg(l->tok[2]);
+  b = getReg(l->tok[3]);
+  emitWord(0xDu << 28 | (unsigned)(c & 0xFFFF) << 12 | a << 8 | b << 4,
+           format(" //Write value in %s to address in %s with offset %s", l->tok[3], l->tok[2], l->tok[1]));
+}
+
+void compileIntID(Line* l)
+{
+  checkArgs(l, 1);
+  emitWord(0xCu << 28 | getReg(l->tok[1]), format(" //Save Interrupt ID to %s", l->tok[1]));
+}
+
+void compilePush(Line* l)
+{
+  checkArgs(l, 1);
+  emitWord(0xBu << 28 | getReg(l->tok[1]) << 4, format(" //Push %s to stack", l->tok[1]));
+}
+
+void compilePop(Line* l)
+{
+  checkArgs(l, 1);
+  emitWord(0xAu << 28 | getReg(l->tok[1]), format(" //Pop from stack to %s", l->tok[1]));
+}
+
+//a jump to a label is compiled in pass two
+void compileJump(Line* l)
+{
+  long long v;
+  checkArgs(l, 1);
+  if (!tryNumber(l->tok[1], 0, &v))
+  {
+    emitPending(l);
+    return;
+  }
+  checkFitsInBits(v, 27, 0);
+  emitWord(0x9u << 28 | (unsigned)v << 1, format(" //Jump to constant address %s", l->tok[1]));
+}
+
+void compileJumpo(Line* l)
+{
+  long long v;
+  checkArgs(l, 1);
+  v = getNumber(l->tok[1], 0);
+  checkFitsInBits(v, 27, 0);
+  emitWord(0x9u << 28 | (unsigned)v << 1 | 1, format(" //Jump to offset address %s", l->tok[1]));
+}
+
+//only the lowest 12 bits of the offset are used, like Assembler.py does
+void compileJumpr(Line* l)
+{
+  long long c;
+  int b;
+  checkArgs(l, 2);
+  c = getNumber(l->tok[1], 1);
+  checkFitsInBits(c, 16, 1);
+  b = getReg(l->tok[2]);
+  emitWord(0x8u << 28 | (unsigned)(c & 0xFFF) << 12 | b << 4,
+           format(" //Jump to reg %s with offset %s", l->tok[2], l->tok[1]));
+}
+
+void compileJumpro(Line* l)
+{
+  long long c;
+  int b;
+  checkArgs(l, 2);
+  c = getNumber(l->tok[1], 1);
+  checkFitsInBits(c, 16, 1);
+  b = getReg(l->tok[2]);
+  emitWord(0x8u << 28 | (unsigned)(c & 0xFFFF) << 12 | b << 4 | 1,
+           format(" //Jump to offset in reg %s with offset %s", l->tok[2], l->tok[1]));
+}
+
+//a branch to a label is compiled in pass two (after checking the registers)
+void compileBranch(Line* l, int opcode, int isSigned)
+{
+  static const char* ops[8] = {" == ", " > ", " >= ", " ?? ", " != ", " < ", " <= ", " ?? "};
+  long long c;
+  int a, b;
+
+  checkArgs(l, 3);
+  if (!tryNumber(l->tok[3], 1, &c))
+  {
+    getReg(l->tok[1]);
+    getReg(l->tok[2]);
+    emitPending(l);
+    return;
+  }
+  a = getReg(l->tok[1]);
+  b = getReg(l->tok[2]);
+  checkFitsInBits(c, 16, 1);
+  emitWord(0x6u << 28 | (unsigned)(c & 0xFFFF) << 12 | a << 8 | b << 4 | opcode << 1 | isSigned,
+           format(" //%s If %s%s%s, then jump to offset %s", isSigned ? "(signed)" : "(unsigned)",
+                  l->tok[1], ops[opcode], l->tok[2], l->tok[3]));
+}
+
+void compileBEQ(Line* l) { compileBranch(l, 0, 0); }
+void compileBGT(Line* l) { compileBranch(l, 1, 0); }
+void compileBGTS(Line* l) { compileBranch(l, 1, 1); }
+void compileBGE(Line* l) { compileBranch(l, 2, 0); }
+void compileBGES(Line* l) { compileBranch(l, 2, 1); }
+void compileBNE(Line* l) { compileBranch(l, 4, 0); }
+void compileBLT(Line* l) { compileBranch(l, 5, 0); }
+void compileBLTS(Line* l) { compileBranch(l, 5, 1); }
+void compileBLE(Line* l) { compileBranch(l, 6, 0); }
+void compileBLES(Line* l) { compileBranch(l, 6, 1); }
+
+void compileSavPC(Line* l)
+{
+  checkArgs(l, 1);
+  emitWord(0x5u << 28 | getReg(l->tok[1]), format(" //Save PC to %s", l->tok[1]));
+}
+
+void compileReti(Line* l)
+{
+  checkArgs(l, 0);
+  emitWord(0x40000000, " //Return from interrupt");
+}
+
+void compileCcache(Line* l)
+{
+  checkArgs(l, 0);
+  emitWord(0x70000000, " //Clear L1 Cache");
+}
+
+//compiles ARITH/ARITHC instructions, except LOAD/LOADHI
+void compileARITH(Line* l, int opcode)
+{
+  static const char* ops[16] = {" OR ", " AND ", " XOR ", " + ", " - ", " << ", " >> ", " ~A ",
+                                " * (signed) ", " * (unsigned) ", " SLT ", " SLTU ", "", "", " >> (signed) ", " * (signed FP) "};
+  int a, b = 0, d, constant;
+  long long c = 0;
+  char* comment;
+
+  checkArgs(l, 3);
+  a = getReg(l->tok[1]);
+  constant = l->tok[2][0] != 'r' && l->tok[2][0] != 'R';
+  if (constant)
+  {
+    c = getNumber(l->tok[2], 1);
+    checkFitsInBits(c, 16, 1);
+  }
+  else
+    b = getReg(l->tok[2]);
+  d = getReg(l->tok[3]);
+
+  comment = format(" //Compute %s%s%s and write result to %s", l->tok[1], ops[opcode], l->tok[2], l->tok[3]);
+  if (constant)
+    emitWord(0x1u << 28 | opcode << 24 | (unsigned)(c & 0xFFFF) << 8 | a << 4 | d, comment);
+  else
+    emitWord(opcode << 24 | a << 8 | b << 4 | d, comment);
+}
+
+void compileOR(Line* l) { compileARITH(l, 0); }
+void compileAND(Line* l) { compileARITH(l, 1); }
+void compileXOR(Line* l) { compileARITH(l, 2); }
+void compileADD(Line* l) { compileARITH(l, 3); }
+void compileSUB(Line* l) { compileARITH(l, 4); }
+void compileSHIFTL(Line* l) { compileARITH(l, 5); }
+void compileSHIFTR(Line* l) { compileARITH(l, 6); }
+void compileMULTS(Line* l) { compileARITH(l, 8); }
+void compileMULTU(Line* l) { compileARITH(l, 9); }
+void compileSLT(Line* l) { compileARITH(l, 10); }
+void compileSLTU(Line* l) { compileARITH(l, 11); }
+void compileSHIFTRS(Line* l) { compileARITH(l, 14); }
+void compileMULTFP(Line* l) { compileARITH(l, 15); }
+
+void compileNOT(Line* l)
+{
+  int a, d;
+  checkArgs(l, 2);
+  a = getReg(l->tok[1]);
+  d = getReg(l->tok[2]);
+  emitWord(0x07u << 24 | a << 8 | d, format(" //Compute NOT %s and write result to %s", l->tok[1], l->tok[2]));
+}
+
+void compileLoad(Line* l)
+{
+  long long v;
+  int d;
+  checkArgs(l, 2);
+  v = getNumber(l->tok[1], 0);
+  checkFitsInBits(v, 16, 0);
+  d = getReg(l->tok[2]);
+  emitWord(0x1Cu << 24 | (unsigned)v << 8 | d << 4 | d, format(" //Set %s to %s", l->tok[2], l->tok[1]));
+}
+
+void compileLoadHi(Line* l)
+{
+  long long v;
+  int d;
+  checkArgs(l, 2);
+  v = getNumber(l->tok[1], 0);
+  checkFitsInBits(v, 16, 0);
+  d = getReg(l->tok[2]);
+  emitWord(0x1Du << 24 | (unsigned)v << 8 | d << 4 | d, format(" //Set highest 16 bits of %s to %s", l->tok[2], l->tok[1]));
+}
+
+//addr2reg becomes loadLabelLow and loadLabelHigh, compiled in pass two
+void compileAddr2reg(Line* l)
+{
+  checkArgs(l, 2);
+  getReg(l->tok[2]);
+  emitPending(makeLine(l->no, 3, "loadLabelLow", l->tok[1], l->tok[2]));
+  emitPending(makeLine(l->no, 3, "loadLabelHigh", l->tok[1], l->tok[2]));
+}
+
+//load32 becomes a load, followed by a loadhi if the value does not fit in 16 bits
+void compileLoad32(Line* l)
+{
+  long long v;
+  unsigned w;
+
+  checkArgs(l, 2);
+  v = getNumber(l->tok[1], 1);
+  if (v >= 0 && v < 0x10000)
+  {
+    compileLoad(l);
+    return;
+  }
+  if (v >= 0)
+    checkFitsInBits(v, 32, 0);
+  else if (v < -2147483648LL)
+    fail("Negative value %lld does not fit in 32 bits (signed)", v);
+
+  w = (unsigned)v;
+  compileLoad(makeLine(l->no, 3, "load", format("%u", w & 0xFFFF), l->tok[2]));
+  compileLoadHi(makeLine(l->no, 3, "loadhi", format("%u", w >> 16), l->tok[2]));
+}
+
+//splits an address into the 11 highest and 16 lowest of (at least) 27 bits
+int addressBits(long long v)
+{
+  int len = 0;
+  while (v >> len)
+    len++;
+  return len > 27 ? len - 11 : 16;
+}
+
+void compileLoadLabelLow(Line* l)
+{
+  long long v;
+  int d;
+  checkArgs(l, 2);
+  v = getNumber(l->tok[1], 0);
+  v &= (1LL << addressBits(v)) - 1;
+  checkFitsInBits(v, 16, 0);
+  d = getReg(l->tok[2]);
+  emitWord(0x1Cu << 24 | (unsigned)v << 8 | d << 4 | d, format(" //Set %s to %lld", l->tok[2], v));
+}
+
+void compileLoadLabelHigh(Line* l)
+{
+  long long v;
+  int d;
+  checkArgs(l, 2);
+  v = getNumber(l->tok[1], 0);
+  v >>= addressBits(v);
+  checkFitsInBits(v, 16, 0);
+  d = getReg(l->tok[2]);
+  emitWord(0x1Du << 24 | (unsigned)v << 8 | d << 4 | d, format(" //Set highest 16 bits of %s to %lld", l->tok[2], v));
+}
+
+void compileNop(Line* l)
+{
+  checkArgs(l, 0);
+  emitWord(0, " //NOP");
+}
+
+void checkDataArgs(Line* l)
+{
+  if (l->cnt < 2)
+    fail("Incorrect number of arguments. Expected 1 or more, but got %d", l->cnt - 1);
+}
+
+//data words, the words of the line that are the directive itself are skipped
+void compileDw(Line* l)
+{
+  int i;
+  checkDataArgs(l);
+  for (i = 0; i < l->cnt; i++)
+    if (strcmp(l->tok[i], ".dw"))
+    {
+      long long v = getNumber(l->tok[i], 1);
+      if (l->tok[i][0] == '-' && v < 0)
+        checkFitsInBits(v, 33, 1);
+      else
+        checkFitsInBits(v, 32, 0);
+    }
+  for (i = 0; i < l->cnt; i++)
+    if (strcmp(l->tok[i], ".dw"))
+      emitWord((unsigned)getNumber(l->tok[i], 1), " //data");
+}
+
+//values of the given number of bits, packed into words starting at the highest bits
+void compilePacked(Line* l, const char* directive, int bits)
+{
+  int i, pos = 0;
+  unsigned w = 0;
+
+  checkDataArgs(l);
+  for (i = 0; i < l->cnt; i++)
+    if (strcmp(l->tok[i], directive))
+    {
+      long long v = getNumber(l->tok[i], 0);
+      checkFitsInBits(v, bits, 0);
+    }
+  for (i = 0; i < l->cnt; i++)
+    if (strcmp(l->tok[i], directive))
+    {
+      pos += bits;
+      w |= (unsigned)getNumber(l->tok[i], 0) << (32 - pos);
+      if (pos == 32)
+      {
+        emitWord(w, " //data");
+        pos = 0;
+        w = 0;
+      }
+    }
+  if (pos)
+    emitWord(w, " //data");
+}
+
+void compileDd(Line* l) { compilePacked(l, ".dd", 16); }
+void compileDb(Line* l) { compilePacked(l, ".db", 8); }
+
+//a string becomes a .db line with the (unicode) value of each character
+void compileDs(Line* l)
+{
+  Line* db;
+  const unsigned char* s;
+  size_t len;
+  int cnt = 1;
+
+  checkArgs(l, 1);
+  s = (const unsigned char*)l->tok[1];
+  len = strlen(l->tok[1]);
+  if (!len || s[0] != '"' || s[len - 1] != '"')
+    fail("Invalid string: %s", l->tok[1]);
+
+  db = makeLine(l->no, 1, ".db");
+  db->tok = realloc(db->tok, (len + 1) * sizeof(char*));
+  for (s++; s < (const unsigned char*)l->tok[1] + len - 1;)
+  {
+    unsigned c = *s++;
+    int more = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+    if (more)
+      c &= 0x3F >> more;
+    while (more-- && (*s & 0xC0) == 0x80)
+      c = c << 6 | (*s++ & 0x3F);
+    db->tok[cnt++] = format("%u", c);
+  }
+  db->cnt = cnt;
+  compileDb(db);
+}
+
+void compileSpace(Line* l)
+{
+  checkArgs(l, 1);
+  addItem(out, ItemSpace)->count = (long)getNumber(l->tok[1], 0);
+}
+
+//a .dl with a label is compiled in pass two
+void compileDl(Line* l)
+{
+  long long v;
+  checkArgs(l, 1);
+  if (!tryNumber(l->tok[1], 0, &v))
+  {
+    emitPending(l);
+    return;
+  }
+  checkFitsInBits(v, 27, 0);
+  emitWord((unsigned)v, format(" //Label data %s", l->tok[1]));
+}
+
+//debug line of bcc -g (.func name or .line file number), kept for the address map
+void compileDebug(Line* l)
+{
+  char* text = format("%s ", l->tok[0] + 1);
+  int i;
+
+  for (i = 1; i < l->cnt; i++)
+    text = format(i == 1 ? "%s%s" : "%s %s", text, l->tok[i]);
+  addItem(out, ItemDebug)->text = text;
+}
+
+void compileNothing(Line* l)
+{
+  (void)l;
+}
+
+typedef struct
+{
+  const char* name;
+  void (*compile)(Line* l);
+} Instruction;
+
+Instruction instructions[] =
+{
+  { "halt", compileHalt },
+  { "read", compileRead },
+  { "write", compileWrite },
+  { "readintid", compileIntID },
+  { "push", compilePush },
+  { "pop", compilePop },
+  { "jump", compileJump },
+  { "jumpo", compileJumpo },
+  { "jumpr", compileJumpr },
+  { "jumpro", compileJumpro },
+  { "beq", compileBEQ },
+  { "bgt", compileBGT },
+  { "bgts", compileBGTS },
+  { "bge", compileBGE },
+  { "bges", compileBGES },
+  { "bne", compileBNE },
+  { "blt", compileBLT },
+  { "blts", compileBLTS },
+  { "ble", compileBLE },
+  { "bles", compileBLES },
+  { "savpc", compileSavPC },
+  { "reti", compileReti },
+  { "ccache", compileCcache },
+  { "or", compileOR },
+  { "and", compileAND },
+  { "xor", compileXOR },
+  { "add", compileADD },
+  { "sub", compileSUB },
+  { "shiftl", compileSHIFTL },
+  { "shiftr", compileSHIFTR },
+  { "shiftrs", compileSHIFTRS },
+  { "not", compileNOT },
+  { "mults", compileMULTS },
+  { "multu", compileMULTU },
+  { "multfp", compileMULTFP },
+  { "slt", compileSLT },
+  { "sltu", compileSLTU },
+  { "load", compileLoad },
+  { "loadhi", compileLoadHi },
+  { "addr2reg", compileAddr2reg },
+  { "load32", compileLoad32 },
+  { "nop", compileNop },
+  { ".dw", compileDw },
+  { ".dd", compileDd },
+  { ".db", compileDb },
+  { ".ds", compileDs },
+  { ".dl", compileDl },
+  { ".space", compileSpace },
+  { ".func", compileDebug },
+  { ".line", compileDebug },
+  { ".globl", compileNothing },
+  { "loadlabellow", compileLoadLabelLow },
+  { "loadlabelhigh", compileLoadLabelHigh },
+  { "`include", compileNothing },
+  { ".eof", compileNothing },
+  { NULL, NULL }
+};
+
+Map instructionMap;
+
+//branches take the offset to a label instead of its address
+int isBranch(const char* word)
+{
+  static const char* branches[] = {"beq", "bgt", "bgts", "bge", "bges", "bne", "blt", "blts", "ble", "bles", NULL};
+  int i;
+  for (i = 0; branches[i]; i++)
+    if (!strcasecmp(word, branches[i]))
+      return 1;
+  return 0;
+}
+
+void compileLine(Line* l)
+{
+  char name[32];
+  long k;
+  size_t i, len = strlen(l->tok[0]);
+
+  for (i = 0; i < len && i < sizeof name - 1; i++)
+    name[i] = (l->tok[0][i] >= 'A' && l->tok[0][i] <= 'Z') ? l->tok[0][i] - 'A' + 'a' : l->tok[0][i];
+  name[i] = '\0';
+
+  if (len < sizeof name && mapGet(&instructionMap, name, &k))
+    instructions[k].compile(l);
+  //check if line is a label
+  else if (l->cnt == 1 && l->tok[0][len - 1] == ':')
+    addItem(out, ItemLabel)->text = format("%.*s", (int)len - 1, l->tok[0]);
+  else
+    fail("Unknown instruction '%s'", l->tok[0]);
+}
+
+//compiles lines that can be compiled directly, the others are kept for pass two
+ItemList passOne(LineList* parsed)
+{
+  ItemList result = {0};
+  int i;
+
+  out = &result;
+  for (i = 0; i < parsed->cnt; i++)
+  {
+    curLine = &parsed->line[i];
+    compileLine(curLine);
+  }
+  curLine = NULL;
+  out = NULL;
+  return result;
+}
+
+/*
+------------------ASSEMBLING---------------------
+*/
+
+//whether an item of pass one never goes on to the item below it (jump, jumpo, jumpr, jumpro, reti and halt)
+int endsFlow(Item* it)
+{
+  if (it->kind == ItemPending)
+    return !strcasecmp(it->pend->tok[0], "jump");
+  return it->kind == ItemWord && (!strncmp(it->text, " //Jump to", 10) ||
+         !strcmp(it->text, " //Return from interrupt") || !strcmp(it->text, " //Halt"));
+}
+
+//removes the functions and data that can't be reached from Main, Int and Syscall (-O)
+//code is split into blocks at the labels that are no Label_ labels, data at every label.
+//A block is reached when a reached block uses one of its labels (jump, branch, addr2reg, .dl),
+//or, for code, when the block above it is reached and does not end with a jump.
+//The data from GlobalPtr_Base on (bcc --gp) is addressed from that label, so it stays as a whole.
+//Each block is walked once, the labels are looked up in a hash table
+ItemList removeUnreachableBlocks(ItemList* code, ItemList* data)
+{
+  int n = code->cnt + data->cnt, i, j, cur = -1, blocks = 0, todoCnt = 0, globalPtrData = 0;
+  Item** item = xmalloc((n + 1) * sizeof(Item*));
+  int* first = xmalloc((n + 1) * sizeof(int));  // per block, its first item
+  int* falls = xmalloc((n + 1) * sizeof(int));  // per block, whether it goes on to the block below it
+  int* todo;
+  char* isCode = xmalloc(n + 1);
+  char* reached = calloc(n + 1, 1);
+  const char* roots[] = {"Main", "Int", "Syscall"};
+  Map owner = {0};
+  ItemList result = {0};
+  long k, removedWords = 0;
+  int removedCnt = 0, todoCap = n + 4;
+
+  //a block is put on the list once as a root, or for a block above it, or for a use of one of its labels
+  for (i = 0; i < n; i++)
+  {
+    Item* it = i < code->cnt ? &code->item[i] : &data->item[i - code->cnt];
+    if (it->kind == ItemPending)
+      todoCap += it->pend->cnt;
+  }
+  todo = xmalloc(todoCap * sizeof(int));
+
+  for (i = 0; i < n; i++)
+  {
+    int inCode = i < code->cnt;
+    Item* it = item[i] = inCode ? &code->item[i] : &data->item[i - code->cnt];
+
+    if (i == code->cnt)
+    {
+      cur = -1;
+      globalPtrData = 0;
+    }
+    if (it->kind == ItemLabel && !globalPtrData && (!inCode || !strstr(it->text, "Label_")))
+    {
+      //labels right after each other in code belong to the same block
+      if (cur < 0 || !inCode || item[i - 1]->kind != ItemLabel)
+      {
+        first[blocks] = i;
+        isCode[blocks] = inCode;
+        cur = blocks++;
+      }
+      if (!strcmp(it->text, "GlobalPtr_Base"))
+      {
+        globalPtrData = 1;
+        todo[todoCnt++] = cur;
+      }
+    }
+    else if (cur < 0)
+    {
+      first[blocks] = i;
+      isCode[blocks] = inCode;
+      cur = blocks++;
+      todo[todoCnt++] = cur;
+    }
+    if (it->kind == ItemLabel)
+      mapPut(&owner, it->text, cur);
+  }
+  first[blocks] = n;
+
+  for (j = 0; j < blocks; j++)
+  {
+    int last = -1;
+    for (i = first[j]; i < first[j + 1]; i++)
+      if (item[i]->kind != ItemLabel && item[i]->kind != ItemDebug)
+        last = i;
+    falls[j] = isCode[j] && j + 1 < blocks && isCode[j + 1] && !(last >= 0 && endsFlow(item[last]));
+  }
+
+  for (j = 0; j < 3; j++)
+    if (mapGet(&owner, roots[j], &k))
+      todo[todoCnt++] = (int)k;
+
+  while (todoCnt)
+  {
+    int b = todo[--todoCnt];
+    if (reached[b])
+      continue;
+    reached[b] = 1;
+    for (i = first[b]; i < first[b + 1]; i++)
+    {
+      Line* l = item[i]->pend;
+      if (item[i]->kind != ItemPending)
+        continue;
+      for (j = 1; j < l->cnt; j++)
+        if (mapGet(&owner, l->tok[j], &k) && !reached[k])
+          todo[todoCnt++] = (int)k;
+    }
+    if (falls[b] && !reached[b + 1])
+      todo[todoCnt++] = b + 1;
+  }
+
+  for (j = 0; j < blocks; j++)
+  {
+    long size = 0;
+    for (i = first[j]; i < first[j + 1]; i++)
+    {
+      if (reached[j])
+        *addItem(&result, 0) = *item[i];
+      else if (item[i]->kind != ItemLabel && item[i]->kind != ItemDebug)
+        size += item[i]->kind == ItemSpace ? item[i]->count : 1;
+    }
+    if (!reached[j] && verbose)
+    {
+      fprintf(stderr, "Removed %s: %ld words\n", item[first[j]]->text, size);
+      removedCnt++;
+      removedWords += size;
+    }
+  }
+  if (verbose)
+    fprintf(stderr, "Removed %d symbols, %ld words\n", removedCnt, removedWords);
+  return result;
+}
+
+//adds the jumps to Main, Int and Syscall and the place for the length of the program
+//NOTE: because of a unknown bug in B32P the 4th instruction needs to be jump Main as well
+ItemList addHeaderCode(ItemList* items)
+{
+  ItemList result = {0};
+  int i;
+
+  addItem(&result, ItemPending)->pend = makeLine(0, 2, "jump", "Main");
+  addItem(&result, ItemPending)->pend = makeLine(0, 2, "jump", "Int");
+  if (BDOSprogram)
+    addItem(&result, ItemPending)->pend = makeLine(0, 2, "jump", "Main");
+  else
+    addItem(&result, ItemLength);
+  addItem(&result, ItemPending)->pend = makeLine(0, 2, "jump", "Main");
+  if (BDOSos)
+    addItem(&result, ItemPending)->pend = makeLine(0, 2, "jump", "Syscall");
+
+  for (i = 0; i < items->cnt; i++)
+    *addItem(&result, 0) = items->item[i];
+  return result;
+}
+
+//removes the debug lines, and keeps them by the index of the line below them
+ItemList takeDebugLines(ItemList* items, int** debugAt)
+{
+  ItemList result = {0};
+  int i;
+
+  *debugAt = xmalloc((items->cnt + 1) * sizeof(int));
+  for (i = 0; i < items->cnt; i++)
+  {
+    if (items->item[i].kind == ItemDebug)
+      continue;
+    (*debugAt)[result.cnt] = i; //the lines before it that are not in the result are debug lines
+    *addItem(&result, 0) = items->item[i];
+  }
+  (*debugAt)[result.cnt] = items->cnt;
+  return result;
+}
+
+//gives each label the address of the first line below it that is no label,
+//numbers the lines (a .space takes as many addresses as the words it reserves)
+//and returns the lines without the labels
+ItemList moveLabels(ItemList* items, Map* labelMap)
+{
+  ItemList result = {0};
+  long address = programOffset;
+  int i, j, first = 0;
+
+  for (i = 0; i < items->cnt; i++)
+  {
+    Item* it = &items->item[i];
+    if (it->kind == ItemLabel)
+    {
+      if (i == items->cnt - 1)
+        fail("label %s: has no instructions below it", it->text);
+      continue;
+    }
+
+    it->addr = address;
+    address += it->kind == ItemSpace ? it->count : 1;
+    for (j = first; j < i; j++)
+    {
+      if (mapGet(labelMap, items->item[j].text, NULL))
+        fail("label %s is already defined", items->item[j].text);
+      mapPut(labelMap, items->item[j].text, it->addr);
+    }
+    first = i + 1;
+    *addItem(&result, 0) = *it;
+  }
+  return result;
+}
+
+//writes code.map, a line with the address, function and source line for each address where one of them changes
+//labels that are no Label_ labels start a function or data without a source line, until the next debug line
+//debugAt gives the index in all items of each item that is no debug line
+void writeDebugMap(ItemList* items, ItemList* all, int* debugAt)
+{
+  FILE* f = fopen("code.map", "w");
+  const char* function = "-";
+  const char* source = "-";
+  const char* lastFunction = NULL;
+  const char* lastSource = NULL;
+  int i, d = 0;
+
+  if (!f)
+    fail("can not write code.map");
+
+  for (i = 0; i < items->cnt; i++)
+  {
+    Item* it = &items->item[i];
+
+    //the debug lines above this line
+    for (; d < debugAt[i]; d++)
+    {
+      char* text = all->item[d].text;
+      if (!strncmp(text, "func ", 5))
+        function = text + 5;
+      else
+      {
+        char* sp;
+        source = format("%s", text + 5);
+        if ((sp = strrchr(source, ' ')) != NULL)
+          *sp = ':';
+      }
+    }
+    d++;
+
+    if (it->kind == ItemLabel)
+    {
+      if (!strstr(it->text, "Label_"))
+      {
+        function = it->text;
+        source = "-";
+      }
+    }
+    else if (!lastFunction || strcmp(function, lastFunction) || strcmp(source, lastSource))
+    {
+      fprintf(f, "%08lX %s %s\n", it->addr, function, source);
+      lastFunction = function;
+      lastSource = source;
+    }
+  }
+  fclose(f);
+}
+
+//compiles the lines with labels
+void passTwo(ItemList* items, Map* labelMap)
+{
+  ItemList one = {0};
+  int i, j;
+
+  out = &one;
+  for (i = 0; i < items->cnt; i++)
+  {
+    Item* it = &items->item[i];
+    Line* l = it->pend;
+    Line x;
+    int word = -1;
+    long address = 0;
+
+    if (it->kind != ItemPending)
+      continue;
+    //the last word that is a label is replaced by its address
+    for (j = 0; j < l->cnt; j++)
+      if (mapGet(labelMap, l->tok[j], &address))
+        word = j;
+    if (word < 0)
+      continue;
+    mapGet(labelMap, l->tok[word], &address);
+
+    x.no = l->no;
+    x.cnt = l->cnt;
+    x.tok = xmalloc(l->cnt * sizeof(char*));
+    memcpy(x.tok, l->tok, l->cnt * sizeof(char*));
+    //branches take the offset to the label
+    x.tok[word] = format("%ld", isBranch(x.tok[0]) ? address - it->addr : address);
+
+    one.cnt = 0;
+    curLine = &x;
+    compileLine(&x);
+    curLine = NULL;
+    if (one.cnt != 1)
+      fail("label %s can not be used in this line", l->tok[word]);
+    one.item[0].addr = it->addr;
+    *it = one.item[0];
+  }
+  out = NULL;
+}
+
+//A relocatable BDOS user program (reloc) starts with the magic number, the length of the program and the number
+//of relocations. The relocations follow the program, one word each, with the kind in the highest two bits and the
+//address below it: 0 for a jump, 1 for a .dl and 2 for a loadLabelLow with the loadLabelHigh below it.
+#define RELOC_MAGIC 0x52454C4Fu
+
+//returns the number of relocations of the lines that use the address of a label, before pass two compiles them
+int findRelocations(ItemList* items, Map* labelMap, unsigned** relocs)
+{
+  int i, j, cnt = 0;
+
+  *relocs = xmalloc((items->cnt + 1) * sizeof(unsigned));
+  for (i = 0; i < items->cnt; i++)
+  {
+    Line* l = items->item[i].pend;
+    int kind, label = 0, paired = 1;
+
+    if (items->item[i].kind != ItemPending)
+      continue;
+    if (!strcasecmp(l->tok[0], "jump"))
+      kind = 0;
+    else if (!strcasecmp(l->tok[0], ".dl"))
+      kind = 1;
+    else if (!strcasecmp(l->tok[0], "loadlabellow"))
+      kind = 2;
+    else if (!strcasecmp(l->tok[0], "loadlabelhigh"))
+      kind = 3;
+    else
+      continue;
+    for (j = 0; j < l->cnt; j++)
+      if (mapGet(labelMap, l->tok[j], NULL))
+        label = 1;
+    if (!label)
+      continue;
+
+    //the loader needs both halves of an address to add to it
+    if (kind >= 2)
+    {
+      Item* other = kind == 2 ? (i + 1 < items->cnt ? &items->item[i + 1] : NULL) : (i > 0 ? &items->item[i - 1] : NULL);
+      paired = other && other->kind == ItemPending && other->pend->cnt >= 2 &&
+               !strcmp(other->pend->tok[0], kind == 2 ? "loadLabelHigh" : "loadLabelLow") && !strcmp(other->pend->tok[1], l->tok[1]);
+    }
+    if (!paired)
+    {
+      char* text = l->tok[0];
+      for (j = 1; j < l->cnt; j++)
+        text = format("%s %s", text, l->tok[j]);
+      fail("%s can not be relocated without %s", text, kind == 2 ? "loadLabelHigh" : "loadLabelLow");
+    }
+
+    if (kind < 3)
+      (*relocs)[cnt++] = (unsigned)kind << 30 | (unsigned)items->item[i].addr;
+  }
+  return cnt;
+}
+
+//writes a word to code.bin, and with its comment to the listing
+void writeWord(FILE* f, unsigned w, const char* comment)
+{
+  unsigned char bytes[4];
+  bytes[0] = w >> 24;
+  bytes[1] = w >> 16;
+  bytes[2] = w >> 8;
+  bytes[3] = w;
+  fwrite(bytes, 1, 4, f);
+  if (listing)
+  {
+    char bits[33];
+    int b;
+    for (b = 0; b < 32; b++)
+      bits[b] = '0' + ((w >> (31 - b)) & 1);
+    bits[32] = '\0';
+    printf("%s%s\n", bits, comment);
+  }
+}
+
+//check if all labels are compiled
+void checkNoLabels(ItemList* items)
+{
+  int i;
+
+  for (i = 0; i < items->cnt; i++)
+  {
+    Line* l = items->item[i].pend;
+    if (items->item[i].kind == ItemPending)
+      fail("label %s is undefined", l->tok[isBranch(l->tok[0]) && l->cnt > 3 ? 3 : l->cnt > 1 ? 1 : 0]);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  LineList parsed;
+  ItemList items, labelItems, debugItems;
+  Map labelMap = {0};
+  int* debugAt;
+  int i, args = 1, end, dataLength = 0, relocCnt = 0;
+  unsigned* relocs = NULL;
+  long length = 0;
+  FILE* f;
+
+  for (i = 0; instructions[i].name; i++)
+    mapPut(&instructionMap, instructions[i].name, i);
+
+  //-O, -g, -v and -l can be given anywhere
+  for (i = 1; i < argc; i++)
+  {
+    size_t len = strlen(argv[i]);
+    if (!strcmp(argv[i], "-O"))
+      optimizeSize = 1;
+    else if (!strcmp(argv[i], "-g"))
+      debugMap = 1;
+    else if (!strcmp(argv[i], "-v"))
+      verbose = 1;
+    else if (!strcmp(argv[i], "-l"))
+      listing = 1;
+    else if (len > 2 && (!strcmp(argv[i] + len - 2, ".o") || !strcmp(argv[i] + len - 2, ".a")))
+      fail("objects can only be linked by Assembler.py");
+    else
+      argv[args++] = argv[i];
+  }
+
+  //check assemble mode and offset
+  if (args >= 3 && !strcasecmp(argv[1], "bdos"))
+  {
+    BDOSprogram = 1;
+    programOffset = (long)getNumber(argv[2], 1);
+  }
+  if (args >= 2 && !strcasecmp(argv[1], "os"))
+    BDOSos = 1;
+  if (args >= 2 && !strcasecmp(argv[1], "reloc"))
+    BDOSprogram = relocatable = 1;
+  if (args >= 2 && !strcasecmp(argv[1], "obj"))
+    fail("objects can only be made by Assembler.py");
+
+  parsed = parseLines("code.asm");
+
+  //move .data, .rdata and .bss sections down
+  parsed = moveSectionsDown(&parsed, &dataLength);
+
+  //remove all .code, .data, .rdata, .bss, .globl and .EOF lines
+  parsed = removeAssemblerDirectives(&parsed);
+
+  //insert libraries, they go above everything so the data stays at the end
+  parsed = insertLibraries(&parsed);
+
+  //obtain and remove the define statements, and replace defined words with their value
+  parsed = processDefines(&parsed);
+
+  if (optimizeSize)
+  {
+    LineList code = parsed, data = parsed;
+    ItemList codeItems;
+    code.cnt = parsed.cnt - dataLength;
+    data.line += code.cnt;
+    data.cnt = dataLength;
+    codeItems = passOne(&code);
+    items = passOne(&data);
+    items = removeUnreachableBlocks(&codeItems, &items);
+  }
+  else
+    items = passOne(&parsed);
+
+  //add interrupt code and jumps
+  items = addHeaderCode(&items);
+
+  //take out the debug lines, they are kept apart for the address map
+  debugItems = items;
+  items = takeDebugLines(&debugItems, &debugAt);
+  labelItems = items;
+
+  //number the lines and give the labels their address
+  items = moveLabels(&labelItems, &labelMap);
+
+  if (debugMap)
+    writeDebugMap(&labelItems, &debugItems, debugAt);
+
+  if (relocatable)
+    relocCnt = findRelocations(&items, &labelMap, &relocs);
+
+  passTwo(&items, &labelMap);
+
+  checkNoLabels(&items);
+
+  //the .space lines at the end (.bss) are left out, the program clears them when it starts
+  end = items.cnt;
+  while (end > 0 && items.item[end - 1].kind == ItemSpace)
+    end--;
+  for (i = 0; i < end; i++)
+    length += items.item[i].kind == ItemSpace ? items.item[i].count : 1;
+
+  f = fopen("code.bin", "wb");
+  if (!f)
+    fail("can not write code.bin");
+  if (relocatable)
+  {
+    writeWord(f, RELOC_MAGIC, " //Relocatable program");
+    writeWord(f, (unsigned)length, " //Length of program");
+    writeWord(f, (unsigned)relocCnt, " //Number of relocations");
+  }
+  for (i = 0; i < end; i++)
+  {
+    Item* it = &items.item[i];
+    long n = it->kind == ItemSpace ? it->count : 1, j;
+    unsigned w = it->kind == ItemLength ? (unsigned)length : it->word;
+    const char* comment = it->kind == ItemSpace ? " //data" : it->kind == ItemLength ? " //Length of program" : it->text;
+
+    for (j = 0; j < n; j++)
+      writeWord(f, w, comment);
+  }
+  for (i = 0; i < relocCnt; i++)
+  {
+    static const char* names[] = {"jump", ".dl", "addr2reg"};
+    writeWord(f, relocs[i], format(" //Relocate %s at %u", names[relocs[i] >> 30], relocs[i] & 0x3FFFFFFF));
+  }
+  fclose(f);
+  return 0;
+}
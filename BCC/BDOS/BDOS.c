@@ -13,87 +13,17 @@
 - Socket 7 is used for netHID
 */
 
-/*
- * Defines (also might be used by included libraries below)
- */
-
-// As of writing, BCC assigns 4 memory addresses to ints, so we should use chars instead
-// However, this is confusing, so we typedef it to word, since that is what it basically is
-#define word char
-
-#define SYSCALL_RETVAL_ADDR 0x200000  // Address for system call communication with user program
-#define TEMP_ADDR 0x220000            // Address for (potentially) large temporary outputs/buffers
-#define RUN_ADDR 0x400000             // Address of loaded user program
-
-#define NETWORK_LOCAL_IP 213          // local IP address (last byte)
-
-#define MAX_PATH_LENGTH 127           // Max length of a file path
-#define BDOS_DEFAULT_BLOCKS 1024      // Default number of blocks for the BRFS filesystem
-#define BDOS_DEFAULT_BLOCK_SIZE 128   // Default number of words per block for the BRFS filesystem
-
-// Interrupt IDs for interrupt handler
-#define INTID_TIMER1 0x1
-#define INTID_TIMER2 0x2
-#define INTID_UART0 0x3
-#define INTID_GPU 0x4
-#define INTID_TIMER3 0x5
-#define INTID_PS2 0x6
-#define INTID_UART1 0x7
-#define INTID_UART2 0x8
-
-// System call IDs
-#define SYS_HID_CHECKFIFO 1
-#define SYS_HID_READFIFO 2
-#define SYS_BDOS_PRINTC 3
-#define SYS_BDOS_PRINT 4
-#define SYS_FS_OPEN 5
-#define SYS_FS_CLOSE 6
-#define SYS_FS_READ 7
-#define SYS_FS_WRITE 8
-#define SYS_FS_SETCURSOR 9
-#define SYS_FS_GETCURSOR 10
-#define SYS_FS_DELETE 11
-#define SYS_FS_MKDIR 12
-#define SYS_FS_MKFILE 13
-#define SYS_FS_STAT 14
-#define SYS_FS_READDIR 15
-#define SYS_FS_GETCWD 16
-#define SYS_FS_SYNCFLASH 17
-// Syscalls 17-19 are reserved for future use
-#define SYS_SHELL_ARGC 20
-#define SYS_SHELL_ARGV 21
-#define SYS_USB_KB_BUF 99
+#include "BDOS.h"
 
 /*
- * Global vars (also might be used by included libraries below)
+ * Global vars (also used by the libraries)
  */
 
 // Flag that indicates whether a user program is running
 word bdos_userprogram_running = 0;
 
-/*
- * Included libraries
- */
-
-// Data includes
-#include "data/ASCII_BW.c"
-#include "data/PS2SCANCODES.c"
-#include "data/USBSCANCODES.c"
-
-// Code includes
-#include "lib/stdlib.c"
-#include "lib/math.c"
-#include "lib/gfx.c"
-#include "lib/hidfifo.c"
-#include "lib/ps2.c"
-#include "lib/brfs.c"
-#include "lib/shell.c"
-#include "lib/usbkeyboard.c"
-#include "lib/wiz5500.c"
-#include "lib/netloader.c"
-#include "lib/nethid.c"
-#include "lib/spiflash.c"
-
+// Address the user program runs from, its interrupt handler is at the next address
+word bdos_userprogram_addr = RUN_ADDR;
 
 /*
  * Functions
@@ -356,9 +286,11 @@ void interrupt()
         "push r14\n"
         "push r15\n"
 
+        "addr2reg bdos_userprogram_addr r1\n"
+        "read 0 r1 r2\n"
         "savpc r1\n"
         "push r1\n"
-        "jump 0x400001\n"
+        "jumpr 1 r2\n"
 
         "; restore registers\n"
         "pop r15\n"
@@ -0,0 +1,84 @@
+/*
+ * BDOS header
+ * BDOS is built from separate modules: BDOS.c, each file in data/ and each library in lib/.
+ * Every module includes this file for the defines, global variables and functions they share.
+ * See compileBDOS.sh for how the modules are compiled and linked.
+ */
+
+// As of writing, BCC assigns 4 memory addresses to ints, so we should use chars instead
+// However, this is confusing, so we typedef it to word, since that is what it basically is
+#define word char
+
+#define SYSCALL_RETVAL_ADDR 0x200000  // Address for system call communication with user program
+#define TEMP_ADDR 0x220000            // Address for (potentially) large temporary outputs/buffers
+#define RUN_ADDR 0x400000             // Address of loaded user program
+
+#define NETWORK_LOCAL_IP 213          // local IP address (last byte)
+
+#define MAX_PATH_LENGTH 127           // Max length of a file path
+#define BDOS_DEFAULT_BLOCKS 1024      // Default number of blocks for the BRFS filesystem
+#define BDOS_DEFAULT_BLOCK_SIZE 128   // Default number of words per block for the BRFS filesystem
+
+// Interrupt IDs for interrupt handler
+#define INTID_TIMER1 0x1
+#define INTID_TIMER2 0x2
+#define INTID_UART0 0x3
+#define INTID_GPU 0x4
+#define INTID_TIMER3 0x5
+#define INTID_PS2 0x6
+#define INTID_UART1 0x7
+#define INTID_UART2 0x8
+
+// System call IDs
+#define SYS_HID_CHECKFIFO 1
+#define SYS_HID_READFIFO 2
+#define SYS_BDOS_PRINTC 3
+#define SYS_BDOS_PRINT 4
+#define SYS_FS_OPEN 5
+#define SYS_FS_CLOSE 6
+#define SYS_FS_READ 7
+#define SYS_FS_WRITE 8
+#define SYS_FS_SETCURSOR 9
+#define SYS_FS_GETCURSOR 10
+#define SYS_FS_DELETE 11
+#define SYS_FS_MKDIR 12
+#define SYS_FS_MKFILE 13
+#define SYS_FS_STAT 14
+#define SYS_FS_READDIR 15
+#define SYS_FS_GETCWD 16
+#define SYS_FS_SYNCFLASH 17
+// Syscalls 17-19 are reserved for future use
+#define SYS_SHELL_ARGC 20
+#define SYS_SHELL_ARGV 21
+#define SYS_USB_KB_BUF 99
+
+// Global vars of BDOS.c
+extern word bdos_userprogram_running;
+extern word bdos_userprogram_addr;
+
+// Functions of BDOS.c that are used by the libraries
+void bdos_restore();
+
+// Data tables in data/, as functions with assembly data
+void DATA_PALETTE_DEFAULT();
+void DATA_ASCII_DEFAULT();
+void DATA_PS2SCANCODE_NORMAL();
+void DATA_PS2SCANCODE_SHIFTED();
+void DATA_PS2SCANCODE_EXTENDED();
+void DATA_USBSCANCODE_NORMAL();
+void DATA_USBSCANCODE_SHIFTED();
+
+// Libraries
+#include "lib/stdlib.h"
+#include "lib/math.h"
+#include "lib/gfx.h"
+#include "lib/hidfifo.h"
+#include "lib/ps2.h"
+#include "lib/brfs.h"
+#include "lib/loader.h"
+#include "lib/shell.h"
+#include "lib/usbkeyboard.h"
+#include "lib/wiz5500.h"
+#include "lib/netloader.h"
+#include "lib/nethid.h"
+#include "lib/spiflash.h"
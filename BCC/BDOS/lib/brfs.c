@@ -9,47 +9,10 @@ Implementing in BDOS on PCB v3:
 - Lets use the last 4MiB of this space for BRFS (0x100000 - 0x200000)
 */
 
-#define BRFS_SUPPORTED_VERSION 1
+#include "BDOS.h"
 
-#define BRFS_RAM_STORAGE_ADDR 0x100000 // From 4th MiB
-
-// Addresses in SPI Flash
-#define SPIFLASH_MEMMAP_ADDR 0x800000
-// Note that each section should be in a different 4KiB sector in SPI Flash
-#define BRFS_SPIFLASH_SUPERBLOCK_ADDR 0xDF000 // One sector before FAT
-#define BRFS_SPIFLASH_FAT_ADDR 0xE0000 // Can be 32768 words (128KiB) for 32MiB of 256word blocks
-#define BRFS_SPIFLASH_BLOCK_ADDR 0x100000 // From first MiB
-
-//#define MAX_PATH_LENGTH 127 // Set by BDOS
-#define MAX_OPEN_FILES 16 // Can be set higher, but 4 is good for testing
-
-// Length of structs, should not be changed
-#define SUPERBLOCK_SIZE 16
-#define DIR_ENTRY_SIZE 8
-
-#define BRFS_MAX_BLOCKS 65536 // 64KiB
 word brfs_changed_blocks[BRFS_MAX_BLOCKS >> 5]; // Bitmap of changed blocks, each block has 1 bit
 
-// 16 words long
-struct brfs_superblock
-{
-  word total_blocks;
-  word words_per_block;
-  word label[10];       // 1 char per word
-  word brfs_version;
-  word reserved[3];
-};
-
-// 8 words long
-struct brfs_dir_entry
-{
-  word filename[4];       // 4 chars per word
-  word modify_date;       // TBD when RTC added to FPGC
-  word flags;             // 32 flags, from right to left: directory, hidden 
-  word fat_idx;           // idx of first FAT block
-  word filesize;          // file size in words, not bytes
-};
-
 word *brfs_ram_storage = (word*) BRFS_RAM_STORAGE_ADDR; // RAM storage of file system
 
 // Variables for open files
@@ -78,7 +41,7 @@ void brfs_dump_section(word* addr, word len, word linesize)
 
     // newline every linesize words
     // also print last linesize words as chars if alphanum
-    if (i != 0 && MATH_modU(i+1, linesize) == 0)
+    if (i != 0 && (unsigned)(i+1) % linesize == 0)
     {
       uprint("  ");
       word j;
@@ -944,7 +907,7 @@ word brfs_read(word file_pointer, word* buffer, word length)
       // - repeat until length is 0
       while (length > 0)
       {
-        word cursor_in_block = MATH_modU(brfs_cursors[i], superblock->words_per_block);
+        word cursor_in_block = (unsigned)brfs_cursors[i] % superblock->words_per_block;
         word words_until_end_of_block = superblock->words_per_block - cursor_in_block;
         word words_to_read = words_until_end_of_block > length ? length : words_until_end_of_block;
 
@@ -1018,7 +981,7 @@ word brfs_write(word file_pointer, word* buffer, word length)
       // - repeat until length is 0
       while (length > 0)
       {
-        word cursor_in_block = MATH_modU(brfs_cursors[i], superblock->words_per_block);
+        word cursor_in_block = (unsigned)brfs_cursors[i] % superblock->words_per_block;
         word words_until_end_of_block = superblock->words_per_block - cursor_in_block;
         word words_to_write = words_until_end_of_block > length ? length : words_until_end_of_block;
 
@@ -1267,7 +1230,7 @@ void brfs_write_blocks_to_flash()
 
   uprintln("---Writing blocks to SPI Flash---");
 
-  word blocks_per_sector = MATH_divU(4096, superblock->words_per_block * 4);
+  word blocks_per_sector = 4096u / (superblock->words_per_block * 4);
   uprint("Blocks per sector: ");
   uprintDec(blocks_per_sector);
   uprintln("");
@@ -1282,9 +1245,9 @@ void brfs_write_blocks_to_flash()
     {
       if (sector_to_erase == -1)
       {
-        sector_to_erase = MATH_divU(i, blocks_per_sector);
+        sector_to_erase = (unsigned)i / blocks_per_sector;
       }
-      else if (sector_to_erase != MATH_divU(i, blocks_per_sector))
+      else if (sector_to_erase != (unsigned)i / blocks_per_sector)
       {
         word addr = BRFS_SPIFLASH_BLOCK_ADDR; // Workaround because of large static number
         addr += sector_to_erase * 4096;
@@ -1297,7 +1260,7 @@ void brfs_write_blocks_to_flash()
 
         brfs_write_sector_to_flash(sector_to_erase);
 
-        sector_to_erase = MATH_divU(i, blocks_per_sector);
+        sector_to_erase = (unsigned)i / blocks_per_sector;
       }
     }
   }
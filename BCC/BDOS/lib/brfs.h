@@ -0,0 +1,79 @@
+/*
+* Interface of lib/brfs.c
+* Included by all BDOS modules through BDOS.h
+*/
+
+#define BRFS_SUPPORTED_VERSION 1
+
+#define BRFS_RAM_STORAGE_ADDR 0x100000 // From 4th MiB
+
+// Addresses in SPI Flash
+#define SPIFLASH_MEMMAP_ADDR 0x800000
+// Note that each section should be in a different 4KiB sector in SPI Flash
+#define BRFS_SPIFLASH_SUPERBLOCK_ADDR 0xDF000 // One sector before FAT
+#define BRFS_SPIFLASH_FAT_ADDR 0xE0000 // Can be 32768 words (128KiB) for 32MiB of 256word blocks
+#define BRFS_SPIFLASH_BLOCK_ADDR 0x100000 // From first MiB
+
+//#define MAX_PATH_LENGTH 127 // Set by BDOS
+#define MAX_OPEN_FILES 16 // Can be set higher, but 4 is good for testing
+
+// Length of structs, should not be changed
+#define SUPERBLOCK_SIZE 16
+#define DIR_ENTRY_SIZE 8
+
+#define BRFS_MAX_BLOCKS 65536 // 64KiB
+
+// 16 words long
+struct brfs_superblock
+{
+  word total_blocks;
+  word words_per_block;
+  word label[10];       // 1 char per word
+  word brfs_version;
+  word reserved[3];
+};
+
+// 8 words long
+struct brfs_dir_entry
+{
+  word filename[4];       // 4 chars per word
+  word modify_date;       // TBD when RTC added to FPGC
+  word flags;             // 32 flags, from right to left: directory, hidden 
+  word fat_idx;           // idx of first FAT block
+  word filesize;          // file size in words, not bytes
+};
+
+// Global variables
+extern word brfs_changed_blocks[BRFS_MAX_BLOCKS >> 5];
+extern word *brfs_ram_storage;
+extern word brfs_cursors[MAX_OPEN_FILES];
+extern word brfs_file_pointers[MAX_OPEN_FILES];
+extern struct brfs_dir_entry* brfs_dir_entry_pointers[MAX_OPEN_FILES];
+
+// Functions
+void brfs_dump_section(word* addr, word len, word linesize);
+void brfs_dump(word fatsize, word datasize);
+word brfs_get_fat_idx_of_dir(char* dir_path);
+word brfs_find_next_free_block(word* fat_addr, word blocks);
+word brfs_find_next_free_dir_entry(word* dir_addr, word dir_entries_max);
+void brfs_create_single_dir_entry(struct brfs_dir_entry* dir_entry, char* filename, word fat_idx, word filesize, word flags);
+void brfs_init_directory(word* dir_addr, word dir_entries_max, word dir_fat_idx, word parent_fat_idx);
+void brfs_format(word blocks, word words_per_block, char* label, word full_format);
+word brfs_create_directory(char* parent_dir_path, char* dirname);
+word brfs_create_file(char* parent_dir_path, char* filename);
+word brfs_read_directory(char* dir_path, struct brfs_dir_entry* buffer);
+word brfs_open_file(char* file_path);
+word brfs_close_file(word file_pointer);
+word brfs_delete(char* file_path);
+word brfs_set_cursor(word file_pointer, word cursor);
+word brfs_get_cursor(word file_pointer);
+word brfs_get_fat_idx_at_cursor(word file_pointer, word cursor);
+word brfs_read(word file_pointer, word* buffer, word length);
+word brfs_write(word file_pointer, word* buffer, word length);
+struct brfs_dir_entry* brfs_stat(char* file_path);
+void brfs_write_fat_to_flash();
+void brfs_write_sector_to_flash(word sector_idx);
+void brfs_write_blocks_to_flash();
+void brfs_write_to_flash();
+word brfs_superblock_is_valid(struct brfs_superblock* superblock);
+word brfs_read_from_flash();
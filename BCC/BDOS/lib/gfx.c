@@ -8,9 +8,7 @@
 
 // uses math.c
 
-#define GFX_WINDOW_PATTERN_ADDR 0xC01420
-#define GFX_WINDOW_PALETTE_ADDR 0xC01C20
-#define GFX_CURSOR_ASCII        219
+#include "BDOS.h"
 
 word GFX_cursor = 0;
 word GFX_disable_cursor = 0;
@@ -0,0 +1,34 @@
+/*
+* Interface of lib/gfx.c
+* Included by all BDOS modules through BDOS.h
+*/
+
+#define GFX_WINDOW_PATTERN_ADDR 0xC01420
+#define GFX_WINDOW_PALETTE_ADDR 0xC01C20
+#define GFX_CURSOR_ASCII        219
+
+// Global variables
+extern word GFX_cursor;
+extern word GFX_disable_cursor;
+
+// Functions
+void GFX_asmDefines();
+void GFX_printWindowColored(word addr, word len, word pos, word palette);
+void GFX_printBGColored(word addr, word len, word pos, word palette);
+void GFX_copyPatternTable(word addr);
+void GFX_copyPaletteTable(word addr);
+void GFX_clearBGtileTable();
+void GFX_clearBGpaletteTable();
+void GFX_clearWindowtileTable();
+void GFX_clearWindowpaletteTable();
+void GFX_clearSprites();
+void GFX_clearParameters();
+void GFX_initVram();
+word GFX_WindowPosFromXY(word x, word y);
+word GFX_BackgroundPosFromXY(word x, word y);
+void GFX_ScrollUp();
+void GFX_printCursor();
+void GFX_PrintcConsole(char c);
+void GFX_PrintConsole(char* str);
+void GFX_PrintDecConsole(word i);
+void GFX_DumpcConsole(char c);
@@ -10,7 +10,7 @@
 * - If available, read using HID_FifoRead
 */
 
-#define HID_FIFO_SIZE 0x20
+#include "BDOS.h"
 
 word hidfifo[HID_FIFO_SIZE];
 word hidreadIdx = 0;
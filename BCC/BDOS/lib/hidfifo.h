@@ -0,0 +1,17 @@
+/*
+* Interface of lib/hidfifo.c
+* Included by all BDOS modules through BDOS.h
+*/
+
+#define HID_FIFO_SIZE 0x20
+
+// Global variables
+extern word hidfifo[HID_FIFO_SIZE];
+extern word hidreadIdx;
+extern word hidwriteIdx;
+extern word hidbufSize;
+
+// Functions
+void HID_FifoWrite(word c);
+word HID_FifoAvailable();
+word HID_FifoRead();
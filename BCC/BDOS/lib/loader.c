@@ -0,0 +1,82 @@
+/*
+* Program loader library
+* Prepares a user program in memory to be run
+*
+* A user program is either:
+* - a flat binary, assembled for RUN_ADDR (Assembler.py bdos 0x400000), that only runs from there
+* - a relocatable program (Assembler.py reloc), that runs from any address:
+*     word 0: LOADER_MAGIC
+*     word 1: length of the program in words
+*     word 2: number of relocations
+*     the program, assembled for address 0
+*     the relocations, one word each: the kind in the highest 2 bits, the address in the program below it
+*
+* USAGE:
+* - Read the whole file to any address (RUN_ADDR for flat binaries)
+* - Call loader_prepare with that address, run the program from the address it returns
+* - The relocations are behind the program, where its .bss starts, so they are gone once it runs
+*/
+
+#include "BDOS.h"
+
+/**
+ * Apply the relocations of a relocatable program for the address it is at
+*/
+void loader_relocate(word* program, word* relocs, word count)
+{
+  word base = (word) program;
+  word mask = 0xFFFF; // large constants have to be in a register
+  word i;
+  for (i = 0; i < count; i++)
+  {
+    word kind = (unsigned)relocs[i] >> 30;
+    word* p = program + ((unsigned)(relocs[i] << 2) >> 2);
+    if (kind == LOADER_RELOC_JUMP)
+    {
+      *p += base << 1;
+    }
+    else if (kind == LOADER_RELOC_DATA)
+    {
+      *p += base;
+    }
+    else if (kind == LOADER_RELOC_ADDR2REG)
+    {
+      word low = ((unsigned)p[0] >> 8) & mask;
+      word high = ((unsigned)p[1] >> 8) & mask;
+      word addr = low + (high << 16) + base;
+      p[0] += ((addr & mask) - low) << 8;
+      p[1] += (((unsigned)addr >> 16) - high) << 8;
+    }
+  }
+}
+
+/**
+ * Prepare the program that is read to image, size is the number of words read
+ * Returns the address to run the program from, or 0 if it can't run from there
+*/
+word loader_prepare(word* image, word size)
+{
+  if (size < 1)
+  {
+    return 0;
+  }
+
+  if (image[0] != LOADER_MAGIC)
+  {
+    // Flat binary, its addresses are for RUN_ADDR
+    if ((word)image != RUN_ADDR)
+    {
+      return 0;
+    }
+    return RUN_ADDR;
+  }
+
+  if (size < LOADER_HEADER_SIZE || LOADER_HEADER_SIZE + image[1] + image[2] > size)
+  {
+    return 0;
+  }
+
+  word* program = image + LOADER_HEADER_SIZE;
+  loader_relocate(program, program + image[1], image[2]);
+  return (word) program;
+}
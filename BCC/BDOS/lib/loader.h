@@ -0,0 +1,16 @@
+/*
+* Interface of lib/loader.c
+* Included by all BDOS modules through BDOS.h
+*/
+
+#define LOADER_MAGIC 0x52454C4F // "RELO", can't be the first word of a flat binary (jump Main)
+#define LOADER_HEADER_SIZE 3
+
+// Kinds of relocations
+#define LOADER_RELOC_JUMP 0     // jump to a label: the address is in bits 27..1
+#define LOADER_RELOC_DATA 1     // .dl of a label: the address is the whole word
+#define LOADER_RELOC_ADDR2REG 2 // loadLabelLow with loadLabelHigh below it: the address is split in two 16 bit halves
+
+// Functions
+void loader_relocate(word* program, word* relocs, word count);
+word loader_prepare(word* image, word size);
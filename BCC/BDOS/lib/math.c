@@ -3,6 +3,8 @@
 * Contains functions math operation that are not directly supported by the ALU
 */
 
+#include "BDOS.h"
+
 // Divide two signed integer numbers using MU
 word MATH_div(word dividend, word divisor)
 {
@@ -0,0 +1,17 @@
+/*
+* Interface of lib/math.c
+* Included by all BDOS modules through BDOS.h
+*/
+
+// Functions
+word MATH_div(word dividend, word divisor);
+word MATH_mod(word dividend, word divisor);
+word MATH_divU(word dividend, word divisor);
+word MATH_modU(word dividend, word divisor);
+word MATH_SW_divmod(word dividend, word divisor, word* rem);
+word MATH_SW_div(word dividend, word divisor);
+word MATH_SW_mod(word dividend, word divisor);
+word MATH_SW_divmodU(word dividend, word divisor, word mod);
+word MATH_SW_divU(word dividend, word divisor);
+word MATH_SW_modU(word dividend, word divisor);
+word MATH_abs(word x);
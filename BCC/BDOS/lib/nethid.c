@@ -7,10 +7,7 @@
 // uses wiz5500.c
 // uses hidfifo.c
 
-// Port for network bootloader
-#define NETHID_PORT 3222
-// Socket to listen to (0-7)
-#define NETHID_SOCKET 7
+#include "BDOS.h"
 
 word NETHID_isInitialized = 0;
 
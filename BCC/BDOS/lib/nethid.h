@@ -0,0 +1,18 @@
+/*
+* Interface of lib/nethid.c
+* Included by all BDOS modules through BDOS.h
+*/
+
+// Port for network bootloader
+#define NETHID_PORT 3222
+// Socket to listen to (0-7)
+#define NETHID_SOCKET 7
+
+// Global variables
+extern word NETHID_isInitialized;
+extern char NETHID_rxBuf[WIZNET_MAX_RBUF];
+
+// Functions
+void NETHID_handleSession(word s);
+void NETHID_init(word s);
+void NETHID_loop(word s);
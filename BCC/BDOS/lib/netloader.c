@@ -6,10 +6,7 @@
 
 // uses wiz5500.c
 
-// Port for network bootloader
-#define NETLOADER_PORT 3220
-// Socket to listen to (0-7)
-#define NETLOADER_SOCKET 0
+#include "BDOS.h"
 
 // Checks if p starts with cmd
 // Returns 1 if true, 0 otherwise
@@ -115,6 +112,15 @@ word NETLOADER_getContentStart(char* rbuf, word rsize)
 
 void NETLOADER_runProgramFromMemory()
 {
+    // relocate the program if it is relocatable
+    bdos_userprogram_addr = loader_prepare((word*) RUN_ADDR, NETLOADER_wordPosition);
+    if (!bdos_userprogram_addr)
+    {
+        GFX_PrintConsole("Not a valid program\n");
+        shell_clear_command();
+        shell_print_prompt();
+        return;
+    }
 
     // indicate that a user program is running
     bdos_userprogram_running = 1;
@@ -139,9 +145,11 @@ void NETLOADER_runProgramFromMemory()
         "push r15\n"
 
         //"ccache\n"
+        "addr2reg bdos_userprogram_addr r1\n"
+        "read 0 r1 r2\n"
         "savpc r1\n"
         "push r1\n"
-        "jump 0x400000\n"
+        "jumpr 0 r2\n"
 
         "; restore registers\n"
         "pop r15\n"
@@ -0,0 +1,25 @@
+/*
+* Interface of lib/netloader.c
+* Included by all BDOS modules through BDOS.h
+*/
+
+// Port for network bootloader
+#define NETLOADER_PORT 3220
+// Socket to listen to (0-7)
+#define NETLOADER_SOCKET 0
+
+// Global variables
+extern word NETLOADER_wordPosition;
+extern word NETLOADER_currentByteShift;
+
+// Functions
+word NETLOADER_frameCompare(char* p, char* cmd);
+void NETLOADER_appendBufferToRunAddress(char* b, word len);
+word NETLOADER_getContentLength(char* rbuf, word rsize);
+void NETLOADER_getFileName(char* rbuf, word rsize, char* fileNameStr);
+word NETLOADER_getContentStart(char* rbuf, word rsize);
+void NETLOADER_runProgramFromMemory();
+word NETLOADER_percentageDone(word remaining, word full);
+void NETLOADER_handleSession(word s);
+void NETLOADER_init(word s);
+word NETLOADER_loop(word s);
@@ -14,8 +14,7 @@
 * - implement windows key
 */
 
-#define PS2_ADDR 0xC02740
-#define PS2_DATA_OFFSET 3
+#include "BDOS.h"
 
 // uses PS2SCANCODES.c
 // uses hidfifo.c
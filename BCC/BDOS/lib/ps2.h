@@ -0,0 +1,18 @@
+/*
+* Interface of lib/ps2.c
+* Included by all BDOS modules through BDOS.h
+*/
+
+#define PS2_ADDR 0xC02740
+#define PS2_DATA_OFFSET 3
+
+// Global variables
+extern word ps2caps;
+extern word ps2shifted;
+extern word ps2controlled;
+extern word ps2alted;
+extern word ps2extended;
+extern word ps2released;
+
+// Functions
+void PS2_HandleInterrupt();
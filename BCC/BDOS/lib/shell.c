@@ -1,6 +1,4 @@
-// Max length of a single command
-#define SHELL_CMD_MAX_LENGTH 128
-#define SHELL_BIN_PATH "/bin/"
+#include "BDOS.h"
 
 word shell_cmd[SHELL_CMD_MAX_LENGTH];
 word shell_cmd_idx = 0;
@@ -156,6 +154,14 @@ word shell_run_program(word run_from_path)
     return 0;
   }
 
+  // Relocate the program if it is relocatable
+  bdos_userprogram_addr = loader_prepare(program, filesize);
+  if (!bdos_userprogram_addr)
+  {
+    GFX_PrintConsole("Not a valid program\n");
+    return 0;
+  }
+
   // Run program
   // Indicate that a user program is running
   bdos_userprogram_running = 1;
@@ -182,9 +188,11 @@ word shell_run_program(word run_from_path)
     "push r15\n"
 
     //"ccache\n"
+    "addr2reg bdos_userprogram_addr r1\n"
+    "read 0 r1 r2\n"
     "savpc r1\n"
     "push r1\n"
-    "jump 0x400000\n"
+    "jumpr 0 r2\n"
 
     "; restore registers\n"
     "pop r15\n"
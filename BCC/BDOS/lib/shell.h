@@ -0,0 +1,30 @@
+/*
+* Interface of lib/shell.c
+* Included by all BDOS modules through BDOS.h
+*/
+
+// Max length of a single command
+#define SHELL_CMD_MAX_LENGTH 128
+#define SHELL_BIN_PATH "/bin/"
+
+// Global variables
+extern word shell_cmd[SHELL_CMD_MAX_LENGTH];
+extern word shell_cmd_idx;
+extern word* shell_tokens[SHELL_CMD_MAX_LENGTH >> 1];
+extern word shell_num_tokens;
+extern word shell_path[MAX_PATH_LENGTH];
+
+// Functions
+void shell_print_prompt();
+void shell_clear_command();
+void shell_append_command(char c);
+void shell_parse_command();
+void shell_print_help();
+word shell_run_program(word run_from_path);
+void shell_process_dots(char* path);
+void shell_change_directory();
+void shell_format_filesystem();
+void shell_show_fs_usage();
+void shell_handle_command();
+void shell_init();
+void shell_loop();
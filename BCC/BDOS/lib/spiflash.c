@@ -3,6 +3,8 @@
 * Contains functions to interact with the Winbond W25Q128 SPI Flash chip
 */
 
+#include "BDOS.h"
+
 // Sets SPI0_CS low
 void spiflash_begin_transfer()
 {
@@ -0,0 +1,18 @@
+/*
+* Interface of lib/spiflash.c
+* Included by all BDOS modules through BDOS.h
+*/
+
+// Functions
+void spiflash_begin_transfer();
+void spiflash_end_transfer();
+word spiflash_transfer(word dataByte);
+void spiflash_qspi();
+void spiflash_init();
+void spiflash_read_chip_ids();
+void spiflash_enable_write();
+void spiflash_read_from_address(word* output, word addr, word len, word bytes_to_word);
+void spiflash_write_page_in_words(word* input, word addr, word len);
+word spiflash_read_status_reg(word reg_idx);
+word spiflash_sector_erase(word addr);
+word spiflash_chip_erase();
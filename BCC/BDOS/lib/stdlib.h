@@ -0,0 +1,56 @@
+/*
+* Interface of lib/stdlib.c
+* Included by all BDOS modules through BDOS.h
+*/
+
+#define UART_TX_ADDR 0xC02723
+
+// Timer I/O Addresses
+#define TIMER1_VAL 0xC02739
+#define TIMER1_CTRL 0xC0273A
+#define TIMER2_VAL 0xC0273B
+#define TIMER2_CTRL 0xC0273C
+#define TIMER3_VAL 0xC0273D
+#define TIMER3_CTRL 0xC0273E
+
+// Global variables
+extern word timer1Value;
+extern word timer2Value;
+extern word timer3Value;
+extern char * strtok_old_str;
+
+// Functions
+void memcpy(word* dest, word* src, word n);
+word memcmp(word* a, word* b, word n);
+void memset(word* dest, word val, word n);
+word strlen(char* str);
+word strcpy(char* dest, char* src);
+word strcat(char* dest, char* src);
+word strcmp(char* s1, char* s2);
+char* strchr (const char *s, char c);
+char* strrchr (const char *s, int c);
+char* strtok(char* str, const char* delim);
+void strcompress(word* dest, char* src);
+void strdecompress(char* dest, word* src);
+char* basename(char *path);
+char* dirname(char* output, char *path);
+word itoar(word n, char *s);
+void itoa(word n, char *s);
+word itoahr(word n, char *s);
+void itoah(word n, char *s);
+word isalpha(char c);
+word isdigit(char c);
+word isalnum(char c);
+word strToInt(char* str);
+void uprintc(char c);
+void uprint(char* str);
+void uprintln(char* str);
+void uprintDec(word i);
+void uprintHex(word i);
+void uprintlnDec(word i);
+void uprintlnHex(word i);
+void delay(word ms);
+word getIntID();
+char toUpper(char c);
+void strToUpper(char* str);
+void hexdump(char* addr, word len);
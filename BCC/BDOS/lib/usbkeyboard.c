@@ -8,25 +8,7 @@
 // uses hidfifo.c
 // uses USBSCANCODES.c
 
-#define USBKEYBOARD_CMD_SET_USB_SPEED        0x04
-#define USBKEYBOARD_CMD_RESET_ALL            0x05
-#define USBKEYBOARD_CMD_GET_STATUS           0x22
-#define USBKEYBOARD_CMD_SET_USB_MODE         0x15
-#define USBKEYBOARD_MODE_HOST_0              0x05
-#define USBKEYBOARD_MODE_HOST_1              0x07
-#define USBKEYBOARD_MODE_HOST_2              0x06
-#define USBKEYBOARD_ANSW_USB_INT_CONNECT     0x15
-
-#define USBKEYBOARD_POLLING_RATE 30
-#define USBKEYBOARD_HOLD_COUNTS 20
-
-// These are in stdlib.c already
-// #define TIMER2_VAL 0xC0273B
-// #define TIMER2_CTRL 0xC0273C
-
-#define USBKEYBOARD_SPI2_INTERRUPT 0xC02730
-
-#define USBKEYBOARD_DATA_OFFSET 3
+#include "BDOS.h"
 
 /*
 *   Global Variables
@@ -0,0 +1,55 @@
+/*
+* Interface of lib/usbkeyboard.c
+* Included by all BDOS modules through BDOS.h
+*/
+
+#define USBKEYBOARD_CMD_SET_USB_SPEED        0x04
+#define USBKEYBOARD_CMD_RESET_ALL            0x05
+#define USBKEYBOARD_CMD_GET_STATUS           0x22
+#define USBKEYBOARD_CMD_SET_USB_MODE         0x15
+#define USBKEYBOARD_MODE_HOST_0              0x05
+#define USBKEYBOARD_MODE_HOST_1              0x07
+#define USBKEYBOARD_MODE_HOST_2              0x06
+#define USBKEYBOARD_ANSW_USB_INT_CONNECT     0x15
+
+#define USBKEYBOARD_POLLING_RATE 30
+#define USBKEYBOARD_HOLD_COUNTS 20
+
+// These are in stdlib.h already
+// #define TIMER2_VAL 0xC0273B
+// #define TIMER2_CTRL 0xC0273C
+
+#define USBKEYBOARD_SPI2_INTERRUPT 0xC02730
+
+#define USBKEYBOARD_DATA_OFFSET 3
+
+// Global variables
+extern word USBkeyboard_endp_mode;
+extern word USBkeyboard_buffer[8];
+extern word USBkeyboard_buffer_parsed[8];
+extern word USBkeyboard_buffer_prev[8];
+extern word USBkeyboard_holdCounter;
+extern word USBkeyboard_holdButton;
+extern word USBkeyboard_holdButtonDataOrig;
+
+// Functions
+void USBkeyboard_asmDefines();
+void USBkeyboard_spiBeginTransfer();
+void USBkeyboard_spiEndTransfer();
+word USBkeyboard_spiTransfer(word dataByte);
+word USBkeyboard_WaitGetStatus();
+word USBkeyboard_noWaitGetStatus();
+word USBkeyboard_setUSBmode(word mode);
+void USBkeyboard_setUSBspeed(word speed);
+void USBkeyboard_init();
+void USBkeyboard_connectDevice();
+void USBkeyboard_toggle_recv();
+void USBkeyboard_issue_token(word endp_and_pid);
+void USBkeyboard_receive_data(char* usbBuf);
+void USBkeyboard_set_addr(word addr);
+void USBkeyboard_set_config(word cfg);
+void USBkeyboard_sendToFifo(char usbCode, char* usbBuf);
+word USBkeyboard_buttonInBuffer(char button, char* buffer);
+void USBkeyboard_parse_buffer(char* usbBuf, char* usbBufPrev);
+void USBkeyboard_poll();
+void USBkeyboard_HandleInterrupt();
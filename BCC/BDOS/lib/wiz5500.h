@@ -0,0 +1,126 @@
+/*
+* Interface of lib/wiz5500.c
+* Included by all BDOS modules through BDOS.h
+*/
+
+// Wiznet W5500 Op Codes
+#define WIZNET_WRITE_COMMON 0x04 //opcode to write to one of the common block of registers
+#define WIZNET_READ_COMMON  0x00 //opcode to read one of the common block of registers
+#define WIZNET_WRITE_SnR    0x0C // s<<5 (nnn 01 1 00) opcode to write to one of the socket n registers
+#define WIZNET_READ_SnR     0x08 // s<<5 (nnn 01 0 00) opcode to read one of the socket n registers
+#define WIZNET_WRITE_SnTX   0x14 // s<<5 (nnn 10 1 00) opcode to write to the socket n transmit buffer
+#define WIZNET_READ_SnRX    0x18 // s<<5 (nnn 11 0 00) opcode to read from the socket n receive buffer
+
+// Wiznet W5500 Register Addresses
+#define WIZNET_MR     0x0000    // Mode
+#define WIZNET_GAR    0x0001    // Gateway IP address
+#define WIZNET_SUBR   0x0005    // Subnet mask address
+#define WIZNET_SHAR   0x0009    // Source MAC address
+#define WIZNET_SIPR   0x000F    // Source IP address
+#define WIZNET_IR     0x0015    // Interrupt
+#define WIZNET_IMR    0x0016    // Interrupt Mask
+#define WIZNET_RTR    0x0019    // Timeout address
+#define WIZNET_RCR    0x001B    // Retry count
+#define WIZNET_UIPR   0x0028    // Unreachable IP address in UDP mode
+#define WIZNET_UPORT  0x002C    // Unreachable Port address in UDP mode
+
+//W5500 Socket Registers follow
+#define WIZNET_SnMR        0x0000        // Mode
+#define WIZNET_SnCR        0x0001        // Command
+#define WIZNET_SnIR        0x0002        // Interrupt
+#define WIZNET_SnSR        0x0003        // Status
+#define WIZNET_SnPORT      0x0004        // Source Port (2 bytes)
+#define WIZNET_SnDHAR      0x0006        // Destination Hardw Addr
+#define WIZNET_SnDIPR      0x000C        // Destination IP Addr
+#define WIZNET_SnDPORT     0x0010        // Destination Port
+#define WIZNET_SnMSSR      0x0012        // Max Segment Size
+#define WIZNET_SnPROTO     0x0014        // Protocol in IP RAW Mode
+#define WIZNET_SnTOS       0x0015        // IP TOS
+#define WIZNET_SnTTL       0x0016        // IP TTL
+#define WIZNET_SnRX_BSZ    0x001E        // RX Buffer Size
+#define WIZNET_SnTX_BSZ    0x001F        // TX Buffer Size
+#define WIZNET_SnTX_FSR    0x0020        // TX Free Size
+#define WIZNET_SnTX_RD     0x0022        // TX Read Pointer
+#define WIZNET_SnTX_WR     0x0024        // TX Write Pointer
+#define WIZNET_SnRX_RSR    0x0026        // RX RECEIVED SIZE REGISTER
+#define WIZNET_SnRX_RD     0x0028        // RX Read Pointer
+#define WIZNET_SnRX_WR     0x002A        // RX Write Pointer (supported?
+
+//Socket n Mode Register (0x0000)
+//WIZNET_SnMR
+#define WIZNET_MR_CLOSE    0x00    // Unused socket
+#define WIZNET_MR_TCP      0x01    // TCP
+#define WIZNET_MR_UDP      0x02    // UDP
+#define WIZNET_MR_IPRAW    0x03    // IP LAYER RAW SOCK
+#define WIZNET_MR_MACRAW   0x04    // MAC LAYER RAW SOCK
+#define WIZNET_MR_PPPOE    0x05    // PPPoE
+#define WIZNET_MR_ND       0x20    // No Delayed Ack(TCP) flag
+#define WIZNET_MR_MULTI    0x80    // support multicating
+
+//Socket n Command Register (0x0001)
+//WIZNET_SnCR
+#define WIZNET_CR_OPEN          0x01   // Initialize or open socket
+#define WIZNET_CR_LISTEN        0x02   // Wait connection request in tcp mode(Server mode)
+#define WIZNET_CR_CONNECT       0x04   // Send connection request in tcp mode(Client mode)
+#define WIZNET_CR_DISCON        0x08   // Send closing reqeuset in tcp mode
+#define WIZNET_CR_CLOSE         0x10   // Close socket
+#define WIZNET_CR_SEND          0x20   // Update Tx memory pointer and send data
+#define WIZNET_CR_SEND_MAC      0x21   // Send data with MAC address, so without ARP process
+#define WIZNET_CR_SEND_KEEP     0x22   // Send keep alive message
+#define WIZNET_CR_RECV          0x40   // Update Rx memory buffer pointer and receive data
+
+//Socket n Interrupt Register (0x0002)
+//WIZNET_SnIR
+// Bit 0: CON
+// Bit 1: DISCON
+// Bit 2: RECV
+// Bit 3: TIMEOUT
+// Bit 4: SEND_OK
+
+//Socket n Status Register (0x0003)
+//WIZNET_SnSR 
+#define WIZNET_SOCK_CLOSED      0x00   // Closed
+#define WIZNET_SOCK_INIT        0x13   // Init state
+#define WIZNET_SOCK_LISTEN      0x14   // Listen state
+#define WIZNET_SOCK_SYNSENT     0x15   // Connection state
+#define WIZNET_SOCK_SYNRECV     0x16   // Connection state
+#define WIZNET_SOCK_ESTABLISHED 0x17   // Success to connect
+#define WIZNET_SOCK_FIN_WAIT    0x18   // Closing state
+#define WIZNET_SOCK_CLOSING     0x1A   // Closing state
+#define WIZNET_SOCK_TIME_WAIT   0x1B   // Closing state
+#define WIZNET_SOCK_CLOSE_WAIT  0x1C   // Closing state
+#define WIZNET_SOCK_LAST_ACK    0x1D   // Closing state
+#define WIZNET_SOCK_UDP         0x22   // UDP socket
+#define WIZNET_SOCK_IPRAW       0x32   // IP raw mode socket
+#define WIZNET_SOCK_MACRAW      0x42   // MAC raw mode socket
+#define WIZNET_SOCK_PPPOE       0x5F   // PPPOE socket
+
+//Socket n Source Port Register (0x0004, 0x0005)
+//WIZNET_SnPORT
+// MSByte: 0x0004
+// LSByte: 0x0005
+
+#define WIZNET_MAX_RBUF 2048 // buffer for receiving data (max rx packet size!)
+#define WIZNET_MAX_TBUF 2048 // buffer for sending data (max tx packet size!)
+
+// Functions
+void W5500_asmDefines();
+void wiz_spi_begin_transfer();
+void wiz_spi_end_transfer();
+word wiz_spi_transfer(word dataByte);
+void wiz_write(word addr, word cb, char* buf, word len);
+word wiz_write_single(word addr, word cb, word data);
+void wiz_write_double(word addr, word cb, word data);
+void wiz_read(word addr, word cb, char* buf, word len);
+word wiz_read_single(word addr, word cb);
+word wiz_read_double(word addr, word cb);
+void wiz_send_cmd(word s, word cmd);
+void wiz_set_sock_reg_8(word s, word addr, word val);
+word wiz_get_sock_reg_8(word s, word addr);
+void wiz_set_sock_reg_16(word s, word addr, word val);
+word wiz_get_sock_reg_16(word s, word addr);
+void wiz_init(char* ip_addr, char* gateway_addr, char* mac_addr, char* sub_mask);
+void wiz_init_socket_tcp_host(word s, word port);
+word wiz_write_data(word s, char* buf, word buflen);
+word wiz_read_recv_data(word s, char* buf, word buflen);
+void wiz_flush(word s, word rsize);
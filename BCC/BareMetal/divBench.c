@@ -0,0 +1,100 @@
+// Division benchmark
+// Compares the MATH_div/MATH_mod calls with the inline / and % operators of the host BCC.
+// Only compiles with the host BCC, as the bcc in FPGCbuildTools does not support / and %.
+// Results are sent over UART.
+
+#define word char
+
+#include "lib/math.c"
+#include "lib/stdlib.c"
+
+#define N    256  // Decimals of pi to compute.
+#define LEN  854  // (10*N) / 3 + 1
+#define TMPMEM_LOCATION 0x440000
+
+word frameCount = 0;
+
+word *a = (char*) TMPMEM_LOCATION;
+
+
+#define SPIGOT_PI spigotPiCall
+#define DIV_CALLS
+#include "divBenchKernel.c"
+#undef SPIGOT_PI
+#undef DIV_CALLS
+
+#define SPIGOT_PI spigotPiInline
+#include "divBenchKernel.c"
+
+
+// Runs the kernel once and prints the number of frames it took
+void runBench(char* name, word useInline)
+{
+  word sum = 0;
+
+  frameCount = 0;
+  while (frameCount == 0); // wait until next frame to start
+  frameCount = 0;
+
+  if (useInline)
+  {
+    sum = spigotPiInline();
+  }
+  else
+  {
+    sum = spigotPiCall();
+  }
+
+  word frames = frameCount;
+
+  uprint(name);
+  uprint("digit sum ");
+  uprintDec(sum);
+  uprint("frames    ");
+  uprintDec(frames);
+}
+
+
+int main()
+{
+  uprintln("---------------DivBench---------------");
+
+  runBench("MATH_div/MATH_mod: ", 0);
+  runBench("inline / and %:    ", 1);
+
+  return 48;
+}
+
+void int1()
+{
+  timer1Value = 1; // notify ending of timer1
+}
+
+void int2()
+{
+
+}
+
+void int3()
+{
+
+}
+
+void int4()
+{
+  frameCount++;
+}
+
+void interrupt()
+{
+  word i = getIntID();
+
+  if (i == 1)
+  {
+    int1();
+  }
+  else if (i == 4)
+  {
+    int4();
+  }
+}
@@ -0,0 +1,80 @@
+// PiBench256 kernel from userBDOS/bench.c, included by divBench.c once for each way of dividing.
+// Defines SPIGOT_PI(), which uses MATH_div and MATH_mod when DIV_CALLS is defined,
+// and the / and % operators otherwise.
+// Returns the sum of all digits instead of printing them.
+word SPIGOT_PI()
+{
+  word j = 0;
+  word predigit = 0;
+  word nines = 0;
+  word x = 0;
+  word q = 0;
+  word k = 0;
+  word i = 0;
+  word sum = 0;
+
+  for(j=N; j; )
+  {
+    q = 0;
+    k = LEN+LEN-1;
+
+    for(i=LEN; i; --i)
+    {
+      if (j == N)
+      {
+        x = 20 + q*i;
+      }
+      else
+      {
+        x = (10*a[i-1]) + q*i;
+      }
+#ifdef DIV_CALLS
+      q = MATH_div(x, k);
+#else
+      q = x / k;
+#endif
+      a[i-1] = (x-q*k);
+      k -= 2;
+    }
+
+#ifdef DIV_CALLS
+    k = MATH_mod(x, 10);
+#else
+    k = x % 10;
+#endif
+
+    if (k==9)
+    {
+      ++nines;
+    }
+
+    else
+    {
+      if (j)
+      {
+        --j;
+#ifdef DIV_CALLS
+        sum += predigit + MATH_div(x, 10);
+#else
+        sum += predigit + x / 10;
+#endif
+      }
+
+      for(; nines; --nines)
+      {
+        if (j)
+        {
+          --j;
+          if (x < 10)
+          {
+            sum += 9;
+          }
+        }
+      }
+
+      predigit = k;
+    }
+  }
+
+  return sum;
+}
@@ -11,11 +11,14 @@
 /*****************************************************************************/
 
 /* Notes:
-- everything after the last \n is ignored, should not be a problem because wrapper
 - does not support includes or other things that are not used when using BCC
 - does not support asm defines, because of performance reasons
 - also does not keep track of line numbers for errors and does less checks for errors
     since the input is from BCC and therefore has some kind of standard
+- reads the input file once: pass 1 tokenizes each line into a record in the heap
+    and gives the labels their offset within their section,
+    pass 2 encodes the records of each section, when all label addresses are known
+- the records and labels are allocated from one heap, so memory use grows with the program
 */
 
 #define word char
@@ -24,19 +27,89 @@
 #include "lib/sys.c"
 #include "lib/stdlib.c"
 #include "lib/brfs.c"
-#include "lib/stdio.c"
 
-#define USERBDOS_OFFSET 0x400000 // applied offset to all labels
+#define USERBDOS_OFFSET 0x400000 // applied offset to all labels, unless relocatable
+
+// relocatable programs start with a header and end with a relocation table, read by the BDOS loader
+#define RELOC_MAGIC 0x52454C4F // "RELO"
+#define RELOC_JUMP 0 // jump to a label
+#define RELOC_DATA 1 // .dl of a label
+#define RELOC_ADDR2REG 2 // load of the label with a loadhi below it
+
+// records and the output grow up from the bottom, labels and the label hash table down from the top
+#define HEAP_ADDR 0x420000
+#define HEAP_END 0x720000
+
+// sections, in the order they are placed in the binary
+#define SECTION_CODE 0
+#define SECTION_DATA 1
+#define SECTION_RDATA 2
+#define SECTION_BSS 3
+#define SECTION_COUNT 4
+
+// types of the arguments in a record
+#define ARG_NUMBER 0
+#define ARG_REG 1
+#define ARG_LABEL 2
+
+// operations of a record
+// arithmetic operations are OP_OR + their opcode
+#define OP_OR 0x10
+#define OP_MULTFP (OP_OR + 0xF)
+// branches are OP_BEQ + (their opcode << 1) + signed
+#define OP_BEQ 0x20
+#define OP_BLES (OP_BEQ + 0xD)
+#define OP_HALT 1
+#define OP_READ 2
+#define OP_WRITE 3
+#define OP_READINTID 4
+#define OP_PUSH 5
+#define OP_POP 6
+#define OP_JUMP 7
+#define OP_JUMPO 8
+#define OP_JUMPR 9
+#define OP_JUMPRO 10
+#define OP_SAVPC 11
+#define OP_RETI 12
+#define OP_CCACHE 13
+#define OP_NOT 14
+#define OP_LOAD 15
+#define OP_LOADHI 0x30
+#define OP_NOP 0x31
+#define OP_ADDR2REG 0x32
+#define OP_LOAD32 0x33
+#define OP_DW 0x34
+#define OP_DL 0x35
+#define OP_SPACE 0x36
+#define OP_DB 0x37
+#define OP_DEFINE 0x38
+// section directives are OP_SECTION + their section
+#define OP_SECTION 0x40
+
+/* Records:
+- header word: op in bits 7..0, section in bits 9..8,
+    type of args 1 to 4 in two bits each from bit 10, number of args from bit 18
+- one word per arg: the number, the register or a pointer to the label
+- only the first four args can be registers or labels, all others are numbers (.dw)
+*/
 
-#define OUTFILE_DATA_ADDR 0x420000
-#define OUTFILE_CODE_ADDR 0x4A0000
-#define OUTFILE_PASS1_ADDR 0x520000
-#define OUTFILE_PASS2_ADDR 0x610000
+/* Labels:
+- word 0: section, -1 if not defined yet
+- word 1: offset in its section, the address (including labelOffset) after pass 1
+- word 2: hash of the name
+- name, terminated by 0
+*/
+#define LABEL_SECTION 0
+#define LABEL_ADDR 1
+#define LABEL_HASH 2
+#define LABEL_NAME 3
 
-#define LABELLISTLINENR_ADDR 0x6F0000
-#define LABELLIST_ADDR 0x700000
+#define EOF -1
+#define INPUTBUFFER_SIZE 4096 // words of the input file read at once
 
-#define LINEBUFFER_ADDR 0x6E0000
+#define TOKEN_SIZE 128 // max length of a token, therefore of a label
+#define MNEMONIC_HASH_SIZE 128 // power of 2, more than twice the number of mnemonics
+#define LABELHASH_START_SIZE 1024 // power of 2, doubles when 3/4 full
 
 word fd_input = -1;
 word fd_output = -1;
@@ -44,775 +117,696 @@ word fd_output = -1;
 char absolute_path_in[MAX_PATH_LENGTH];
 word filesize_input = 0;
 
-char *lineBuffer = (char*) LINEBUFFER_ADDR;
+word inputBuffer[INPUTBUFFER_SIZE];
+word inputBufferLength = 0;
+word inputBufferCursor = 0;
+word inputRemaining = 0; // words of the input file not read into the buffer yet
 
-word memCursor = 0; // cursor for readMemLine
-word globalLineCursor = 0; // to keep track of the line number for labels
+char* heapBottom = (char*) HEAP_ADDR;
+char* heapTop = (char*) HEAP_END;
 
-#define LABELLIST_SIZE 2048 // expecting a lot of labels! as of writing, BDOS has ~1000 TODO: 2048 when done
-#define LABEL_NAME_SIZE 32 // max length of a label (therefore of a function name)
+char* recordsAddr = (char*) HEAP_ADDR; // first record
+char* recordsEnd = (char*) HEAP_ADDR; // after the last record
 
-char (*labelListName)[LABEL_NAME_SIZE] = (char (*)[LABEL_NAME_SIZE]) LABELLIST_ADDR; // 2d array containing all lines of the input file
-//char labelListName[LABELLIST_SIZE][LABEL_NAME_SIZE]; // old version, makes binary too large
+char tokenBuffer[TOKEN_SIZE];
+word tokenLength = 0;
+word tokenHash = 0;
 
-word* labelListLineNumber = (word*) LABELLISTLINENR_ADDR;
-//word labelListLineNumber[LABELLIST_SIZE]; // value should be the line number of the corresponding label name
+word mnemonicName[MNEMONIC_HASH_SIZE]; // pointer to the name for each hash, 0 if empty
+word mnemonicOp[MNEMONIC_HASH_SIZE];
 
-word labelListIndex = 0; // current index in the label list
-word prevLinesWereLabels = 0; // allows the current line to know how many labels are pointing to it
-
-// reads a line from the input file, tries to remove all extra characters
-word readFileLine()
-{
-    word foundStart = 0;
-    word foundComment = 0;
+word* labelHashTable = 0; // pointer to the label for each hash, 0 if empty
+word labelHashSize = 0;
+word labelCount = 0;
 
-    word outputi = 0;
+word currentSection = SECTION_CODE;
+word sectionLength[SECTION_COUNT]; // in words, including .space
+word sectionEnd[SECTION_COUNT]; // end of the last words that are not from .space
+word sectionBase[SECTION_COUNT]; // address of each section in the binary
+word binaryLength = 0; // without the .space at the end
 
-    char c = fgetc(fd_input, filesize_input);
-    char cprev = c;
-    // stop on EOF or newline
-    while (c != EOF && c != '\n')
-    {
-        // if we have found a comment, ignore everything after
-        if (c == ';')
-        {
-            foundComment = 1;
-        }
+word relocatable = 0; // assemble for address 0 and add the relocation table
+word labelOffset = USERBDOS_OFFSET; // offset applied to all labels
+word* relocList = 0; // relocation table, kind in the highest 2 bits and address below it
+word relocCount = 0; // number of relocations, counted in pass 1
+word relocListIndex = 0; // current index in the relocation table
 
-        if (!foundComment)
-        {
-            // if we have not found the first non-space yet, ignore until a non-space
-            if (!foundStart)
-            {
-                if (c == ' ')
-                {
-                    // do nothing until we find a non-space
-                }
-                else
-                {
-                    foundStart = 1;
-                    lineBuffer[outputi] = c;
-                    outputi++;
-                }
-            }
-            else
-            {
-                if (cprev == ' ' && c == ' ')
-                {
-                    // ignore double space
-                }
-                else
-                {
-                    lineBuffer[outputi] = c;
-                    outputi++;
-                }
-            }
-        }
-            
-        
-        cprev = c;
-        c = fgetc(fd_input, filesize_input);
-    }
-
-    lineBuffer[outputi] = 0; // terminate
-
-    if (c == EOF)
-    {
-        if (lineBuffer[0] != 0)
-        {
-            // all code after the last \n is ignored!
-            bdos_print("Skipped: ");
-            bdos_print(lineBuffer);
-            bdos_print("\n");
-        }
-        return EOF;
-    }
-
-    // if empty line, read next line
-    if (outputi == 0)
-    {
-        return readFileLine();
-    }
-    else if (lineBuffer[outputi-1] == ' ')
+// returns n words from the bottom of the heap
+char* allocate(word n)
+{
+    char* p = heapBottom;
+    heapBottom += n;
+    if (heapBottom > heapTop)
     {
-        // remove trailing space
-        lineBuffer[outputi-1] = 0;
+        bdos_print("Out of memory\n");
+        exit(1);
     }
-
-    return 0;
+    return p;
 }
 
-
-// Reads a line from memory
-// Assumes all extra characters are already processed
-word readMemLine(char* memAddr)
+// returns n words from the top of the heap
+char* allocateTop(word n)
 {
-    word outputi = 0;
-
-    char c = memAddr[memCursor];
-    memCursor++;
-    while (c != 0 && c != '\n')
+    heapTop -= n;
+    if (heapTop < heapBottom)
     {
-        lineBuffer[outputi] = c;
-        outputi++;
-        c = memAddr[memCursor];
-        memCursor++;
+        bdos_print("Out of memory\n");
+        exit(1);
     }
+    return heapTop;
+}
 
-    lineBuffer[outputi] = 0; // terminate
-
-    // memory ends with a 0
-    if (c == 0)
+word hashString(char* s)
+{
+    word hash = 0;
+    word i = 0;
+    while (s[i] != 0)
     {
-        return EOF;
+        hash = (hash << 5) + hash + s[i];
+        i++;
     }
+    return hash;
+}
 
-    // if empty line, read next line
-    if (outputi == 0)
+void addMnemonic(char* name, word op)
+{
+    word hash = hashString(name) & (MNEMONIC_HASH_SIZE - 1);
+    while (mnemonicName[hash] != 0)
     {
-        bdos_print("Empty string in readMemLine!!!\n");
-        return EOF;
+        hash = (hash + 1) & (MNEMONIC_HASH_SIZE - 1);
     }
-
-    return 0;
+    mnemonicName[hash] = (word) name;
+    mnemonicOp[hash] = op;
 }
 
+void initMnemonics()
+{
+    addMnemonic("halt", OP_HALT);
+    addMnemonic("read", OP_READ);
+    addMnemonic("write", OP_WRITE);
+    addMnemonic("readintid", OP_READINTID);
+    addMnemonic("push", OP_PUSH);
+    addMnemonic("pop", OP_POP);
+    addMnemonic("jump", OP_JUMP);
+    addMnemonic("jumpo", OP_JUMPO);
+    addMnemonic("jumpr", OP_JUMPR);
+    addMnemonic("jumpro", OP_JUMPRO);
+    addMnemonic("beq", OP_BEQ);
+    addMnemonic("bgt", OP_BEQ + 2);
+    addMnemonic("bgts", OP_BEQ + 3);
+    addMnemonic("bge", OP_BEQ + 4);
+    addMnemonic("bges", OP_BEQ + 5);
+    addMnemonic("bne", OP_BEQ + 8);
+    addMnemonic("blt", OP_BEQ + 10);
+    addMnemonic("blts", OP_BEQ + 11);
+    addMnemonic("ble", OP_BEQ + 12);
+    addMnemonic("bles", OP_BEQ + 13);
+    addMnemonic("savpc", OP_SAVPC);
+    addMnemonic("reti", OP_RETI);
+    addMnemonic("ccache", OP_CCACHE);
+    addMnemonic("or", OP_OR);
+    addMnemonic("and", OP_OR + 0x1);
+    addMnemonic("xor", OP_OR + 0x2);
+    addMnemonic("add", OP_OR + 0x3);
+    addMnemonic("sub", OP_OR + 0x4);
+    addMnemonic("shiftl", OP_OR + 0x5);
+    addMnemonic("shiftr", OP_OR + 0x6);
+    addMnemonic("mults", OP_OR + 0x8);
+    addMnemonic("multu", OP_OR + 0x9);
+    addMnemonic("slt", OP_OR + 0xA);
+    addMnemonic("sltu", OP_OR + 0xB);
+    addMnemonic("shiftrs", OP_OR + 0xE);
+    addMnemonic("multfp", OP_OR + 0xF);
+    addMnemonic("not", OP_NOT);
+    addMnemonic("load", OP_LOAD);
+    addMnemonic("loadhi", OP_LOADHI);
+    addMnemonic("nop", OP_NOP);
+    addMnemonic("addr2reg", OP_ADDR2REG);
+    addMnemonic("load32", OP_LOAD32);
+    addMnemonic(".dw", OP_DW);
+    addMnemonic(".dl", OP_DL);
+    addMnemonic(".space", OP_SPACE);
+    addMnemonic(".db", OP_DB);
+    addMnemonic("define", OP_DEFINE);
+    addMnemonic(".code", OP_SECTION + SECTION_CODE);
+    addMnemonic(".data", OP_SECTION + SECTION_DATA);
+    addMnemonic(".rdata", OP_SECTION + SECTION_RDATA);
+    addMnemonic(".bss", OP_SECTION + SECTION_BSS);
+}
 
-// Fills bufOut with argi in linebuffer
-void getArgPos(word argi, char* bufOut)
+// returns the op of the mnemonic in tokenBuffer, -1 if unknown
+word findMnemonic()
 {
-    word linei = 0;
-    char c = 0;
-    word lineLength = strlen(lineBuffer);
-    while(argi > 0 && linei < lineLength)
+    word hash = tokenHash & (MNEMONIC_HASH_SIZE - 1);
+    while (mnemonicName[hash] != 0)
     {
-        c = lineBuffer[linei];
-        if (c == ' ')
+        if (strcmp((char*) mnemonicName[hash], tokenBuffer) == 0)
         {
-            argi--;
+            return mnemonicOp[hash];
         }
-        linei++;
-    }
-    if (linei == 0)
-    {
-        bdos_print("getArgPos error");
-        exit(1);
-    }
-    // copy until space or \n
-    word i = 0;
-    c = lineBuffer[linei];
-    while (c != ' ' && c != 0)
-    {
-        bufOut[i] = c;
-        linei++;
-        i++;
-        c = lineBuffer[linei];
+        hash = (hash + 1) & (MNEMONIC_HASH_SIZE - 1);
     }
-    bufOut[i] = 0; // terminate
+    return -1;
 }
 
-
-// parses the number at argument i in linebuffer
-// can be hex or decimal or binary
-word getNumberAtArg(word argi)
+// returns the position in the hash table of a label name, which contains the label or is empty
+word findLabelHash(char* labelName, word hash)
 {
-    word linei = 0;
-    char c = 0;
-    word lineLength = strlen(lineBuffer);
-    while(argi > 0 && linei < lineLength)
+    word mask = labelHashSize - 1;
+    word i = hash & mask;
+    while (labelHashTable[i] != 0)
     {
-        c = lineBuffer[linei];
-        if (c == ' ')
+        word* label = (word*) labelHashTable[i];
+        if (label[LABEL_HASH] == hash && strcmp(labelName, label + LABEL_NAME) == 0)
         {
-            argi--;
+            return i;
         }
-        linei++;
+        i = (i + 1) & mask;
     }
-    if (linei == 0)
+    return i;
+}
+
+// replaces the label hash table by an empty one of size entries, and adds the labels of the old one
+// the old table is left unused in the heap
+void resizeLabelHash(word size)
+{
+    word* oldTable = labelHashTable;
+    word oldSize = labelHashSize;
+
+    labelHashTable = (word*) allocateTop(size);
+    labelHashSize = size;
+    word i;
+    for (i = 0; i < size; i++)
     {
-        bdos_print("NumberAtArg error");
-        exit(1);
+        labelHashTable[i] = 0;
     }
 
-    // linei is now at the start of the number string
-    // copy until space or \n
-    char strNumberBuf[36];
-    word i = 0;
-    c = lineBuffer[linei];
-    while (c != ' ' && c != 0)
+    for (i = 0; i < oldSize; i++)
     {
-        strNumberBuf[i] = c;
-        linei++;
-        i++;
-        c = lineBuffer[linei];
+        if (oldTable[i] != 0)
+        {
+            word* label = (word*) oldTable[i];
+            labelHashTable[findLabelHash(label + LABEL_NAME, label[LABEL_HASH])] = oldTable[i];
+        }
     }
-    strNumberBuf[i] = 0; // terminate
+}
 
-    word valueToReturn = 0;
-    if (strNumberBuf[1] == 'x' || strNumberBuf[1] == 'X')
+// returns the label with the name, adds it as not defined yet if it is new
+word* getLabel(char* labelName, word hash)
+{
+    word i = findLabelHash(labelName, hash);
+    if (labelHashTable[i] != 0)
     {
-        // hex number
-        valueToReturn = hexToInt(strNumberBuf);
+        return (word*) labelHashTable[i];
     }
-    else if (strNumberBuf[1] == 'b' || strNumberBuf[1] == 'B')
+
+    word* label = (word*) allocateTop(LABEL_NAME + strlen(labelName) + 1);
+    label[LABEL_SECTION] = -1;
+    label[LABEL_ADDR] = 0;
+    label[LABEL_HASH] = hash;
+    strcpy(label + LABEL_NAME, labelName);
+    labelHashTable[i] = (word) label;
+    labelCount++;
+
+    if ((labelCount << 2) > labelHashSize * 3)
     {
-        // binary number
-        valueToReturn = binToInt(strNumberBuf);
+        resizeLabelHash(labelHashSize << 1);
     }
-    else
+    return label;
+}
+
+// defines the label at the current position in the current section
+void defineLabel(char* labelName)
+{
+    word* label = getLabel(labelName, hashString(labelName));
+    if (label[LABEL_SECTION] != -1)
     {
-        // dec number
-        valueToReturn = decToInt(strNumberBuf);
+        bdos_print("Label defined twice: ");
+        bdos_print(labelName);
+        bdos_print("\n");
+        exit(1);
     }
-
-    return valueToReturn;
+    label[LABEL_SECTION] = currentSection;
+    label[LABEL_ADDR] = sectionLength[currentSection];
 }
 
+#include "pass2.c"
 
-// returns 1 if the current line is a label
-word isLabel()
+// returns the number of words a record assembles to
+word recordLength(word* record)
 {
-    // loop until \0 or space
-    word i = 0;
-    while(lineBuffer[i] != 0 && lineBuffer[i] != ' ')
-    {
-        i++;
+    word op = record[0] & 0xFF;
+    switch (op)
+    {
+        case OP_ADDR2REG:
+            return 2;
+        case OP_LOAD32:
+            // the loadhi is skipped if the highest 16 bits are 0
+            if ((unsigned)getNumberArg(record, 1, "LOAD32") >> 16)
+            {
+                return 2;
+            }
+            return 1;
+        case OP_DW:
+            return (unsigned)record[0] >> 18;
+        case OP_SPACE:
+            return getNumberArg(record, 1, "SPACE");
+        case OP_DB:
+            bdos_print(".db is not yet implemented!\n");
+            exit(1);
     }
+    return 1;
+}
 
-    // empty line
-    if (i == 0)
+// adds a record to the current section, so the labels below it get the right offset
+void Pass1Record(word* record)
+{
+    word op = record[0] & 0xFF;
+    word length = recordLength(record);
+    sectionLength[currentSection] += length;
+    if (op != OP_SPACE && length > 0)
     {
-        return 0;
+        sectionEnd[currentSection] = sectionLength[currentSection];
     }
 
-    // label if ends with :
-    if (lineBuffer[i-1] == ':')
+    if (op == OP_DL || op == OP_ADDR2REG || (op == OP_JUMP && getArgType(record, 1) == ARG_LABEL))
     {
-        return 1;
+        relocCount++;
     }
-
-    return 0;
 }
 
-void Pass1StoreLabel()
+// reads the next part of the input file into the buffer, returns its first char or EOF
+word fillInputBuffer()
 {
-    // loop until \0 or space
-    word labelStrLen = 0;
-    while(lineBuffer[labelStrLen] != 0 && lineBuffer[labelStrLen] != ' ')
+    if (inputRemaining == 0)
     {
-        labelStrLen++;
+        return EOF;
     }
 
-    // store label name minus the :
-    memcpy(labelListName[labelListIndex], lineBuffer, labelStrLen-1);
-    // terminate
-    labelListName[labelListIndex][labelStrLen-1] = 0;
-
-    labelListIndex++;
-    // labelListLineNumber will be set when the next instruction is found
-
-    // notify next line that it has a label
-    prevLinesWereLabels++;
+    word length = INPUTBUFFER_SIZE;
+    if (inputRemaining < length)
+    {
+        length = inputRemaining;
+    }
+    fs_read(fd_input, inputBuffer, length);
+    inputRemaining -= length;
+    inputBufferLength = length;
+    inputBufferCursor = 1;
+    return inputBuffer[0];
 }
 
-void Pass1StoreDefine()
+// returns the next char of the input file
+word readChar()
 {
-    // defines are not supported right now, so they are skipped
+    if (inputBufferCursor < inputBufferLength)
+    {
+        word c = inputBuffer[inputBufferCursor];
+        inputBufferCursor++;
+        return c;
+    }
+    return fillInputBuffer();
 }
 
-// Create two lines with the same args:
-// loadLabelLow
-// loadLabelHigh
-// returns the number of lines added
-word Pass1Addr2reg(char* outputAddr, char* outputCursor)
+// returns 1 if c separates the tokens of a line
+word isSeparator(word c)
 {
-    word lineBufArgsLen = strlen(lineBuffer) - 9; // minus addr2len and space
-    // copy name of instruction
-    memcpy((outputAddr + *outputCursor), "loadLabelLow ", 13);
-    (*outputCursor) += 13;
-    // copy args
-    memcpy((outputAddr + *outputCursor), (lineBuffer+9), lineBufArgsLen);
-    (*outputCursor) += lineBufArgsLen;
-    // add a newline
-    *(outputAddr + *outputCursor) = '\n';
-    (*outputCursor)++;
-
-    // copy name of instruction
-    memcpy((outputAddr + *outputCursor), "loadLabelHigh ", 14);
-    (*outputCursor) += 14;
-    // copy args
-    memcpy((outputAddr + *outputCursor), (lineBuffer+9), lineBufArgsLen);
-    (*outputCursor) += lineBufArgsLen;
-    // add a newline
-    *(outputAddr + *outputCursor) = '\n';
-    (*outputCursor)++;
-
-    return 2;
+    return c == ' ' || c == '\t' || c == '\r';
 }
 
-// Converts into load and loadhi
-// skips loadhi if the value fits in 32bits
-// returns the number of lines added
-word Pass1Load32(char* outputAddr, char* outputCursor)
+// skips the rest of the line, returns the \n or EOF
+// searches the buffer directly, since most lines from BCC are comments
+word skipLine(word c)
 {
-    // get the destination register
-    char dstRegBuf[16];
-    getArgPos(2, dstRegBuf);
-    word dstRegBufLen = strlen(dstRegBuf);
-
-    // get and parse the value that is being loaded
-    word load32Value = getNumberAtArg(1);
-
-    // split into 16 bit unsigned values
-    word mask16Bit = 0xFFFF;
-    word lowVal = load32Value & mask16Bit;
-    word highVal = ((unsigned) load32Value >> 16) & mask16Bit;
-
-    // add lowval
-    char buf[16];
-    itoa(lowVal, buf);
-    word buflen = strlen(buf);
-    // copy name of instruction
-    memcpy((outputAddr + *outputCursor), "load ", 5);
-    (*outputCursor) += 5;
-    // copy value
-    memcpy((outputAddr + *outputCursor), buf, buflen);
-    (*outputCursor) += buflen;
-    // add a space
-    *(outputAddr + *outputCursor) = ' ';
-    (*outputCursor)++;
-    // copy destination register
-    memcpy((outputAddr + *outputCursor), dstRegBuf, dstRegBufLen);
-    (*outputCursor) += dstRegBufLen;
-    // add a newline
-    *(outputAddr + *outputCursor) = '\n';
-    (*outputCursor)++;
-
-    // add highval
-    if (highVal) // skip if 0
-    {
-        itoa(highVal, buf);
-        word buflen = strlen(buf);
-        // copy name of instruction
-        memcpy((outputAddr + *outputCursor), "loadhi ", 7);
-        (*outputCursor) += 7;
-        // copy value
-        memcpy((outputAddr + *outputCursor), buf, buflen);
-        (*outputCursor) += buflen;
-        // add a space
-        *(outputAddr + *outputCursor) = ' ';
-        (*outputCursor)++;
-        // copy destination register
-        memcpy((outputAddr + *outputCursor), dstRegBuf, dstRegBufLen);
-        (*outputCursor) += dstRegBufLen;
-        // add a newline
-        *(outputAddr + *outputCursor) = '\n';
-        (*outputCursor)++;
-        return 2;
+    while (c != '\n' && c != EOF)
+    {
+        word i = inputBufferCursor;
+        word length = inputBufferLength;
+        char* buffer = inputBuffer;
+        while (i < length && buffer[i] != '\n')
+        {
+            i++;
+        }
+        if (i < length)
+        {
+            inputBufferCursor = i + 1;
+            return '\n';
+        }
+        inputBufferCursor = i;
+        c = fillInputBuffer();
     }
-
-    return 1;
+    return c;
 }
 
-// Creates a single .dw line using numBuf as value
-void addSingleDwLine(char* outputAddr, char* outputCursor, char* numBuf)
+// reads the token starting with c into tokenBuffer, returns the char after it
+word readToken(word c)
 {
-    word numBufLen = strlen(numBuf);
-    // copy name of instruction
-    memcpy((outputAddr + *outputCursor), ".dw ", 4);
-    (*outputCursor) += 4;
-    // copy value
-    memcpy((outputAddr + *outputCursor), numBuf, numBufLen);
-    (*outputCursor) += numBufLen;
-    // add a newline
-    *(outputAddr + *outputCursor) = '\n';
-    (*outputCursor)++;
+    word hash = 0;
+    word i = 0;
+    while (c != ' ' && c != '\n' && c != EOF && c != ';' && c != '\t' && c != '\r')
+    {
+        if (i == TOKEN_SIZE - 1)
+        {
+            tokenBuffer[i] = 0;
+            bdos_print("Token too long: ");
+            bdos_print(tokenBuffer);
+            bdos_print("\n");
+            exit(1);
+        }
+        tokenBuffer[i] = c;
+        hash = (hash << 5) + hash + c;
+        i++;
+        c = readChar();
+    }
+    tokenBuffer[i] = 0; // terminate
+    tokenLength = i;
+    tokenHash = hash;
+    return c;
 }
 
-// Puts each value after .dw on its own line with its own .dw prefix
-// returns the number of lines added
-word Pass1Dw(char* outputAddr, char* outputCursor)
+// parses the token as an argument into arg, returns its type
+word parseArg(word* arg)
 {
-    word numberOfLinesAdded = 0;
-    char numBuf[36]; // buffer to store each space separated number in
-    word i = 0;
-    word linei = 4; // index of linebuffer, start after .dw
+    char c = tokenBuffer[0];
 
-    char c = lineBuffer[linei];
-    while (c != 0)
+    // numbers start with a digit or a minus sign, labels never do
+    if ((c >= '0' && c <= '9') || c == '-')
     {
-        if (c == ' ')
+        if (tokenBuffer[1] == 'x' || tokenBuffer[1] == 'X')
+        {
+            *arg = hexToInt(tokenBuffer);
+        }
+        else if (tokenBuffer[1] == 'b' || tokenBuffer[1] == 'B')
         {
-            numBuf[i] = 0; // terminate
-            addSingleDwLine(outputAddr, outputCursor, numBuf); // process number
-            numberOfLinesAdded++;
-            i = 0; // reset numBuf index
+            *arg = binToInt(tokenBuffer);
         }
         else
         {
-            numBuf[i] = c;
-            i++;
+            *arg = decToInt(tokenBuffer);
         }
-        linei++;
-        c = lineBuffer[linei];
+        return ARG_NUMBER;
     }
 
-    numBuf[i] = 0; // terminate
-    addSingleDwLine(outputAddr, outputCursor, numBuf); // process the final number
-    numberOfLinesAdded++;
+    // registers are an r followed by only digits
+    if (c == 'r' && tokenLength > 1)
+    {
+        word reg = 0;
+        word i = 1;
+        while (tokenBuffer[i] >= '0' && tokenBuffer[i] <= '9')
+        {
+            reg = (reg << 3) + (reg << 1) + (tokenBuffer[i] - '0');
+            i++;
+        }
+        if (tokenBuffer[i] == 0)
+        {
+            *arg = reg;
+            return ARG_REG;
+        }
+    }
 
-    return numberOfLinesAdded;
+    *arg = (word) getLabel(tokenBuffer, tokenHash);
+    return ARG_LABEL;
 }
 
-void Pass1Db(char* outputAddr, char* outputCursor)
+// reads the args of the line into a record with op, returns the char after the line
+word readRecord(word op, word c)
 {
-    bdos_print(".db is not yet implemented!\n");
-    exit(1);
-}
-
+    word* record = (word*) allocate(1);
+    word header = op + (currentSection << 8);
+    word argc = 0;
 
-// Convert each line into the number of lines equal to the number of words in binary
-// Also reads defines and processes labels
-void LinePass1(char* outputAddr, char* outputCursor)
-{
-    // non-instructions
-    if (memcmp(lineBuffer, "define ", 7))
+    while (1)
     {
-        Pass1StoreDefine();
-    }
-    else if (isLabel())
-    {
-        Pass1StoreLabel();
-    }
-    else
-    {
-        // all instructions that can end up in multiple lines
-
-        // set values to the labels (while loop, since multiple labels can point to the same addr)
-        while(prevLinesWereLabels > 0)
+        while (isSeparator(c))
         {
-            labelListLineNumber[labelListIndex - prevLinesWereLabels] = globalLineCursor;
-            prevLinesWereLabels--;
+            c = readChar();
         }
-
-        if (memcmp(lineBuffer, "addr2reg ", 9))
+        if (c == '\n' || c == EOF || c == ';')
         {
-            globalLineCursor += Pass1Addr2reg(outputAddr, outputCursor);
+            break;
         }
-        else if (memcmp(lineBuffer, "load32 ", 7))
-        {
-            globalLineCursor += Pass1Load32(outputAddr, outputCursor);
-        }
-        else if (memcmp(lineBuffer, ".dw ", 4))
+
+        c = readToken(c);
+        argc++;
+        word type = parseArg((word*) allocate(1));
+        if (argc <= 4)
         {
-            globalLineCursor += Pass1Dw(outputAddr, outputCursor);
+            header += type << (8 + (argc << 1));
         }
-        else if (memcmp(lineBuffer, ".db ", 4))
+        else if (type != ARG_NUMBER)
         {
-            Pass1Db(outputAddr, outputCursor);
-        }
-        else
-        {
-            // just copy the line
-            word lineBufLen = strlen(lineBuffer);
-            memcpy((outputAddr + *outputCursor), lineBuffer, lineBufLen);
-            (*outputCursor) += lineBufLen;
-            // add a newline
-            *(outputAddr + *outputCursor) = '\n';
-            (*outputCursor)++;
-            globalLineCursor++;
+            bdos_print("Only the first four args can be regs or labels: ");
+            bdos_print(tokenBuffer);
+            bdos_print("\n");
+            exit(1);
         }
-    }    
-}
-
-void doPass1()
-{
-    bdos_print("Performing pass 1\n");
-
-    memCursor = 0; // reset cursor for readMemLine
-    globalLineCursor = 0; // keep track of the line number for the labels
-
-    char* outfileCodeAddr = (char*) OUTFILE_CODE_ADDR; // read from
-    char* outfilePass1Addr = (char*) OUTFILE_PASS1_ADDR; // write to
-    word filePass1Cursor = 0;
-
-    // add userBDOS header instructions
-    char* userBDOSHeader = "jump Main\njump Int\njump Main\njump Main\n";
-    memcpy(outfilePass1Addr, userBDOSHeader, strlen(userBDOSHeader));
-    filePass1Cursor += strlen(userBDOSHeader);
-    globalLineCursor += 4;
-
-    while (readMemLine(outfileCodeAddr) != EOF)
-    {
-        LinePass1(outfilePass1Addr, &filePass1Cursor);
     }
 
-    outfilePass1Addr[*(&filePass1Cursor)] = 0; // terminate
-
+    record[0] = header + (argc << 18);
+    Pass1Record(record);
+    return c;
 }
 
-#include "pass2.c"
-
-void LinePass2(char* outputAddr, char* outputCursor)
+// adds a record for a jump to a label, for the userBDOS header
+void addHeaderJump(char* labelName)
 {
-    // Go through all possible instructions:
-    if (memcmp(lineBuffer, "halt", 4))
-        pass2Halt(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "read ", 5))
-        pass2Read(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "write ", 6))
-        pass2Write(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "readintid ", 10))
-        pass2Readintid(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "push ", 5))
-        pass2Push(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "pop ", 4))
-        pass2Pop(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "jump ", 5))
-        pass2Jump(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "jumpo ", 6))
-        pass2Jumpo(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "jumpr ", 6))
-        pass2Jumpr(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "jumpro ", 7))
-        pass2Jumpr(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "beq ", 4))
-        pass2Beq(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "bgt ", 4))
-        pass2Bgt(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "bgts ", 5))
-        pass2Bgts(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "bge ", 4))
-        pass2Bge(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "bges ", 5))
-        pass2Bges(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "bne ", 4))
-        pass2Bne(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "blt ", 4))
-        pass2Blt(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "blts ", 5))
-        pass2Blts(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "ble ", 4))
-        pass2Ble(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "bles ", 5))
-        pass2Bles(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "savpc ", 6))
-        pass2Savpc(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "reti", 4))
-        pass2Reti(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "ccache", 6))
-        pass2Ccache(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "or ", 3))
-        pass2Or(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "and ", 4))
-        pass2And(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "xor ", 4))
-        pass2Xor(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "add ", 4))
-        pass2Add(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "sub ", 4))
-        pass2Sub(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "shiftl ", 7))
-        pass2Shiftl(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "shiftr ", 7))
-        pass2Shiftr(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "shiftrs ", 8))
-        pass2Shiftrs(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "not ", 4))
-        pass2Not(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "mults ", 6))
-        pass2Mults(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "multu ", 6))
-        pass2Multu(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "multfp ", 7))
-        pass2Multfp(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "slt ", 4))
-        pass2Slt(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "sltu ", 5))
-        pass2Sltu(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "load ", 5))
-        pass2Load(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "loadhi ", 7))
-        pass2Loadhi(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "loadLabelLow ", 13))
-        pass2LoadLabelLow(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "loadLabelHigh ", 14))
-        pass2LoadLabelHigh(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, "nop", 3))
-        pass2Nop(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, ".dw ", 4))
-        pass2Dw(outputAddr, outputCursor);
-    else if (memcmp(lineBuffer, ".dl ", 4))
-        pass2Dl(outputAddr, outputCursor);
-    else
-    {
-        bdos_print("Unknown instruction!\n");
-        bdos_print(lineBuffer);
-        bdos_print("\n");
-        exit(1);
-    }
+    word* record = (word*) allocate(2);
+    word argc = 1;
+    record[0] = OP_JUMP + (currentSection << 8) + (ARG_LABEL << 10) + (argc << 18);
+    record[1] = (word) getLabel(labelName, hashString(labelName));
+    Pass1Record(record);
 }
 
-
-// returns the length of the binary
-word doPass2()
+// Reads the input file once, tokenizing each line into a record
+// labels get the offset in their section
+void readInput()
 {
-    bdos_print("Performing pass 2\n");
-
-    memCursor = 0; // reset cursor for readMemLine
-
-    char* outfilePass1Addr = (char*) OUTFILE_PASS1_ADDR; // read from
-    char* outfilePass2Addr = (char*) OUTFILE_PASS2_ADDR; // write to
-    word filePass2Cursor = 0;
-
-    while (readMemLine(outfilePass1Addr) != EOF)
-    {
-        LinePass2(outfilePass2Addr, &filePass2Cursor);
-    }
+    resizeLabelHash(LABELHASH_START_SIZE);
 
-    return filePass2Cursor;
-}
-
-
-void moveDataDown()
-{
-    char* outfileDataAddr = (char*) OUTFILE_DATA_ADDR;
-    *outfileDataAddr = 0; // initialize to 0
-    word fileDataCursor = 0;
-
-    char* outfileCodeAddr = (char*) OUTFILE_CODE_ADDR;
-    *outfileCodeAddr = 0; // initialize to 0
-    word fileCodeCursor = 0;
-
-    bdos_print("Reading .data and .code sections\n");
+    // add userBDOS header instructions
+    currentSection = SECTION_CODE;
+    addHeaderJump("Main");
+    addHeaderJump("Int");
+    addHeaderJump("Main");
+    addHeaderJump("Main");
 
-    // Open file
-    fd_input = fs_open(absolute_path_in);
-    if (fd_input == -1)
-    {
-        bdos_print("UNEXPECTED: Could not open input file.\n");
-        exit(1);
-    }
+    // .bss sections are placed at the end, between the labels for the startup code that clears them
+    currentSection = SECTION_BSS;
+    defineLabel("Bss_Start");
+    currentSection = SECTION_CODE;
 
-    // .data, also do pass one on the code
-    word inDataSection = 0;
-    word inCodeSection = 0;
-    while (readFileLine() != EOF)
+    word c = readChar();
+    while (c != EOF)
     {
-        if (memcmp(lineBuffer, ".data", 5))
+        if (c == '\n' || isSeparator(c))
         {
-            inDataSection = 1;
-            inCodeSection = 0;
-            continue; // skip this line
+            c = readChar();
+            continue;
         }
-        if (memcmp(lineBuffer, ".rdata", 6))
+        // skip comments
+        if (c == ';')
         {
-            inDataSection = 0;
-            inCodeSection = 0;
-            continue; // skip this line
+            c = skipLine(c);
+            continue;
         }
-        if (memcmp(lineBuffer, ".code", 5))
+
+        c = readToken(c);
+        if (tokenBuffer[tokenLength - 1] == ':')
         {
-            inDataSection = 0;
-            inCodeSection = 1;
-            continue; // skip this line
+            // label name minus the :
+            tokenBuffer[tokenLength - 1] = 0;
+            defineLabel(tokenBuffer);
+            continue;
         }
-        if (memcmp(lineBuffer, ".bss", 4))
+
+        word op = findMnemonic();
+        if (op == -1)
         {
-            inDataSection = 0;
-            inCodeSection = 0;
-            continue; // skip this line
+            bdos_print("Unknown instruction!\n");
+            bdos_print(tokenBuffer);
+            bdos_print("\n");
+            exit(1);
         }
 
-
-        if (inDataSection)
+        if (op >= OP_SECTION)
         {
-            // copy to data section
-            word lineBufLen = strlen(lineBuffer);
-            memcpy((outfileDataAddr + fileDataCursor), lineBuffer, lineBufLen);
-            fileDataCursor += lineBufLen;
-            // add a newline
-            *(outfileDataAddr + fileDataCursor) = '\n';
-            fileDataCursor++;
+            currentSection = op - OP_SECTION;
+            c = skipLine(c);
         }
-
-        if (inCodeSection)
+        else if (op == OP_DEFINE)
         {
-            // copy to code section
-            word lineBufLen = strlen(lineBuffer);
-            memcpy((outfileCodeAddr + fileCodeCursor), lineBuffer, lineBufLen);
-            fileCodeCursor += lineBufLen;
-            // add a newline
-            *(outfileCodeAddr + fileCodeCursor) = '\n';
-            fileCodeCursor++;
+            // defines are not supported right now, so they are skipped
+            c = skipLine(c);
+        }
+        else
+        {
+            c = readRecord(op, c);
         }
     }
 
-    *(outfileCodeAddr+fileCodeCursor) = 0; // terminate code section
-    // do not increment the codeCursor, because we will append the data section
+    currentSection = SECTION_BSS;
+    defineLabel("Bss_End");
 
-    bdos_print("Reading .rdata and .bss sections\n");
+    recordsEnd = heapBottom;
+}
 
-    // reopen file to reiterate
-    fs_close(fd_input);
-    fd_input = fs_open(absolute_path_in);
-    if (fd_input == -1)
+// Places the sections after each other and gives all labels their address
+void placeLabels()
+{
+    word address = 0;
+    word i;
+    for (i = 0; i < SECTION_COUNT; i++)
     {
-        bdos_print("UNEXPECTED: Could not open input file.\n");
-        exit(1);
+        sectionBase[i] = address;
+        if (sectionEnd[i] > 0)
+        {
+            binaryLength = address + sectionEnd[i];
+        }
+        address += sectionLength[i];
     }
 
-    //.rdata and .bss at the same time
-    inDataSection = 0;
-    while (readFileLine() != EOF)
+    for (i = 0; i < labelHashSize; i++)
     {
-        if (memcmp(lineBuffer, ".data", 5))
+        if (labelHashTable[i] != 0)
         {
-            inDataSection = 0;
-            continue; // skip this line
-        }
-        if (memcmp(lineBuffer, ".rdata", 6))
-        {
-            inDataSection = 1;
-            continue; // skip this line
-        }
-        if (memcmp(lineBuffer, ".code", 5))
-        {
-            inDataSection = 0;
-            continue; // skip this line
-        }
-        if (memcmp(lineBuffer, ".bss", 4))
-        {
-            inDataSection = 1;
-            continue; // skip this line
+            word* label = (word*) labelHashTable[i];
+            if (label[LABEL_SECTION] == -1)
+            {
+                bdos_print("Could not find label: ");
+                bdos_print(label + LABEL_NAME);
+                bdos_print("\n");
+                exit(1);
+            }
+            label[LABEL_ADDR] += sectionBase[label[LABEL_SECTION]] + labelOffset;
         }
+    }
+}
 
-        if (inDataSection)
-        {
-            // copy to data section
-            word lineBufLen = strlen(lineBuffer);
-            memcpy((outfileDataAddr + fileDataCursor), lineBuffer, lineBufLen);
-            fileDataCursor += lineBufLen;
-            // add a newline
-            *(outfileDataAddr + fileDataCursor) = '\n';
-            fileDataCursor++;
-        }
+void assembleRecord(word* record, char* outputAddr, char* outputCursor)
+{
+    word op = record[0] & 0xFF;
+
+    if (op >= OP_OR && op <= OP_MULTFP)
+    {
+        pass2Arith(record, outputAddr, outputCursor, op);
+        return;
+    }
+    if (op >= OP_BEQ && op <= OP_BLES)
+    {
+        pass2Branch(record, outputAddr, outputCursor, op);
+        return;
+    }
+
+    switch (op)
+    {
+        case OP_HALT:
+            pass2Halt(record, outputAddr, outputCursor);
+            break;
+        case OP_READ:
+            pass2Read(record, outputAddr, outputCursor);
+            break;
+        case OP_WRITE:
+            pass2Write(record, outputAddr, outputCursor);
+            break;
+        case OP_READINTID:
+            pass2Readintid(record, outputAddr, outputCursor);
+            break;
+        case OP_PUSH:
+            pass2Push(record, outputAddr, outputCursor);
+            break;
+        case OP_POP:
+            pass2Pop(record, outputAddr, outputCursor);
+            break;
+        case OP_JUMP:
+            pass2Jump(record, outputAddr, outputCursor);
+            break;
+        case OP_JUMPO:
+            pass2Jumpo(record, outputAddr, outputCursor);
+            break;
+        case OP_JUMPR:
+            pass2Jumpr(record, outputAddr, outputCursor);
+            break;
+        case OP_JUMPRO:
+            pass2Jumpro(record, outputAddr, outputCursor);
+            break;
+        case OP_SAVPC:
+            pass2Savpc(record, outputAddr, outputCursor);
+            break;
+        case OP_RETI:
+            pass2Reti(record, outputAddr, outputCursor);
+            break;
+        case OP_CCACHE:
+            pass2Ccache(record, outputAddr, outputCursor);
+            break;
+        case OP_NOT:
+            pass2Not(record, outputAddr, outputCursor);
+            break;
+        case OP_LOAD:
+            pass2Load(record, outputAddr, outputCursor);
+            break;
+        case OP_LOADHI:
+            pass2Loadhi(record, outputAddr, outputCursor);
+            break;
+        case OP_NOP:
+            pass2Nop(record, outputAddr, outputCursor);
+            break;
+        case OP_ADDR2REG:
+            pass2Addr2reg(record, outputAddr, outputCursor);
+            break;
+        case OP_LOAD32:
+            pass2Load32(record, outputAddr, outputCursor);
+            break;
+        case OP_DW:
+            pass2Dw(record, outputAddr, outputCursor);
+            break;
+        case OP_DL:
+            pass2Dl(record, outputAddr, outputCursor);
+            break;
+        case OP_SPACE:
+            pass2Space(record, outputAddr, outputCursor);
+            break;
     }
+}
 
-    *(outfileDataAddr+fileDataCursor) = 0; // terminate data section
-    fileDataCursor++;
+// Encodes the records of each section in order, so the relocation table is sorted by address
+// Returns the address of the binary
+char* doPass2()
+{
+    char* outputAddr = allocate(binaryLength);
+    word outputCursor = 0;
+    if (relocatable)
+    {
+        relocList = (word*) allocate(relocCount);
+    }
 
-    bdos_print("Appending all to .code section\n");
+    word section;
+    for (section = 0; section < SECTION_COUNT; section++)
+    {
+        word* record = (word*) recordsAddr;
+        while (record < recordsEnd)
+        {
+            word header = record[0];
+            if (((header >> 8) & 3) == section)
+            {
+                assembleRecord(record, outputAddr, &outputCursor);
+            }
+            record += 1 + ((unsigned)header >> 18);
+        }
+    }
 
-    // append data section to code section, including \0
-    memcpy((outfileCodeAddr+fileCodeCursor), outfileDataAddr, fileDataCursor);
+    return outputAddr;
+}
 
-    fs_close(fd_input);
+// prints the time a step took since startTime
+void printTime(char* step, word startTime)
+{
+    bdos_print(step);
+    bdos_print(": ");
+    bdos_printdec(millis() - startTime);
+    bdos_print(" ms\n");
 }
 
 
-int main() 
+int main()
 {
     bdos_print("B322 Assembler\n");
 
@@ -820,7 +814,7 @@ int main()
     word argc = shell_argc();
     if (argc < 3)
     {
-        bdos_print("Usage: asm <source file> <output file>\n");
+        bdos_print("Usage: asm <source file> <output file> [reloc]\n");
         return 1;
     }
 
@@ -849,7 +843,7 @@ int main()
     // Get file size
     struct brfs_dir_entry* entry = (struct brfs_dir_entry*)fs_stat(absolute_path_in);
     filesize_input = entry->filesize;
-    fs_close(fd_input); // Close so we can reopen it later when needed
+    inputRemaining = filesize_input;
 
     // Get output filename
     args = shell_argv();
@@ -879,12 +873,30 @@ int main()
     }
     fs_close(fd_output); // Close so we can reopen it later when needed
 
+    // Relocatable output, for any address
+    if (argc >= 4)
+    {
+        args = shell_argv();
+        if (strcmp(args[3], "reloc") == 0)
+        {
+            relocatable = 1;
+            labelOffset = 0;
+        }
+    }
 
-
-    moveDataDown(); // Move all data sections below the code sections
+    word startTime = millis();
+    word stepTime = startTime;
+    bdos_print("Reading\n");
+    initMnemonics();
+    readInput();
+    fs_close(fd_input);
+    printTime("Reading", stepTime);
     // done reading file, everything else can be done in memory
-    doPass1();
-    word pass2Length = doPass2();
+    stepTime = millis();
+    bdos_print("Assembling\n");
+    placeLabels();
+    char* outputAddr = doPass2();
+    printTime("Assembling", stepTime);
 
 
     bdos_print("Writing binary file\n");
@@ -894,11 +906,26 @@ int main()
         bdos_print("UNEXPECTED: Could not open output file.\n");
         return 1;
     }
-    
-    char* outfilePass2Addr = (char*) OUTFILE_PASS2_ADDR;
-    fs_write(fd_output, outfilePass2Addr, pass2Length);
+
+    if (relocatable)
+    {
+        word header[3];
+        header[0] = RELOC_MAGIC;
+        header[1] = binaryLength;
+        header[2] = relocListIndex;
+        fs_write(fd_output, (char*) header, 3);
+    }
+
+    fs_write(fd_output, outputAddr, binaryLength);
+
+    if (relocatable)
+    {
+        fs_write(fd_output, (char*) relocList, relocListIndex);
+    }
     fs_close(fd_output);
-    
+
+    printTime("Total", startTime);
+
     return 0;
 }
 
@@ -912,4 +939,4 @@ void interrupt()
       timer1Value = 1;  // Notify ending of timer1
       break;
   }
-}
\ No newline at end of file
+}
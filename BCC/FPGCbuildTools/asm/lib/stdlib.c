@@ -144,6 +144,20 @@ word getIntID()
   return retval;
 }
 
+// Returns milliseconds since last reset
+word millis() 
+{
+  word retval = 0;
+
+  asm(
+    "load32 0xC0274A r2\n"  // millis addr
+    "read 0 r2 r2\n"        // read millis
+    "write -4 r14 r2\n"     // write to stack to return
+    );
+
+  return retval;
+}
+
 /*
 Recursive helper function for itoa
 Eventually returns the number of digits in n
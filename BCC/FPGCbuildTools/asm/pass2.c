@@ -7,36 +7,83 @@
 /*                                                                           */
 /*****************************************************************************/
 
-word getNumberForLabel(char* labelName)
+// returns the type of argument i (from 1) of the record, -1 if it has no such argument
+word getArgType(word* record, word i)
 {
-    word bdosOffset = USERBDOS_OFFSET;
-    word i;
-    for (i = 0; i < labelListIndex; i++)
+    if (i > ((unsigned)record[0] >> 18))
     {
-        if (strcmp(labelName, labelListName[i]) == 0)
-        {
-            return (labelListLineNumber[i] + bdosOffset);
-        }
+        return -1;
+    }
+    if (i > 4)
+    {
+        return ARG_NUMBER;
     }
-    bdos_print("Could not find label: ");
-    bdos_print(labelName);
-    bdos_print("\n");
+    return ((unsigned)record[0] >> (8 + (i << 1))) & 3;
+}
+
+// prints the error for argument i of instrName and exits
+void argError(char* instrName, word i, char* error)
+{
+    bdos_print(instrName);
+    bdos_print(": arg");
+    bdos_printdec(i);
+    bdos_print(error);
     exit(1);
-    return 0;
 }
 
-void pass2Halt(char* outputAddr, char* outputCursor)
+// returns the register of argument i of the record
+word getRegArg(word* record, word i, char* instrName)
+{
+    if (getArgType(record, i) != ARG_REG)
+    {
+        argError(instrName, i, " not a reg\n");
+    }
+    return record[i];
+}
+
+// returns the number of argument i of the record
+word getNumberArg(word* record, word i, char* instrName)
+{
+    if (getArgType(record, i) != ARG_NUMBER)
+    {
+        argError(instrName, i, " not a number\n");
+    }
+    return record[i];
+}
+
+// returns the address of the label of argument i of the record, including the offset
+word getLabelArg(word* record, word i, char* instrName)
+{
+    if (getArgType(record, i) != ARG_LABEL)
+    {
+        argError(instrName, i, " not a label\n");
+    }
+    word* label = (word*) record[i];
+    return label[LABEL_ADDR];
+}
+
+// adds the instruction at address to the relocation table, if relocatable
+void addRelocation(word kind, word address)
+{
+    if (relocatable)
+    {
+        relocList[relocListIndex] = (kind << 30) + address;
+        relocListIndex++;
+    }
+}
+
+void pass2Halt(word* record, char* outputAddr, char* outputCursor)
 {
     char instr = 0xFFFFFFFF;
     outputAddr[*outputCursor] = instr;
     (*outputCursor) += 1;
 }
 
-void pass2Read(char* outputAddr, char* outputCursor)
+void pass2Read(word* record, char* outputAddr, char* outputCursor)
 {
     word instr = 0xE0000000;
 
-    word arg1num = getNumberAtArg(1);
+    word arg1num = getNumberArg(record, 1, "READ");
     // arg1 should fit in 16 bits (signed numbers have 1 bit less)
     word bitsCheck = 16;
     if (arg1num < 0)
@@ -52,30 +99,12 @@ void pass2Read(char* outputAddr, char* outputCursor)
     word mask = 0xffff;
     instr += ((arg1num & mask) << 12);
 
-    // arg2
-    char arg2buf[16];
-    getArgPos(2, arg2buf);
     // arg2 should be a reg
-    if (arg2buf[0] != 'r')
-    {
-        bdos_print("READ: arg2 not a reg\n");
-        exit(1);
-    }
-    word arg2num = strToInt(&arg2buf[1]);
-
+    word arg2num = getRegArg(record, 2, "READ");
     instr += (arg2num << 8);
 
-    // arg3
-    char arg3buf[16];
-    getArgPos(3, arg3buf);
     // arg3 should be a reg
-    if (arg3buf[0] != 'r')
-    {
-        bdos_print("READ: arg3 not a reg\n");
-        exit(1);
-    }
-    word arg3num = strToInt(&arg3buf[1]);
-
+    word arg3num = getRegArg(record, 3, "READ");
     instr += arg3num;
 
     // write to mem
@@ -83,11 +112,11 @@ void pass2Read(char* outputAddr, char* outputCursor)
     (*outputCursor) += 1;
 }
 
-void pass2Write(char* outputAddr, char* outputCursor)
+void pass2Write(word* record, char* outputAddr, char* outputCursor)
 {
     word instr = 0xD0000000;
 
-    word arg1num = getNumberAtArg(1);
+    word arg1num = getNumberArg(record, 1, "WRITE");
     // arg1 should fit in 16 bits (signed numbers have 1 bit less)
     word bitsCheck = 16;
     if (arg1num < 0)
@@ -96,37 +125,19 @@ void pass2Write(char* outputAddr, char* outputCursor)
     }
     if ((MATH_abs(arg1num) >> bitsCheck) > 0)
     {
-        bdos_print("READ: arg1 is >16 bits\n");
+        bdos_print("WRITE: arg1 is >16 bits\n");
         exit(1);
     }
 
     word mask = 0xffff;
     instr += ((arg1num & mask) << 12);
 
-    // arg2
-    char arg2buf[16];
-    getArgPos(2, arg2buf);
     // arg2 should be a reg
-    if (arg2buf[0] != 'r')
-    {
-        bdos_print("WRITE: arg2 not a reg\n");
-        exit(1);
-    }
-    word arg2num = strToInt(&arg2buf[1]);
-
+    word arg2num = getRegArg(record, 2, "WRITE");
     instr += (arg2num << 8);
 
-    // arg3
-    char arg3buf[16];
-    getArgPos(3, arg3buf);
     // arg3 should be a reg
-    if (arg3buf[0] != 'r')
-    {
-        bdos_print("WRITE: arg3 not a reg\n");
-        exit(1);
-    }
-    word arg3num = strToInt(&arg3buf[1]);
-
+    word arg3num = getRegArg(record, 3, "WRITE");
     instr += (arg3num << 4);
 
     // write to mem
@@ -134,21 +145,12 @@ void pass2Write(char* outputAddr, char* outputCursor)
     (*outputCursor) += 1;
 }
 
-void pass2Readintid(char* outputAddr, char* outputCursor)
+void pass2Readintid(word* record, char* outputAddr, char* outputCursor)
 {
     word instr = 0xC0000000;
 
-    // arg1
-    char arg1buf[16];
-    getArgPos(1, arg1buf);
     // arg1 should be a reg
-    if (arg1buf[0] != 'r')
-    {
-        bdos_print("READINTID: arg1 not a reg\n");
-        exit(1);
-    }
-    word arg1num = strToInt(&arg1buf[1]);
-
+    word arg1num = getRegArg(record, 1, "READINTID");
     instr += arg1num;
 
     // write to mem
@@ -156,21 +158,12 @@ void pass2Readintid(char* outputAddr, char* outputCursor)
     (*outputCursor) += 1;
 }
 
-void pass2Push(char* outputAddr, char* outputCursor)
+void pass2Push(word* record, char* outputAddr, char* outputCursor)
 {
     word instr = 0xB0000000;
 
-    // arg1
-    char arg1buf[16];
-    getArgPos(1, arg1buf);
     // arg1 should be a reg
-    if (arg1buf[0] != 'r')
-    {
-        bdos_print("PUSH: arg1 not a reg\n");
-        exit(1);
-    }
-    word arg1num = strToInt(&arg1buf[1]);
-
+    word arg1num = getRegArg(record, 1, "PUSH");
     instr += (arg1num << 4);
 
     // write to mem
@@ -178,21 +171,12 @@ void pass2Push(char* outputAddr, char* outputCursor)
     (*outputCursor) += 1;
 }
 
-void pass2Pop(char* outputAddr, char* outputCursor)
+void pass2Pop(word* record, char* outputAddr, char* outputCursor)
 {
     word instr = 0xA0000000;
 
-    // arg1
-    char arg1buf[16];
-    getArgPos(1, arg1buf);
     // arg1 should be a reg
-    if (arg1buf[0] != 'r')
-    {
-        bdos_print("POP: arg1 not a reg\n");
-        exit(1);
-    }
-    word arg1num = strToInt(&arg1buf[1]);
-
+    word arg1num = getRegArg(record, 1, "POP");
     instr += arg1num;
 
     // write to mem
@@ -200,40 +184,27 @@ void pass2Pop(char* outputAddr, char* outputCursor)
     (*outputCursor) += 1;
 }
 
-void pass2Jump(char* outputAddr, char* outputCursor)
+void pass2Jump(word* record, char* outputAddr, char* outputCursor)
 {
     word instr = 0x90000000;
-    
-    // check if jump to label
-    // if yes, replace label with line number
-    char arg1buf[LABEL_NAME_SIZE+1];
-    getArgPos(1, arg1buf);
-    word arg1bufLen = strlen(arg1buf);
-    word argIsLabel = 0;
-    word i;
-    for (i = 0; i < arg1bufLen; i++)
-    {
-        if (arg1buf[i] < '0' || arg1buf[i] > '9')
-        {
-            argIsLabel = 1;
-            break;
-        }
-    }
 
+    // check if jump to label
+    // if yes, replace label with its address
     word arg1num = 0;
-    if (argIsLabel)
+    if (getArgType(record, 1) == ARG_LABEL)
     {
-        arg1num = getNumberForLabel(arg1buf);
+        arg1num = getLabelArg(record, 1, "JUMP");
+        addRelocation(RELOC_JUMP, *outputCursor);
     }
     else
     {
-        arg1num = getNumberAtArg(1);
+        arg1num = getNumberArg(record, 1, "JUMP");
     }
 
     // arg1 should fit in 27 bits
     if (((unsigned)arg1num >> 27) > 0)
     {
-        bdos_print("JUMPO: arg1 is >27 bits\n");
+        bdos_print("JUMP: arg1 is >27 bits\n");
         exit(1);
     }
 
@@ -244,11 +215,11 @@ void pass2Jump(char* outputAddr, char* outputCursor)
     (*outputCursor) += 1;
 }
 
-void pass2Jumpo(char* outputAddr, char* outputCursor)
+void pass2Jumpo(word* record, char* outputAddr, char* outputCursor)
 {
     word instr = 0x90000000;
 
-    word arg1num = getNumberAtArg(1);
+    word arg1num = getNumberArg(record, 1, "JUMPO");
 
     // arg1 should fit in 27 bits
     if (((unsigned)arg1num >> 27) > 0)
@@ -265,11 +236,11 @@ void pass2Jumpo(char* outputAddr, char* outputCursor)
     (*outputCursor) += 1;
 }
 
-void pass2Jumpr(char* outputAddr, char* outputCursor)
+void pass2Jumpr(word* record, char* outputAddr, char* outputCursor)
 {
     word instr = 0x80000000;
 
-    word arg1num = getNumberAtArg(1);
+    word arg1num = getNumberArg(record, 1, "JUMPR");
 
     // arg1 should fit in 16 bits
     if (((unsigned)arg1num >> 16) > 0)
@@ -280,17 +251,8 @@ void pass2Jumpr(char* outputAddr, char* outputCursor)
 
     instr += (arg1num << 12);
 
-    // arg2
-    char arg2buf[16];
-    getArgPos(2, arg2buf);
     // arg2 should be a reg
-    if (arg2buf[0] != 'r')
-    {
-        bdos_print("JUMPR: arg2 not a reg\n");
-        exit(1);
-    }
-    word arg2num = strToInt(&arg2buf[1]);
-
+    word arg2num = getRegArg(record, 2, "JUMPR");
     instr += (arg2num << 4);
 
     // write to mem
@@ -298,46 +260,40 @@ void pass2Jumpr(char* outputAddr, char* outputCursor)
     (*outputCursor) += 1;
 }
 
-void pass2Jumpro(char* outputAddr, char* outputCursor)
+void pass2Jumpro(word* record, char* outputAddr, char* outputCursor)
 {
     bdos_print("JUMPRO: unimplemented\n");
     exit(1);
     return;
 }
 
-void pass2BranchBase(char* outputAddr, char* outputCursor, word branchOpCode, word branchSigned)
+// the instruction is OP_BEQ + (branch opcode << 1) + signed
+void pass2Branch(word* record, char* outputAddr, char* outputCursor, word op)
 {
     word instr = 0x60000000;
+    word branchOpCode = (op - OP_BEQ) >> 1;
+    word branchSigned = (op - OP_BEQ) & 1;
 
-    // arg1
-    char arg1buf[16];
-    getArgPos(1, arg1buf);
     // arg1 should be a reg
-    if (arg1buf[0] != 'r')
-    {
-        bdos_print("BEQ: arg1 not a reg\n");
-        exit(1);
-    }
-    word arg1num = strToInt(&arg1buf[1]);
-
+    word arg1num = getRegArg(record, 1, "BRANCH");
     instr += (arg1num << 8);
 
-    // arg2
-    char arg2buf[16];
-    getArgPos(2, arg2buf);
     // arg2 should be a reg
-    if (arg2buf[0] != 'r')
-    {
-        bdos_print("BEQ: arg2 not a reg\n");
-        exit(1);
-    }
-    word arg2num = strToInt(&arg2buf[1]);
-
+    word arg2num = getRegArg(record, 2, "BRANCH");
     instr += (arg2num << 4);
 
-
     // arg3
-    word arg3num = getNumberAtArg(3);
+    // check if branch to label
+    // if yes, replace label with the offset to it
+    word arg3num = 0;
+    if (getArgType(record, 3) == ARG_LABEL)
+    {
+        arg3num = getLabelArg(record, 3, "BRANCH") - labelOffset - *outputCursor;
+    }
+    else
+    {
+        arg3num = getNumberArg(record, 3, "BRANCH");
+    }
     // arg3 should fit in 16 bits (signed numbers have 1 bit less)
     word bitsCheck = 16;
     if (branchSigned)
@@ -346,7 +302,7 @@ void pass2BranchBase(char* outputAddr, char* outputCursor, word branchOpCode, wo
     }
     if ((MATH_abs(arg3num) >> bitsCheck) > 0)
     {
-        bdos_print("READ: arg3 is >16 bits\n");
+        bdos_print("BRANCH: arg3 is >16 bits\n");
         exit(1);
     }
 
@@ -367,72 +323,12 @@ void pass2BranchBase(char* outputAddr, char* outputCursor, word branchOpCode, wo
     (*outputCursor) += 1;
 }
 
-
-void pass2Beq(char* outputAddr, char* outputCursor)
-{
-    pass2BranchBase(outputAddr, outputCursor, 0x0, 0);
-}
-
-void pass2Bgt(char* outputAddr, char* outputCursor)
-{
-    pass2BranchBase(outputAddr, outputCursor, 0x1, 0);
-}
-
-void pass2Bgts(char* outputAddr, char* outputCursor)
-{
-    pass2BranchBase(outputAddr, outputCursor, 0x1, 1);
-}
-
-void pass2Bge(char* outputAddr, char* outputCursor)
-{
-    pass2BranchBase(outputAddr, outputCursor, 0x2, 0);
-}
-
-void pass2Bges(char* outputAddr, char* outputCursor)
-{
-    pass2BranchBase(outputAddr, outputCursor, 0x2, 1);
-}
-
-void pass2Bne(char* outputAddr, char* outputCursor)
-{
-    pass2BranchBase(outputAddr, outputCursor, 0x4, 0);
-}
-
-void pass2Blt(char* outputAddr, char* outputCursor)
-{
-    pass2BranchBase(outputAddr, outputCursor, 0x5, 0);
-}
-
-void pass2Blts(char* outputAddr, char* outputCursor)
-{
-    pass2BranchBase(outputAddr, outputCursor, 0x5, 1);
-}
-
-void pass2Ble(char* outputAddr, char* outputCursor)
-{
-    pass2BranchBase(outputAddr, outputCursor, 0x6, 0);
-}
-
-void pass2Bles(char* outputAddr, char* outputCursor)
-{
-    pass2BranchBase(outputAddr, outputCursor, 0x6, 1);
-}
-
-void pass2Savpc(char* outputAddr, char* outputCursor)
+void pass2Savpc(word* record, char* outputAddr, char* outputCursor)
 {
     word instr = 0x50000000;
 
-    // arg1
-    char arg1buf[16];
-    getArgPos(1, arg1buf);
     // arg1 should be a reg
-    if (arg1buf[0] != 'r')
-    {
-        bdos_print("SAVPC: arg1 not a reg\n");
-        exit(1);
-    }
-    word arg1num = strToInt(&arg1buf[1]);
-
+    word arg1num = getRegArg(record, 1, "SAVPC");
     instr += arg1num;
 
     // write to mem
@@ -440,48 +336,39 @@ void pass2Savpc(char* outputAddr, char* outputCursor)
     (*outputCursor) += 1;
 }
 
-void pass2Reti(char* outputAddr, char* outputCursor)
+void pass2Reti(word* record, char* outputAddr, char* outputCursor)
 {
     word instr = 0x40000000;
     outputAddr[*outputCursor] = instr;
     (*outputCursor) += 1;
 }
 
-void pass2Ccache(char* outputAddr, char* outputCursor)
+void pass2Ccache(word* record, char* outputAddr, char* outputCursor)
 {
     word instr = 0x70000000;
     outputAddr[*outputCursor] = instr;
     (*outputCursor) += 1;
 }
 
-void pass2ArithBase(char* outputAddr, char* outputCursor, word arithOpCode)
+// the instruction is OP_OR + ALU opcode
+void pass2Arith(word* record, char* outputAddr, char* outputCursor, word op)
 {
     word instr = 0;
 
     // opcode
-    instr += (arithOpCode << 24);
+    instr += ((op - OP_OR) << 24);
 
-    // arg1
-    char arg1buf[16];
-    getArgPos(1, arg1buf);
     // arg1 should be a reg
-    if (arg1buf[0] != 'r')
-    {
-        bdos_print("ARITH: arg1 not a reg\n");
-        exit(1);
-    }
-    word arg1num = strToInt(&arg1buf[1]);
+    word arg1num = getRegArg(record, 1, "ARITH");
 
     // Add arg1num when arg2 is known to be a const or not
 
     // arg2
-    char arg2buf[16];
-    getArgPos(2, arg2buf);
     word arg2num = 0;
     // if arg2 is a const
-    if (arg2buf[0] != 'r')
+    if (getArgType(record, 2) != ARG_REG)
     {
-        arg2num= getNumberAtArg(2);
+        arg2num = getNumberArg(record, 2, "ARITH");
 
         // arg2 should fit in 16 bits (signed numbers have 1 bit less)
         word bitsCheck = 16;
@@ -502,22 +389,13 @@ void pass2ArithBase(char* outputAddr, char* outputCursor, word arithOpCode)
     }
     else // arg2 is a reg
     {
-        arg2num = strToInt(&arg2buf[1]);
+        arg2num = record[2];
         instr += (arg2num << 4);
         instr += (arg1num << 8);
     }
 
-    // arg3
-    char arg3buf[16];
-    getArgPos(3, arg3buf);
     // arg3 should be a reg
-    if (arg3buf[0] != 'r')
-    {
-        bdos_print("ARITH: arg3 not a reg\n");
-        exit(1);
-    }
-    word arg3num = strToInt(&arg3buf[1]);
-
+    word arg3num = getRegArg(record, 3, "ARITH");
     instr += arg3num;
 
     // write to mem
@@ -525,98 +403,16 @@ void pass2ArithBase(char* outputAddr, char* outputCursor, word arithOpCode)
     (*outputCursor) += 1;
 }
 
-void pass2Or(char* outputAddr, char* outputCursor)
-{
-    pass2ArithBase(outputAddr, outputCursor, 0x0);
-}
-
-void pass2And(char* outputAddr, char* outputCursor)
-{
-    pass2ArithBase(outputAddr, outputCursor, 0x1);
-}
-
-void pass2Xor(char* outputAddr, char* outputCursor)
-{
-    pass2ArithBase(outputAddr, outputCursor, 0x2);
-}
-
-void pass2Add(char* outputAddr, char* outputCursor)
-{
-    pass2ArithBase(outputAddr, outputCursor, 0x3);
-}
-
-void pass2Sub(char* outputAddr, char* outputCursor)
-{
-    pass2ArithBase(outputAddr, outputCursor, 0x4);
-}
-
-void pass2Shiftl(char* outputAddr, char* outputCursor)
-{
-    pass2ArithBase(outputAddr, outputCursor, 0x5);
-}
-
-void pass2Shiftr(char* outputAddr, char* outputCursor)
-{
-    pass2ArithBase(outputAddr, outputCursor, 0x6);
-}
-
-void pass2Shiftrs(char* outputAddr, char* outputCursor)
-{
-    pass2ArithBase(outputAddr, outputCursor, 0xe);
-}
-
-void pass2Mults(char* outputAddr, char* outputCursor)
-{
-    pass2ArithBase(outputAddr, outputCursor, 0x8);
-}
-
-void pass2Multu(char* outputAddr, char* outputCursor)
-{
-    pass2ArithBase(outputAddr, outputCursor, 0x9);
-}
-
-void pass2Multfp(char* outputAddr, char* outputCursor)
-{
-    pass2ArithBase(outputAddr, outputCursor, 0xf);
-}
-
-void pass2Slt(char* outputAddr, char* outputCursor)
-{
-    pass2ArithBase(outputAddr, outputCursor, 0xa);
-}
-
-void pass2Sltu(char* outputAddr, char* outputCursor)
-{
-    pass2ArithBase(outputAddr, outputCursor, 0xb);
-}
-
-void pass2Not(char* outputAddr, char* outputCursor)
+void pass2Not(word* record, char* outputAddr, char* outputCursor)
 {
     word instr = 0x7000000;
 
-    // arg1
-    char arg1buf[16];
-    getArgPos(1, arg1buf);
     // arg1 should be a reg
-    if (arg1buf[0] != 'r')
-    {
-        bdos_print("ARITH: arg1 not a reg\n");
-        exit(1);
-    }
-    word arg1num = strToInt(&arg1buf[1]);
+    word arg1num = getRegArg(record, 1, "NOT");
     instr += (arg1num << 8);
 
-    // arg2
-    char arg2buf[16];
-    getArgPos(2, arg2buf);
     // arg2 should be a reg
-    if (arg2buf[0] != 'r')
-    {
-        bdos_print("ARITH: arg2 not a reg\n");
-        exit(1);
-    }
-    word arg2num = strToInt(&arg2buf[1]);
-
+    word arg2num = getRegArg(record, 2, "NOT");
     instr += arg2num;
 
     // write to mem
@@ -624,11 +420,21 @@ void pass2Not(char* outputAddr, char* outputCursor)
     (*outputCursor) += 1;
 }
 
-void pass2Load(char* outputAddr, char* outputCursor)
+// writes a load or loadhi (instr) of a 16 bit value to reg
+void pass2LoadBase(char* outputAddr, char* outputCursor, word instr, word value, word reg)
 {
-    word instr = 0x1C000000;
+    instr += (value << 8);
+    instr += (reg << 4);
+    instr += reg;
 
-    word arg1num = getNumberAtArg(1);
+    // write to mem
+    outputAddr[*outputCursor] = instr;
+    (*outputCursor) += 1;
+}
+
+void pass2Load(word* record, char* outputAddr, char* outputCursor)
+{
+    word arg1num = getNumberArg(record, 1, "LOAD");
 
     // arg1 should fit in 16 bits unsigned
     if (((unsigned)arg1num >> 16) > 0)
@@ -637,32 +443,14 @@ void pass2Load(char* outputAddr, char* outputCursor)
         exit(1);
     }
 
-    instr += (arg1num << 8);
-
-    // arg2
-    char arg2buf[16];
-    getArgPos(2, arg2buf);
     // arg2 should be a reg
-    if (arg2buf[0] != 'r')
-    {
-        bdos_print("LOAD: arg2 not a reg\n");
-        exit(1);
-    }
-    word arg2num = strToInt(&arg2buf[1]);
-
-    instr += (arg2num << 4);
-    instr += arg2num;
-
-    // write to mem
-    outputAddr[*outputCursor] = instr;
-    (*outputCursor) += 1;
+    word arg2num = getRegArg(record, 2, "LOAD");
+    pass2LoadBase(outputAddr, outputCursor, 0x1C000000, arg1num, arg2num);
 }
 
-void pass2Loadhi(char* outputAddr, char* outputCursor)
+void pass2Loadhi(word* record, char* outputAddr, char* outputCursor)
 {
-    word instr = 0x1D000000;
-
-    word arg1num = getNumberAtArg(1);
+    word arg1num = getNumberArg(record, 1, "LOADHI");
 
     // arg1 should fit in 16 bits unsigned
     if (((unsigned)arg1num >> 16) > 0)
@@ -671,117 +459,87 @@ void pass2Loadhi(char* outputAddr, char* outputCursor)
         exit(1);
     }
 
-    instr += (arg1num << 8);
-
-    // arg2
-    char arg2buf[16];
-    getArgPos(2, arg2buf);
     // arg2 should be a reg
-    if (arg2buf[0] != 'r')
-    {
-        bdos_print("LOADHI: arg2 not a reg\n");
-        exit(1);
-    }
-    word arg2num = strToInt(&arg2buf[1]);
-
-    instr += (arg2num << 4);
-    instr += arg2num;
-
-    // write to mem
-    outputAddr[*outputCursor] = instr;
-    (*outputCursor) += 1;
+    word arg2num = getRegArg(record, 2, "LOADHI");
+    pass2LoadBase(outputAddr, outputCursor, 0x1D000000, arg1num, arg2num);
 }
 
-void pass2LoadLabelLow(char* outputAddr, char* outputCursor)
+// Converts into load and loadhi
+// skips loadhi if the value fits in 16 bits, pass 1 counts the same number of words
+void pass2Load32(word* record, char* outputAddr, char* outputCursor)
 {
-    word instr = 0x1C000000;
-
-    char arg1buf[LABEL_NAME_SIZE+1];
-    getArgPos(1, arg1buf);
-    word arg1num = getNumberForLabel(arg1buf);
-
-    // only use the lowest 16 bits
-    arg1num = arg1num << 16;
-    arg1num = (unsigned)arg1num >> 16;
+    word load32Value = getNumberArg(record, 1, "LOAD32");
+    word arg2num = getRegArg(record, 2, "LOAD32");
 
-    instr += (arg1num << 8);
+    // split into 16 bit unsigned values
+    word mask16Bit = 0xFFFF;
+    word lowVal = load32Value & mask16Bit;
+    word highVal = ((unsigned) load32Value >> 16) & mask16Bit;
 
-    // arg2
-    char arg2buf[16];
-    getArgPos(2, arg2buf);
-    // arg2 should be a reg
-    if (arg2buf[0] != 'r')
+    pass2LoadBase(outputAddr, outputCursor, 0x1C000000, lowVal, arg2num);
+    if (highVal) // skip if 0
     {
-        bdos_print("LOADLABELLOW: arg2 not a reg\n");
-        exit(1);
+        pass2LoadBase(outputAddr, outputCursor, 0x1D000000, highVal, arg2num);
     }
-    word arg2num = strToInt(&arg2buf[1]);
-
-    instr += (arg2num << 4);
-    instr += arg2num;
-
-    // write to mem
-    outputAddr[*outputCursor] = instr;
-    (*outputCursor) += 1;
 }
 
-void pass2LoadLabelHigh(char* outputAddr, char* outputCursor)
+// Converts into load and loadhi of the lowest and highest 16 bits of the address of the label
+void pass2Addr2reg(word* record, char* outputAddr, char* outputCursor)
 {
-    word instr = 0x1D000000;
-
-    char arg1buf[LABEL_NAME_SIZE+1];
-    getArgPos(1, arg1buf);
-    word arg1num = getNumberForLabel(arg1buf);
-
-    // only use the highest 16 bits
-    arg1num = (unsigned)arg1num >> 16;
-
-    instr += (arg1num << 8);
-
-    // arg2
-    char arg2buf[16];
-    getArgPos(2, arg2buf);
-    // arg2 should be a reg
-    if (arg2buf[0] != 'r')
-    {
-        bdos_print("LOADLABELHIGH: arg2 not a reg\n");
-        exit(1);
-    }
-    word arg2num = strToInt(&arg2buf[1]);
+    word arg1num = getLabelArg(record, 1, "ADDR2REG");
+    word arg2num = getRegArg(record, 2, "ADDR2REG");
 
-    instr += (arg2num << 4);
-    instr += arg2num;
+    // the loadhi is always below the load
+    addRelocation(RELOC_ADDR2REG, *outputCursor);
 
-    // write to mem
-    outputAddr[*outputCursor] = instr;
-    (*outputCursor) += 1;
+    word mask16Bit = 0xFFFF;
+    pass2LoadBase(outputAddr, outputCursor, 0x1C000000, arg1num & mask16Bit, arg2num);
+    pass2LoadBase(outputAddr, outputCursor, 0x1D000000, (unsigned)arg1num >> 16, arg2num);
 }
 
-void pass2Nop(char* outputAddr, char* outputCursor)
+void pass2Nop(word* record, char* outputAddr, char* outputCursor)
 {
     word instr = 0;
     outputAddr[*outputCursor] = instr;
     (*outputCursor) += 1;
 }
 
-void pass2Dw(char* outputAddr, char* outputCursor)
+// each value of the .dw is a word
+void pass2Dw(word* record, char* outputAddr, char* outputCursor)
 {
-    word dwValue = getNumberAtArg(1);
-
-    // write to mem
-    outputAddr[*outputCursor] = dwValue;
-    (*outputCursor) += 1;
+    word argc = (unsigned)record[0] >> 18;
+    word i;
+    for (i = 1; i <= argc; i++)
+    {
+        // write to mem
+        outputAddr[*outputCursor] = record[i];
+        (*outputCursor) += 1;
+    }
 }
 
-void pass2Dl(char* outputAddr, char* outputCursor)
+void pass2Dl(word* record, char* outputAddr, char* outputCursor)
 {
-    char arg1buf[LABEL_NAME_SIZE+1];
-    getArgPos(1, arg1buf);
-    word dlValue = getNumberForLabel(arg1buf);
+    word dlValue = getLabelArg(record, 1, "DL");
+    addRelocation(RELOC_DATA, *outputCursor);
 
     // write to mem
     outputAddr[*outputCursor] = dlValue;
     (*outputCursor) += 1;
 }
 
+// the zeros after the end of the binary are not written
+void pass2Space(word* record, char* outputAddr, char* outputCursor)
+{
+    word spaceLength = getNumberArg(record, 1, "SPACE");
 
+    // write zeros to mem
+    word i;
+    for (i = 0; i < spaceLength; i++)
+    {
+        if (*outputCursor < binaryLength)
+        {
+            outputAddr[*outputCursor] = 0;
+        }
+        (*outputCursor) += 1;
+    }
+}
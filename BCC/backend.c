@@ -46,11 +46,31 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 - Do optimizations (like size stuff)
 */
 
-/* WORDSIZE issue tags (to look into if I will ever try to fix it)
-//WORDSIZE
-//CurFxnLocalOfs (gcc.c)
+/* WORDSIZE
+By default, the compiler still thinks in bytes (SizeOfWord = 4), so every int and pointer takes 4 addresses.
+With --word, char, short, int and pointers are all a single 32 bit word (SizeOfWord = 1, CharBits = 32),
+ so sizes, pointer arithmetic, struct layout and frame offsets count in words.
+Frame and parameter offsets below are therefore always expressed in multiples of SizeOfWord.
 */
 
+int GenOptimize; // -O (1) or -O2 (2), see GenOptimizeFxn()
+
+// --gp: small global variables are addressed relative to the global pointer register.
+// BCC lays them out itself: the .data sections keep their order when the assembler
+// moves them behind the code, so the offset of a variable from GlobalPtr_Base, the
+// first word of .data, is the total size of the data emitted before it.
+// The register points GP_BIAS words past GlobalPtr_Base to use negative offsets too.
+int GenGlobalPtr;
+// -c: the output is a module for the linker, the startup code is only put in the module with main()
+int GenModule;
+int GenMainDefined;
+// -g: ";@func" and ";@line" comments that the assembler turns into an address map
+int GenDebugMap;
+#define GP_REG B32POpRegV1
+#define GP_BIAS 32767
+#define GP_MAX_WORDS 16 // larger variables are accessed through their labels
+unsigned GenDataSize; // size of the .data emitted so far
+int GenGpOfs[MAX_IDENT_TABLE_LEN]; // per identifier: 1 + offset from GlobalPtr_Base, 0 if not addressed with --gp
 
 STATIC
 void GenInit(void)
@@ -69,15 +89,130 @@ void GenInit(void)
 STATIC
 int GenInitParams(int argc, char** argv, int* idx)
 {
+  (void)argc;
+
+  if (!strcmp(argv[*idx], "--word"))
+  {
+    // Word addressed mode: B32P addresses memory in 32 bit words
+    SizeOfWord = 1;
+    CharBits = 32;
+    return 1;
+  }
+  else if (!strcmp(argv[*idx], "-O"))
+  {
+    if (GenOptimize < 1)
+      GenOptimize = 1;
+    return 1;
+  }
+  else if (!strcmp(argv[*idx], "-O2"))
+  {
+    GenOptimize = 2;
+    return 1;
+  }
+  else if (!strcmp(argv[*idx], "--gp"))
+  {
+    GenGlobalPtr = 1;
+    return 1;
+  }
+  else if (!strcmp(argv[*idx], "-c"))
+  {
+    GenModule = 1;
+    return 1;
+  }
+  else if (!strcmp(argv[*idx], "-g"))
+  {
+    GenDebugMap = 1;
+    return 1;
+  }
+
   return 0;
 }
 
+// Sets the global pointer for --gp. Every entry into the C code does this,
+// since the code running before (BDOS, a user program, asm code) may use r3.
+STATIC
+void GenLoadGlobalPtr(void)
+{
+  if (GenGlobalPtr)
+    printf2("    addr2reg GlobalPtr_Base r3 ; initialize global pointer\n"
+            "    add r3 %d r3\n", GP_BIAS);
+}
+
+// Whether a global variable of this size should be placed in the --gp window
+STATIC
+int GenGlobalPtrFits(unsigned size)
+{
+  return GenGlobalPtr && size && size <= GP_MAX_WORDS * (unsigned)SizeOfWord &&
+         GenDataSize + size <= 2 * GP_BIAS + 1;
+}
+
+// Called after the definition of data in .data, label is the identifier of a
+// file-scope variable or -1
+STATIC
+void GenGlobalDataAdded(int label, unsigned size)
+{
+  if (label >= 0)
+    GenGpOfs[label] = GenGlobalPtrFits(size) ? GenDataSize + 1 : 0;
+  GenDataSize += size;
+}
+
+STATIC
+int GenGlobalPtrOfs(int label, int* ofs)
+{
+  if (!GenGlobalPtr || !GenGpOfs[label])
+    return 0;
+  *ofs = GenGpOfs[label] - 1 - GP_BIAS;
+  return 1;
+}
+
+// Clears .bss at startup. Bss_Start and Bss_End are defined by the assembler,
+// around the .bss sections of all modules.
+STATIC
+void GenClearBss(void)
+{
+  printf2(
+    "    addr2reg Bss_Start r1   ; clear .bss\n"
+    "    addr2reg Bss_End r2\n"
+    "    beq r1 r2 4\n"
+    "    write 0 r1 r0\n"
+    "    add r1 1 r1\n"
+    "    bne r1 r2 -2\n");
+}
+
+STATIC void GenStartup(void);
+
 STATIC
 void GenInitFinalize(void)
 {
   // finalization of initialization of target-specific code generator
   // Put all C specific wrapper code (start) here
 
+  if (GenModule)
+  {
+    // The offsets of --gp are only known for the variables of the file itself
+    if (GenGlobalPtr)
+      error("--gp can't be combined with -c\n");
+    return; // the startup code follows main(), see GenFin()
+  }
+
+  if (GenGlobalPtr)
+  {
+    // The first .data section, so the base of the variables laid out for --gp.
+    // The assembler needs data below a label, so GlobalPtr_Base gets a word of its own.
+    printf2(
+      ".data\n"
+      "GlobalPtr_Base:\n"
+      ".dw 0\n");
+    GenDataSize = 1;
+  }
+
+  GenStartup();
+}
+
+// Code at Main, that sets up the stack and runs main()
+STATIC
+void GenStartup(void)
+{
   if (compileUserBDOS)
   {
     printf2(
@@ -85,9 +220,13 @@ void GenInitFinalize(void)
       "; Setup stack and return function before jumping to Main of BDOS user program\n"
       "; BDOS user programs have their stack to keep the other stacks intact\n"
       "Main:\n"
-      "    ccache                  ; clear cache\n"
+      "    ccache                  ; clear cache\n");
+    GenLoadGlobalPtr();
+    printf2(
       "    load32 0 r14            ; initialize base pointer address\n"
-      "    load32 0x73FFFF r13     ; initialize user main stack address\n"
+      "    load32 0x73FFFF r13     ; initialize user main stack address\n");
+    GenClearBss();
+    printf2(
       "    addr2reg Return_BDOS r1 ; get address of return function\n"
       "    or r0 r1 r15            ; copy return addr to r15\n"
       "    jump main               ; jump to main of C program\n"
@@ -111,9 +250,13 @@ void GenInitFinalize(void)
       ".code\n"
       "; Setup stack and return function before jumping to Main of C program\n"
       "Main:\n"
-      "    ccache                  ; clear cache\n"
+      "    ccache                  ; clear cache\n");
+    GenLoadGlobalPtr();
+    printf2(
       "    load32 0 r14            ; initialize base pointer address\n"
-      "    load32 0x77FFFF r13     ; initialize main stack address\n"
+      "    load32 0x77FFFF r13     ; initialize main stack address\n");
+    GenClearBss();
+    printf2(
       "    addr2reg Return_UART r1 ; get address of return function\n"
       "    or r0 r1 r15            ; copy return addr to r15\n"
       "    jump main               ; jump to main of C program\n"
@@ -150,12 +293,39 @@ STATIC
 void GenLabel(char* Label, int Static)
 {
   {
-    if (!Static && GenExterns)
+    if (!Static && GenModule)
+      printf2(".globl %s\n", Label); // visible to the other modules
+    else if (!Static && GenExterns)
       printf2("; .globl %s\n", Label);
     printf2("%s:\n", Label);
   }
 }
 
+// -g: the function and source line that the following code belongs to.
+// Only a change of the line is printed, the assembler keeps the last one.
+int GenDebugLineNo;
+char GenDebugFile[MAX_FILE_NAME_LEN + 1];
+
+STATIC
+void GenDebugFxn(char* name)
+{
+  if (!GenDebugMap)
+    return;
+  printf2(";@func %s\n", name);
+  GenDebugLineNo = 0;
+}
+
+STATIC
+void GenDebugLine(void)
+{
+  char* file = FileNames[FileCnt - 1];
+  if (!GenDebugMap || (LineNo == GenDebugLineNo && !strcmp(file, GenDebugFile)))
+    return;
+  printf2(";@line %s %d\n", file, LineNo);
+  GenDebugLineNo = LineNo;
+  strcpy(GenDebugFile, file);
+}
+
 STATIC
 void GenPrintLabel(char* Label)
 {
@@ -182,7 +352,14 @@ void GenPrintNumLabel(int label)
 STATIC
 void GenZeroData(unsigned Size, int bss)
 {
-  (void)bss;
+  // In .bss only the size is given, the assembler places .bss behind all other
+  // code and data without writing it to the output and the startup code clears it
+  if (bss)
+  {
+    printf2(".space %u\n", truncUint(Size));
+    return;
+  }
+
   printf2("; .space %u\n", truncUint(Size));
 
   // B32P implementation of .space:
@@ -205,6 +382,7 @@ void GenIntData(int Size, int Val)
   Val = truncInt(Val);
 
   // Print multiple times, since the compiler does not know yet B32P is word addressable
+  // (in --word mode every type has Size 1, so each value is printed once)
   if (Size == 1)
     printf2(" .dw %d\n", Val);
   else if (Size == 2)
@@ -226,7 +404,7 @@ void GenAddrData(int Size, char* Label, int ofs)
   ofs = truncInt(ofs);
 
   int i;
-  for (i = 0; i < 4; i++) // label is 4 "bytes", hotfix since the compiler does not know yet B32P is word addressable
+  for (i = 0; i < Size; i++) // label is 4 "bytes" (or 1 word in --word mode), hotfix since the compiler does not know yet B32P is word addressable
   {
     printf2(".dl ");
 
@@ -292,14 +470,13 @@ void GenRecordFxnSize(char* startLabelName, int endLabelNo)
 #define B32PInstrLoad32    0x55
 #define B32PInstrNOP       0x56
 #define B32PInstrSHIFTRS   0x57
+#define B32PInstrMULTFP    0x58
 
 STATIC
-void GenPrintInstr(int instr, int val)
+char* GenInstrName(int instr)
 {
   char* p = "";
 
-  (void)val;
-
   switch (instr)
   {
   case B32PInstrHalt      : p = "halt"; break;
@@ -313,14 +490,14 @@ void GenPrintInstr(int instr, int val)
   case B32PInstrJumpr     : p = "jumpr"; break;
   case B32PInstrJumpro    : p = "jumpro"; break;
   case B32PInstrBEQ       : p = "beq"; break;
-  case B32PInstrBGT       : p = "bgts"; break; // HACK: Default signed comparison, because of MIPS
+  case B32PInstrBGT       : p = "bgt"; break;
   case B32PInstrBGTS      : p = "bgts"; break;
-  case B32PInstrBGE       : p = "bges"; break; // HACK: Default signed comparison, because of MIPS
+  case B32PInstrBGE       : p = "bge"; break;
   case B32PInstrBGES      : p = "bges"; break;
   case B32PInstrBNE       : p = "bne"; break;
-  case B32PInstrBLT       : p = "blts"; break; // HACK: Default signed comparison, because of MIPS
+  case B32PInstrBLT       : p = "blt"; break;
   case B32PInstrBLTS      : p = "blts"; break;
-  case B32PInstrBLE       : p = "bles"; break; // HACK: Default signed comparison, because of MIPS
+  case B32PInstrBLE       : p = "ble"; break;
   case B32PInstrBLES      : p = "bles"; break;
   case B32PInstrSavPC     : p = "savpc"; break;
   case B32PInstrReti      : p = "reti"; break;
@@ -332,6 +509,7 @@ void GenPrintInstr(int instr, int val)
   case B32PInstrSHIFTL    : p = "shiftl"; break;
   case B32PInstrSHIFTR    : p = "shiftr"; break;
   case B32PInstrSHIFTRS   : p = "shiftrs"; break;
+  case B32PInstrMULTFP    : p = "multfp"; break;
   case B32PInstrNOT       : p = "not"; break;
   case B32PInstrMULTS     : p = "mults"; break;
   case B32PInstrMULTU     : p = "multu"; break;
@@ -343,7 +521,15 @@ void GenPrintInstr(int instr, int val)
   case B32PInstrLoad32    : p = "load32"; break;
   }
 
-  printf2(" %s ", p);
+  return p;
+}
+
+STATIC
+void GenPrintInstr(int instr, int val)
+{
+  (void)val;
+
+  printf2(" %s ", GenInstrName(instr));
 }
 
 #define B32POpRegZero                    0x00 //0  0
@@ -387,6 +573,9 @@ void GenPrintInstr(int instr, int val)
 #define TEMP_REG_A B32POpRegT8 // two temporary registers used for momentary operations, similarly to the AT register
 #define TEMP_REG_B B32POpRegT9
 
+#define DIVIDER_ADDR 0xC02744 // memory mapped integer divider: write dividend at +0, divisor and read result at +1..+4
+#define FP_DIVIDER_ADDR 0xC02742 // memory mapped 16.16 fixed point divider: write dividend at +0, divisor and read result at +1
+
 STATIC
 void GenPrintOperand(int op, int val)
 {
@@ -567,24 +756,187 @@ void GenJumpIfNotZero(int label)
                          B32POpNumLabel, label);
 }
 
+#define SWITCH_LINEAR_MAX    4 // up to this many cases are compared one by one
+#define SWITCH_TABLE_MIN     4 // a jump table needs at least this many cases...
+#define SWITCH_TABLE_DENSITY 3 // ...and at least one case per this many table entries
+
+// Jumps through a table of case labels indexed by GenWreg - lowest case value.
+// The table goes right after the jumpr, so the optimizer can find the targets of the jump.
+STATIC
+void GenSwitchTable(int (*cases)[2], int cnt, int defLabel)
+{
+  unsigned lo = truncUint(cases[0][0]);
+  unsigned range = truncUint(cases[cnt - 1][0]) - lo;
+  int idxReg = GenWreg;
+  int lbl = LabelCnt++;
+  int i;
+  unsigned v;
+
+  if (lo)
+  {
+    if (truncInt(lo) >= -32767 && truncInt(lo) <= 32767)
+    {
+      GenPrintInstr3Operands(B32PInstrSUB, 0,
+                             GenWreg, 0,
+                             B32POpConst, truncInt(lo),
+                             TEMP_REG_A, 0);
+    }
+    else
+    {
+      GenPrintInstr2Operands(B32PInstrLoad, 0,
+                             B32POpConst, truncInt(lo),
+                             TEMP_REG_A, 0);
+      GenPrintInstr3Operands(B32PInstrSUB, 0,
+                             GenWreg, 0,
+                             TEMP_REG_A, 0,
+                             TEMP_REG_A, 0);
+    }
+    idxReg = TEMP_REG_A;
+  }
+
+  // The unsigned compare also catches values below the lowest case
+  GenPrintInstr3Operands(B32PInstrSLTU, 0,
+                         idxReg, 0,
+                         B32POpConst, range + 1,
+                         TEMP_REG_B, 0);
+  GenPrintInstr3Operands(B32PInstrBNE, 0,
+                         TEMP_REG_B, 0,
+                         B32POpRegZero, 0,
+                         B32POpConst, 2);
+  GenPrintInstr1Operand(B32PInstrJump, 0,
+                        B32POpNumLabel, defLabel);
+
+  GenPrintInstr2Operands(B32PInstrAddr2reg, 0,
+                         B32POpNumLabel, lbl,
+                         B32POpRegAt, 0);
+  GenPrintInstr3Operands(B32PInstrADD, 0,
+                         B32POpRegAt, 0,
+                         idxReg, 0,
+                         B32POpRegAt, 0);
+  GenPrintInstr2Operands(B32PInstrRead, 0,
+                         B32POpIndRegAt, 0,
+                         B32POpRegAt, 0);
+  GenPrintInstr2Operands(B32PInstrJumpr, 0,
+                         B32POpConst, 0,
+                         B32POpRegAt, 0);
+
+  // One word per entry in both the byte and the word addressed modes
+  puts2(RoDataHeaderFooter[0]);
+  GenNumLabel(lbl);
+  for (i = 0, v = 0; v <= range; v++)
+  {
+    printf2(".dl ");
+    if (truncUint(cases[i][0]) - lo == v)
+      GenPrintNumLabel(cases[i++][1]);
+    else
+      GenPrintNumLabel(defLabel);
+    puts2("");
+  }
+  puts2(RoDataHeaderFooter[1]);
+  puts2(CodeHeaderFooter[0]);
+}
+
+// Dispatches GenWreg to the sorted cases: dense runs of cases get a jump table,
+// sparse ones a binary search that ends in compares for a few cases.
+// Returns 1 if the code always jumps away, 0 if it falls through when no case matches.
+STATIC
+int GenSwitchTree(int (*cases)[2], int cnt, int defLabel)
+{
+  unsigned range = truncUint(cases[cnt - 1][0]) - truncUint(cases[0][0]);
+  int mid, pivot, lbl, i;
+
+  if (cnt >= SWITCH_TABLE_MIN && range < 32767 && range / SWITCH_TABLE_DENSITY < (unsigned)cnt)
+  {
+    GenSwitchTable(cases, cnt, defLabel);
+    return 1;
+  }
+
+  if (cnt <= SWITCH_LINEAR_MAX)
+  {
+    for (i = 0; i < cnt; i++)
+      GenJumpIfEqual(cases[i][0], cases[i][1]);
+    return 0;
+  }
+
+  // Values below the middle case go to the lower half
+  mid = cnt / 2;
+  pivot = truncInt(cases[mid][0]);
+  lbl = LabelCnt++;
+  if (pivot >= -32767 && pivot <= 32767)
+  {
+    GenPrintInstr3Operands(B32PInstrSLT, 0,
+                           GenWreg, 0,
+                           B32POpConst, pivot,
+                           TEMP_REG_B, 0);
+  }
+  else
+  {
+    GenPrintInstr2Operands(B32PInstrLoad, 0,
+                           B32POpConst, pivot,
+                           TEMP_REG_B, 0);
+    GenPrintInstr3Operands(B32PInstrSLT, 0,
+                           GenWreg, 0,
+                           TEMP_REG_B, 0,
+                           TEMP_REG_B, 0);
+  }
+  GenPrintInstr3Operands(B32PInstrBEQ, 0,
+                         TEMP_REG_B, 0,
+                         B32POpRegZero, 0,
+                         B32POpConst, 2);
+  GenPrintInstr1Operand(B32PInstrJump, 0,
+                        B32POpNumLabel, lbl);
+
+  if (!GenSwitchTree(cases + mid, cnt - mid, defLabel))
+    GenJumpUncond(defLabel);
+  GenNumLabel(lbl);
+  return GenSwitchTree(cases, mid, defLabel);
+}
+
+// Generates the jumps to the cases ([0] is the case value, [1] the label) of a switch.
+// The cases are sorted by their signed values, which is fine for unsigned switches too
+// as long as the compares and the ranges use the same order.
+STATIC
+int GenSwitch(int (*cases)[2], int cnt, int defLabel)
+{
+  int i, j;
+
+  if (!cnt)
+    return 0;
+
+  for (i = 1; i < cnt; i++)
+  {
+    int v = cases[i][0], l = cases[i][1];
+    for (j = i; j > 0 && truncInt(cases[j - 1][0]) > truncInt(v); j--)
+    {
+      cases[j][0] = cases[j - 1][0];
+      cases[j][1] = cases[j - 1][1];
+    }
+    cases[j][0] = v;
+    cases[j][1] = l;
+  }
+
+  return GenSwitchTree(cases, cnt, defLabel);
+}
+
 fpos_t GenPrologPos;
 int GenLeaf;
+int GenFrameless; // -O: the function doesn't use r13 and r14, no prolog and epilog
 
 STATIC
-void GenWriteFrameSize(void) //WORDSIZE
+void GenWriteFrameSize(void)
 {
-  unsigned size = 8/*RA + FP*/ - CurFxnMinLocalOfs;
+  unsigned size = 2 * SizeOfWord/*RA + FP*/ - CurFxnMinLocalOfs;
   //printf2(" subu r13, r13, %10u\n", size); // 10 chars are enough for 32-bit unsigned ints
   printf2(" sub r13 %10u r13\n", size); // r13 = r13 - size
 
   //printf2(" sw r14, %10u r13\n", size - 8);
-  printf2(" write %10u r13 r14\n", size - 8); // write r14 to memory[r13+(size-8)]
+  printf2(" write %10u r13 r14\n", size - 2 * SizeOfWord); // write r14 to memory[r13+(size-8)]
   
   //printf2(" addu r14, r13, %10u\n", size - 8);
-  printf2(" add r13 %10u r14\n", size - 8); // r14 = r13 + (size-8)
+  printf2(" add r13 %10u r14\n", size - 2 * SizeOfWord); // r14 = r13 + (size-8)
 
   //printf2(" %csw r15, 4 r14\n", GenLeaf ? ';' : ' ');
-  printf2(" %c write 4 r14 r15\n", GenLeaf ? ';' : ' '); // write r15 to memory[r14+4]
+  printf2(" %c write %d r14 r15\n", GenLeaf ? ';' : ' ', SizeOfWord); // write r15 to memory[r14+4]
 }
 
 STATIC
@@ -597,33 +949,204 @@ void GenUpdateFrameSize(void)
   fsetpos(OutFile, &pos);
 }
 
+FILE* GenFxnOutFile; // the real output file while a function body is being buffered
+FILE* GenFxnBufFile; // buffer for the function body
+int GenFxnHasAsm;
+
+#define MAX_AGGR_LOCALS 256
+int GenAggrLocalCnt;
+int GenAggrLocals[MAX_AGGR_LOCALS][2]; // offset and size of local arrays and structures
+
+#include "optimizer.c"
+
 STATIC
-void GenFxnProlog(void)
+void GenStartAsm(void)
+{
+  GenFxnHasAsm = 1;
+  // mark the asm code in the buffer, it's copied as is
+  if (GenOptimize && GenFxnOutFile)
+    puts2(";@asm");
+}
+
+STATIC
+void GenEndAsm(void)
+{
+  if (GenOptimize && GenFxnOutFile)
+    puts2(";@endasm");
+  // the asm code may have used r3
+  GenLoadGlobalPtr();
+}
+
+STATIC
+void GenLocalVar(int ofs, unsigned size, int aggregate)
+{
+  // Array and structure members are accessed at offsets of their own,
+  // none of the words inside them may be moved to a register
+  if (!aggregate)
+    return;
+  if (GenAggrLocalCnt >= MAX_AGGR_LOCALS)
+  {
+    // too many to track, keep all locals in memory
+    GenAggrLocals[0][0] = -GenMaxLocalsSize();
+    GenAggrLocals[0][1] = GenMaxLocalsSize();
+    GenAggrLocalCnt = 1;
+    return;
+  }
+  GenAggrLocals[GenAggrLocalCnt][0] = ofs;
+  GenAggrLocals[GenAggrLocalCnt][1] = (int)size;
+  GenAggrLocalCnt++;
+}
+
+STATIC
+void GenWriteParams(void)
 {
   if (CurFxnParamCntMin && CurFxnParamCntMax)
   {
     int i, cnt = CurFxnParamCntMax;
     if (cnt > 4)
-      cnt = 4; //WORDSIZE?
+      cnt = 4;
     // TBD!!! for structure passing use the cumulative parameter size
     // instead of the number of parameters. Currently this bug is masked
     // by the subroutine that pushes structures on the stack (it copies
     // all words except the first to the stack). But passing structures
     // in registers from assembly code won't always work.
     for (i = 0; i < cnt; i++)
-      GenPrintInstr2Operands(B32PInstrWrite, 0,
-                             B32POpIndRegSp, 4 * i, //WORDSIZE
-                             B32POpRegA0 + i, 0);
+      if (OptSlotRegAt(2 * SizeOfWord + SizeOfWord * i) < 0) // -O may keep it in a register
+        GenPrintInstr2Operands(B32PInstrWrite, 0,
+                               B32POpIndRegSp, SizeOfWord * i,
+                               B32POpRegA0 + i, 0);
+  }
+}
+
+// Prints the prolog and the optimized body of the function buffered with -O
+STATIC
+void GenOptimizeFxn(void)
+{
+  int i, s, analyzed, savedOfs;
+
+  OutFile = GenFxnOutFile;
+  GenFxnOutFile = NULL;
+
+  OptReadFxn();
+  OptInlineCalls();
+  analyzed = !GenFxnHasAsm && OptBuildNodes() && OptFindSlots() && OptBuildFlow();
+  if (analyzed)
+  {
+    OptLiveness();
+    OptAllocRegs();
+    OptRewriteSlots();
+    analyzed = OptPeephole();
+    // -O2: constants and unreachable code first, recomputations once the loops are done
+    if (analyzed && GenOptimize > 1 && OptSsa(0))
+      analyzed = OptPeephole();
+    if (analyzed && OptLoops())
+      analyzed = OptPeephole();
+    else
+      analyzed = 0;
+    if (analyzed && GenOptimize > 1 && OptSsa(1))
+      analyzed = OptPeephole();
+  }
+  else
+  {
+    OptSlotCnt = 0;
+  }
+  OptFindSavedRegs(analyzed);
+  if (analyzed)
+    OptInlineFxn();
+  else if (GenFxnHasAsm)
+    OptInlineAsm();
+
+  savedOfs = CurFxnMinLocalOfs;
+  CurFxnMinLocalOfs -= OptSavedCnt * SizeOfWord;
+  if (analyzed)
+    OptTailCalls(savedOfs);
+
+  GenFrameless = analyzed && OptNeedsNoFrame();
+  OptFrameless += GenFrameless;
+  OptSchedule();
+  if (!GenFrameless)
+  {
+    GenWriteParams();
+    GenWriteFrameSize();
   }
 
+  for (i = 0; i < OptSavedCnt; i++)
+    GenPrintInstr2Operands(B32PInstrWrite, 0,
+                           B32POpIndRegFp, savedOfs - SizeOfWord * (i + 1),
+                           OptSavedRegs[i], 0);
+
+  // Move the parameters to their registers, A0-A3 first as they may be reused
+  for (i = 0; i < 2; i++)
+    for (s = 0; s < OptSlotCnt; s++)
+    {
+      int ofs = OptSlotOfs[s], r = OptSlotReg[s], idx;
+      if (r < 0 || ofs < 2 * SizeOfWord)
+        continue;
+      idx = (ofs - 2 * SizeOfWord) / SizeOfWord;
+#ifndef NO_ANNOTATIONS
+      if (!i)
+      {
+        GenStartCommentLine(); printf2("(@%d) in r%d\n", ofs, r);
+      }
+#endif
+      if (!i && idx < 4 && r != B32POpRegA0 + idx)
+        GenPrintInstr3Operands(B32PInstrOR, 0,
+                               B32POpRegZero, 0,
+                               B32POpRegA0 + idx, 0,
+                               r, 0);
+      else if (i && idx >= 4)
+        GenPrintInstr2Operands(B32PInstrRead, 0,
+                               B32POpIndRegFp, ofs,
+                               r, 0);
+    }
+
+#ifndef NO_ANNOTATIONS
+  for (s = 0; s < OptSlotCnt; s++)
+    if (OptSlotReg[s] >= 0 && OptSlotOfs[s] < 0)
+    {
+      GenStartCommentLine(); printf2("(@%d) in r%d\n", OptSlotOfs[s], OptSlotReg[s]);
+    }
+#endif
+
+  for (i = 0; i < OptLineCnt; i++)
+    OptPrintLine(i);
+
+  for (i = 0; i < OptSavedCnt; i++)
+    GenPrintInstr2Operands(B32PInstrRead, 0,
+                           B32POpIndRegFp, savedOfs - SizeOfWord * (i + 1),
+                           OptSavedRegs[i], 0);
+}
+
+STATIC
+void GenFxnProlog(void)
+{
   GenLeaf = 1; // will be reset to 0 if a call is generated
+  GenFrameless = 0;
+  if (IsMain)
+    GenMainDefined = 1;
+
+  if (GenOptimize)
+  {
+    // Buffer the body, GenFxnEpilog() prints it along with the prolog
+    if (!GenFxnBufFile && !(GenFxnBufFile = tmpfile()))
+      errorFile("temporary file");
+    rewind(GenFxnBufFile);
+    GenFxnOutFile = OutFile;
+    OutFile = GenFxnBufFile;
+    GenFxnHasAsm = 0;
+    GenAggrLocalCnt = 0;
+    OptSlotCnt = 0;
+    return;
+  }
+
+  GenWriteParams();
 
   fgetpos(OutFile, &GenPrologPos);
   GenWriteFrameSize();
 }
 
 STATIC
-void GenGrowStack(int size) //WORDSIZE
+void GenGrowStack(int size)
 {
   if (!size)
     return;
@@ -647,21 +1170,27 @@ void GenGrowStack(int size) //WORDSIZE
 STATIC
 void GenFxnEpilog(void)
 {
-  GenUpdateFrameSize();
+  if (GenOptimize)
+    GenOptimizeFxn();
+  else
+    GenUpdateFrameSize();
 
-  if (!GenLeaf)
-    GenPrintInstr2Operands(B32PInstrRead, 0,
-                           B32POpIndRegFp, 4, //WORDSIZE
-                           B32POpRegRa, 0);
+  if (!GenFrameless)
+  {
+    if (!GenLeaf)
+      GenPrintInstr2Operands(B32PInstrRead, 0,
+                             B32POpIndRegFp, SizeOfWord,
+                             B32POpRegRa, 0);
 
-  GenPrintInstr2Operands(B32PInstrRead, 0,
-                         B32POpIndRegFp, 0,
-                         B32POpRegFp, 0);
+    GenPrintInstr2Operands(B32PInstrRead, 0,
+                           B32POpIndRegFp, 0,
+                           B32POpRegFp, 0);
 
-  GenPrintInstr3Operands(B32PInstrADD, 0,
-                         B32POpRegSp, 0,
-                         B32POpConst, 8/*RA + FP*/ - CurFxnMinLocalOfs, //WORDSIZE
-                         B32POpRegSp, 0);
+    GenPrintInstr3Operands(B32PInstrADD, 0,
+                           B32POpRegSp, 0,
+                           B32POpConst, 2 * SizeOfWord/*RA + FP*/ - CurFxnMinLocalOfs,
+                           B32POpRegSp, 0);
+  }
 
   GenPrintInstr2Operands(B32PInstrJumpr, 0,
                         B32POpConst, 0,
@@ -710,18 +1239,8 @@ int GenGetBinaryOperatorInstr(int tok)
   case '*':
   case tokAssignMul:
     return B32PInstrMULTS;
-  case '/':
-  case '%':
-  case tokAssignDiv:
-  case tokAssignMod:
-    printf("DIVISION/MOD is not supported!\n");
-    return B32PInstrHalt;
-  case tokUDiv:
-  case tokUMod:
-  case tokAssignUDiv:
-  case tokAssignUMod:
-    printf("DIVISION/MOD is not supported!\n");
-    return B32PInstrHalt;
+  case tokFpMul:
+    return B32PInstrMULTFP;
   case tokLShift:
   case tokAssignLSh:
     return B32PInstrSHIFTL;
@@ -759,6 +1278,16 @@ void GenPostIdentAccess(void)
 STATIC
 void GenReadIdent(int regDst, int opSz, int label)
 {
+  int ofs;
+  if (GenGlobalPtrOfs(label, &ofs))
+  {
+    GenPrintInstr3Operands(B32PInstrRead, 0,
+                           B32POpConst, ofs,
+                           GP_REG, 0,
+                           regDst, 0);
+    return;
+  }
+
   GenPrintInstr2Operands(B32PInstrAddr2reg, 0,
                          B32POpLabel, label,
                          B32POpRegAt, 0);
@@ -790,6 +1319,16 @@ void GenReadIndirect(int regDst, int regSrc, int opSz)
 STATIC
 void GenWriteIdent(int regSrc, int opSz, int label)
 {
+  int ofs;
+  if (GenGlobalPtrOfs(label, &ofs))
+  {
+    GenPrintInstr3Operands(B32PInstrWrite, 0,
+                           B32POpConst, ofs,
+                           GP_REG, 0,
+                           regSrc, 0);
+    return;
+  }
+
   GenPrintInstr2Operands(B32PInstrAddr2reg, 0,
                          B32POpLabel, label,
                          B32POpRegAt, 0);
@@ -1019,7 +1558,7 @@ void GenPushReg(void)
 
   GenPrintInstr3Operands(B32PInstrSUB, 0,
                          B32POpRegSp, 0,
-                         B32POpConst, 4, //WORDSIZE
+                         B32POpConst, SizeOfWord,
                          B32POpRegSp, 0);
 
   GenPrintInstr2Operands(B32PInstrWrite, 0,
@@ -1048,12 +1587,115 @@ void GenPopReg(void)
 
   GenPrintInstr3Operands(B32PInstrADD, 0,
                          B32POpRegSp, 0,
-                         B32POpConst, 4, //WORDSIZE
+                         B32POpConst, SizeOfWord,
                          B32POpRegSp, 0);
   GenLreg = TEMP_REG_A;
   GenRreg = GenWreg;
 }
 
+// Divides regA by regB with the memory mapped hardware divider and puts
+// the quotient (tok is '/', tokUDiv or tokFpDiv) or the remainder into regDst.
+// Uses the AT register for the divider address, so regA, regB and regDst
+// may be any other registers, including TEMP_REG_A and TEMP_REG_B
+STATIC
+void GenDivide(int tok, int regDst, int regA, int regB)
+{
+  int ofs, addr = DIVIDER_ADDR;
+
+  switch (tok)
+  {
+  case tokFpDiv: addr = FP_DIVIDER_ADDR; ofs = 1; break;
+  case '/': case tokAssignDiv: ofs = 1; break;
+  case tokUDiv: case tokAssignUDiv: ofs = 2; break;
+  case '%': case tokAssignMod: ofs = 3; break;
+  default: ofs = 4; break; // tokUMod, tokAssignUMod
+  }
+
+  GenPrintInstr2Operands(B32PInstrLoad, 0,
+                         B32POpConst, addr,
+                         B32POpRegAt, 0);
+  GenPrintInstr2Operands(B32PInstrWrite, 0,
+                         B32POpIndRegAt, 0,
+                         regA, 0);
+  // Writing the divisor starts the division, reading the result waits for it
+  GenPrintInstr2Operands(B32PInstrWrite, 0,
+                         B32POpIndRegAt, ofs,
+                         regB, 0);
+  GenPrintInstr2Operands(B32PInstrRead, 0,
+                         B32POpIndRegAt, ofs,
+                         regDst, 0);
+}
+
+// Signed division and modulo of GenWreg by a positive power of 2 without the divider.
+// Negative dividends are biased by (divisor - 1) so the quotient rounds toward zero:
+//   q = (x + bias) >> k, r = x - ((x + bias) & -divisor), bias = (x >> 31) >>> (32 - k)
+// Returns 0 if the divisor isn't suitable
+STATIC
+int GenDivPow2(int tok, int divisor)
+{
+  unsigned m = truncUint(divisor);
+  int k = 0;
+
+  if ((tok != '/' && tok != '%') || !m || (m & (m - 1)) || truncInt(divisor) < 0)
+    return 0;
+  while (m >>= 1) k++;
+  if (tok == '%' && k > 14) // -divisor must fit into the 16-bit constant of AND
+    return 0;
+
+  if (k == 0)
+  {
+    // x / 1 == x, x % 1 == 0
+    if (tok == '%')
+      GenPrintInstr2Operands(B32PInstrLoad, 0,
+                             B32POpConst, 0,
+                             GenWreg, 0);
+    return 1;
+  }
+
+  if (k == 1)
+  {
+    GenPrintInstr3Operands(B32PInstrSHIFTR, 0,
+                           GenWreg, 0,
+                           B32POpConst, 31,
+                           TEMP_REG_A, 0);
+  }
+  else
+  {
+    GenPrintInstr3Operands(B32PInstrSHIFTRS, 0,
+                           GenWreg, 0,
+                           B32POpConst, 31,
+                           TEMP_REG_A, 0);
+    GenPrintInstr3Operands(B32PInstrSHIFTR, 0,
+                           TEMP_REG_A, 0,
+                           B32POpConst, 32 - k,
+                           TEMP_REG_A, 0);
+  }
+  GenPrintInstr3Operands(B32PInstrADD, 0,
+                         GenWreg, 0,
+                         TEMP_REG_A, 0,
+                         TEMP_REG_A, 0);
+
+  if (tok == '/')
+  {
+    GenPrintInstr3Operands(B32PInstrSHIFTRS, 0,
+                           TEMP_REG_A, 0,
+                           B32POpConst, k,
+                           GenWreg, 0);
+  }
+  else
+  {
+    GenPrintInstr3Operands(B32PInstrAND, 0,
+                           TEMP_REG_A, 0,
+                           B32POpConst, -(1 << k),
+                           TEMP_REG_A, 0);
+    GenPrintInstr3Operands(B32PInstrSUB, 0,
+                           GenWreg, 0,
+                           TEMP_REG_A, 0,
+                           GenWreg, 0);
+  }
+  return 1;
+}
+
 #define tokRevIdent    0x100
 #define tokRevLocalOfs 0x101
 #define tokAssign0     0x102
@@ -1120,6 +1762,7 @@ void GenPrep(int* idx)
   case '%':
   case tokUDiv:
   case tokUMod:
+  case tokFpDiv:
   case tokLShift:
   case tokRShift:
   case tokURShift:
@@ -1187,6 +1830,7 @@ void GenPrep(int* idx)
 
   case '+':
   case '*':
+  case tokFpMul:
   case '&':
   case '^':
   case '|':
@@ -1309,6 +1953,10 @@ void GenPrep(int* idx)
 }
 
 /*
+  The "if" forms of <, <=, >, >= and of == and != with constants that do not
+  fit in 16 bits below are not used anymore: GenCmp() emits a single signed
+  (bXXs) or unsigned (bXX) branch on the compared values for them instead.
+
 ;     l <[u] 0       // slt[u] w, w, 0                            "k"
       l <[u] const   // slt[u] w, w, const                        "m"
       l <[u] r       // slt[u] w, l, r                            "i"
@@ -1421,15 +2069,43 @@ void GenCmp(int* idx, int op)
   if (constness == 2)
     GenPopReg();
 
-  // bltz, blez, bgez, bgtz are for signed comparison with 0 only,
-  // so for conditional branches on <0u, <=0u, >0u, >=0u use the general method instead
-  if (condbranch && op < 4 && constness == 0 && unsign)
+  // Conditional branches on <, <=, >, >= and on == or != a constant that
+  // does not fit in 16 bits branch on the compared values themselves,
+  // smaller constants are xor'ed with the value, which is then tested against r0
+  if (condbranch && (op < 4 || (constness == 1 && (constval < -0x8000 || constval >= 0x8000))))
   {
-    // Except, >0u is more optimal as !=0
-    if (op == 2)
-      op = 5;
-    else
-      constness = 1;
+    static int branches[2][6] =
+    {
+      { B32PInstrBLTS, B32PInstrBLES, B32PInstrBGTS, B32PInstrBGES, B32PInstrBEQ, B32PInstrBNE },
+      { B32PInstrBLT, B32PInstrBLE, B32PInstrBGT, B32PInstrBGE, B32PInstrBEQ, B32PInstrBNE }
+    };
+    int lreg = GenLreg, rreg = GenRreg;
+
+    if (constness != 2)
+    {
+      lreg = GenWreg;
+      rreg = B32POpRegZero;
+      if (constness == 1)
+      {
+        GenPrintInstr2Operands(B32PInstrLoad, 0,
+                               B32POpConst, constval,
+                               TEMP_REG_A, 0);
+        rreg = TEMP_REG_A;
+      }
+    }
+
+    // Skip the jump to the label if its condition is false,
+    // the optimizer turns this into one branch to the label
+    if (condbranch == 1)
+      op ^= (op < 4) ? 3 : 1; // the opposite condition
+    GenPrintInstr3Operands(branches[unsign][op], 0,
+                           lreg, 0,
+                           rreg, 0,
+                           B32POpConst, 2);
+    GenPrintInstr1Operand(B32PInstrJump, 0,
+                          B32POpNumLabel, label);
+    *idx += 1;
+    return;
   }
 
   p = CmpBlocks[op][condbranch != 0][constness];
@@ -1470,14 +2146,14 @@ void GenCmp(int* idx, int op)
       */
       if (condbranch == 1)
       {
-        GenPrintInstr3Operands(B32PInstrBGE, 0,
+        GenPrintInstr3Operands(B32PInstrBGES, 0,
                                GenWreg, 0,
                                B32POpRegZero, 0,
                                B32POpConst, 2);
       }
       else
       {
-        GenPrintInstr3Operands(B32PInstrBGT, 0,
+        GenPrintInstr3Operands(B32PInstrBGTS, 0,
                                B32POpRegZero, 0,
                                GenWreg, 0,
                                B32POpConst, 2);
@@ -1495,14 +2171,14 @@ void GenCmp(int* idx, int op)
       */
       if (condbranch == 1)
       {
-        GenPrintInstr3Operands(B32PInstrBGE, 0,
+        GenPrintInstr3Operands(B32PInstrBGES, 0,
                                B32POpRegZero, 0,
                                GenWreg, 0,
                                B32POpConst, 2);
       }
       else
       {
-        GenPrintInstr3Operands(B32PInstrBGT, 0,
+        GenPrintInstr3Operands(B32PInstrBGTS, 0,
                                GenWreg, 0,
                                B32POpRegZero, 0,
                                B32POpConst, 2);
@@ -1628,6 +2304,99 @@ int GenIsCmp(int t)
     t == tokNEQ;
 }
 
+// Number of words up to which structure/union copies are fully unrolled,
+// bigger ones are copied by a loop moving STRUCT_COPY_STEP words per iteration
+#define STRUCT_COPY_UNROLL 16
+#define STRUCT_COPY_STEP 4
+
+int GenStructCpyCalls; // copies that still call the StructCpyLabel function
+
+// Tells if the call at stack[i] is to the function that copies structures/unions
+// (fxn(sizeof *psright, psright, psleft)), 2 if they are made of whole words only
+STATIC
+int GenStructCopyKind(int i)
+{
+  int v = stack[i - 1][1];
+  if (stack[i - 1][0] != tokIdent)
+    return 0;
+  if (StructCpyWordLabel && v == AddNumericIdent(StructCpyWordLabel))
+    return 2;
+  return StructCpyLabel && v == AddNumericIdent(StructCpyLabel);
+}
+
+// Copies words from A1 to A2, two at a time so that no write waits for the read before it
+STATIC
+void GenStructCopyWords(int cnt, int stride)
+{
+  int k;
+  for (k = 0; k < cnt; k += 2)
+  {
+    int pair = k + 1 < cnt;
+    GenPrintInstr2Operands(B32PInstrRead, 0,
+                           B32POpIndRegA1, k * stride,
+                           B32POpRegAt, 0);
+    if (pair)
+      GenPrintInstr2Operands(B32PInstrRead, 0,
+                             B32POpIndRegA1, (k + 1) * stride,
+                             B32POpRegA3, 0);
+    GenPrintInstr3Operands(B32PInstrWrite, 0,
+                           B32POpConst, k * stride,
+                           B32POpRegA2, 0,
+                           B32POpRegAt, 0);
+    if (pair)
+      GenPrintInstr3Operands(B32PInstrWrite, 0,
+                             B32POpConst, (k + 1) * stride,
+                             B32POpRegA2, 0,
+                             B32POpRegA3, 0);
+  }
+}
+
+// Inline replacement for the call to the StructCpyLabel function: copies size chars
+// from A1 to A2 and returns A2 in V0. Structures/unions made of whole words only
+// have data at every SizeOfWord'th address, so only those addresses are copied.
+STATIC
+void GenStructCopy(int size, int wordOnly)
+{
+  int stride = wordOnly ? SizeOfWord : 1;
+  int cnt = division(size, stride);
+
+  GenPrintInstr3Operands(B32PInstrOR, 0,
+                         B32POpRegZero, 0,
+                         B32POpRegA2, 0,
+                         B32POpRegV0, 0);
+
+  if (cnt > STRUCT_COPY_UNROLL)
+  {
+    int lbl = LabelCnt++;
+    GenPrintInstr2Operands(B32PInstrLoad, 0,
+                           B32POpConst, division(cnt, STRUCT_COPY_STEP),
+                           B32POpRegA0, 0);
+    GenNumLabel(lbl);
+    GenStructCopyWords(STRUCT_COPY_STEP, stride);
+    GenPrintInstr3Operands(B32PInstrADD, 0,
+                           B32POpRegA1, 0,
+                           B32POpConst, STRUCT_COPY_STEP * stride,
+                           B32POpRegA1, 0);
+    GenPrintInstr3Operands(B32PInstrADD, 0,
+                           B32POpRegA2, 0,
+                           B32POpConst, STRUCT_COPY_STEP * stride,
+                           B32POpRegA2, 0);
+    GenPrintInstr3Operands(B32PInstrSUB, 0,
+                           B32POpRegA0, 0,
+                           B32POpConst, 1,
+                           B32POpRegA0, 0);
+    GenPrintInstr3Operands(B32PInstrBEQ, 0,
+                           B32POpRegA0, 0,
+                           B32POpRegZero, 0,
+                           B32POpConst, 2);
+    GenPrintInstr1Operand(B32PInstrJump, 0,
+                          B32POpNumLabel, lbl);
+    cnt -= division(cnt, STRUCT_COPY_STEP) * STRUCT_COPY_STEP;
+  }
+
+  GenStructCopyWords(cnt, stride);
+}
+
 // Improved register/stack-based code generator
 // DONE: test 32-bit code generation
 STATIC
@@ -1697,6 +2466,11 @@ void GenExpr0(void)
                            t == tokLShift ||
                            t == tokRShift ||
                            t == tokURShift ||
+                           t == '/' ||
+                           t == '%' ||
+                           t == tokUDiv ||
+                           t == tokUMod ||
+                           t == tokFpDiv ||
                            GenIsCmp(t))))
       {
         if (gotUnary)
@@ -1719,9 +2493,16 @@ void GenExpr0(void)
                            t == tokPostInc ||
                            t == tokPostDec)))
       {
-        GenPrintInstr2Operands(B32PInstrAddr2reg, 0,
-                               B32POpLabel, v,
-                               GenWreg, 0);
+        int ofs;
+        if (GenGlobalPtrOfs(v, &ofs))
+          GenPrintInstr3Operands(B32PInstrADD, 0,
+                                 GP_REG, 0,
+                                 B32POpConst, ofs,
+                                 GenWreg, 0);
+        else
+          GenPrintInstr2Operands(B32PInstrAddr2reg, 0,
+                                 B32POpLabel, v,
+                                 GenWreg, 0);
       }
       gotUnary = 1;
       break;
@@ -1747,27 +2528,27 @@ void GenExpr0(void)
       if (gotUnary)
         GenPushReg();
       gotUnary = 0;
-      if (maxCallDepth != 1 && v < 16)
-        GenGrowStack(16 - v);
-      paramOfs = v - 4;
-      if (maxCallDepth == 1 && paramOfs >= 0 && paramOfs <= 12)
+      if (maxCallDepth != 1 && v < 4 * SizeOfWord)
+        GenGrowStack(4 * SizeOfWord - v);
+      paramOfs = v - SizeOfWord;
+      if (maxCallDepth == 1 && paramOfs >= 0 && paramOfs <= 3 * SizeOfWord)
       {
         // Work directly in A0-A3 instead of working in V0 and avoid copying V0 to A0-A3
-        GenWreg = B32POpRegA0 + division(paramOfs, 4); //(paramOfs >> 2); //division(paramOfs, 4);
+        GenWreg = B32POpRegA0 + division(paramOfs, SizeOfWord);
       }
       break;
 
     case ',':
       if (maxCallDepth == 1)
       {
-        if (paramOfs == 16)
+        if (paramOfs == 4 * SizeOfWord)
         {
           // Got the last on-stack parameter, the rest will go in A0-A3
           GenPushReg();
           gotUnary = 0;
           GenWreg = B32POpRegA3;
         }
-        if (paramOfs >= 0 && paramOfs <= 12)
+        if (paramOfs >= 0 && paramOfs <= 3 * SizeOfWord)
         {
           // Advance to the next An reg or revert to V0
           if (paramOfs)
@@ -1776,34 +2557,54 @@ void GenExpr0(void)
             GenWreg = B32POpRegV0;
           gotUnary = 0;
         }
-        paramOfs -= 4;
+        paramOfs -= SizeOfWord;
       }
       break;
 
     case ')':
+      if ((t = GenStructCopyKind(i)) != 0)
+      {
+        if (stack[i - 3][0] == tokNumInt || stack[i - 3][0] == tokNumUint)
+        {
+          // The size is known, copy inline instead of calling the function
+          if (maxCallDepth != 1)
+          {
+            GenPrintInstr2Operands(B32PInstrRead, 0,
+                                   B32POpIndRegSp, SizeOfWord,
+                                   B32POpRegA1, 0);
+            GenPrintInstr2Operands(B32PInstrRead, 0,
+                                   B32POpIndRegSp, 2 * SizeOfWord,
+                                   B32POpRegA2, 0);
+            GenGrowStack(-4 * SizeOfWord);
+          }
+          GenStructCopy(stack[i - 3][1], t == 2);
+          break;
+        }
+        GenStructCpyCalls++;
+      }
       GenLeaf = 0;
       if (maxCallDepth != 1)
       {
-        if (v >= 4)
+        if (v >= SizeOfWord)
           GenPrintInstr2Operands(B32PInstrRead, 0,
                                  B32POpIndRegSp, 0,
                                  B32POpRegA0, 0);
-        if (v >= 8)
+        if (v >= 2 * SizeOfWord)
           GenPrintInstr2Operands(B32PInstrRead, 0,
-                                 B32POpIndRegSp, 4,
+                                 B32POpIndRegSp, SizeOfWord,
                                  B32POpRegA1, 0);
-        if (v >= 12)
+        if (v >= 3 * SizeOfWord)
           GenPrintInstr2Operands(B32PInstrRead, 0,
-                                 B32POpIndRegSp, 8,
+                                 B32POpIndRegSp, 2 * SizeOfWord,
                                  B32POpRegA2, 0);
-        if (v >= 16)
+        if (v >= 4 * SizeOfWord)
           GenPrintInstr2Operands(B32PInstrRead, 0,
-                                 B32POpIndRegSp, 12,
+                                 B32POpIndRegSp, 3 * SizeOfWord,
                                  B32POpRegA3, 0);
       }
       else
       {
-        GenGrowStack(16);
+        GenGrowStack(4 * SizeOfWord);
       }
       if (stack[i - 1][0] == tokIdent)
       {
@@ -1828,8 +2629,8 @@ void GenExpr0(void)
                               B32POpConst, 0,
                               GenWreg, 0);
       }
-      if (v < 16)
-        v = 16;
+      if (v < 4 * SizeOfWord)
+        v = 4 * SizeOfWord;
       GenGrowStack(-v);
       break;
 
@@ -1864,13 +2665,14 @@ void GenExpr0(void)
     case '+':
     case '-':
     case '*':
+    case tokFpMul:
     case '&':
     case '^':
     case '|':
     case tokLShift:
     case tokRShift:
     case tokURShift:
-      if (stack[i - 1][0] == tokNumInt && tok != '*')
+      if (stack[i - 1][0] == tokNumInt && tok != '*' && tok != tokFpMul)
       {
         int instr = GenGetBinaryOperatorInstr(tok);
         GenPrintInstr3Operands(instr, 0,
@@ -1893,27 +2695,21 @@ void GenExpr0(void)
     case tokUDiv:
     case '%':
     case tokUMod:
+    case tokFpDiv:
+      if (stack[i - 1][0] == tokNumInt)
+      {
+        if (!GenDivPow2(tok, stack[i - 1][1]))
+        {
+          GenPrintInstr2Operands(B32PInstrLoad, 0,
+                                 B32POpConst, stack[i - 1][1],
+                                 TEMP_REG_B, 0);
+          GenDivide(tok, GenWreg, GenWreg, TEMP_REG_B);
+        }
+      }
+      else
       {
-        printf("DIVISION/MOD is not supported!\n");
-        /*
         GenPopReg();
-        if (tok == '/' || tok == '%')
-          GenPrintInstr3Operands(MipsInstrDiv, 0,
-                                 B32POpRegZero, 0,
-                                 GenLreg, 0,
-                                 GenRreg, 0);
-        else
-          GenPrintInstr3Operands(MipsInstrDivU, 0,
-                                 B32POpRegZero, 0,
-                                 GenLreg, 0,
-                                 GenRreg, 0);
-        if (tok == '%' || tok == tokUMod)
-          GenPrintInstr1Operand(MipsInstrMfHi, 0,
-                                GenWreg, 0);
-        else
-          GenPrintInstr1Operand(MipsInstrMfLo, 0,
-                                GenWreg, 0);
-        */
+        GenDivide(tok, GenWreg, GenLreg, GenRreg);
       }
       break;
 
@@ -2067,38 +2863,7 @@ void GenExpr0(void)
         else
           GenReadIdent(TEMP_REG_B, v, stack[i - 1][1]);
 
-        if (tok == tokAssignDiv || tok == tokAssignMod)
-        {
-          printf("DIVISION/MOD is not supported!\n");
-          /*
-          GenPrintInstr3Operands(MipsInstrDiv, 0,
-                                 B32POpRegZero, 0,
-                                 TEMP_REG_B, 0,
-                                 GenWreg, 0);*/
-        }
-        else
-        {
-          printf("DIVISION/MOD is not supported!\n");
-          /*
-          GenPrintInstr3Operands(MipsInstrDivU, 0,
-                                 B32POpRegZero, 0,
-                                 TEMP_REG_B, 0,
-                                 GenWreg, 0);*/
-        }
-        if (tok == tokAssignMod || tok == tokAssignUMod)
-        {
-          printf("DIVISION/MOD is not supported!\n");
-          /*
-          GenPrintInstr1Operand(MipsInstrMfHi, 0,
-                                GenWreg, 0);*/
-        }
-        else
-        {
-          printf("DIVISION/MOD is not supported!\n");
-          /*
-          GenPrintInstr1Operand(MipsInstrMfLo, 0,
-                                GenWreg, 0);*/
-        }
+        GenDivide(tok, GenWreg, TEMP_REG_B, GenWreg);
 
         if (stack[i - 1][0] == tokRevLocalOfs)
           GenWriteLocal(GenWreg, v, stack[i - 1][1]);
@@ -2130,38 +2895,7 @@ void GenExpr0(void)
         }
 
         GenReadIndirect(GenWreg, GenLreg, v); // destroys either GenLreg or GenRreg because GenWreg coincides with one of them
-        if (tok == tokAssignDiv || tok == tokAssignMod)
-        {
-          printf("DIVISION/MOD is not supported!\n");
-          /*
-          GenPrintInstr3Operands(MipsInstrDiv, 0,
-                                 B32POpRegZero, 0,
-                                 GenWreg, 0,
-                                 rsaved, 0);*/
-        }
-        else
-        {
-          printf("DIVISION/MOD is not supported!\n");
-          /*
-          GenPrintInstr3Operands(MipsInstrDivU, 0,
-                                 B32POpRegZero, 0,
-                                 GenWreg, 0,
-                                 rsaved, 0);*/
-        }
-        if (tok == tokAssignMod || tok == tokAssignUMod)
-        {
-          printf("DIVISION/MOD is not supported!\n");
-          /*
-          GenPrintInstr1Operand(MipsInstrMfHi, 0,
-                                GenWreg, 0);*/
-        }
-        else
-        {
-          printf("DIVISION/MOD is not supported!\n");
-          /*
-          GenPrintInstr1Operand(MipsInstrMfLo, 0,
-                                GenWreg, 0);*/
-        }
+        GenDivide(tok, GenWreg, GenWreg, rsaved);
         GenWriteIndirect(lsaved, GenWreg, v);
       }
       GenExtendRegIfNeeded(GenWreg, v);
@@ -2365,19 +3099,23 @@ void GenExpr(void)
 STATIC
 void GenFin(void)
 {
-  // No idea what this does (something with structs??), so I just literally converted it to B32P asm
-  if (StructCpyLabel)
+  // Function to copy structures/unions whose size isn't known to GenExpr0()
+  if (GenStructCpyCalls)
   {
     int lbl = LabelCnt++;
 
     puts2(CodeHeaderFooter[0]);
 
-    GenNumLabel(StructCpyLabel);
+    if (StructCpyLabel)
+      GenNumLabel(StructCpyLabel);
+    if (StructCpyWordLabel)
+      GenNumLabel(StructCpyWordLabel);
 
     //puts2(" move r2, r6\n" //r2 := r6
     //      " move r3, r6"); //r3 := r3
+    // r1 is used as the destination pointer instead of r3, which is callee-saved with -O
     puts2(" or r0 r6 r2\n"
-          " or r0 r6 r3");
+          " or r0 r6 r1");
 
 
     GenNumLabel(lbl);
@@ -2391,8 +3129,8 @@ void GenFin(void)
     puts2(" read 0 r5 r6\n"
           " add r5 1 r5\n"
           " sub r4 1 r4\n"
-          " write 0 r3 r6\n"
-          " add r3 1 r3");
+          " write 0 r1 r6\n"
+          " add r1 1 r1");
 
     //printf2(" bne r4, r0, "); GenPrintNumLabel(lbl); // if r4 != 0, jump to lbl
     printf2("beq r4 r0 2\n");
@@ -2405,6 +3143,21 @@ void GenFin(void)
     puts2(CodeHeaderFooter[1]);
   }
 
+  if (GenOptimize && verbose)
+    OptPrintStats();
+
+  // Modules without main() have no wrapper code
+  if (GenModule && !GenMainDefined)
+    return;
+  if (GenModule)
+  {
+    printf2(".globl Main\n"
+            ".globl Int\n");
+    if (compileOS)
+      printf2(".globl Syscall\n");
+    GenStartup();
+  }
+
   // Put all ending C specific wrapper code here
   if (compileUserBDOS)
   {
@@ -2419,7 +3172,9 @@ void GenFin(void)
       "; Therefore, it should return to that interrupt handler and not use reti\n"
       "\n"
       "Int:\n"
-      "\n"
+      "\n");
+    GenLoadGlobalPtr();
+    printf2(
       "    load32 0x7BFFFF r13     ; initialize user int stack address\n"
       "    load32 0 r14            ; initialize base pointer address\n"
       "    addr2reg Return_Interrupt r1 ; get address of return function\n"
@@ -2471,7 +3226,9 @@ void GenFin(void)
       "    push r13\n"
       "    push r14\n"
       "    push r15\n"
-      "\n"
+      "\n");
+    GenLoadGlobalPtr();
+    printf2(
       "    load32 0x7FFFFF r13     ; initialize (BDOS) int stack address\n"
       "    load32 0 r14            ; initialize base pointer address\n"
       "    addr2reg Return_Interrupt r1 ; get address of return function\n"
@@ -2515,7 +3272,9 @@ void GenFin(void)
       "; Because this is not called during an interrupt, we use a different stack\n"
       ";  located at the end of BDOS heap\n"
       "\n"
-      "Syscall:\n"
+      "Syscall:\n");
+    GenLoadGlobalPtr();
+    printf2(
       "    load32 0x3FFFFF r13     ; initialize syscall stack address\n"
       "    load32 0 r14            ; initialize base pointer address\n"
       "    addr2reg Return_Syscall r1 ; get address of return function\n"
@@ -2533,7 +3292,4 @@ void GenFin(void)
       "    halt        ; should not get here\n"
       );
   }
-
-  
-
 }
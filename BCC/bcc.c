@@ -219,6 +219,10 @@ int fsetpos(FILE*, fpos_t*);
 #define SYNTAX_STACK_MAX (4096+1024)
 #endif
 
+#ifndef IDENT_HASH_SIZE
+#define IDENT_HASH_SIZE      1024 // must be a power of 2
+#endif
+
 #ifndef MAX_FILE_NAME_LEN
 #define MAX_FILE_NAME_LEN    95
 #endif
@@ -353,6 +357,8 @@ int fsetpos(FILE*, fpos_t*);
 #define tokNumFloat   0x95
 #define tokNumCharWide 0x96
 #define tokLitStrWide 0x97
+#define tokFpMul      0x98
+#define tokFpDiv      0x99
 
 //#define FormatFlat      0
 #define FormatSegmented 1
@@ -644,8 +650,16 @@ void GenLabel(char* Label, int Static);
 STATIC
 void GenNumLabel(int Label);
 STATIC
+void GenDebugFxn(char* name);
+STATIC
+void GenDebugLine(void);
+STATIC
 void GenZeroData(unsigned Size, int bss);
 STATIC
+int GenGlobalPtrFits(unsigned size);
+STATIC
+void GenGlobalDataAdded(int label, unsigned size);
+STATIC
 void GenIntData(int Size, int Val);
 STATIC
 void GenStartAsciiString(void);
@@ -660,6 +674,8 @@ STATIC
 void GenJumpIfNotZero(int Label);
 STATIC
 void GenJumpIfEqual(int val, int Label);
+STATIC
+int GenSwitch(int (*cases)[2], int cnt, int defLabel);
 
 STATIC
 void GenFxnProlog(void);
@@ -764,6 +780,8 @@ int FindTypedef(char* s);
 #endif
 STATIC
 int GetDeclSize(int SyntaxPtr, int SizeForDeref);
+STATIC
+int StructCpyIdent(int SyntaxPtr);
 
 STATIC
 int ParseExpr(int tok, int* GotUnary, int* ExprTypeSynPtr, int* ConstExpr, int* ConstVal, int option, int option2);
@@ -805,6 +823,9 @@ int CharQueueLen = 0;
 */
 char MacroTable[MAX_MACRO_TABLE_LEN];
 int MacroTableLen = 0;
+// Hash chains of the macro table entries (entry offset + 1, 0 ends a chain)
+int MacroHashTable[IDENT_HASH_SIZE];
+int MacroHashNext[MAX_MACRO_TABLE_LEN];
 #endif
 
 /*
@@ -815,6 +836,13 @@ int MacroTableLen = 0;
 char IdentTable[MAX_IDENT_TABLE_LEN];
 int IdentTableLen = 0;
 int DummyIdent; // corresponds to empty string
+/*
+  Hash chains of the identifier table entries (entry offset + 1, 0 ends a chain).
+  New identifiers are added at the head of their chain and have the greatest
+  offsets, so the chains are sorted by decreasing offset.
+*/
+int IdentHashTable[IDENT_HASH_SIZE];
+int IdentHashNext[MAX_IDENT_TABLE_LEN];
 
 #ifndef MAX_GOTO_LABELS
 #define MAX_GOTO_LABELS 16
@@ -888,6 +916,7 @@ char** CurHeaderFooter;
 
 int CharIsSigned = 1;
 int SizeOfWord = 2; // in chars (char can be a multiple of octets); ints and pointers are of word size
+int CharBits = 8; // bits per char, the smallest addressable unit (32 on word-addressed targets)
 int SizeOfWideChar = 2; // in chars/bytes, 2 or 4
 int WideCharIsSigned = 0; // 0 or 1
 int WideCharType1;
@@ -896,6 +925,7 @@ int WideCharType2; // (un)signed counterpart of WideCharType1
 // TBD??? implement a function to allocate N labels with overflow checks
 int LabelCnt = 1; // label counter for jumps
 int StructCpyLabel = 0; // label of the function to copy structures/unions
+int StructCpyWordLabel = 0; // same, for structures/unions made of whole words only
 int StructPushLabel = 0; // label of the function to push structures/unions onto the stack
 
 // call stack (from higher to lower addresses):
@@ -921,6 +951,7 @@ char* CurFxnName = NULL;
 int CurFxnNameLabel = 0;
 #endif
 int IsMain; // if inside main()
+int CurFxnInline; // if the function is declared inline
 
 int ParseLevel = 0; // Parse level/scope (file:0, fxn:1+)
 int ParamLevel = 0; // 1+ if parsing params, 0 otherwise
@@ -934,11 +965,11 @@ int SyntaxStackCnt;
 STATIC
 unsigned truncUint(unsigned n)
 {
-  // Truncate n to SizeOfWord * 8 bits
-  if (SizeOfWord == 2)
+  // Truncate n to SizeOfWord * CharBits bits
+  if (SizeOfWord * CharBits == 16)
     n &= ~(~0u << 8 << 8);
 #ifdef CAN_COMPILE_32BIT
-  else if (SizeOfWord == 4)
+  else if (SizeOfWord * CharBits == 32)
     n &= ~(~0u << 8 << 12 << 12);
 #endif
   return n;
@@ -947,15 +978,15 @@ unsigned truncUint(unsigned n)
 STATIC
 int truncInt(int n)
 {
-  // Truncate n to SizeOfWord * 8 bits and then sign-extend it
+  // Truncate n to SizeOfWord * CharBits bits and then sign-extend it
   unsigned un = n;
-  if (SizeOfWord == 2)
+  if (SizeOfWord * CharBits == 16)
   {
     un &= ~(~0u << 8 << 8);
     un |= (((un >> 8 >> 7) & 1) * ~0u) << 8 << 8;
   }
 #ifdef CAN_COMPILE_32BIT
-  else if (SizeOfWord == 4)
+  else if (SizeOfWord * CharBits == 32)
   {
     un &= ~(~0u << 8 << 12 << 12);
     un |= (((un >> 8 >> 12 >> 11) & 1) * ~0u) << 8 << 12 << 12;
@@ -966,49 +997,77 @@ int truncInt(int n)
 
 // prep.c code
 
+STATIC
+unsigned HashIdent(char* name)
+{
+  unsigned h = 0;
+  while (*name)
+    h = h * 31 + (unsigned char)*name++;
+  return h & (IDENT_HASH_SIZE - 1);
+}
+
 #ifndef NO_PREPROCESSOR
+// Finds the macro table entry of the macro, returns the offset of its first char
 STATIC
-int FindMacro(char* name)
+int FindMacroEntry(char* name)
 {
-  int i;
+  int i, found = -1;
 
-  for (i = 0; i < MacroTableLen; )
-  {
-    if (!strcmp(MacroTable + i + 1, name))
-      return i + 1 + MacroTable[i];
+  // The oldest definition is at the end of the chain
+  for (i = MacroHashTable[HashIdent(name)]; i; i = MacroHashNext[i - 1])
+    if (!strcmp(MacroTable + i, name))
+      found = i - 1;
 
-    i = i + 1 + MacroTable[i]; // skip id
-    i = i + 1 + MacroTable[i]; // skip ex
-  }
+  return found;
+}
+
+STATIC
+int FindMacro(char* name)
+{
+  int i = FindMacroEntry(name);
+
+  if (i >= 0)
+    return i + 1 + MacroTable[i];
 
   return -1;
 }
 
+STATIC
+void HashMacro(int i)
+{
+  unsigned h = HashIdent(MacroTable + i + 1);
+  MacroHashNext[i] = MacroHashTable[h];
+  MacroHashTable[h] = i + 1;
+}
+
 STATIC
 int UndefineMacro(char* name)
 {
-  int i;
+  int i = FindMacroEntry(name);
+  int len;
 
-  for (i = 0; i < MacroTableLen; )
-  {
-    if (!strcmp(MacroTable + i + 1, name))
-    {
-      int len = 1 + MacroTable[i]; // id part len
-      len = len + 1 + MacroTable[i + len]; // + ex part len
+  if (i < 0)
+    return 0;
 
-      memmove(MacroTable + i,
-              MacroTable + i + len,
-              MacroTableLen - i - len);
-      MacroTableLen -= len;
+  len = 1 + MacroTable[i]; // id part len
+  len = len + 1 + MacroTable[i + len]; // + ex part len
 
-      return 1;
-    }
+  memmove(MacroTable + i,
+          MacroTable + i + len,
+          MacroTableLen - i - len);
+  MacroTableLen -= len;
 
+  // The following entries have moved, rebuild the hash chains
+  for (i = 0; i < IDENT_HASH_SIZE; i++)
+    MacroHashTable[i] = 0;
+  for (i = 0; i < MacroTableLen; )
+  {
+    HashMacro(i);
     i = i + 1 + MacroTable[i]; // skip id
     i = i + 1 + MacroTable[i]; // skip ex
   }
 
-  return 0;
+  return 1;
 }
 
 STATIC
@@ -1022,9 +1081,10 @@ void AddMacroIdent(char* name)
   if (MAX_MACRO_TABLE_LEN - MacroTableLen < l + 3)
     error("Macro table exhausted\n");
 
-  MacroTable[MacroTableLen++] = l + 1; // idlen
-  strcpy(MacroTable + MacroTableLen, name);
-  MacroTableLen += l + 1;
+  MacroTable[MacroTableLen] = l + 1; // idlen
+  strcpy(MacroTable + MacroTableLen + 1, name);
+  HashMacro(MacroTableLen);
+  MacroTableLen += l + 2;
 
   MacroTable[MacroTableLen] = 0; // exlen
 }
@@ -1090,15 +1150,20 @@ STATIC
 int FindIdent(char* name)
 {
   int i;
-  for (i = IdentTableLen; i > 0; )
-  {
-    i -= 1 + IdentTable[i - 1];
-    if (!strcmp(IdentTable + i, name))
-      return i;
-  }
+  for (i = IdentHashTable[HashIdent(name)]; i; i = IdentHashNext[i - 1])
+    if (!strcmp(IdentTable + i - 1, name))
+      return i - 1;
   return -1;
 }
 
+STATIC
+void HashIdentEntry(int i)
+{
+  unsigned h = HashIdent(IdentTable + i);
+  IdentHashNext[i] = IdentHashTable[h];
+  IdentHashTable[h] = i + 1;
+}
+
 STATIC
 int AddIdent(char* name)
 {
@@ -1117,6 +1182,7 @@ int AddIdent(char* name)
     error("Identifier table exhausted\n");
 
   strcpy(IdentTable + IdentTableLen, name);
+  HashIdentEntry(i);
   IdentTableLen += len + 1;
   IdentTable[IdentTableLen++] = len + 1;
 
@@ -1155,11 +1221,23 @@ int AddGotoLabel(char* name, int label)
   return gotoLabels[gotoLabCnt++][1];
 }
 
+// Removes the identifiers added after the table was len chars long
 STATIC
-void UndoNonLabelIdents(int len)
+void UndoIdents(int len)
 {
   int i;
   IdentTableLen = len;
+  // The chains are sorted by decreasing offset, drop their heads
+  for (i = 0; i < IDENT_HASH_SIZE; i++)
+    while (IdentHashTable[i] > len)
+      IdentHashTable[i] = IdentHashNext[IdentHashTable[i] - 1];
+}
+
+STATIC
+void UndoNonLabelIdents(int len)
+{
+  int i;
+  UndoIdents(len);
   for (i = 0; i < gotoLabCnt; i++)
     if (gotoLabels[i][0] >= len)
     {
@@ -1167,6 +1245,7 @@ void UndoNonLabelIdents(int len)
       char* pto = IdentTable + IdentTableLen;
       int l = strlen(pfrom) + 2;
       memmove(pto, pfrom, l);
+      HashIdentEntry(IdentTableLen);
       IdentTableLen += l;
       gotoLabels[i][0] = pto - IdentTable;
     }
@@ -1206,7 +1285,7 @@ char* rws[] =
   "const", "double", "enum", "float", "goto", "inline", "long",
   "register", "restrict", "short", "struct", "typedef", "union",
   "volatile", "_Bool", "_Complex", "_Imaginary",
-  "__interrupt"
+  "__interrupt", "__builtin_fpmul", "__builtin_fpdiv"
 };
 
 unsigned char rwtk[] =
@@ -1217,17 +1296,34 @@ unsigned char rwtk[] =
   tokConst, tokDouble, tokEnum, tokFloat, tokGoto, tokInline, tokLong,
   tokRegister, tokRestrict, tokShort, tokStruct, tokTypedef, tokUnion,
   tokVolatile, tok_Bool, tok_Complex, tok_Imagin,
-  tokIntr
+  tokIntr, tokFpMul, tokFpDiv
 };
 
+// Hash chains of the reserved words (index + 1, 0 ends a chain)
+unsigned char RwHashTable[IDENT_HASH_SIZE];
+unsigned char RwHashNext[sizeof rws / sizeof rws[0]];
+
 STATIC
-int GetTokenByWord(char* word)
+void HashReservedWords(void)
 {
   unsigned i;
 
   for (i = 0; i < division(sizeof rws, sizeof rws[0]); i++)
-    if (!strcmp(rws[i], word))
-      return rwtk[i];
+  {
+    unsigned h = HashIdent(rws[i]);
+    RwHashNext[i] = RwHashTable[h];
+    RwHashTable[h] = i + 1;
+  }
+}
+
+STATIC
+int GetTokenByWord(char* word)
+{
+  unsigned i;
+
+  for (i = RwHashTable[HashIdent(word)]; i; i = RwHashNext[i - 1])
+    if (!strcmp(rws[i - 1], word))
+      return rwtk[i - 1];
 
   return tokIdent;
 }
@@ -1822,6 +1918,48 @@ char* FpFxnName[] =
 };
 #endif
 
+#ifdef NO_FP
+#ifdef CAN_COMPILE_32BIT
+// Without floating point, a constant with a fractional part is a 16.16
+// fixed point int (e.g. 1.5 is 0x18000), rounded to the nearest 1/65536.
+// Reads the fractional part, whole is the integral part.
+STATIC
+unsigned GetFixedPoint(unsigned whole)
+{
+  char* p = CharQueue;
+  char digits[12];
+  int cnt = 0, bit, i;
+  unsigned fract = 0;
+
+  ShiftCharN(1); // '.'
+  while (isdigit(*p & 0xFFu))
+  {
+    if (cnt < (int)sizeof digits)
+      digits[cnt++] = *p - '0';
+    ShiftCharN(1);
+  }
+  if (PrepDontSkipTokens && whole > 0x7FFF)
+    error("Constant too big for 16.16 fixed point\n");
+
+  // Double the decimal fraction, the digit carried out of it is the next bit.
+  // One bit more than needed, for rounding.
+  for (bit = 0; bit < 17; bit++)
+  {
+    int carry = 0;
+    for (i = cnt - 1; i >= 0; i--)
+    {
+      int d = digits[i] * 2 + carry;
+      carry = d >= 10;
+      digits[i] = d - carry * 10;
+    }
+    fract = fract * 2 + carry;
+  }
+
+  return (whole << 16) + ((fract + 1) >> 1);
+}
+#endif
+#endif
+
 STATIC
 int GetNumber(void)
 {
@@ -1975,6 +2113,7 @@ int GetNumber(void)
   {
     // handle decimal and octal integers
     int base = leadingZero ? 8 : 10;
+    unsigned whole = 0; // the digits read as decimal, for fixed point constants
     type = leadingZero ? 'o' : 'd';
     while ((ch = *p) >= '0' && ch < base + '0')
     {
@@ -1982,8 +2121,17 @@ int GetNumber(void)
       if (PrepDontSkipTokens && (n * base + ch < n * base)) //n * base / base != n || 
         error(eTooBig);
       n = n * base + ch;
+      if (whole <= 0x7FFF)
+        whole = whole * 10 + ch;
       ShiftCharN(1);
     }
+#ifdef CAN_COMPILE_32BIT
+    if (*p == '.' && SizeOfWord * CharBits == 32)
+    {
+      type = 'd';
+      n = GetFixedPoint(whole);
+    }
+#endif
   }
 #endif
 
@@ -2033,13 +2181,13 @@ int GetNumber(void)
 
   // Ensure the constant fits into 16(32) bits
   if (
-      (SizeOfWord == 2 && n >> 8 >> 8) // equiv. to SizeOfWord == 2 && n > 0xFFFF
+      (SizeOfWord * CharBits == 16 && n >> 8 >> 8) // equiv. to 16-bit int && n > 0xFFFF
 #ifdef CAN_COMPILE_32BIT
-      || (SizeOfWord == 2 && lSuffix) // long (which must have at least 32 bits) isn't supported in 16-bit models
-      || (SizeOfWord == 4 && n >> 8 >> 12 >> 12) // equiv. to SizeOfWord == 4 && n > 0xFFFFFFFF
+      || (SizeOfWord * CharBits == 16 && lSuffix) // long (which must have at least 32 bits) isn't supported in 16-bit models
+      || (SizeOfWord * CharBits == 32 && n >> 8 >> 12 >> 12) // equiv. to 32-bit int && n > 0xFFFFFFFF
 #endif
      )
-    error("Constant too big for %d-bit type\n", SizeOfWord * 8);
+    error("Constant too big for %d-bit type\n", SizeOfWord * CharBits);
 
   TokenValueInt = (int)n;
 
@@ -2047,9 +2195,9 @@ int GetNumber(void)
   // fitting into 15(31) out of 16(32) bits are signed ints
   if (!uSuffix &&
       (
-       (SizeOfWord == 2 && !(n >> 15)) // equiv. to SizeOfWord == 2 && n <= 0x7FFF
+       (SizeOfWord * CharBits == 16 && !(n >> 15)) // equiv. to 16-bit int && n <= 0x7FFF
 #ifdef CAN_COMPILE_32BIT
-       || (SizeOfWord == 4 && !(n >> 8 >> 12 >> 11)) // equiv. to SizeOfWord == 4 && n <= 0x7FFFFFFF
+       || (SizeOfWord * CharBits == 32 && !(n >> 8 >> 12 >> 11)) // equiv. to 32-bit int && n <= 0x7FFFFFFF
 #endif
       )
      )
@@ -2060,7 +2208,7 @@ int GetNumber(void)
   // into an int since currently there's no next bigger signed type
   // (e.g. long) to use instead of int.
   if (!uSuffix && type == 'd')
-    error("Constant too big for %d-bit signed type\n", SizeOfWord * 8);
+    error("Constant too big for %d-bit signed type\n", SizeOfWord * CharBits);
 
   return tokNumUint;
 }
@@ -2120,8 +2268,8 @@ int GetTokenInner(void)
     ShiftCharN(1); return ch;
   case '.':
     if (p[1] == '.' && p[2] == '.') { ShiftCharN(3); return tokEllipsis; }
-#ifndef NO_FP
-    if (isdigit(p[1] & 0xFFu)) { return GetNumber(); }
+#if !defined(NO_FP) || defined(CAN_COMPILE_32BIT)
+    if (isdigit(p[1] & 0xFFu) && SizeOfWord * CharBits == 32) { return GetNumber(); }
 #endif
     ShiftCharN(1); return ch;
   case '*':
@@ -2193,7 +2341,7 @@ int GetTokenInner(void)
       {
         TokenValueInt = v;
 #ifdef CAN_COMPILE_32BIT
-        TokenValueInt -= (SizeOfWord == 2 && TokenValueInt >= 0x8000) * 0x10000;
+        TokenValueInt -= (SizeOfWord * CharBits == 16 && TokenValueInt >= 0x8000) * 0x10000;
 #endif
       }
       return tokNumInt;
@@ -3025,6 +3173,22 @@ int exprUnary(int tok, int* gotUnary, int commaSeparator, int argOfSizeOf)
       *gotUnary = 1;
       tok = GetToken();
     }
+    else if (tok == tokFpMul || tok == tokFpDiv)
+    {
+      // __builtin_fpmul(a, b) and __builtin_fpdiv(a, b) are binary operators
+      // on 16.16 fixed point ints
+      int op = tok;
+      if ((tok = GetToken()) != '(')
+        errorUnexpectedToken(tok);
+      tok = expr(GetToken(), gotUnary, 1);
+      if (!*gotUnary || tok != ',')
+        errorUnexpectedToken(tok);
+      tok = expr(GetToken(), gotUnary, 1);
+      if (!*gotUnary || tok != ')')
+        errorUnexpectedToken(tok);
+      push(op);
+      tok = GetToken();
+    }
     else if (tok == '(')
     {
       tok = GetToken();
@@ -3599,12 +3763,12 @@ void shiftCountCheck(int *psr, int idx, int ExprTypeSynPtr)
   // the number of bits in int
   if ((SyntaxStack0[ExprTypeSynPtr] != tokUnsigned && sr < 0) ||
       (unsigned)sr >= CHAR_BIT * sizeof(int) ||
-      (unsigned)sr >= 8u * SizeOfWord)
+      (unsigned)sr >= (unsigned)CharBits * SizeOfWord)
   {
     //error("exprval(): Invalid shift count\n");
     warning("Shift count out of range\n");
     // truncate the count, so the assembler doesn't get an invalid count
-    sr &= SizeOfWord * 8 - 1;
+    sr &= SizeOfWord * CharBits - 1;
     *psr = sr;
     stack[idx][1] = sr;
   }
@@ -3671,6 +3835,67 @@ int divCheckAndCalc(int tok, int* psl, int sr, int Unsigned, int ConstExpr[2])
   return !div0;
 }
 
+// Bits 47 through 16 of the 64-bit product of two 16.16 fixed point ints,
+// the same as the multfp instruction
+STATIC
+int fpmulCalc(int sl, int sr)
+{
+  unsigned a = truncUint(sl), b = truncUint(sr);
+  unsigned al = a & 0xFFFF, ah = a >> 16, bl = b & 0xFFFF, bh = b >> 16;
+  unsigned r = (ah * bh << 16) + ah * bl + al * bh + (al * bl >> 16);
+
+  // the product of the unsigned values is too big by b << 32 if a is negative
+  // and by a << 32 if b is negative
+  if (truncInt(sl) < 0)
+    r -= b << 16;
+  if (truncInt(sr) < 0)
+    r -= a << 16;
+  return (int)truncUint(r);
+}
+
+// Divides two 16.16 fixed point ints like the hardware divider does:
+// the quotient of the magnitudes is rounded to the nearest, ties to even
+STATIC
+int fpdivCalc(int* psl, int sr, int ConstExpr[2])
+{
+  unsigned a, b, q = 0, r = 0;
+  int sl = truncInt(*psl), i;
+
+  sr = truncInt(sr);
+  if (!ConstExpr[1] || (sr && !ConstExpr[0]))
+    return 1;
+
+  a = (sl < 0) ? 0u - truncUint(sl) : truncUint(sl);
+  b = (sr < 0) ? 0u - truncUint(sr) : truncUint(sr);
+  if (!b || sl == INT_MIN || sr == INT_MIN || division(a, b) > 0x7FFF)
+  {
+    warning("Division by 0 or division overflow\n");
+    return 0;
+  }
+
+  // (a << 16) / b, one bit of the 48-bit dividend at a time
+  for (i = 47; i >= 0; i--)
+  {
+    r = r * 2 + ((i >= 16) ? (a >> (i - 16)) & 1 : 0);
+    q *= 2;
+    if (r >= b)
+    {
+      r -= b;
+      q++;
+    }
+  }
+  if (r * 2 > b || (r * 2 == b && (q & 1)))
+    q++;
+  if (q > 0x7FFFFFFF)
+  {
+    warning("Division by 0 or division overflow\n");
+    return 0;
+  }
+
+  *psl = ((sl < 0) != (sr < 0)) ? (int)(0u - q) : (int)q;
+  return 1;
+}
+
 STATIC
 void promoteType(int* ExprTypeSynPtr, int* TheOtherExprTypeSynPtr)
 {
@@ -4011,7 +4236,8 @@ int exprval(int* idx, int* ExprTypeSynPtr, int* ConstExpr)
         // insertion of tokUChar, tokSChar and tokUnaryPlus transforms
         // lvalues (values formed by dereferences) into rvalues
         // (by hiding the dereferences), just as casts should do
-        switch (castSize)
+        // (in word-addressed mode a char is as wide as an int, so casts to it are word-sized)
+        switch ((castSize == SizeOfWord) ? 0 : castSize)
         {
         case 1:
           // cast to unsigned char
@@ -4552,9 +4778,7 @@ int exprval(int* idx, int* ExprTypeSynPtr, int* ConstExpr)
 
         ins(oldIdxRight + 2 - (oldSpRight - sp), ',');
 
-        if (!StructCpyLabel)
-          StructCpyLabel = LabelCnt++;
-        ins2(oldIdxRight + 2 - (oldSpRight - sp), tokIdent, AddNumericIdent(StructCpyLabel));
+        ins2(oldIdxRight + 2 - (oldSpRight - sp), tokIdent, StructCpyIdent(RightExprTypeSynPtr));
 
         ins2(oldIdxRight + 2 - (oldSpRight - sp), ')', SizeOfWord * 3);
         ins2(oldIdxRight + 2 - (oldSpRight - sp), tokUnaryStar, 0); // use 0 deref size to drop meaningless dereferences
@@ -4657,6 +4881,8 @@ int exprval(int* idx, int* ExprTypeSynPtr, int* ConstExpr)
   case '*':
   case '/':
   case '%':
+  case tokFpMul:
+  case tokFpDiv:
   case tokLShift:
   case tokRShift:
   case '&':
@@ -4787,6 +5013,13 @@ int exprval(int* idx, int* ExprTypeSynPtr, int* ConstExpr)
           sl = (int)((unsigned)sl * sr);
           break;
 
+        case tokFpMul:
+          sl = fpmulCalc(sl, sr);
+          break;
+        case tokFpDiv:
+          *ConstExpr &= fpdivCalc(&sl, sr, constExpr);
+          break;
+
         case tokLShift:
         case tokRShift:
           if (constExpr[1])
@@ -4817,7 +5050,7 @@ int exprval(int* idx, int* ExprTypeSynPtr, int* ConstExpr)
                 // don't depend on the compiler's implementation, do it "manually"
                 sl = truncInt(sl);
                 sl = (int)((truncUint(sl) >> sr) |
-                           ((sl < 0) * (~0u << (8 * SizeOfWord - sr))));
+                           ((sl < 0) * (~0u << (CharBits * SizeOfWord - sr))));
               }
             }
           }
@@ -6401,7 +6634,7 @@ int TokenStartsDeclaration(int t, int params)
          t == tokEnum ||
          (t == tokIdent && FindTypedef(TokenIdentName) >= 0) ||
 #endif
-         (!params && (t == tokExtern ||
+         (!params && (t == tokExtern || t == tokInline ||
 #ifndef NO_TYPEDEF_ENUM
                       t == tokTypedef ||
 #endif
@@ -6461,18 +6694,20 @@ STATIC
 int FindSymbol(char* s)
 {
   int i;
+  // Identifiers are unique in IdentTable[], so instead of doing strcmp()
+  // look for the index into IdentTable[] found with the hash table
+  int ident = FindIdent(s);
 
   // TBD!!! return declaration scope number so
   // redeclarations can be reported if occur in the same scope.
 
-  // TBD??? Also, I could first use FindIdent() and then just look for the
-  // index into IdentTable[] instead of doing strcmp()
+  if (ident < 0)
+    return -1;
 
   for (i = SyntaxStackCnt - 1; i >= 0; i--)
   {
     int t = SyntaxStack0[i];
-    if (t == tokIdent &&
-        !strcmp(IdentTable + SyntaxStack1[i], s))
+    if (t == tokIdent && SyntaxStack1[i] == ident)
     {
       return i;
     }
@@ -6611,7 +6846,7 @@ int GetDeclSize(int SyntaxPtr, int SizeForDeref)
       break;
     case tokChar:
     case tokSChar:
-      if (!arr && ((tok == tokSChar) || CharIsSigned) && SizeForDeref)
+      if (!arr && ((tok == tokSChar) || CharIsSigned) && SizeForDeref && SizeOfWord != 1)
         return -1; // 1 byte, needing sign extension when converted to int/unsigned int
       // fallthrough
     case tokUChar:
@@ -6748,6 +6983,85 @@ int GetDeclAlignment(int SyntaxPtr)
   return 0;
 }
 
+// Tells if every scalar in the type takes a whole word (no chars or shorts),
+// so that only every SizeOfWord'th address of it holds data
+STATIC
+int GetDeclWordOnly(int SyntaxPtr)
+{
+  int i;
+
+  if (SyntaxPtr < 0) // pointer?
+    return 1;
+
+  for (i = SyntaxPtr; i < SyntaxStackCnt; i++)
+  {
+    int tok = SyntaxStack0[i];
+    switch (tok)
+    {
+    case tokIdent: // skip leading identifiers, if any
+    case tokLocalOfs: // skip local var offset, too
+      break;
+    case tokChar:
+    case tokSChar:
+    case tokUChar:
+#ifdef CAN_COMPILE_32BIT
+    case tokShort:
+    case tokUShort:
+#endif
+      return 0;
+    case tokInt:
+    case tokUnsigned:
+#ifndef NO_FP
+    case tokFloat:
+#endif
+    case '*':
+    case '(':
+      return 1;
+    case '[':
+      i += 2;
+      break;
+    case tokStructPtr:
+      // follow the "type pointer"
+      i = SyntaxStack1[i] - 1;
+      break;
+    case tokStruct:
+    case tokUnion:
+      {
+        int c = 1;
+        // step inside the {} body of the struct/union and check every member
+        for (i += 5; c; i++)
+        {
+          int t = SyntaxStack0[i];
+          c += (t == '(') - (t == ')') + (t == '{') - (t == '}');
+          if (c == 1 && t == tokMemberIdent && !GetDeclWordOnly(i + 2))
+            return 0;
+        }
+      }
+      return 1;
+    default:
+      return 0;
+    }
+  }
+
+  return 0;
+}
+
+// Returns the identifier of the function to copy structures/unions of the type,
+// the backend may copy them inline instead
+STATIC
+int StructCpyIdent(int SyntaxPtr)
+{
+  if (GetDeclWordOnly(SyntaxPtr))
+  {
+    if (!StructCpyWordLabel)
+      StructCpyWordLabel = LabelCnt++;
+    return AddNumericIdent(StructCpyWordLabel);
+  }
+  if (!StructCpyLabel)
+    StructCpyLabel = LabelCnt++;
+  return AddNumericIdent(StructCpyLabel);
+}
+
 #ifndef NO_ANNOTATIONS
 STATIC
 void DumpDecl(int SyntaxPtr, int IsParam)
@@ -6929,7 +7243,7 @@ int ParseArrayDimension(int AllowEmptyDimension)
   oldesp = sp;
   undoIdents = IdentTableLen;
   tok = ParseExpr(tok, &gotUnary, &synPtr, &constExpr, &exprVal, 0, 0);
-  IdentTableLen = undoIdents; // remove all temporary identifier names from e.g. "sizeof"
+  UndoIdents(undoIdents); // remove all temporary identifier names from e.g. "sizeof"
   SyntaxStackCnt = oldssp; // undo any temporary declarations from e.g. "sizeof" in the expression
   sp = oldesp;
 
@@ -7166,7 +7480,7 @@ lcont:
 
             tok = ParseExpr(GetToken(), &gotUnary, &synPtr, &constExpr, &val, ',', 0);
 
-            IdentTableLen = undoIdents; // remove all temporary identifier names from e.g. "sizeof"
+            UndoIdents(undoIdents); // remove all temporary identifier names from e.g. "sizeof"
             SyntaxStackCnt = oldssp; // undo any temporary declarations from e.g. "sizeof" in the expression
             sp = oldesp;
 
@@ -7337,10 +7651,10 @@ lcont:
     *base = tokUnsigned;
 #endif
 
-  if (SizeOfWord == 2)
+  if (SizeOfWord <= 2)
   {
     // to simplify matters, treat short and unsigned short as aliases for int and unsigned int
-    // in 16-bit mode
+    // in 16-bit mode and in word-addressed mode (where an int is a single char)
     if (*base == tokShort)
       *base = tokInt;
     if (*base == tokUShort)
@@ -7581,7 +7895,7 @@ int InitVar(int synPtr, int tok)
   if (!strchr(",;", tok))
     errorUnexpectedToken(tok);
 
-  IdentTableLen = undoIdents; // remove all temporary identifier names from e.g. "sizeof" or "str"
+  UndoIdents(undoIdents); // remove all temporary identifier names from e.g. "sizeof" or "str"
 
   return tok;
 }
@@ -7683,7 +7997,7 @@ int InitScalar(int synPtr, int tok)
     //error("ParseDecl(): cannot initialize a global variable with a non-constant expression\n");
     errorNotConst();
 
-  IdentTableLen = undoIdents; // remove all temporary identifier names from e.g. "sizeof" or "str"
+  UndoIdents(undoIdents); // remove all temporary identifier names from e.g. "sizeof" or "str"
   SyntaxStackCnt = oldssp; // undo any temporary declarations from e.g. "sizeof" or "str" in the expression
   return tok;
 }
@@ -8153,14 +8467,27 @@ int ParseDecl(int tok, unsigned structInfo[4], int cast, int label)
 {
   int base[2];
   int lastSyntaxPtr;
-  int external = tok == tokExtern;
-  int Static = tok == tokStatic;
+  int external, Static;
+  int Inline = 0;
 #ifndef NO_TYPEDEF_ENUM
-  int typeDef = tok == tokTypedef;
+  int typeDef;
 #else
   (void)label;
 #endif
 
+  // inline is only a hint for the function inliner of -O and may come before
+  // or after the storage class
+  while (tok == tokInline)
+  {
+    Inline = 1;
+    tok = GetToken();
+  }
+  external = tok == tokExtern;
+  Static = tok == tokStatic;
+#ifndef NO_TYPEDEF_ENUM
+  typeDef = tok == tokTypedef;
+#endif
+
   if (external |
 #ifndef NO_TYPEDEF_ENUM
       typeDef |
@@ -8168,6 +8495,11 @@ int ParseDecl(int tok, unsigned structInfo[4], int cast, int label)
       Static)
   {
     tok = GetToken();
+    while (tok == tokInline)
+    {
+      Inline = 1;
+      tok = GetToken();
+    }
     if (!TokenStartsDeclaration(tok, 1))
       //error("ParseDecl(): unexpected token %s\n", GetTokenName(tok));
       // Implicit int (as in "extern x; static y;") isn't supported
@@ -8466,6 +8798,11 @@ int ParseDecl(int tok, unsigned structInfo[4], int cast, int label)
         int sz = GetDeclSize(lastSyntaxPtr, 0);
         int initLabel = 0;
         int bss = (!hasInit) & UseBss;
+        int fileScope = isGlobal && !ParseLevel;
+
+        // small variables addressed with --gp must be in .data
+        if (fileScope && GenGlobalPtrFits(sz))
+          bss = 0;
 
 #ifndef NO_ANNOTATIONS
         if (isGlobal)
@@ -8527,6 +8864,9 @@ int ParseDecl(int tok, unsigned structInfo[4], int cast, int label)
           if (oldHeaderFooter)
             puts2(oldHeaderFooter[0]);
           CurHeaderFooter = oldHeaderFooter;
+
+          if (!bss)
+            GenGlobalDataAdded(fileScope ? SyntaxStack1[lastSyntaxPtr] : -1, sz);
         }
 
         if (isLocal)
@@ -8534,6 +8874,9 @@ int ParseDecl(int tok, unsigned structInfo[4], int cast, int label)
           // Now that the size of the local is certainly known,
           // update its offset in the offset token
           SyntaxStack1[lastSyntaxPtr + 1] = AllocLocal(sz);
+          GenLocalVar(SyntaxStack1[lastSyntaxPtr + 1], sz,
+                      SyntaxStack0[lastSyntaxPtr + 2] == '[' ||
+                      SyntaxStack0[lastSyntaxPtr + 2] == tokStructPtr);
 
 #ifndef NO_ANNOTATIONS
           DumpDecl(lastSyntaxPtr, 0);
@@ -8546,9 +8889,6 @@ int ParseDecl(int tok, unsigned structInfo[4], int cast, int label)
 #ifndef NO_ANNOTATIONS
           GenStartCommentLine(); printf2("=\n");
 #endif
-          if (!StructCpyLabel)
-            StructCpyLabel = LabelCnt++;
-
           sp = 0;
 
           push2('(', SizeOfWord * 3);
@@ -8558,7 +8898,7 @@ int ParseDecl(int tok, unsigned structInfo[4], int cast, int label)
           push(',');
           push2(tokNumUint, sz);
           push(',');
-          push2(tokIdent, AddNumericIdent(StructCpyLabel));
+          push2(tokIdent, StructCpyIdent(lastSyntaxPtr));
           push2(')', SizeOfWord * 3);
 
           GenExpr();
@@ -8619,6 +8959,7 @@ int ParseDecl(int tok, unsigned structInfo[4], int cast, int label)
 
         CurFxnName = IdentTable + SyntaxStack1[lastSyntaxPtr];
         IsMain = !strcmp(CurFxnName, "main");
+        CurFxnInline = Inline;
 
         gotoLabCnt = 0;
 
@@ -8640,6 +8981,8 @@ int ParseDecl(int tok, unsigned structInfo[4], int cast, int label)
         puts2(CurHeaderFooter[0]);
 
         GenLabel(CurFxnName, Static);
+        GenDebugFxn(CurFxnName);
+        GenDebugLine();
 
 #ifndef MIPS
 #ifdef CAN_COMPILE_32BIT
@@ -8686,6 +9029,7 @@ int ParseDecl(int tok, unsigned structInfo[4], int cast, int label)
         }
 
         GenNumLabel(CurFxnEpilogLabel);
+        GenDebugLine();
 
 #ifndef MIPS
 #ifdef CAN_COMPILE_32BIT
@@ -8723,7 +9067,7 @@ int ParseDecl(int tok, unsigned structInfo[4], int cast, int label)
 #endif
 
         CurFxnName = NULL;
-        IdentTableLen = undoIdents; // remove all identifier names
+        UndoIdents(undoIdents); // remove all identifier names
         SyntaxStackCnt = undoSymbolsPtr; // remove all params and locals
         SyntaxStack1[SymFuncPtr] = DummyIdent;
       }
@@ -9024,6 +9368,7 @@ int ParseStatement(int tok, int BrkCntTarget[2], int casesIdx)
   do
   {
     statementNeeded = 0;
+    GenDebugLine();
 
     if (tok == ';')
     {
@@ -9129,9 +9474,7 @@ int ParseStatement(int tok, int BrkCntTarget[2], int casesIdx)
           push(',');
           push2(tokNumUint, GetDeclSize(synPtr, 0));
           push(',');
-          if (!StructCpyLabel)
-            StructCpyLabel = LabelCnt++;
-          push2(tokIdent, AddNumericIdent(StructCpyLabel));
+          push2(tokIdent, StructCpyIdent(synPtr));
           push2(')', SizeOfWord * 3);
         }
         else // fallthrough
@@ -9723,7 +10066,6 @@ int ParseStatement(int tok, int BrkCntTarget[2], int casesIdx)
       int undoCases = CasesCnt;
       int brkLabel = LabelCnt++;
       int lbl = LabelCnt++;
-      int i;
 #ifndef NO_ANNOTATIONS
       GenStartCommentLine(); printf2("switch\n");
 #endif
@@ -9775,12 +10117,9 @@ int ParseStatement(int tok, int BrkCntTarget[2], int casesIdx)
       GenJumpUncond(brkLabel);
       // Generate conditional jumps
       GenNumLabel(lbl);
-      for (i = undoCases + 1; i < CasesCnt; i++)
-      {
-        GenJumpIfEqual(Cases[i][0], Cases[i][1]);
-      }
       // If none of the cases matches, take the default case
-      if (Cases[undoCases][1] != brkLabel)
+      if (!GenSwitch(Cases + undoCases + 1, CasesCnt - undoCases - 1, Cases[undoCases][1]) &&
+          Cases[undoCases][1] != brkLabel)
         GenJumpUncond(Cases[undoCases][1]);
       GenNumLabel(brkLabel); // break label
 
@@ -9862,12 +10201,14 @@ int ParseStatement(int tok, int BrkCntTarget[2], int casesIdx)
         //error("ParseStatement(): string literal expression expected in 'asm ( expression )'\n");
         errorUnexpectedToken(tok);
 
+      GenStartAsm();
       do
       {
         GetString('"', 0, 'a');
         tok = GetToken();
       } while (tok == tokLitStr); // concatenate adjacent string literals
       printf2("\n");
+      GenEndAsm();
 
       if (tok != ')')
         //error("ParseStatement(): ')' expected after 'asm ( expression'\n");
@@ -9946,6 +10287,8 @@ int ParseBlock(int BrkCntTarget[2], int casesIdx)
 
     if (TokenStartsDeclaration(tok, 0))
     {
+      if (ParseLevel > 0)
+        GenDebugLine();
       tok = ParseDecl(tok, NULL, 0, 1);
 #ifndef NO_TYPEDEF_ENUM
       if (tok == tokGotoLabel)
@@ -10000,6 +10343,7 @@ int main(int argc, char** argv)
 #endif
 #endif
 
+  HashReservedWords();
   SyntaxStack1[SymFuncPtr] = DummyIdent = AddIdent("");
 
 #ifndef NO_FP
@@ -10228,12 +10572,14 @@ int main(int argc, char** argv)
 #ifndef NO_PREPROCESSOR
   // Define a few macros useful for conditional compilation
   DefineMacro("__SMALLER_C__", "0x0100");
-  if (SizeOfWord == 2)
+  if (SizeOfWord * CharBits == 16)
     DefineMacro("__SMALLER_C_16__", "");
 #ifdef CAN_COMPILE_32BIT
-  else if (SizeOfWord == 4)
+  else if (SizeOfWord * CharBits == 32)
     DefineMacro("__SMALLER_C_32__", "");
 #endif
+  if (CharBits != 8)
+    DefineMacro("__SMALLER_C_WORD_ADDRESSED__", "");
 #ifdef CAN_COMPILE_32BIT
   if (OutputFormat == FormatSegHuge)
     DefineMacro("__HUGE__", "");
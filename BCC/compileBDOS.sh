@@ -1,29 +1,96 @@
 #!/bin/bash
 
-# script for compiling a BDOS. 
+# script for compiling a BDOS.
 
-echo "Compiling C code to B32P ASM"
-if (./bcc --os BDOS/BDOS.c ../Assembler/code.asm) # compile c code and write compiled code to code.asm in Assembler folder
-then
-    echo "C code successfully compiled"
+# BDOS is built from separate modules (see BDOS/BDOS.h). Each module is compiled with bcc -c
+# and assembled into an object in BUILD_DIR, but only if the module, a header it includes
+# or bcc itself changed since its object was made. The objects of the libraries are put
+# in an archive, which is then linked with the other objects by the assembler.
+
+BUILD_DIR=BDOS/build
+ARCHIVE=$BUILD_DIR/bdos.a
+
+# BDOS.c has to be first, as it holds main() and the startup code
+MODULES="BDOS.c data/ASCII_BW.c data/PS2SCANCODES.c data/USBSCANCODES.c"
+LIB_MODULES="lib/stdlib.c lib/math.c lib/gfx.c lib/hidfifo.c lib/ps2.c lib/brfs.c lib/loader.c lib/shell.c lib/usbkeyboard.c lib/wiz5500.c lib/netloader.c lib/nethid.c lib/spiflash.c"
 
-    echo "Assembling B32P ASM code"
-    if (cd ../Assembler && python3 Assembler.py os -O > ../Programmer/code.list) # compile and write to code.list in Programmer folder
+# Compiles and assembles module $1 into BUILD_DIR if its object is out of date
+buildModule()
+{
+    local src=BDOS/$1
+    local name=$(basename $1 .c)
+    local obj=$BUILD_DIR/$name.o
+
+    if [[ -f $obj && ! $src -nt $obj && ! ./bcc -nt $obj ]]
+    then
+        # the modules that include BDOS.h also depend on all headers
+        if ! grep -q '#include "BDOS.h"' $src || [[ -z $(find BDOS/BDOS.h BDOS/lib -name "*.h" -newer $obj) ]]
+        then
+            return 0
+        fi
+    fi
+
+    echo "Compiling $1"
+    local flags="-c"
+    if [[ $1 == "BDOS.c" ]]
+    then
+        flags="-c --os"
+    fi
+    if ! ./bcc $flags -I BDOS $src $BUILD_DIR/$name.asm # compile c code of the module
+    then
+        echo "Failed to compile C code of $1"
+        return 1
+    fi
+    if ! (cd ../Assembler && python3 Assembler.py obj ../BCC/$BUILD_DIR/$name.asm > ../BCC/$obj.tmp) # assemble into an object
     then
-            echo "B32P ASM code successfully assembled"
-            # convert list to binary files and send to FPGC
-
-            if [[ $1 == "flash" ||  $1 == "write" ]]
-            then
-                (cd ../Programmer && bash compileROM.sh && echo "Flashing binary to FPGC flash" && python3 flash.py write -v verify.bin)
-            else
-                (cd ../Programmer && bash compileROM.sh noPadding && echo "Sending binary to FPGC" && python3 uartFlasher.py)
-            fi
-    
-    else # assemble failed, run again to show error
-        echo "Failed to assemble B32P ASM code"
-        cd ../Assembler && python3 Assembler.py os -O
+        echo "Failed to assemble B32P ASM code of $1"
+        cat $obj.tmp
+        rm -f $obj.tmp
+        return 1
     fi
-else # compile failed
-    echo "Failed to compile C code"
+    mv $obj.tmp $obj
+}
+
+mkdir -p $BUILD_DIR
+
+for module in $MODULES $LIB_MODULES
+do
+    buildModule $module || exit 1
+done
+
+# Put the objects of the libraries in the archive if any of them changed
+LIB_OBJECTS=""
+for module in $LIB_MODULES
+do
+    LIB_OBJECTS="$LIB_OBJECTS $BUILD_DIR/$(basename $module .c).o"
+done
+if [[ ! -f $ARCHIVE || -n $(find $LIB_OBJECTS -newer $ARCHIVE) ]]
+then
+    echo "Creating archive of the libraries"
+    cat $LIB_OBJECTS > $ARCHIVE
+fi
+
+OBJECTS=""
+for module in $MODULES
+do
+    OBJECTS="$OBJECTS ../BCC/$BUILD_DIR/$(basename $module .c).o"
+done
+
+echo "Linking B32P objects"
+if (cd ../Assembler && python3 Assembler.py os $OBJECTS ../BCC/$ARCHIVE -O > ../Programmer/code.list) # link and write to code.list in Programmer folder
+then
+        echo "B32P objects successfully linked"
+        # convert list to binary files and send to FPGC
+
+        if [[ $1 == "flash" ||  $1 == "write" ]]
+        then
+            (cd ../Programmer && bash compileROM.sh && echo "Flashing binary to FPGC flash" && python3 flash.py write -v verify.bin)
+        elif [[ $1 != "build" ]]
+        then
+            (cd ../Programmer && bash compileROM.sh noPadding && echo "Sending binary to FPGC" && python3 uartFlasher.py)
+        fi
+
+else # link failed, run again to show error
+    echo "Failed to link B32P objects"
+    cd ../Assembler && python3 Assembler.py os $OBJECTS ../BCC/$ARCHIVE -O
 fi
@@ -0,0 +1,3728 @@
+/*
+Copyright (c) 2021-2022, bartpleiter
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*****************************************************************************/
+/*                                                                           */
+/*                           BCC (B32P C Compiler)                           */
+/*                                                                           */
+/*                    B32P code optimizer (-O), included by                  */
+/*                    the code generator in backend.c                        */
+/*                                                                           */
+/*****************************************************************************/
+
+/*
+  -O: whole function optimization
+
+  With -O the body of a function isn't written to OutFile directly, but to a
+  temporary buffer. GenFxnEpilog() then reads the body back, parses the
+  instructions and runs the optimization passes over them before printing the
+  prolog, the body and the epilog.
+
+  Register allocation:
+  Scalar locals and parameters whose address is never taken live in registers
+  instead of in their stack slots. The live ranges of the slots are computed
+  from the generated code and registers are handed out to them with a linear
+  scan over the ranges. When the registers run out, the slot with the fewest
+  (loop weighted) references stays in memory.
+  With -O, r3 and T0-T2 (r8-r10) are callee-saved, so slots kept in them
+  survive calls (--gp reserves r3 for the global pointer). A function saves and restores only those of them it writes.
+  The other registers can hold a slot only where neither a call nor the
+  generated code itself needs them.
+  Functions with asm() are not allocated, but still save the callee-saved
+  registers their asm code uses (or all of them if the asm code jumps away).
+
+  Peephole optimization:
+  After the register allocation, a table of rewrite rules is applied to the
+  instructions of the function until none of the rules applies anymore (see
+  OptRuleName[] and OptApplyRule()). The rules look at neighboring
+  instructions of a basic block and use the register liveness to tell if an
+  intermediate result is still needed. They turn the "skip the jump" branches
+  into branches to labels, remove jumps to the next instruction, unreachable
+  code and unused results, and fold constants, address offsets, register
+  copies and reloads of stack slots into the instructions that use them.
+  Intermediate results pushed on the stack go to a free register instead.
+  With -verbose the number of instructions and words each rule removed is
+  printed at the end.
+
+  Loop optimization:
+  After that, the loops are optimized, innermost first. A loop is the range of
+  nodes from the target of a backward jump to the jump, if it's only entered by
+  falling into its first node. Instructions that compute the same value in
+  every iteration (addresses of globals, constants, arithmetic on registers
+  the loop doesn't change) are moved in front of the loop into a free
+  register. Registers only changed by "add rI K rI" are induction variables:
+  shifts, multiplications and additions of them get a register of their own
+  that is advanced along with rI, which turns a[i] into an incremented pointer
+  and removes the multiplication. If rI is then only needed for the loop test,
+  the test compares such a pointer with its final value instead and rI is
+  dropped. Memory reads are never moved, they may be memory mapped I/O.
+  The copies left behind are removed by the peephole rules, which run again
+  after every loop.
+
+  Value propagation (-O2):
+  The values of the registers are tracked through the flow graph in SSA form:
+  a register holds the result of the instruction that last wrote it, or a phi
+  where paths with different values meet. Constants are propagated through
+  this optimistically, following only the branches that can be taken (sparse
+  conditional constant propagation). Code that can't be reached is removed,
+  branches with a known outcome become jumps or disappear, constant results
+  are loaded directly and constant operands go into the instructions. An
+  operation on the same values as an earlier one (looking through copies)
+  becomes a copy of the earlier result, if its register still holds it on
+  every path (value numbering). This runs before the loop optimization and
+  again after it, when the earlier result may also be copied to a register
+  the function doesn't use, so that loop invariant code is moved out first.
+  The peephole rules then remove the results that are no longer used.
+
+  Inlining:
+  Once a function is optimized, its code is kept if it's small, straight
+  (no branches or calls) and doesn't need the frame, the stack or callee-saved
+  registers, along with the moves of its parameters to their registers. Calls
+  to it later in the file are replaced by that code before the caller is
+  analyzed. Functions declared inline may be larger. Functions with asm() can be
+  inlined too if the asm code follows the convention of the libraries: the
+  arguments are taken from r4-r7 and the result is stored in the local retval
+  with "write -4 r14 rX", which becomes a move to r2. The asm code must not jump
+  and may only change the registers a call changes, pushes and pops of those
+  around it are dropped.
+
+  Tail calls:
+  A call that passes its arguments in registers and is followed only by the
+  epilog becomes a jump: the saved registers are restored and the frame is
+  removed in front of it, so the callee returns to the caller of the function.
+  This needs the callee to find the 4 words for its parameters above r13, which
+  the caller of the function reserved, and nothing in the frame may be used by
+  the callee, so functions that take the address of a local are skipped.
+
+  Frameless functions:
+  A function that calls nothing (tail calls aside), saves no registers and has
+  all its locals and its register parameters in registers doesn't need r13 and
+  r14 anymore. It gets no prolog and its epilog is only "jumpr 0 r15".
+
+  Scheduling:
+  An instruction that uses the register loaded by the read or pop right before
+  it waits a cycle. Last, the instructions of each basic block are reordered
+  with a list scheduler to put independent instructions in that cycle: it
+  keeps the register dependencies and the order of the memory accesses, and
+  prefers the instruction with the longest path to the end of the block. A
+  block is only changed if it ends up with fewer stalls. -verbose prints the
+  stalls found and removed for each function.
+*/
+
+#define MAX_OPT_TEXT  0x400000
+#define MAX_OPT_LINES 0x10000
+#define MAX_OPT_SLOTS 112
+#define OPT_SET_WORDS 4 // 16 registers + MAX_OPT_SLOTS slots
+#define OPT_SLOT_BIT  16
+
+#define OptKindOther  0 // comment, directive or data
+#define OptKindLabel  1
+#define OptKindInstr  2
+#define OptKindAsm    3 // text of an asm() statement
+
+#define OptArgReg     1
+#define OptArgConst   2
+#define OptArgSym     3
+#define OptArgRegConst 4 // either, for OptArgsAre()
+
+#define OPT_CALLEE_SAVED ((1u << 3) | (1u << 8) | (1u << 9) | (1u << 10))
+#define OPT_CALL_CLOBBERED ((1u << 1) | (1u << 2) | (1u << 4) | (1u << 5) | (1u << 6) | (1u << 7) | \
+                            (1u << 11) | (1u << 12) | (1u << 15))
+// the global pointer of --gp must survive the function and is read by every callee
+#define OPT_GP_LIVE (GenGlobalPtr ? 1u << GP_REG : 0)
+
+char OptText[MAX_OPT_TEXT];
+int OptTextLen; // used part of OptText, inlined code is added behind it
+char* OptLine[MAX_OPT_LINES];
+int OptLineCnt;
+unsigned char OptKind[MAX_OPT_LINES];
+unsigned char OptModified[MAX_OPT_LINES]; // print the line from OptInstr/OptArg*, not from OptLine
+unsigned char OptDeleted[MAX_OPT_LINES];
+int OptInstr[MAX_OPT_LINES];
+int OptArgCnt[MAX_OPT_LINES];
+int OptArgType[MAX_OPT_LINES][3];
+int OptArgVal[MAX_OPT_LINES][3]; // register number, constant or offset of the symbol in OptText
+
+int OptNodeLine[MAX_OPT_LINES]; // instruction lines
+int OptNodeOf[MAX_OPT_LINES]; // node of an instruction line
+int OptNodeCnt;
+int OptLabelNode[MAX_OPT_LINES]; // for label lines, the node that follows the label
+unsigned char OptCall[MAX_OPT_LINES];
+int OptSucc[MAX_OPT_LINES][2];
+int OptTable[MAX_OPT_LINES]; // for switch jumps (jumpr 0 rN), the first ".dl" line of the jump table
+int OptTableNode[MAX_OPT_LINES]; // for the ".dl" lines of jump tables, the node of the target label
+unsigned OptUse[MAX_OPT_LINES][OPT_SET_WORDS];
+unsigned OptDef[MAX_OPT_LINES][OPT_SET_WORDS];
+unsigned OptIn[MAX_OPT_LINES][OPT_SET_WORDS];
+unsigned OptOut[MAX_OPT_LINES][OPT_SET_WORDS];
+int OptLoopDepth[MAX_OPT_LINES];
+
+int OptSlotCnt;
+int OptSlotOfs[MAX_OPT_SLOTS];
+int OptSlotReg[MAX_OPT_SLOTS];
+int OptSlotStart[MAX_OPT_SLOTS];
+int OptSlotEnd[MAX_OPT_SLOTS];
+int OptSlotWeight[MAX_OPT_SLOTS];
+int OptTakenCnt;
+int OptTaken[MAX_OPT_SLOTS];
+int OptParamsTaken;
+
+// Registers for values, in preference order: registers that need no saving first
+int OptPool[] = { 4, 5, 6, 7, 11, 12, 1, 3, 10, 9, 8 };
+#define OPT_POOL_SIZE ((int)(sizeof OptPool / sizeof OptPool[0]))
+
+int OptSavedRegs[16]; // callee-saved registers written by the function, in save order
+int OptSavedCnt;
+
+int OptStale; // the flow graph and the liveness need to be rebuilt
+int OptBranchesFit; // the function is small enough for branches to reach all of its labels
+
+// Peephole rules, tried in this order
+#define OptRuleBranchOverJump 0
+#define OptRuleJumpToNext     1
+#define OptRuleUnreachable    2
+#define OptRuleIdentity       3
+#define OptRuleFoldConst      4
+#define OptRuleSmallConst     5
+#define OptRuleFoldAdd        6
+#define OptRuleFoldOffset     7
+#define OptRuleReload         8
+#define OptRuleCopyForward    9
+#define OptRuleCopyBack       10
+#define OptRuleRenameSaved    11
+#define OptRuleDeadCode       12
+#define OptRuleDeadCounter    13
+#define OptRuleStackTemp      14
+#define OPT_RULE_CNT          15
+#define OPT_MAX_SWEEPS        16
+
+char* OptRuleName[OPT_RULE_CNT] =
+{
+  "branch over jump", "jump to next", "unreachable code", "identity op",
+  "constant operand", "small constant", "add chain", "address offset",
+  "stack reload", "copy forward", "copy back", "callee-saved temp",
+  "dead code", "dead counter", "stack temp"
+};
+// Totals for the whole translation unit
+int OptRuleApplied[OPT_RULE_CNT];
+int OptRuleInstrs[OPT_RULE_CNT]; // instructions removed
+int OptRuleWords[OPT_RULE_CNT]; // words removed
+
+STATIC
+int OptIsSpace(int c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+STATIC
+int OptTokenLen(char* s)
+{
+  int l = 0;
+  while (s[l] && !OptIsSpace(s[l]) && s[l] != ';')
+    l++;
+  return l;
+}
+
+// Returns the register number of an "rN" token or -1
+STATIC
+int OptRegToken(char* s, int l)
+{
+  int r = 0, i;
+  if (l < 2 || l > 3 || (s[0] != 'r' && s[0] != 'R'))
+    return -1;
+  for (i = 1; i < l; i++)
+  {
+    if (!isdigit(s[i] & 0xFF))
+      return -1;
+    r = r * 10 + s[i] - '0';
+  }
+  return (r < 16) ? r : -1;
+}
+
+STATIC
+void OptParseLine(int i, int inCode)
+{
+  char* p = OptLine[i];
+  int l, instr, k, load16;
+
+  OptKind[i] = OptKindOther;
+  OptModified[i] = OptDeleted[i] = 0;
+  OptArgCnt[i] = 0;
+
+  while (OptIsSpace(*p))
+    p++;
+  if (!inCode || *p == '\0' || *p == ';' || *p == '.')
+    return;
+
+  l = OptTokenLen(p);
+  if (p[l - 1] == ':')
+  {
+    OptKind[i] = OptKindLabel;
+    return;
+  }
+
+  OptKind[i] = OptKindInstr;
+  OptInstr[i] = -1; // unknown
+  for (instr = B32PInstrHalt; instr <= B32PInstrMULTFP; instr++)
+  {
+    char* name = GenInstrName(instr);
+    if ((int)strlen(name) == l && !strncmp(p, name, l))
+    {
+      OptInstr[i] = instr;
+      break;
+    }
+  }
+  // "load" of asm code, the same as load32 for 16-bit constants (checked below)
+  load16 = l == 4 && !strncmp(p, "load", 4);
+
+  for (p += l; ; p += l)
+  {
+    char* end;
+    long v;
+    while (OptIsSpace(*p))
+      p++;
+    if (*p == '\0' || *p == ';')
+      break;
+    l = OptTokenLen(p);
+    if ((k = OptArgCnt[i]++) >= 3)
+    {
+      OptInstr[i] = -1;
+      break;
+    }
+    if ((OptArgVal[i][k] = OptRegToken(p, l)) >= 0)
+    {
+      OptArgType[i][k] = OptArgReg;
+      continue;
+    }
+    v = strtol(p, &end, 0);
+    if (end == p + l)
+    {
+      OptArgType[i][k] = OptArgConst;
+      OptArgVal[i][k] = (int)v;
+      continue;
+    }
+    OptArgType[i][k] = OptArgSym;
+    OptArgVal[i][k] = (int)(p - OptText);
+  }
+
+  if (load16)
+    OptInstr[i] = (OptArgCnt[i] == 2 && OptArgType[i][0] == OptArgConst &&
+                   OptArgVal[i][0] >= 0 && OptArgVal[i][0] <= 0xFFFF) ? B32PInstrLoad : -1;
+}
+
+// Reads the buffered function body into OptLine[]
+STATIC
+void OptReadFxn(void)
+{
+  long size = ftell(GenFxnBufFile);
+  int i, inCode = 1, inAsm = 0;
+  char* p;
+
+  if (size < 0 || size >= MAX_OPT_TEXT)
+    error("Function is too big for -O\n");
+  rewind(GenFxnBufFile);
+  if (fread(OptText, 1, size, GenFxnBufFile) != (size_t)size)
+    errorFile("temporary file");
+  OptText[size] = '\0';
+  OptTextLen = size + 1;
+
+  OptLineCnt = 0;
+  for (p = OptText; *p; )
+  {
+    char* e = strchr(p, '\n');
+    if (OptLineCnt >= MAX_OPT_LINES)
+      error("Function is too big for -O\n");
+    OptLine[OptLineCnt++] = p;
+    if (!e)
+      break;
+    *e = '\0';
+    p = e + 1;
+  }
+
+  for (i = 0; i < OptLineCnt; i++)
+  {
+    char* s = OptLine[i];
+    while (OptIsSpace(*s))
+      s++;
+    if (!strcmp(s, ";@asm") || !strcmp(s, ";@endasm"))
+    {
+      inAsm = s[2] == 'a';
+      OptKind[i] = OptKindOther;
+      OptDeleted[i] = 1;
+      continue;
+    }
+    if (inAsm)
+    {
+      OptKind[i] = OptKindAsm;
+      OptModified[i] = OptDeleted[i] = 0;
+      continue;
+    }
+    if (*s == '.')
+    {
+      if (!strncmp(s, ".code", 5))
+        inCode = 1;
+      else if (!strncmp(s, ".data", 5) || !strncmp(s, ".rdata", 6) || !strncmp(s, ".bss", 4))
+        inCode = 0;
+    }
+    OptParseLine(i, inCode);
+  }
+}
+
+STATIC
+void OptSetBit(unsigned* set, int bit)
+{
+  set[bit >> 5] |= 1u << (bit & 31);
+}
+
+STATIC
+int OptTestBit(unsigned* set, int bit)
+{
+  return (set[bit >> 5] >> (bit & 31)) & 1;
+}
+
+STATIC
+int OptFindSlot(int ofs)
+{
+  int s;
+  for (s = 0; s < OptSlotCnt; s++)
+    if (OptSlotOfs[s] == ofs)
+      return s;
+  return -1;
+}
+
+STATIC
+int OptNameEqual(char* s, char* label)
+{
+  int l = OptTokenLen(s);
+  while (OptIsSpace(*label))
+    label++;
+  return !strncmp(s, label, l) && label[l] == ':';
+}
+
+STATIC
+int OptSymEqual(int i, int k, char* label)
+{
+  return OptNameEqual(OptText + OptArgVal[i][k], label);
+}
+
+STATIC
+int OptArgsAre(int i, int cnt, int t0, int t1, int t2)
+{
+  int t[3];
+  int k;
+  t[0] = t0; t[1] = t1; t[2] = t2;
+  if (OptArgCnt[i] != cnt)
+    return 0;
+  for (k = 0; k < cnt; k++)
+    if (OptArgType[i][k] != t[k] && !(t[k] == OptArgRegConst && OptArgType[i][k] != OptArgSym))
+      return 0;
+  return 1;
+}
+
+// Decides which frame slots may live in registers.
+// Returns 0 if the code can't be analyzed.
+STATIC
+int OptFindSlots(void)
+{
+  int n, i, t;
+
+  OptTakenCnt = 0;
+  OptParamsTaken = 0;
+  OptSlotCnt = 0;
+
+  // Slots whose address is taken must stay in memory
+  for (n = 0; n < OptNodeCnt; n++)
+  {
+    i = OptNodeLine[n];
+    for (t = 0; t < OptArgCnt[i]; t++)
+    {
+      if (OptArgType[i][t] != OptArgReg || OptArgVal[i][t] != B32POpRegFp)
+        continue;
+      if ((OptInstr[i] == B32PInstrRead || OptInstr[i] == B32PInstrWrite) && t == 1 &&
+          OptArgType[i][0] == OptArgConst)
+        continue;
+      if ((OptInstr[i] == B32PInstrADD || OptInstr[i] == B32PInstrSUB) && t == 0 &&
+          OptArgType[i][1] == OptArgConst && OptArgType[i][2] == OptArgReg)
+      {
+        int ofs = OptArgVal[i][1];
+        if (OptInstr[i] == B32PInstrSUB)
+          ofs = -ofs;
+        if (ofs >= 2 * SizeOfWord)
+          OptParamsTaken = 1; // e.g. va_start(), the other params are reachable from this one
+        else if (OptTakenCnt < MAX_OPT_SLOTS)
+          OptTaken[OptTakenCnt++] = ofs;
+        else
+          return 0;
+        continue;
+      }
+      return 0; // some other use of the frame pointer
+    }
+  }
+
+  for (n = 0; n < OptNodeCnt; n++)
+  {
+    int ofs, ok = 1;
+    i = OptNodeLine[n];
+    if ((OptInstr[i] != B32PInstrRead && OptInstr[i] != B32PInstrWrite) ||
+        OptArgVal[i][1] != B32POpRegFp)
+      continue;
+    ofs = OptArgVal[i][0];
+    if (OptFindSlot(ofs) >= 0)
+      continue;
+    if (ofs % SizeOfWord)
+      ok = 0;
+    else if (ofs < 0)
+    {
+      for (t = 0; t < GenAggrLocalCnt; t++)
+        if (ofs >= GenAggrLocals[t][0] && ofs < GenAggrLocals[t][0] + GenAggrLocals[t][1])
+          ok = 0;
+    }
+    else if (ofs < 2 * SizeOfWord || OptParamsTaken ||
+             (ofs - 2 * SizeOfWord) / SizeOfWord >= CurFxnParamCntMax)
+      ok = 0;
+    for (t = 0; t < OptTakenCnt; t++)
+      if (OptTaken[t] == ofs)
+        ok = 0;
+    if (ok && OptSlotCnt < MAX_OPT_SLOTS)
+    {
+      OptSlotOfs[OptSlotCnt] = ofs;
+      OptSlotReg[OptSlotCnt] = -1;
+      OptSlotCnt++;
+    }
+  }
+
+  return 1;
+}
+
+// Finds the label line that the symbol operand k of line i refers to, -1 if none
+STATIC
+int OptFindLabel(int i, int k)
+{
+  int j;
+  for (j = 0; j < OptLineCnt; j++)
+    if (OptKind[j] == OptKindLabel && OptSymEqual(i, k, OptLine[j]))
+      return j;
+  return -1;
+}
+
+// Returns the ".dl Label" entry of a jump table at line i, NULL if the line isn't one
+STATIC
+char* OptTableEntry(int i)
+{
+  char* p = OptLine[i];
+  while (OptIsSpace(*p))
+    p++;
+  if (strncmp(p, ".dl", 3) || !OptIsSpace(p[3]))
+    return NULL;
+  for (p += 3; OptIsSpace(*p); p++)
+    ;
+  return p;
+}
+
+// Finds the jump table that GenSwitchTable() puts right after the "jumpr" at line i
+// (".rdata", the table label and one ".dl" line per entry) and the nodes of its targets.
+// Returns the line of the first entry or -1 if there's no table.
+STATIC
+int OptFindTable(int i)
+{
+  int j, k, first;
+  char* p;
+
+  for (j = i + 1; j < OptLineCnt && OptKind[j] == OptKindOther && !OptTableEntry(j); j++)
+    ;
+  first = j;
+  for (; j < OptLineCnt && (p = OptTableEntry(j)) != NULL; j++)
+  {
+    for (k = 0; k < OptLineCnt; k++)
+      if (OptKind[k] == OptKindLabel && OptNameEqual(p, OptLine[k]))
+        break;
+    if (k == OptLineCnt)
+      return -1;
+    OptTableNode[j] = OptLabelNode[k];
+  }
+  return (j > first) ? first : -1;
+}
+
+// Collects the instructions of the function into nodes and finds the calls.
+// Returns 0 if the code can't be analyzed.
+STATIC
+int OptBuildNodes(void)
+{
+  int i, n;
+
+  OptNodeCnt = 0;
+  for (i = 0; i < OptLineCnt; i++)
+  {
+    if (OptKind[i] == OptKindAsm)
+      return 0;
+    if (OptKind[i] == OptKindInstr && !OptDeleted[i])
+    {
+      if (OptInstr[i] < 0)
+        return 0;
+      OptNodeLine[OptNodeCnt] = i;
+      OptNodeOf[i] = OptNodeCnt;
+      OptCall[OptNodeCnt] = 0;
+      OptNodeCnt++;
+    }
+    else if (OptKind[i] == OptKindLabel)
+      OptLabelNode[i] = OptNodeCnt;
+  }
+
+  // Calls are "savpc r15; add r15 3 r15; jump f" or "jumpr 0 rN" in place of the jump
+  for (n = 0; n + 2 < OptNodeCnt; n++)
+    if (OptInstr[OptNodeLine[n]] == B32PInstrSavPC)
+    {
+      int j = OptNodeLine[n + 2];
+      if (OptInstr[OptNodeLine[n + 1]] != B32PInstrADD ||
+          (OptInstr[j] != B32PInstrJump && OptInstr[j] != B32PInstrJumpr))
+        return 0;
+      OptCall[n + 2] = 1;
+    }
+
+  return 1;
+}
+
+// Finds the register uses and definitions of the instruction at line i,
+// call tells if it's the jump of a call.
+// Returns 0 if the instruction or its operands are unexpected.
+STATIC
+int OptRegUseDef(int i, int call, unsigned* use, unsigned* def)
+{
+  int* a = OptArgVal[i];
+
+  *use = *def = 0;
+
+  switch (OptInstr[i])
+  {
+  case B32PInstrOR:
+  case B32PInstrAND:
+  case B32PInstrXOR:
+  case B32PInstrADD:
+  case B32PInstrSUB:
+  case B32PInstrSHIFTL:
+  case B32PInstrSHIFTR:
+  case B32PInstrSHIFTRS:
+  case B32PInstrMULTS:
+  case B32PInstrMULTU:
+  case B32PInstrMULTFP:
+  case B32PInstrSLT:
+  case B32PInstrSLTU:
+    if (!OptArgsAre(i, 3, OptArgReg, OptArgRegConst, OptArgReg))
+      return 0;
+    *use = 1u << a[0];
+    if (OptArgType[i][1] == OptArgReg)
+      *use |= 1u << a[1];
+    *def = 1u << a[2];
+    break;
+  case B32PInstrNOT:
+    if (!OptArgsAre(i, 2, OptArgReg, OptArgReg, 0))
+      return 0;
+    *use = 1u << a[0];
+    *def = 1u << a[1];
+    break;
+  case B32PInstrRead:
+    if (!OptArgsAre(i, 3, OptArgConst, OptArgReg, OptArgReg))
+      return 0;
+    *use = 1u << a[1];
+    *def = 1u << a[2];
+    break;
+  case B32PInstrWrite:
+    if (!OptArgsAre(i, 3, OptArgConst, OptArgReg, OptArgReg))
+      return 0;
+    *use = (1u << a[1]) | (1u << a[2]);
+    break;
+  case B32PInstrLoad:
+  case B32PInstrLoad32:
+  case B32PInstrAddr2reg:
+    if (OptArgCnt[i] != 2 || OptArgType[i][1] != OptArgReg)
+      return 0;
+    *def = 1u << a[1];
+    break;
+  case B32PInstrLoadHi:
+    if (!OptArgsAre(i, 2, OptArgConst, OptArgReg, 0))
+      return 0;
+    *use = *def = 1u << a[1];
+    break;
+  case B32PInstrSavPC:
+  case B32PInstrPop:
+  case B32PInstrIntID:
+    if (!OptArgsAre(i, 1, OptArgReg, 0, 0))
+      return 0;
+    *def = 1u << a[0];
+    break;
+  case B32PInstrPush:
+    if (!OptArgsAre(i, 1, OptArgReg, 0, 0))
+      return 0;
+    *use = 1u << a[0];
+    break;
+  case B32PInstrBEQ:
+  case B32PInstrBGT:
+  case B32PInstrBGTS:
+  case B32PInstrBGE:
+  case B32PInstrBGES:
+  case B32PInstrBNE:
+  case B32PInstrBLT:
+  case B32PInstrBLTS:
+  case B32PInstrBLE:
+  case B32PInstrBLES:
+    if (OptArgCnt[i] != 3 || OptArgType[i][0] != OptArgReg || OptArgType[i][1] != OptArgReg)
+      return 0;
+    *use = (1u << a[0]) | (1u << a[1]);
+    break;
+  case B32PInstrJump:
+  case B32PInstrJumpr:
+    if (OptInstr[i] == B32PInstrJumpr)
+    {
+      if (!OptArgsAre(i, 2, OptArgConst, OptArgReg, 0))
+        return 0;
+      *use = 1u << a[1];
+    }
+    else if (!OptArgsAre(i, 1, OptArgSym, 0, 0))
+      return 0;
+    if (call)
+    {
+      *use |= (1u << B32POpRegA0) | (1u << B32POpRegA1) | (1u << B32POpRegA2) | (1u << B32POpRegA3) |
+              (1u << B32POpRegSp) | OPT_GP_LIVE;
+      *def = OPT_CALL_CLOBBERED;
+    }
+    break;
+  case B32PInstrHalt:
+    break;
+  default:
+    return 0;
+  }
+
+  *use &= ~1u; // r0 is always 0
+  *def &= ~1u;
+  return 1;
+}
+
+// Builds the flow graph and the register/slot uses and definitions of every instruction.
+// Returns 0 if the code can't be analyzed.
+STATIC
+int OptBuildFlow(void)
+{
+  int i, n, k;
+
+  for (n = 0; n < OptNodeCnt; n++)
+  {
+    unsigned* use = OptUse[n];
+    unsigned* def = OptDef[n];
+    int* a;
+    i = OptNodeLine[n];
+    a = OptArgVal[i];
+
+    for (k = 0; k < OPT_SET_WORDS; k++)
+      use[k] = def[k] = 0;
+    if (!OptRegUseDef(i, OptCall[n], &use[0], &def[0]))
+      return 0;
+
+    if ((OptInstr[i] == B32PInstrRead || OptInstr[i] == B32PInstrWrite) &&
+        a[1] == B32POpRegFp && (k = OptFindSlot(a[0])) >= 0)
+      OptSetBit((OptInstr[i] == B32PInstrRead) ? use : def, OPT_SLOT_BIT + k);
+
+    OptSucc[n][0] = n + 1;
+    OptSucc[n][1] = -1;
+    OptTable[n] = -1;
+
+    switch (OptInstr[i])
+    {
+    case B32PInstrBEQ:
+    case B32PInstrBGT:
+    case B32PInstrBGTS:
+    case B32PInstrBGE:
+    case B32PInstrBGES:
+    case B32PInstrBNE:
+    case B32PInstrBLT:
+    case B32PInstrBLTS:
+    case B32PInstrBLE:
+    case B32PInstrBLES:
+      if (OptArgType[i][2] == OptArgSym)
+      {
+        if ((k = OptFindLabel(i, 2)) < 0)
+          return 0;
+        OptSucc[n][1] = OptLabelNode[k];
+        break;
+      }
+      // otherwise only the "skip the following jump" form is generated
+      if (OptArgType[i][2] != OptArgConst || a[2] != 2 ||
+          n + 1 >= OptNodeCnt || OptInstr[OptNodeLine[n + 1]] != B32PInstrJump)
+        return 0;
+      OptSucc[n][1] = n + 2;
+      break;
+    case B32PInstrJump:
+    case B32PInstrJumpr:
+      if (OptCall[n])
+        break;
+      if (OptInstr[i] == B32PInstrJumpr)
+      {
+        // a switch jump goes to any of the labels in its table
+        if ((OptTable[n] = OptFindTable(i)) < 0)
+          return 0;
+        OptSucc[n][0] = -1;
+        break;
+      }
+      if ((k = OptFindLabel(i, 0)) < 0)
+        return 0;
+      OptSucc[n][0] = OptLabelNode[k];
+      break;
+    case B32PInstrHalt:
+      OptSucc[n][0] = -1;
+      break;
+    }
+  }
+
+  return 1;
+}
+
+STATIC
+void OptLiveness(void)
+{
+  int n, k, s, changed;
+
+  for (n = 0; n < OptNodeCnt; n++)
+    for (k = 0; k < OPT_SET_WORDS; k++)
+      OptIn[n][k] = OptOut[n][k] = 0;
+
+  do
+  {
+    changed = 0;
+    for (n = OptNodeCnt - 1; n >= 0; n--)
+    {
+      for (k = 0; k < OPT_SET_WORDS; k++)
+      {
+        unsigned out = 0, in;
+        for (s = 0; s < 2; s++)
+        {
+          int succ = OptSucc[n][s];
+          if (succ < 0)
+            continue;
+          if (succ >= OptNodeCnt)
+            out |= k ? 0 : (1u << B32POpRegV0) | OPT_GP_LIVE; // the epilog returns V0
+          else
+            out |= OptIn[succ][k];
+        }
+        if (OptTable[n] >= 0)
+        {
+          int j;
+          for (j = OptTable[n]; j < OptLineCnt && OptTableEntry(j); j++)
+          {
+            int succ = OptTableNode[j];
+            if (succ >= OptNodeCnt)
+              out |= k ? 0 : (1u << B32POpRegV0) | OPT_GP_LIVE;
+            else
+              out |= OptIn[succ][k];
+          }
+        }
+        in = OptUse[n][k] | (out & ~OptDef[n][k]);
+        if (out != OptOut[n][k] || in != OptIn[n][k])
+          changed = 1;
+        OptOut[n][k] = out;
+        OptIn[n][k] = in;
+      }
+    }
+  } while (changed);
+}
+
+// Checks whether slot s can be kept in register r without clobbering
+// or being clobbered by the other uses of r
+STATIC
+int OptRegFits(int s, int r)
+{
+  int n, ofs = OptSlotOfs[s];
+  int bit = OPT_SLOT_BIT + s;
+
+  if (ofs >= 2 * SizeOfWord && r >= B32POpRegA0 && r <= B32POpRegA3)
+  {
+    // A0-A3 hold the incoming arguments, a parameter may only stay in its own
+    int idx = (ofs - 2 * SizeOfWord) / SizeOfWord;
+    if (idx < 4 && r != B32POpRegA0 + idx)
+      return 0;
+  }
+
+  if (OptNodeCnt && OptTestBit(OptIn[0], bit) && OptTestBit(OptIn[0], r))
+    return 0;
+
+  for (n = 0; n < OptNodeCnt; n++)
+  {
+    int i = OptNodeLine[n];
+    int move = (OptInstr[i] == B32PInstrRead || OptInstr[i] == B32PInstrWrite) &&
+               OptArgVal[i][1] == B32POpRegFp && OptArgVal[i][0] == ofs &&
+               OptArgVal[i][2] == r;
+    if (move)
+      continue;
+    if (OptTestBit(OptDef[n], r) && OptTestBit(OptOut[n], bit))
+      return 0;
+    if (OptTestBit(OptDef[n], bit) && OptTestBit(OptOut[n], r))
+      return 0;
+  }
+
+  return 1;
+}
+
+STATIC
+void OptAllocRegs(void)
+{
+  int order[MAX_OPT_SLOTS], active[MAX_OPT_SLOTS];
+  int cnt = 0, activeCnt = 0;
+  int n, s, k, j;
+
+  // Loop depth for weighting the references: every backward jump makes a loop
+  for (n = 0; n < OptNodeCnt; n++)
+    OptLoopDepth[n] = 0;
+  for (n = 0; n < OptNodeCnt; n++)
+  {
+    int t = OptSucc[n][0];
+    if (OptInstr[OptNodeLine[n]] == B32PInstrJump && !OptCall[n] && t >= 0 && t <= n)
+      for (j = t; j <= n; j++)
+        OptLoopDepth[j]++;
+  }
+
+  for (s = 0; s < OptSlotCnt; s++)
+  {
+    int bit = OPT_SLOT_BIT + s;
+    OptSlotStart[s] = OptSlotEnd[s] = -2;
+    OptSlotWeight[s] = 0;
+    if (OptNodeCnt && OptTestBit(OptIn[0], bit))
+      OptSlotStart[s] = -1; // defined at entry
+    for (n = 0; n < OptNodeCnt; n++)
+    {
+      int refd = OptTestBit(OptUse[n], bit) || OptTestBit(OptDef[n], bit);
+      if (refd)
+      {
+        int d = OptLoopDepth[n];
+        OptSlotWeight[s] += 1 << (2 * ((d < 5) ? d : 5));
+      }
+      if (refd || OptTestBit(OptIn[n], bit) || OptTestBit(OptOut[n], bit))
+      {
+        if (OptSlotStart[s] == -2)
+          OptSlotStart[s] = n;
+        OptSlotEnd[s] = n;
+      }
+    }
+    if (!OptSlotWeight[s])
+      continue;
+    // insert sorted by the start of the live range
+    for (k = cnt; k > 0 && OptSlotStart[order[k - 1]] > OptSlotStart[s]; k--)
+      order[k] = order[k - 1];
+    order[k] = s;
+    cnt++;
+  }
+
+  for (k = 0; k < cnt; k++)
+  {
+    int cur = order[k];
+    int victim = -1;
+
+    // Expire the ranges that ended
+    for (j = 0; j < activeCnt; )
+    {
+      if (OptSlotEnd[active[j]] < OptSlotStart[cur] || OptSlotReg[active[j]] < 0)
+        active[j] = active[--activeCnt];
+      else
+        j++;
+    }
+
+    for (j = 0; j < OPT_POOL_SIZE; j++)
+    {
+      int r = OptPool[j], a;
+      if (GenGlobalPtr && r == GP_REG)
+        continue; // holds the global pointer with --gp
+      for (a = 0; a < activeCnt; a++)
+        if (OptSlotReg[active[a]] == r)
+          break;
+      if (a == activeCnt && OptRegFits(cur, r))
+        break;
+    }
+
+    if (j < OPT_POOL_SIZE)
+    {
+      OptSlotReg[cur] = OptPool[j];
+    }
+    else
+    {
+      // Out of registers, the least used range stays in memory
+      for (j = 0; j < activeCnt; j++)
+      {
+        int a = active[j];
+        if (OptSlotWeight[a] < OptSlotWeight[cur] &&
+            (victim < 0 || OptSlotWeight[a] < OptSlotWeight[victim]) &&
+            OptRegFits(cur, OptSlotReg[a]))
+          victim = a;
+      }
+      if (victim < 0)
+        continue;
+      OptSlotReg[cur] = OptSlotReg[victim];
+      OptSlotReg[victim] = -1;
+    }
+    active[activeCnt++] = cur;
+  }
+}
+
+// Replaces the frame accesses of the slots kept in registers with register moves
+STATIC
+void OptRewriteSlots(void)
+{
+  int n, s;
+  for (n = 0; n < OptNodeCnt; n++)
+  {
+    int i = OptNodeLine[n];
+    int* a = OptArgVal[i];
+    int r, other;
+    if ((OptInstr[i] != B32PInstrRead && OptInstr[i] != B32PInstrWrite) || a[1] != B32POpRegFp ||
+        (s = OptFindSlot(a[0])) < 0 || (r = OptSlotReg[s]) < 0)
+      continue;
+    other = a[2];
+    if (other == r)
+    {
+      OptDeleted[i] = 1;
+      continue;
+    }
+    OptModified[i] = 1;
+    OptArgCnt[i] = 3;
+    OptArgType[i][0] = OptArgType[i][1] = OptArgType[i][2] = OptArgReg;
+    a[0] = B32POpRegZero;
+    if (OptInstr[i] == B32PInstrRead)
+    {
+      a[1] = r;
+      a[2] = other;
+    }
+    else
+    {
+      a[1] = other;
+      a[2] = r;
+    }
+    OptInstr[i] = B32PInstrOR;
+  }
+}
+
+STATIC
+int OptIsBranch(int instr)
+{
+  return instr >= B32PInstrBEQ && instr <= B32PInstrBLES;
+}
+
+// Branch with the opposite condition
+STATIC
+int OptInverseBranch(int instr)
+{
+  switch (instr)
+  {
+  case B32PInstrBEQ: return B32PInstrBNE;
+  case B32PInstrBNE: return B32PInstrBEQ;
+  case B32PInstrBGT: return B32PInstrBLE;
+  case B32PInstrBLE: return B32PInstrBGT;
+  case B32PInstrBGE: return B32PInstrBLT;
+  case B32PInstrBLT: return B32PInstrBGE;
+  case B32PInstrBGTS: return B32PInstrBLES;
+  case B32PInstrBLES: return B32PInstrBGTS;
+  case B32PInstrBGES: return B32PInstrBLTS;
+  default: return B32PInstrBGES;
+  }
+}
+
+// Checks whether v fits in the sign-extended 16-bit constant of ALU instructions
+STATIC
+int OptFitsConst(int v)
+{
+  return v >= -32767 && v <= 32767;
+}
+
+// Next instruction line in the same basic block, -1 if none
+STATIC
+int OptNextInstr(int i)
+{
+  while (++i < OptLineCnt)
+  {
+    if (OptKind[i] == OptKindLabel || OptKind[i] == OptKindAsm)
+      return -1;
+    if (OptKind[i] == OptKindInstr && !OptDeleted[i])
+      return i;
+  }
+  return -1;
+}
+
+// Previous instruction line in the same basic block, -1 if none
+STATIC
+int OptPrevInstr(int i)
+{
+  while (--i >= 0)
+  {
+    if (OptKind[i] == OptKindLabel || OptKind[i] == OptKindAsm)
+      return -1;
+    if (OptKind[i] == OptKindInstr && !OptDeleted[i])
+      return i;
+  }
+  return -1;
+}
+
+// Checks whether line i is the jump of a call
+STATIC
+int OptIsCall(int i)
+{
+  int p;
+  if (OptInstr[i] != B32PInstrJump && OptInstr[i] != B32PInstrJumpr)
+    return 0;
+  if ((p = OptPrevInstr(i)) < 0 || OptInstr[p] != B32PInstrADD)
+    return 0;
+  return (p = OptPrevInstr(p)) >= 0 && OptInstr[p] == B32PInstrSavPC;
+}
+
+// Checks whether line i is the jump skipped by a preceding "bXX a b 2"
+STATIC
+int OptIsSkipped(int i)
+{
+  int p = OptPrevInstr(i);
+  return p >= 0 && OptIsBranch(OptInstr[p]) && OptArgType[p][2] == OptArgConst;
+}
+
+// Number of words the instruction at line i assembles to
+STATIC
+int OptWords(int i)
+{
+  if (OptKind[i] != OptKindInstr || OptDeleted[i])
+    return 0;
+  if (OptInstr[i] == B32PInstrAddr2reg)
+    return 2;
+  if (OptInstr[i] == B32PInstrLoad && OptArgType[i][0] == OptArgConst &&
+      (OptArgVal[i][0] < 0 || OptArgVal[i][0] > 0xFFFF))
+    return 2; // load + loadhi
+  return 1;
+}
+
+STATIC
+void OptCountCode(int* instrs, int* words)
+{
+  int i;
+  *instrs = *words = 0;
+  for (i = 0; i < OptLineCnt; i++)
+    if (OptKind[i] == OptKindInstr && !OptDeleted[i])
+    {
+      (*instrs)++;
+      *words += OptWords(i);
+    }
+}
+
+// Rebuilds the flow graph and the liveness after changes to the code.
+// Returns 0 if the code can't be analyzed anymore.
+STATIC
+int OptFresh(void)
+{
+  if (OptStale)
+  {
+    if (!OptBuildNodes() || !OptBuildFlow())
+      return 0;
+    OptLiveness();
+    OptStale = 0;
+  }
+  return 1;
+}
+
+// Checks whether register r may be read after line i
+STATIC
+int OptLiveAfter(int i, int r)
+{
+  return !OptFresh() || OptTestBit(OptOut[OptNodeOf[i]], r);
+}
+
+STATIC
+int OptLineUseDef(int i, unsigned* use, unsigned* def)
+{
+  return OptRegUseDef(i, OptIsCall(i), use, def);
+}
+
+// Changes line i into "instr a0 a1 a2" with register operands
+STATIC
+void OptSetRegInstr(int i, int instr, int a0, int a1, int a2)
+{
+  OptInstr[i] = instr;
+  OptArgCnt[i] = 3;
+  OptArgType[i][0] = OptArgType[i][1] = OptArgType[i][2] = OptArgReg;
+  OptArgVal[i][0] = a0;
+  OptArgVal[i][1] = a1;
+  OptArgVal[i][2] = a2;
+  OptModified[i] = 1;
+}
+
+// "op rA rB rD" or "op rA K rD"
+STATIC
+int OptIsAlu(int i)
+{
+  int instr = OptInstr[i];
+  return ((instr >= B32PInstrOR && instr <= B32PInstrSLTU && instr != B32PInstrNOT) ||
+          instr == B32PInstrSHIFTRS || instr == B32PInstrMULTFP) &&
+         OptArgsAre(i, 3, OptArgReg, OptArgRegConst, OptArgReg);
+}
+
+// "add rA K rD" or "sub rA K rD", the added value goes to *k
+STATIC
+int OptIsAddConst(int i, int* k)
+{
+  if ((OptInstr[i] != B32PInstrADD && OptInstr[i] != B32PInstrSUB) ||
+      !OptArgsAre(i, 3, OptArgReg, OptArgConst, OptArgReg))
+    return 0;
+  *k = (OptInstr[i] == B32PInstrADD) ? OptArgVal[i][1] : -OptArgVal[i][1];
+  return 1;
+}
+
+// "or r0 rS rD"
+STATIC
+int OptIsMove(int i)
+{
+  return OptInstr[i] == B32PInstrOR && OptArgsAre(i, 3, OptArgReg, OptArgReg, OptArgReg) &&
+         OptArgVal[i][0] == B32POpRegZero;
+}
+
+// Operands that must stay the same for "x op 0 = x"
+STATIC
+int OptHasRightZero(int instr)
+{
+  return instr == B32PInstrOR || instr == B32PInstrXOR || instr == B32PInstrADD || instr == B32PInstrSUB ||
+         instr == B32PInstrSHIFTL || instr == B32PInstrSHIFTR || instr == B32PInstrSHIFTRS;
+}
+
+// Replaces the reads of register r in line i with register s.
+// Returns 0 if line i doesn't read r in operands that can be replaced.
+STATIC
+int OptReplaceUse(int i, int r, int s)
+{
+  int* a = OptArgVal[i];
+  int k, from = 0, to = -1, found = 0;
+
+  if (OptIsAlu(i) || OptIsBranch(OptInstr[i]))
+    to = 1;
+  else if (OptInstr[i] == B32PInstrNOT && OptArgCnt[i] == 2)
+    to = 0;
+  else if (OptInstr[i] == B32PInstrRead)
+    from = to = 1;
+  else if (OptInstr[i] == B32PInstrWrite)
+    from = 1, to = 2;
+
+  for (k = from; k <= to; k++)
+    if (OptArgType[i][k] == OptArgReg && a[k] == r)
+    {
+      a[k] = s;
+      found = 1;
+    }
+  if (found)
+    OptModified[i] = 1;
+  return found;
+}
+
+// bXX a b 2; jump L  ->  b(!XX) a b L
+STATIC
+int OptBranchOverJump(int i)
+{
+  int j;
+  if (!OptBranchesFit || !OptIsBranch(OptInstr[i]) ||
+      OptArgType[i][2] != OptArgConst || OptArgVal[i][2] != 2 ||
+      (j = OptNextInstr(i)) < 0 || OptInstr[j] != B32PInstrJump || OptArgType[j][0] != OptArgSym)
+    return 0;
+  OptInstr[i] = OptInverseBranch(OptInstr[i]);
+  OptArgType[i][2] = OptArgSym;
+  OptArgVal[i][2] = OptArgVal[j][0];
+  OptModified[i] = 1;
+  OptDeleted[j] = 1;
+  return 1;
+}
+
+// jump L; L:  ->  L:
+// bXX a b L; L:  ->  L:
+STATIC
+int OptJumpToNext(int i)
+{
+  int j, k;
+  if (OptInstr[i] == B32PInstrJump && OptArgType[i][0] == OptArgSym && !OptIsCall(i) && !OptIsSkipped(i))
+    k = 0;
+  else if (OptIsBranch(OptInstr[i]) && OptArgType[i][2] == OptArgSym)
+    k = 2;
+  else
+    return 0;
+  for (j = i + 1; j < OptLineCnt; j++)
+  {
+    if (OptKind[j] == OptKindLabel)
+    {
+      if (OptSymEqual(i, k, OptLine[j]))
+      {
+        OptDeleted[i] = 1;
+        return 1;
+      }
+    }
+    else if (OptKind[j] == OptKindAsm || (OptKind[j] == OptKindInstr && !OptDeleted[j]))
+      break;
+  }
+  return 0;
+}
+
+// Removes the code between a jump (or halt) and the next label
+STATIC
+int OptUnreachable(int i)
+{
+  int j, found = 0;
+  if (OptInstr[i] != B32PInstrHalt &&
+      (OptInstr[i] != B32PInstrJump || OptIsCall(i) || OptIsSkipped(i)))
+    return 0;
+  while ((j = OptNextInstr(i)) >= 0)
+    OptDeleted[j] = found = 1;
+  return found;
+}
+
+// add rA 0 rD  ->  or r0 rA rD
+// or r0 rA rA  ->  (nothing)
+// (and other operations that leave an operand unchanged)
+STATIC
+int OptIdentity(int i)
+{
+  int* a = OptArgVal[i];
+  int instr = OptInstr[i];
+  int src;
+
+  if (!OptIsAlu(i))
+    return 0;
+  if (OptArgType[i][1] == OptArgConst)
+  {
+    if (!(a[1] == 0 && OptHasRightZero(instr)) &&
+        !(a[1] == 1 && (instr == B32PInstrMULTS || instr == B32PInstrMULTU)))
+      return 0;
+    src = a[0];
+  }
+  else if (instr == B32PInstrOR && a[0] == B32POpRegZero)
+    src = a[1];
+  else if (OptHasRightZero(instr) && a[1] == B32POpRegZero)
+    src = a[0];
+  else if ((instr == B32PInstrOR || instr == B32PInstrAND) && a[0] == a[1])
+    src = a[0];
+  else
+    return 0;
+
+  if (src == a[2])
+    OptDeleted[i] = 1;
+  else if (OptIsMove(i) && a[1] == src)
+    return 0; // a move already
+  else
+    OptSetRegInstr(i, B32PInstrOR, B32POpRegZero, src, a[2]);
+  return 1;
+}
+
+// load32 K rT; op rA rT rD  ->  op rA K rD
+// (if rT isn't used afterwards, rA and rT may be swapped if op is commutative,
+// K = 0 is replaced with r0 in any instruction)
+STATIC
+int OptFoldConst(int i)
+{
+  int j, t, v, instr;
+  int* a;
+  unsigned use, def;
+
+  if (OptInstr[i] != B32PInstrLoad || !OptArgsAre(i, 2, OptArgConst, OptArgReg, 0) ||
+      !OptFitsConst(v = OptArgVal[i][0]) || (t = OptArgVal[i][1]) == B32POpRegZero ||
+      (j = OptNextInstr(i)) < 0 || !OptLineUseDef(j, &use, &def) || !(use & (1u << t)))
+    return 0;
+  if (!(def & (1u << t)) && OptLiveAfter(j, t))
+    return 0;
+
+  if (v == 0 && OptReplaceUse(j, t, B32POpRegZero))
+  {
+    OptDeleted[i] = 1;
+    return 1;
+  }
+
+  a = OptArgVal[j];
+  instr = OptInstr[j];
+  if (!OptIsAlu(j) || OptArgType[j][1] != OptArgReg || (a[0] == t) == (a[1] == t))
+    return 0;
+  if (a[0] == t)
+  {
+    if (instr != B32PInstrADD && instr != B32PInstrOR && instr != B32PInstrAND &&
+        instr != B32PInstrXOR && instr != B32PInstrMULTS && instr != B32PInstrMULTU &&
+        instr != B32PInstrMULTFP)
+      return 0;
+    a[0] = a[1];
+  }
+  OptArgType[j][1] = OptArgConst;
+  a[1] = v;
+  OptModified[j] = 1;
+  OptDeleted[i] = 1;
+  return 1;
+}
+
+// load32 K rD  ->  or r0 K rD
+// (for negative K, which takes two words with load32)
+STATIC
+int OptSmallConst(int i)
+{
+  int v;
+  if (OptInstr[i] != B32PInstrLoad || !OptArgsAre(i, 2, OptArgConst, OptArgReg, 0) ||
+      (v = OptArgVal[i][0]) >= 0 || !OptFitsConst(v))
+    return 0;
+  OptSetRegInstr(i, B32PInstrOR, B32POpRegZero, 0, OptArgVal[i][1]);
+  OptArgType[i][1] = OptArgConst;
+  OptArgVal[i][1] = v;
+  return 1;
+}
+
+// add rA K1 rT; add rT K2 rD  ->  add rA K1+K2 rD
+// (if rT isn't used afterwards)
+STATIC
+int OptFoldAdd(int i)
+{
+  int j, k1, k2, t;
+  if (!OptIsAddConst(i, &k1) || (j = OptNextInstr(i)) < 0 || !OptIsAddConst(j, &k2))
+    return 0;
+  t = OptArgVal[i][2];
+  if (OptArgVal[j][0] != t || !OptFitsConst(k1 + k2) ||
+      (OptArgVal[j][2] != t && OptLiveAfter(j, t)))
+    return 0;
+  OptInstr[j] = B32PInstrADD;
+  OptArgVal[j][0] = OptArgVal[i][0];
+  OptArgVal[j][1] = k1 + k2;
+  OptModified[j] = 1;
+  OptDeleted[i] = 1;
+  return 1;
+}
+
+// add rA K rT; read O rT rD  ->  read O+K rA rD
+// (if rT isn't used afterwards, the same for write)
+STATIC
+int OptFoldOffset(int i)
+{
+  int j, k, t;
+  int* a;
+  if (!OptIsAddConst(i, &k) || (j = OptNextInstr(i)) < 0 ||
+      (OptInstr[j] != B32PInstrRead && OptInstr[j] != B32PInstrWrite) ||
+      !OptArgsAre(j, 3, OptArgConst, OptArgReg, OptArgReg))
+    return 0;
+  t = OptArgVal[i][2];
+  a = OptArgVal[j];
+  if (a[1] != t || !OptFitsConst(a[0] + k))
+    return 0;
+  if (OptInstr[j] == B32PInstrWrite ? (a[2] == t || OptLiveAfter(j, t)) : (a[2] != t && OptLiveAfter(j, t)))
+    return 0;
+  a[0] += k;
+  a[1] = OptArgVal[i][0];
+  OptModified[j] = 1;
+  OptDeleted[i] = 1;
+  return 1;
+}
+
+// write O rB rX; ...; read O rB rY  ->  write O rB rX; ...; or r0 rX rY
+// read O rB rX; ...; read O rB rY  ->  read O rB rX; ...; or r0 rX rY
+// Only for the stack (rB is sp or fp), other addresses may be memory mapped I/O.
+STATIC
+int OptReload(int i)
+{
+  int j, o, b, x;
+  unsigned use, def;
+
+  if ((OptInstr[i] != B32PInstrRead && OptInstr[i] != B32PInstrWrite) ||
+      !OptArgsAre(i, 3, OptArgConst, OptArgReg, OptArgReg))
+    return 0;
+  o = OptArgVal[i][0];
+  b = OptArgVal[i][1];
+  x = OptArgVal[i][2];
+  if ((b != B32POpRegSp && b != B32POpRegFp) || x == b || x == B32POpRegZero)
+    return 0;
+
+  for (j = OptNextInstr(i); j >= 0; j = OptNextInstr(j))
+  {
+    int instr = OptInstr[j];
+    if (instr == B32PInstrRead && OptArgsAre(j, 3, OptArgConst, OptArgReg, OptArgReg) &&
+        OptArgVal[j][0] == o && OptArgVal[j][1] == b)
+    {
+      if (OptArgVal[j][2] == x)
+        OptDeleted[j] = 1;
+      else
+        OptSetRegInstr(j, B32PInstrOR, B32POpRegZero, x, OptArgVal[j][2]);
+      return 1;
+    }
+    // Stop at anything that may change the memory or the registers
+    if (instr == B32PInstrWrite || instr == B32PInstrJump || instr == B32PInstrJumpr ||
+        instr == B32PInstrSavPC || instr == B32PInstrHalt ||
+        !OptLineUseDef(j, &use, &def) || (def & ((1u << b) | (1u << x))))
+      break;
+  }
+  return 0;
+}
+
+// op ... rT; or r0 rT rD  ->  op ... rD
+// (if rT isn't used afterwards)
+STATIC
+int OptCopyForward(int i)
+{
+  int p, t, instr;
+  unsigned use, def;
+
+  if (!OptIsMove(i) || (t = OptArgVal[i][1]) == OptArgVal[i][2] || t == B32POpRegZero ||
+      (p = OptPrevInstr(i)) < 0)
+    return 0;
+  instr = OptInstr[p];
+  if (!(OptIsAlu(p) || instr == B32PInstrNOT || instr == B32PInstrRead ||
+        instr == B32PInstrLoad || instr == B32PInstrAddr2reg) ||
+      !OptLineUseDef(p, &use, &def) || def != (1u << t) || OptLiveAfter(i, t))
+    return 0;
+  OptArgVal[p][OptArgCnt[p] - 1] = OptArgVal[i][2];
+  OptModified[p] = 1;
+  OptDeleted[i] = 1;
+  return 1;
+}
+
+// or r0 rS rT; op ... rT ...  ->  op ... rS ...
+// (if rT isn't used afterwards, instructions in between may not use rS or rT)
+STATIC
+int OptCopyBack(int i)
+{
+  int j, s, t;
+  unsigned use, def;
+
+  if (!OptIsMove(i) || (s = OptArgVal[i][1]) == (t = OptArgVal[i][2]) || t == B32POpRegZero)
+    return 0;
+  for (j = OptNextInstr(i); ; j = OptNextInstr(j))
+  {
+    if (j < 0 || !OptLineUseDef(j, &use, &def))
+      return 0;
+    if (use & (1u << t))
+      break;
+    if (((use | def) & ((1u << s) | (1u << t))) || OptIsBranch(OptInstr[j]) ||
+        OptInstr[j] == B32PInstrJump || OptInstr[j] == B32PInstrJumpr)
+      return 0;
+  }
+  if ((!(def & (1u << t)) && OptLiveAfter(j, t)) || !OptReplaceUse(j, t, s))
+    return 0;
+  OptDeleted[i] = 1;
+  return 1;
+}
+
+// Checks whether the register operands of line i can be renamed
+STATIC
+int OptCanRename(int i)
+{
+  int instr = OptInstr[i];
+  return OptIsAlu(i) || OptIsBranch(instr) ||
+         (instr == B32PInstrNOT && OptArgsAre(i, 2, OptArgReg, OptArgReg, 0)) ||
+         ((instr == B32PInstrRead || instr == B32PInstrWrite) &&
+          OptArgsAre(i, 3, OptArgConst, OptArgReg, OptArgReg)) ||
+         ((instr == B32PInstrLoad || instr == B32PInstrAddr2reg) && OptArgCnt[i] == 2);
+}
+
+// op ... rS; ... rS ...  ->  op ... rF; ... rF ...
+// Moves a short-lived value from a callee-saved register rS into
+// a free register rF that doesn't need to be saved
+STATIC
+int OptRenameSaved(int i)
+{
+  static int regs[] =
+  {
+    TEMP_REG_A, TEMP_REG_B, B32POpRegAt,
+    B32POpRegA3, B32POpRegA2, B32POpRegA1, B32POpRegA0, B32POpRegV0
+  };
+  int j, k, r, last = -1;
+  unsigned use, def, refs, live;
+
+  if (!OptCanRename(i) || OptIsBranch(OptInstr[i]) || OptInstr[i] == B32PInstrWrite ||
+      !OptLineUseDef(i, &use, &def) || (def & (def - 1)) || !(def & OPT_CALLEE_SAVED) || !OptFresh())
+    return 0;
+  r = OptArgVal[i][OptArgCnt[i] - 1];
+  refs = use | def;
+  live = OptOut[OptNodeOf[i]][0];
+
+  // Find the end of the value's live range in the basic block
+  for (j = OptNextInstr(i); j >= 0 && last < 0; j = OptNextInstr(j))
+  {
+    int instr = OptInstr[j];
+    if (instr == B32PInstrJump || instr == B32PInstrJumpr || instr == B32PInstrSavPC ||
+        instr == B32PInstrHalt || !OptLineUseDef(j, &use, &def))
+      return 0;
+    refs |= use | def;
+    live |= OptOut[OptNodeOf[j]][0];
+    if ((use | def) & (1u << r))
+    {
+      if (!(use & (1u << r)) || !OptCanRename(j))
+        return 0;
+      if (!(def & (1u << r)) && !OptTestBit(OptOut[OptNodeOf[j]], r))
+        last = j;
+    }
+    if (OptIsBranch(instr) && last < 0)
+      return 0;
+  }
+  if (last < 0)
+    return 0;
+
+  for (k = 0; k < (int)(sizeof regs / sizeof regs[0]); k++)
+    if (!((refs | live) & (1u << regs[k])))
+      break;
+  if (k == (int)(sizeof regs / sizeof regs[0]))
+    return 0;
+
+  OptArgVal[i][OptArgCnt[i] - 1] = regs[k];
+  OptModified[i] = 1;
+  for (j = OptNextInstr(i); ; j = OptNextInstr(j))
+  {
+    OptReplaceUse(j, r, regs[k]);
+    if (OptLineUseDef(j, &use, &def) && (def & (1u << r)))
+    {
+      OptArgVal[j][OptArgCnt[j] - 1] = regs[k];
+      OptModified[j] = 1;
+    }
+    if (j == last)
+      break;
+  }
+  return 1;
+}
+
+// Removes instructions without side effects whose results aren't used
+STATIC
+int OptDeadCode(int i)
+{
+  int instr = OptInstr[i];
+  int d;
+  unsigned use, def;
+
+  if (!(OptIsAlu(i) || instr == B32PInstrNOT || instr == B32PInstrLoad || instr == B32PInstrLoadHi ||
+        instr == B32PInstrAddr2reg ||
+        (instr == B32PInstrRead && (OptArgVal[i][1] == B32POpRegSp || OptArgVal[i][1] == B32POpRegFp))) ||
+      !OptLineUseDef(i, &use, &def))
+    return 0;
+  d = OptArgVal[i][OptArgCnt[i] - 1];
+  if (d == B32POpRegZero || d > TEMP_REG_B || def != (1u << d) || OptLiveAfter(i, d))
+    return 0;
+  OptDeleted[i] = 1;
+  return 1;
+}
+
+// The first node of the loop that node n jumps or branches back to, -1 if none
+STATIC
+int OptLoopHead(int n)
+{
+  int i = OptNodeLine[n], t = -1;
+  if (OptInstr[i] == B32PInstrJump && !OptCall[n])
+    t = OptSucc[n][0];
+  else if (OptIsBranch(OptInstr[i]) && OptArgType[i][2] == OptArgSym)
+    t = OptSucc[n][1];
+  return (t >= 0 && t <= n) ? t : -1;
+}
+
+// Checks whether register r is read when the nodes t..n are left through node m
+STATIC
+int OptLiveOnExit(int m, int t, int n, int r)
+{
+  int k, s;
+  for (k = 0; k < 2; k++)
+  {
+    s = OptSucc[m][k];
+    if (s >= OptNodeCnt)
+    {
+      if (r == B32POpRegV0 || (OPT_GP_LIVE & (1u << r)))
+        return 1;
+    }
+    else if (s >= 0 && (s < t || s > n) && OptTestBit(OptIn[s], r))
+      return 1;
+  }
+  if (OptTable[m] >= 0)
+    for (k = OptTable[m]; k < OptLineCnt && OptTableEntry(k); k++)
+    {
+      s = OptTableNode[k];
+      if (s >= OptNodeCnt || ((s < t || s > n) && OptTestBit(OptIn[s], r)))
+        return 1;
+    }
+  return 0;
+}
+
+// add rI K rI  ->  (nothing)
+// (in a loop that doesn't read rI otherwise and after which rI isn't used)
+STATIC
+int OptDeadCounter(int i)
+{
+  int k, r, n, m, t = -1;
+
+  if (!OptIsAddConst(i, &k) || (r = OptArgVal[i][0]) != OptArgVal[i][2] ||
+      r == B32POpRegZero || r > TEMP_REG_B || !OptFresh())
+    return 0;
+  n = OptNodeOf[i];
+  for (m = n; m < OptNodeCnt; m++)
+    if ((t = OptLoopHead(m)) >= 0 && t <= n)
+      break;
+  if (m == OptNodeCnt)
+    return 0;
+  for (k = t; k <= m; k++)
+    if ((k != n && OptTestBit(OptUse[k], r)) || OptLiveOnExit(k, t, m, r))
+      return 0;
+  OptDeleted[i] = 1;
+  return 1;
+}
+
+// Checks whether line i is "op r13 K r13" with K the size of a word
+STATIC
+int OptIsStackAdjust(int i, int instr)
+{
+  return OptInstr[i] == instr && OptArgsAre(i, 3, OptArgReg, OptArgConst, OptArgReg) &&
+         OptArgVal[i][0] == B32POpRegSp && OptArgVal[i][1] == SizeOfWord && OptArgVal[i][2] == B32POpRegSp;
+}
+
+// Checks whether line i is "instr 0 r13 rN"
+STATIC
+int OptIsStackTop(int i, int instr)
+{
+  return OptInstr[i] == instr && OptArgsAre(i, 3, OptArgConst, OptArgReg, OptArgReg) &&
+         OptArgVal[i][0] == 0 && OptArgVal[i][1] == B32POpRegSp;
+}
+
+// sub r13 W r13; write 0 r13 rX; ...; read 0 r13 rY; add r13 W r13  ->  or r0 rX rT; ...; or r0 rT rY
+// (an intermediate result the code generator keeps on the stack, if a register is free for it)
+STATIC
+int OptStackTemp(int i)
+{
+  int w, j, t, k, end;
+  unsigned use, def, busy = 0, changed = 0;
+
+  if (!OptIsStackAdjust(i, B32PInstrSUB) || (w = OptNextInstr(i)) < 0 || !OptIsStackTop(w, B32PInstrWrite))
+    return 0;
+  for (j = OptNextInstr(w); j >= 0 && !OptIsStackTop(j, B32PInstrRead); j = OptNextInstr(j))
+  {
+    if (!OptLineUseDef(j, &use, &def) || ((use | def) & (1u << B32POpRegSp)) ||
+        OptIsBranch(OptInstr[j]) || OptInstr[j] == B32PInstrJump || OptInstr[j] == B32PInstrJumpr)
+      return 0;
+    busy |= use | def;
+    changed |= def;
+  }
+  if (j < 0 || (end = OptNextInstr(j)) < 0 || !OptIsStackAdjust(end, B32PInstrADD) || !OptFresh())
+    return 0;
+
+  // rX itself if it keeps the value, otherwise a register unused until the read
+  t = OptArgVal[w][2];
+  if (changed & (1u << t))
+  {
+    for (k = 0; k < OPT_POOL_SIZE; k++)
+    {
+      t = OptPool[k];
+      if ((OPT_CALL_CLOBBERED & (1u << t)) && !(busy & (1u << t)) && !OptLiveAfter(w, t))
+        break;
+    }
+    if (k == OPT_POOL_SIZE)
+      return 0;
+  }
+
+  OptDeleted[i] = OptDeleted[end] = 1;
+  if (t == OptArgVal[w][2])
+    OptDeleted[w] = 1;
+  else
+    OptSetRegInstr(w, B32PInstrOR, B32POpRegZero, OptArgVal[w][2], t);
+  OptSetRegInstr(j, B32PInstrOR, B32POpRegZero, t, OptArgVal[j][2]);
+  return 1;
+}
+
+STATIC
+int OptApplyRule(int rule, int i)
+{
+  switch (rule)
+  {
+  case OptRuleBranchOverJump: return OptBranchOverJump(i);
+  case OptRuleJumpToNext: return OptJumpToNext(i);
+  case OptRuleUnreachable: return OptUnreachable(i);
+  case OptRuleIdentity: return OptIdentity(i);
+  case OptRuleFoldConst: return OptFoldConst(i);
+  case OptRuleSmallConst: return OptSmallConst(i);
+  case OptRuleFoldAdd: return OptFoldAdd(i);
+  case OptRuleFoldOffset: return OptFoldOffset(i);
+  case OptRuleReload: return OptReload(i);
+  case OptRuleCopyForward: return OptCopyForward(i);
+  case OptRuleCopyBack: return OptCopyBack(i);
+  case OptRuleRenameSaved: return OptRenameSaved(i);
+  case OptRuleDeadCode: return OptDeadCode(i);
+  case OptRuleDeadCounter: return OptDeadCounter(i);
+  case OptRuleStackTemp: return OptStackTemp(i);
+  }
+  return 0;
+}
+
+// Applies the rules until none of them applies anymore.
+// Returns 0 if the result can't be analyzed.
+STATIC
+int OptPeephole(void)
+{
+  int i, rule, changed, sweeps = 0;
+  int instrs, words;
+
+  OptCountCode(&instrs, &words);
+  OptBranchesFit = words < 32767;
+  OptStale = 1;
+
+  do
+  {
+    changed = 0;
+    for (rule = 0; rule < OPT_RULE_CNT; rule++)
+      for (i = 0; i < OptLineCnt; i++)
+        if (OptKind[i] == OptKindInstr && !OptDeleted[i] && OptApplyRule(rule, i))
+        {
+          int newInstrs, newWords;
+          OptStale = changed = 1;
+          OptCountCode(&newInstrs, &newWords);
+          OptRuleApplied[rule]++;
+          OptRuleInstrs[rule] += instrs - newInstrs;
+          OptRuleWords[rule] += words - newWords;
+          instrs = newInstrs;
+          words = newWords;
+        }
+  } while (changed && ++sweeps < OPT_MAX_SWEEPS);
+
+  return OptFresh();
+}
+
+// Inserts an instruction line before line i, filled in by the caller
+STATIC
+void OptInsertLine(int i)
+{
+  int cnt = OptLineCnt - i;
+  static char empty[] = "";
+
+  memmove(OptLine + i + 1, OptLine + i, cnt * sizeof OptLine[0]);
+  memmove(OptKind + i + 1, OptKind + i, cnt * sizeof OptKind[0]);
+  memmove(OptModified + i + 1, OptModified + i, cnt * sizeof OptModified[0]);
+  memmove(OptDeleted + i + 1, OptDeleted + i, cnt * sizeof OptDeleted[0]);
+  memmove(OptInstr + i + 1, OptInstr + i, cnt * sizeof OptInstr[0]);
+  memmove(OptArgCnt + i + 1, OptArgCnt + i, cnt * sizeof OptArgCnt[0]);
+  memmove(OptArgType + i + 1, OptArgType + i, cnt * sizeof OptArgType[0]);
+  memmove(OptArgVal + i + 1, OptArgVal + i, cnt * sizeof OptArgVal[0]);
+  OptLineCnt++;
+
+  OptLine[i] = empty; // printed from OptInstr/OptArg*
+  OptKind[i] = OptKindInstr;
+  OptModified[i] = 1;
+  OptDeleted[i] = 0;
+  OptArgCnt[i] = 0;
+  OptStale = 1;
+}
+
+// Value propagation (-O2, see the top of the file).
+// In front of every node, each register holds a value: the result of the node
+// that wrote it last on all paths (OPT_VAL_DEF), or a phi of the node where
+// paths with different values meet (OPT_VAL_PHI). The first node is the phi of
+// the values the caller passes in.
+
+#define MAX_OPT_SSA_NODES 0x4000 // larger functions are left alone
+#define OPT_SSA_HASH 1024
+
+#define OPT_VAL_TOP 0 // no path reaches it yet
+#define OPT_VAL_DEF(n, r) ((((n) + 1) << 4) | (r))
+#define OPT_VAL_PHI(n, r) (-OPT_VAL_DEF(n, r))
+#define OPT_VAL_NODE(v) (((((v) < 0) ? -(v) : (v)) >> 4) - 1)
+
+// What is known about the value of a node or a phi
+#define OptConstTop     0 // nothing yet, may still become a constant
+#define OptConstKnown   1
+#define OptConstVarying 2
+
+int OptSsaVal[MAX_OPT_SSA_NODES][16]; // values of the registers in front of a node
+unsigned char OptSsaReached[MAX_OPT_SSA_NODES];
+unsigned char OptSsaDefKind[MAX_OPT_SSA_NODES]; // the result of a node
+int OptSsaDefConst[MAX_OPT_SSA_NODES];
+unsigned char OptSsaPhiKind[MAX_OPT_SSA_NODES][16];
+int OptSsaPhiConst[MAX_OPT_SSA_NODES][16];
+int OptSsaHash[OPT_SSA_HASH]; // nodes with the same hash of their operation, for CSE
+int OptSsaNext[MAX_OPT_SSA_NODES];
+int OptSsaSame[MAX_OPT_SSA_NODES]; // for computations replaced with copies, the node they copy
+
+// Results that are also copied to an unused register, to be taken from there later
+#define MAX_OPT_SSA_KEEP 16
+int OptSsaKeepCnt;
+int OptSsaKeepNode[MAX_OPT_SSA_KEEP];
+int OptSsaKeepReg[MAX_OPT_SSA_KEEP]; // -1 while not needed
+unsigned char OptSsaKeepIn[MAX_OPT_SSA_KEEP][MAX_OPT_SSA_NODES]; // the copy is there in front of a node
+unsigned OptSsaFree; // registers the function doesn't use
+
+// Totals for the whole translation unit, printed with -verbose
+int OptSsaConsts; // results and operands replaced with constants
+int OptSsaBranches; // branches decided
+int OptSsaUnreached; // instructions removed
+int OptSsaCse; // computations replaced with copies
+
+// The only register written by node n, if it's a computation without side effects, else -1
+STATIC
+int OptSsaDefReg(int n)
+{
+  int i = OptNodeLine[n], r;
+  unsigned def = OptDef[n][0] & 0xFFFF;
+  if (!(OptIsAlu(i) || OptInstr[i] == B32PInstrNOT || OptInstr[i] == B32PInstrLoad ||
+        OptInstr[i] == B32PInstrLoadHi || OptInstr[i] == B32PInstrAddr2reg) ||
+      OptCall[n] || !def || (def & (def - 1)))
+    return -1;
+  for (r = 0; !(def & (1u << r)); r++)
+    ;
+  return r;
+}
+
+// What is known about value v, a constant goes to *c
+STATIC
+int OptSsaConst(int v, int* c)
+{
+  int n = OPT_VAL_NODE(v);
+  if (v == OPT_VAL_TOP)
+    return OptConstTop;
+  if (v < 0)
+  {
+    *c = OptSsaPhiConst[n][(-v) & 15];
+    return OptSsaPhiKind[n][(-v) & 15];
+  }
+  *c = OptSsaDefConst[n];
+  return OptSsaDefKind[n];
+}
+
+// What is known about operand k of node n
+STATIC
+int OptSsaArg(int n, int k, int* c)
+{
+  int i = OptNodeLine[n];
+  if (OptArgType[i][k] == OptArgConst)
+  {
+    *c = OptArgVal[i][k];
+    return OptConstKnown;
+  }
+  if (OptArgType[i][k] != OptArgReg)
+    return OptConstVarying;
+  if (OptArgVal[i][k] == B32POpRegZero)
+  {
+    *c = 0;
+    return OptConstKnown;
+  }
+  return OptSsaConst(OptSsaVal[n][OptArgVal[i][k]], c);
+}
+
+// Combines what is known about a value with another possibility
+STATIC
+int OptSsaMeet(unsigned char* kind, int* c, int kind2, int c2)
+{
+  if (kind2 == OptConstTop || *kind == OptConstVarying)
+    return 0;
+  if (*kind == OptConstTop)
+  {
+    *kind = kind2;
+    *c = c2;
+    return 1;
+  }
+  if (kind2 == OptConstKnown && c2 == *c)
+    return 0;
+  *kind = OptConstVarying;
+  return 1;
+}
+
+// Computes the result of node n from what is known about its operands
+STATIC
+int OptSsaEval(int n, int* c)
+{
+  int i = OptNodeLine[n], instr = OptInstr[i];
+  int ka, kb, a = 0, b = 0;
+  unsigned x, y, r;
+
+  if (OptSsaDefReg(n) < 0 || instr == B32PInstrAddr2reg || instr == B32PInstrMULTFP)
+    return OptConstVarying;
+  if (instr == B32PInstrLoad)
+    return OptSsaArg(n, 0, c);
+  if (instr == B32PInstrLoadHi)
+  {
+    if ((kb = OptSsaArg(n, 1, &b)) != OptConstKnown)
+      return kb;
+    *c = (int)(((unsigned)b & 0xFFFF) | ((unsigned)OptArgVal[i][0] << 16));
+    return OptConstKnown;
+  }
+  ka = OptSsaArg(n, 0, &a);
+  kb = (instr == B32PInstrNOT) ? OptConstKnown : OptSsaArg(n, 1, &b);
+  if (ka == OptConstVarying || kb == OptConstVarying)
+    return OptConstVarying;
+  if (ka == OptConstTop || kb == OptConstTop)
+    return OptConstTop;
+
+  x = a;
+  y = b;
+  switch (instr)
+  {
+  case B32PInstrOR: r = x | y; break;
+  case B32PInstrAND: r = x & y; break;
+  case B32PInstrXOR: r = x ^ y; break;
+  case B32PInstrADD: r = x + y; break;
+  case B32PInstrSUB: r = x - y; break;
+  case B32PInstrSHIFTL: r = (y < 32) ? x << y : 0; break;
+  case B32PInstrSHIFTR: r = (y < 32) ? x >> y : 0; break;
+  case B32PInstrSHIFTRS:
+    if (y > 31)
+      y = 31;
+    r = x >> y;
+    if (x & 0x80000000u)
+      r |= ~(0xFFFFFFFFu >> y);
+    break;
+  case B32PInstrMULTS:
+  case B32PInstrMULTU: r = x * y; break;
+  case B32PInstrSLT: r = a < b; break;
+  case B32PInstrSLTU: r = x < y; break;
+  case B32PInstrNOT: r = ~x; break;
+  default: return OptConstVarying;
+  }
+  *c = (int)(r & 0xFFFFFFFFu);
+  return OptConstKnown;
+}
+
+// Decides the branch of node n: 1 if it's taken, 0 if not,
+// -1 if it may go either way and -2 if it's not known yet
+STATIC
+int OptSsaBranch(int n)
+{
+  int ka, kb, a = 0, b = 0;
+  unsigned x, y;
+
+  ka = OptSsaArg(n, 0, &a);
+  kb = OptSsaArg(n, 1, &b);
+  if (ka == OptConstVarying || kb == OptConstVarying)
+    return -1;
+  if (ka == OptConstTop || kb == OptConstTop)
+    return -2;
+  x = a;
+  y = b;
+  switch (OptInstr[OptNodeLine[n]])
+  {
+  case B32PInstrBEQ: return x == y;
+  case B32PInstrBNE: return x != y;
+  case B32PInstrBGT: return x > y;
+  case B32PInstrBGE: return x >= y;
+  case B32PInstrBLT: return x < y;
+  case B32PInstrBLE: return x <= y;
+  case B32PInstrBGTS: return a > b;
+  case B32PInstrBGES: return a >= b;
+  case B32PInstrBLTS: return a < b;
+  default: return a <= b;
+  }
+}
+
+// Successor k of node n, -2 if that path can't be taken and -1 after the last one
+STATIC
+int OptSsaSucc(int n, int k)
+{
+  int j;
+  if (OptIsBranch(OptInstr[OptNodeLine[n]]))
+  {
+    int t = OptSsaBranch(n);
+    if (k > 1)
+      return -1;
+    if (t == -2 || t == !k)
+      return -2;
+  }
+  if (k < 2)
+    return (OptSucc[n][k] < 0) ? -2 : OptSucc[n][k];
+  if (OptTable[n] < 0)
+    return -1;
+  j = OptTable[n] + k - 2;
+  return (j < OptLineCnt && OptTableEntry(j)) ? OptTableNode[j] : -1;
+}
+
+// Passes the register values after node n on to node s
+STATIC
+int OptSsaFlow(int n, int s)
+{
+  int r, changed = 0;
+  unsigned def = OptDef[n][0];
+
+  if (s >= OptNodeCnt)
+    return 0;
+  if (!OptSsaReached[s])
+    OptSsaReached[s] = changed = 1;
+
+  for (r = 1; r < 16; r++)
+  {
+    int out = (def & (1u << r)) ? OPT_VAL_DEF(n, r) : OptSsaVal[n][r];
+    int cur = OptSsaVal[s][r], phi = OPT_VAL_PHI(s, r), c = 0, kind;
+    if (cur == out)
+      continue;
+    if (cur == OPT_VAL_TOP)
+    {
+      OptSsaVal[s][r] = out;
+      changed = 1;
+      continue;
+    }
+    if (cur != phi)
+    {
+      OptSsaVal[s][r] = phi;
+      changed = 1;
+      kind = OptSsaConst(cur, &c);
+      OptSsaMeet(&OptSsaPhiKind[s][r], &OptSsaPhiConst[s][r], kind, c);
+    }
+    kind = OptSsaConst(out, &c);
+    changed |= OptSsaMeet(&OptSsaPhiKind[s][r], &OptSsaPhiConst[s][r], kind, c);
+  }
+  return changed;
+}
+
+// Finds the register values, the constants and the reachable nodes
+// (sparse conditional constant propagation, on the registers)
+STATIC
+void OptSsaPropagate(void)
+{
+  int n, r, changed;
+
+  for (n = 0; n < OptNodeCnt; n++)
+  {
+    OptSsaReached[n] = 0;
+    OptSsaDefKind[n] = OptConstTop;
+    for (r = 0; r < 16; r++)
+    {
+      OptSsaVal[n][r] = OPT_VAL_TOP;
+      OptSsaPhiKind[n][r] = OptConstTop;
+    }
+  }
+  OptSsaReached[0] = 1;
+  for (r = 0; r < 16; r++)
+  {
+    OptSsaVal[0][r] = OPT_VAL_PHI(0, r);
+    OptSsaPhiKind[0][r] = OptConstVarying;
+  }
+
+  do
+  {
+    changed = 0;
+    for (n = 0; n < OptNodeCnt; n++)
+    {
+      int c = 0, kind, k, s;
+      if (!OptSsaReached[n])
+        continue;
+      kind = OptSsaEval(n, &c);
+      changed |= OptSsaMeet(&OptSsaDefKind[n], &OptSsaDefConst[n], kind, c);
+      for (k = 0; (s = OptSsaSucc(n, k)) != -1; k++)
+        if (s >= 0)
+          changed |= OptSsaFlow(n, s);
+    }
+  } while (changed);
+}
+
+// Value v with copies followed back to the value they copy
+STATIC
+int OptSsaSource(int v)
+{
+  int k;
+  for (k = 0; k < 16 && v > 0; k++)
+  {
+    int n = OPT_VAL_NODE(v), i = OptNodeLine[n];
+    if (OptSsaSame[n] >= 0)
+      v = OPT_VAL_DEF(OptSsaSame[n], OptSsaDefReg(OptSsaSame[n]));
+    else if (OptIsMove(i) && OptArgVal[i][1] != B32POpRegZero)
+      v = OptSsaVal[n][OptArgVal[i][1]];
+    else
+      break;
+  }
+  return v;
+}
+
+// Checks whether operand k of nodes n and m is the same
+STATIC
+int OptSsaSameArg(int n, int m, int k)
+{
+  int i = OptNodeLine[n], j = OptNodeLine[m];
+  int kn, km, cn = 0, cm = 0;
+
+  if (OptArgType[i][k] == OptArgSym || OptArgType[j][k] == OptArgSym)
+  {
+    char* s = OptText + OptArgVal[i][k];
+    int l = OptTokenLen(s);
+    return OptArgType[i][k] == OptArgType[j][k] && OptTokenLen(OptText + OptArgVal[j][k]) == l &&
+           !strncmp(s, OptText + OptArgVal[j][k], l);
+  }
+  kn = OptSsaArg(n, k, &cn);
+  km = OptSsaArg(m, k, &cm);
+  if (kn == OptConstKnown || km == OptConstKnown)
+    return kn == km && cn == cm;
+  return OptArgType[i][k] == OptArgReg && OptArgType[j][k] == OptArgReg &&
+         OptSsaSource(OptSsaVal[n][OptArgVal[i][k]]) == OptSsaSource(OptSsaVal[m][OptArgVal[j][k]]);
+}
+
+// Hash of the operation of node n for OptSsaHash[]
+STATIC
+unsigned OptSsaKey(int n)
+{
+  int i = OptNodeLine[n], k;
+  unsigned h = OptInstr[i];
+  for (k = 0; k < OptArgCnt[i] - 1; k++)
+  {
+    int c = 0;
+    if (OptArgType[i][k] == OptArgSym)
+    {
+      char* s = OptText + OptArgVal[i][k];
+      int l = OptTokenLen(s);
+      while (l--)
+        h = h * 31 + (unsigned char)*s++;
+    }
+    else if (OptSsaArg(n, k, &c) == OptConstKnown)
+      h = h * 31 + (unsigned)c;
+    else if (OptArgType[i][k] == OptArgReg)
+      h = h * 31 + (unsigned)OptSsaSource(OptSsaVal[n][OptArgVal[i][k]]);
+  }
+  return h % OPT_SSA_HASH;
+}
+
+// Replaces register operands of node n that hold known constants
+STATIC
+int OptSsaConstArgs(int n)
+{
+  int i = OptNodeLine[n], k, c = 0, found = 0;
+  int* a = OptArgVal[i];
+
+  for (k = 0; k < OptArgCnt[i]; k++)
+    if (OptArgType[i][k] == OptArgReg && a[k] != B32POpRegZero &&
+        OptSsaArg(n, k, &c) == OptConstKnown && c == 0)
+      found |= OptReplaceUse(i, a[k], B32POpRegZero);
+
+  if (OptIsAlu(i) && !OptIsMove(i) && OptArgType[i][1] == OptArgReg && a[0] != a[1])
+  {
+    int instr = OptInstr[i];
+    if (OptSsaArg(n, 1, &c) == OptConstKnown && OptFitsConst(c) && a[1] != B32POpRegZero)
+    {
+      OptArgType[i][1] = OptArgConst;
+      a[1] = c;
+      OptModified[i] = found = 1;
+    }
+    else if (OptSsaArg(n, 0, &c) == OptConstKnown && OptFitsConst(c) && a[0] != B32POpRegZero &&
+             (instr == B32PInstrADD || instr == B32PInstrOR || instr == B32PInstrAND ||
+              instr == B32PInstrXOR || instr == B32PInstrMULTS || instr == B32PInstrMULTU))
+    {
+      a[0] = a[1];
+      OptArgType[i][1] = OptArgConst;
+      a[1] = c;
+      OptModified[i] = found = 1;
+    }
+  }
+  return found;
+}
+
+// Finds a register that holds the result of node m in front of node n,
+// which the result is copied to if needed. Returns -1 if there's none.
+STATIC
+int OptSsaKeep(int m, int n)
+{
+  int k, s, p, changed, r;
+  unsigned char* in;
+
+  if (OptLoopDepth[m] > OptLoopDepth[n])
+    return -1; // the copy would run more often than the computation it saves
+  for (k = 0; k < OptSsaKeepCnt && OptSsaKeepNode[k] != m; k++)
+    ;
+  if (k == OptSsaKeepCnt)
+  {
+    // Calls change all the registers the copy may go to, so it stays in place
+    // from m on every path to a node without calls
+    if (k == MAX_OPT_SSA_KEEP || !OptSsaFree)
+      return -1;
+    OptSsaKeepCnt++;
+    OptSsaKeepNode[k] = m;
+    OptSsaKeepReg[k] = -1;
+    in = OptSsaKeepIn[k];
+    for (p = 0; p < OptNodeCnt; p++)
+      in[p] = p != 0;
+    do
+    {
+      changed = 0;
+      for (p = 0; p < OptNodeCnt; p++)
+      {
+        int out = (p == m) || (in[p] && !OptCall[p]), j;
+        if (!OptSsaReached[p] || out)
+          continue;
+        for (j = 0; (s = OptSsaSucc(p, j)) != -1; j++)
+          if (s >= 0 && s < OptNodeCnt && in[s])
+            in[s] = 0, changed = 1;
+      }
+    } while (changed);
+  }
+
+  if (!OptSsaKeepIn[k][n])
+    return -1;
+  if (OptSsaKeepReg[k] < 0)
+  {
+    for (r = 0; r < OPT_POOL_SIZE && !(OptSsaFree & (1u << OptPool[r])); r++)
+      ;
+    if (r == OPT_POOL_SIZE)
+      return -1;
+    OptSsaKeepReg[k] = OptPool[r];
+    OptSsaFree &= ~(1u << OptPool[r]);
+  }
+  return OptSsaKeepReg[k];
+}
+
+// Rewrites the code with what OptSsaPropagate() found:
+// unreachable code is removed, branches with known outcome become jumps or go away,
+// constant results are loaded directly, constant operands are put into the
+// instructions and recomputed values are copied from the register that has them
+// (with keep, also from a copy made for that in an unused register).
+// Returns the number of changes.
+STATIC
+int OptSsa(int keep)
+{
+  int n, i, changes = 0;
+
+  if (!OptFresh() || OptNodeCnt > MAX_OPT_SSA_NODES)
+    return 0;
+  // Relative branches count on the words they jump over
+  for (n = 0; n < OptNodeCnt; n++)
+  {
+    i = OptNodeLine[n];
+    if (OptIsBranch(OptInstr[i]) && OptArgType[i][2] != OptArgSym)
+      return 0;
+  }
+
+  OptSsaPropagate();
+  for (n = 0; n < OPT_SSA_HASH; n++)
+    OptSsaHash[n] = -1;
+  OptSsaKeepCnt = 0;
+  OptSsaFree = OPT_CALL_CLOBBERED & ~(1u << B32POpRegRa);
+  for (n = 0; n < OptNodeCnt; n++)
+  {
+    OptSsaSame[n] = -1;
+    OptLoopDepth[n] = 0;
+    if (!OptCall[n])
+      OptSsaFree &= ~(OptUse[n][0] | OptDef[n][0]);
+  }
+  for (n = 0; n < OptNodeCnt; n++)
+  {
+    int k, t, j;
+    for (k = 0; k < 2; k++)
+      if ((t = OptSucc[n][k]) >= 0 && t <= n && !OptCall[n])
+        for (j = t; j <= n; j++)
+          OptLoopDepth[j]++;
+  }
+
+  for (n = 0; n < OptNodeCnt; n++)
+  {
+    int c = 0, d, m, words;
+    unsigned h;
+    i = OptNodeLine[n];
+
+    if (!OptSsaReached[n])
+    {
+      OptDeleted[i] = 1;
+      OptSsaUnreached++;
+      changes++;
+      continue;
+    }
+
+    if (OptIsBranch(OptInstr[i]))
+    {
+      int t = OptSsaBranch(n);
+      if (t == 1)
+      {
+        OptInstr[i] = B32PInstrJump;
+        OptArgCnt[i] = 1;
+        OptArgType[i][0] = OptArgSym;
+        OptArgVal[i][0] = OptArgVal[i][2];
+        OptModified[i] = 1;
+      }
+      else if (t == 0)
+        OptDeleted[i] = 1;
+      else
+      {
+        if (OptSsaConstArgs(n))
+        {
+          OptSsaConsts++;
+          changes++;
+        }
+        continue;
+      }
+      OptSsaBranches++;
+      changes++;
+      continue;
+    }
+
+    if ((d = OptSsaDefReg(n)) < 0)
+    {
+      if (OptSsaConstArgs(n))
+      {
+        OptSsaConsts++;
+        changes++;
+      }
+      continue;
+    }
+
+    words = OptWords(i);
+    if (OptSsaDefKind[n] == OptConstKnown)
+    {
+      c = OptSsaDefConst[n];
+      if ((OptInstr[i] == B32PInstrLoad && OptArgType[i][0] == OptArgConst) ||
+          (OptIsAlu(i) && OptArgVal[i][0] == B32POpRegZero &&
+           (OptArgType[i][1] == OptArgConst || OptArgVal[i][1] == B32POpRegZero)))
+        continue; // loads a constant already
+      if (words < 2 && !(c >= -32767 && c <= 0xFFFF))
+        continue; // would take more words to load
+      OptInstr[i] = B32PInstrLoad;
+      OptArgCnt[i] = 2;
+      OptArgType[i][0] = OptArgConst;
+      OptArgVal[i][0] = c;
+      OptArgType[i][1] = OptArgReg;
+      OptArgVal[i][1] = d;
+      OptModified[i] = 1;
+      OptSsaConsts++;
+      changes++;
+      continue;
+    }
+
+    // Common subexpressions: the same operation on the same values, while the
+    // register that received the first result still holds it
+    if (OptIsMove(i) || (OptInstr[i] == B32PInstrLoad && words < 2) ||
+        OptInstr[i] == B32PInstrLoadHi)
+      continue;
+    h = OptSsaKey(n);
+    for (m = OptSsaHash[h]; m >= 0; m = OptSsaNext[m])
+    {
+      int j = OptNodeLine[m], k, r;
+      if (OptInstr[j] != OptInstr[i] || OptArgCnt[j] != OptArgCnt[i])
+        continue;
+      for (k = 0; k < OptArgCnt[i] - 1; k++)
+        if (!OptSsaSameArg(n, m, k))
+          break;
+      if (k < OptArgCnt[i] - 1)
+        continue;
+      r = OptSsaDefReg(m);
+      if (OptSsaVal[n][r] != OPT_VAL_DEF(m, r) && (!keep || (r = OptSsaKeep(m, n)) < 0))
+        continue;
+      if (r == d)
+        OptDeleted[i] = 1;
+      else
+        OptSetRegInstr(i, B32PInstrOR, B32POpRegZero, r, d);
+      OptSsaSame[n] = m;
+      OptSsaCse++;
+      changes++;
+      break;
+    }
+    if (m < 0)
+    {
+      OptSsaConstArgs(n);
+      OptSsaNext[n] = OptSsaHash[h];
+      OptSsaHash[h] = n;
+    }
+  }
+
+  // Copy the kept results, last line first as the lines move
+  for (;;)
+  {
+    int last = -1, k;
+    for (k = 0; k < OptSsaKeepCnt; k++)
+      if (OptSsaKeepReg[k] >= 0 && (last < 0 || OptSsaKeepNode[k] > OptSsaKeepNode[last]))
+        last = k;
+    if (last < 0)
+      break;
+    n = OptSsaKeepNode[last];
+    i = OptNodeLine[n] + 1;
+    OptInsertLine(i);
+    OptSetRegInstr(i, B32PInstrOR, B32POpRegZero, OptSsaDefReg(n), OptSsaKeepReg[last]);
+    OptSsaKeepReg[last] = -1;
+  }
+
+  if (changes)
+    OptStale = 1;
+  return changes;
+}
+
+// Loop optimization (see the top of the file).
+// New instructions for a loop go in front of it, into the "preheader".
+
+// Line positions that OptLoopInsert() keeps up to date
+#define OptPosPre   0 // where the preheader instructions go
+#define OptPosCur   1 // the instruction being looked at
+#define OptPosLast  2 // the backward jump
+#define OptPosInc   3 // + rI: the "add rI K rI" of induction variable rI
+#define OPT_POS_CNT (OptPosInc + 16)
+
+int OptLoopPos[OPT_POS_CNT];
+unsigned OptLoopBusy; // registers that can't be used for new values in the loop
+unsigned OptLoopDefs; // registers changed in the loop
+int OptIvBase[16]; // for induction variables, the rI that advances them, -1 for other registers
+int OptIvStep[16]; // amount added with every "add rI K rI"
+unsigned char OptIvPtr[16]; // includes an address (added register)
+unsigned char OptIvNew[16]; // created for the loop
+
+// Totals for the whole translation unit, printed with -verbose
+int OptLoopHoisted;
+int OptLoopReduced;
+int OptLoopTests;
+
+STATIC
+int OptLoopInsert(int pos)
+{
+  int k;
+  OptInsertLine(pos);
+  for (k = 0; k < OPT_POS_CNT; k++)
+    if (OptLoopPos[k] >= pos)
+      OptLoopPos[k]++;
+  return pos;
+}
+
+// Appends a copy of the current instruction to the preheader with rD as the result
+STATIC
+void OptLoopPreheader(int d)
+{
+  int j = OptLoopInsert(OptLoopPos[OptPosPre]);
+  int i = OptLoopPos[OptPosCur];
+  OptInstr[j] = OptInstr[i];
+  OptArgCnt[j] = OptArgCnt[i];
+  memcpy(OptArgType[j], OptArgType[i], sizeof OptArgType[0]);
+  memcpy(OptArgVal[j], OptArgVal[i], sizeof OptArgVal[0]);
+  OptArgVal[j][OptArgCnt[j] - 1] = d;
+}
+
+// A register that's free in the whole loop, -1 if there's none
+STATIC
+int OptLoopFreeReg(void)
+{
+  int j, r;
+  for (j = 0; j < OPT_POOL_SIZE; j++)
+  {
+    r = OptPool[j];
+    if (!(OptLoopBusy & (1u << r)) && !(GenGlobalPtr && r == GP_REG))
+    {
+      OptLoopBusy |= 1u << r;
+      return r;
+    }
+  }
+  return -1;
+}
+
+// Turns the instruction at line i into "or r0 rS rD" and lets the following
+// instructions of its basic block read rS instead of rD, up to line stop
+STATIC
+void OptLoopReplace(int i, int s, int stop)
+{
+  int d = OptArgVal[i][OptArgCnt[i] - 1];
+  int k;
+  unsigned use, def;
+
+  OptSetRegInstr(i, B32PInstrOR, B32POpRegZero, s, d);
+  for (k = OptNextInstr(i); k >= 0 && k != stop; k = OptNextInstr(k))
+  {
+    if (!OptLineUseDef(k, &use, &def) ||
+        ((use & (1u << d)) && !OptReplaceUse(k, d, s)) ||
+        (def & ((1u << d) | (1u << s))))
+      break;
+  }
+}
+
+// Checks whether register operand k of line i has the same value in the whole loop
+STATIC
+int OptLoopInvariant(int i, int k)
+{
+  return OptArgType[i][k] != OptArgReg || !(OptLoopDefs & (1u << OptArgVal[i][k]));
+}
+
+STATIC
+int OptLoopIsIv(int i, int k)
+{
+  return OptArgType[i][k] == OptArgReg && OptIvBase[OptArgVal[i][k]] >= 0;
+}
+
+// Computes a value of the loop in the preheader if it doesn't change
+STATIC
+int OptLoopHoist(int i)
+{
+  int instr = OptInstr[i], r;
+
+  if (instr == B32PInstrAddr2reg || instr == B32PInstrLoad)
+  {
+    if (OptArgType[i][0] == OptArgReg)
+      return 0;
+  }
+  else if (!OptIsAlu(i) || OptIsMove(i) || !OptLoopInvariant(i, 0) || !OptLoopInvariant(i, 1))
+    return 0;
+
+  if ((r = OptLoopFreeReg()) < 0)
+    return 0;
+  OptLoopPreheader(r);
+  OptLoopReplace(OptLoopPos[OptPosCur], r, -1);
+  OptLoopHoisted++;
+  return 1;
+}
+
+// Gives a shift, multiplication or addition of an induction variable a register
+// of its own that advances with the induction variable
+STATIC
+int OptLoopReduce(int i)
+{
+  int instr = OptInstr[i];
+  int x, base, step, ptr = 0, r, j;
+
+  if (!OptIsAlu(i))
+    return 0;
+  x = OptLoopIsIv(i, 0) ? 0 : 1;
+  if (!OptLoopIsIv(i, x) || !OptLoopInvariant(i, !x))
+    return 0;
+  base = OptIvBase[OptArgVal[i][x]];
+  step = OptIvStep[OptArgVal[i][x]];
+
+  switch (instr)
+  {
+  case B32PInstrADD:
+    ptr = OptArgType[i][!x] == OptArgReg && OptArgVal[i][!x] != B32POpRegZero;
+    break;
+  case B32PInstrSUB:
+    if (x)
+      step = -step;
+    break;
+  case B32PInstrSHIFTL:
+    if (x || OptArgType[i][1] != OptArgConst || (unsigned)OptArgVal[i][1] > 15)
+      return 0;
+    step <<= OptArgVal[i][1];
+    break;
+  case B32PInstrMULTS:
+  case B32PInstrMULTU:
+    if (x || OptArgType[i][1] != OptArgConst || !OptFitsConst(OptArgVal[i][1]))
+      return 0;
+    step *= OptArgVal[i][1];
+    break;
+  default:
+    return 0;
+  }
+  ptr |= OptIvPtr[OptArgVal[i][x]];
+  if (!OptFitsConst(step) || (r = OptLoopFreeReg()) < 0)
+    return 0;
+
+  OptLoopPreheader(r);
+  j = OptLoopInsert(OptLoopPos[OptPosInc + base] + 1);
+  OptSetRegInstr(j, B32PInstrADD, r, 0, r);
+  OptArgType[j][1] = OptArgConst;
+  OptArgVal[j][1] = step;
+  OptLoopReplace(OptLoopPos[OptPosCur], r, OptLoopPos[OptPosInc + base]);
+
+  OptLoopDefs |= 1u << r;
+  OptIvBase[r] = base;
+  OptIvStep[r] = step;
+  OptIvPtr[r] = ptr;
+  OptIvNew[r] = 1;
+  OptLoopReduced++;
+  return 1;
+}
+
+// Replaces "slt rI X rD" (or "slt X rI rD", or a branch comparing rI with X) with a
+// comparison of a pointer that advances with rI against its value at the end,
+// if rI isn't needed otherwise
+STATIC
+int OptLoopTest(int iv, unsigned exitLive)
+{
+  int inc = OptLoopPos[OptPosInc + iv];
+  int i, cmp = -1, x, p, r, c, j;
+  unsigned use, def;
+
+  if ((exitLive & (1u << iv)) || OptIvStep[iv] <= 0 || OptLineCnt + 8 >= MAX_OPT_LINES)
+    return 0;
+  for (i = OptLoopPos[OptPosPre]; i <= OptLoopPos[OptPosLast]; i++)
+  {
+    if (OptKind[i] != OptKindInstr || OptDeleted[i] || i == inc || !OptLineUseDef(i, &use, &def))
+      continue;
+    if (use & (1u << iv))
+    {
+      if (cmp >= 0)
+        return 0;
+      cmp = i;
+    }
+  }
+  if (cmp < 0 ||
+      !(((OptInstr[cmp] == B32PInstrSLT || OptInstr[cmp] == B32PInstrSLTU) && OptIsAlu(cmp)) ||
+        (OptIsBranch(OptInstr[cmp]) && OptArgType[cmp][2] == OptArgSym)))
+    return 0;
+  x = (OptArgType[cmp][0] == OptArgReg && OptArgVal[cmp][0] == iv) ? 0 : 1;
+  if (OptArgType[cmp][x] != OptArgReg || OptArgVal[cmp][x] != iv || !OptLoopInvariant(cmp, !x))
+    return 0;
+  OptLoopPos[OptPosCur] = cmp;
+
+  for (p = 0; p < 16; p++)
+    if (OptIvNew[p] && OptIvBase[p] == iv && OptIvPtr[p] &&
+        OptIvStep[p] > 0 && OptIvStep[p] % OptIvStep[iv] == 0)
+      break;
+  if (p == 16 || (r = OptLoopFreeReg()) < 0)
+    return 0;
+  c = OptIvStep[p] / OptIvStep[iv];
+
+  // r = p + (X - rI) * c
+  j = OptLoopInsert(OptLoopPos[OptPosPre]);
+  OptSetRegInstr(j, B32PInstrSUB, OptArgVal[OptLoopPos[OptPosCur]][!x], iv, r);
+  if (OptArgType[OptLoopPos[OptPosCur]][!x] == OptArgConst)
+  {
+    OptArgVal[j][0] = B32POpRegZero;
+    j = OptLoopInsert(OptLoopPos[OptPosPre]);
+    OptSetRegInstr(j, B32PInstrADD, r, 0, r);
+    OptArgType[j][1] = OptArgConst;
+    OptArgVal[j][1] = OptArgVal[OptLoopPos[OptPosCur]][1];
+  }
+  if (c != 1)
+  {
+    j = OptLoopInsert(OptLoopPos[OptPosPre]);
+    OptSetRegInstr(j, B32PInstrMULTS, r, 0, r);
+    OptArgType[j][1] = OptArgConst;
+    OptArgVal[j][1] = c;
+  }
+  j = OptLoopInsert(OptLoopPos[OptPosPre]);
+  OptSetRegInstr(j, B32PInstrADD, r, p, r);
+
+  cmp = OptLoopPos[OptPosCur];
+  OptArgType[cmp][x] = OptArgType[cmp][!x] = OptArgReg;
+  OptArgVal[cmp][x] = p;
+  OptArgVal[cmp][!x] = r;
+  OptModified[cmp] = 1;
+  OptDeleted[OptLoopPos[OptPosInc + iv]] = 1;
+  OptLoopTests++;
+  return 1;
+}
+
+// Checks that the nodes t..n are only entered at t, by falling into it
+STATIC
+int OptLoopEntered(int t, int n)
+{
+  int m, s, k;
+  for (m = 0; m < OptNodeCnt; m++)
+  {
+    if (m >= t && m <= n)
+      continue;
+    for (s = 0; s < 2; s++)
+    {
+      k = OptSucc[m][s];
+      if (k >= t && k <= n &&
+          !(k == t && m == t - 1 && s == 0 && OptInstr[OptNodeLine[m]] != B32PInstrJump &&
+            !(OptIsBranch(OptInstr[OptNodeLine[m]]) && OptArgType[OptNodeLine[m]][2] == OptArgConst)))
+        return 0;
+    }
+    if (OptTable[m] >= 0)
+      for (k = OptTable[m]; k < OptLineCnt && OptTableEntry(k); k++)
+        if (OptTableNode[k] >= t && OptTableNode[k] <= n)
+          return 0;
+  }
+  return 1;
+}
+
+// Optimizes the loop of nodes t..n, returns 1 if it changed anything
+STATIC
+int OptLoop(int t, int n)
+{
+  int defCnt[16];
+  int m, r, i, k, changed = 0;
+  unsigned use, def, exitLive = 0;
+
+  for (r = 0; r < 16; r++)
+  {
+    defCnt[r] = 0;
+    OptIvBase[r] = -1;
+    OptIvPtr[r] = OptIvNew[r] = 0;
+  }
+  for (k = 0; k < OPT_POS_CNT; k++)
+    OptLoopPos[k] = -1;
+
+  OptLoopDefs = 0;
+  OptLoopBusy = OptIn[t][0] | OPT_GP_LIVE;
+  for (m = t; m <= n; m++)
+  {
+    i = OptNodeLine[m];
+    OptLoopBusy |= OptUse[m][0] | OptDef[m][0];
+    OptLoopDefs |= OptDef[m][0];
+    for (r = 0; r < 16; r++)
+      if (OptDef[m][0] & (1u << r))
+      {
+        defCnt[r]++;
+        OptLoopPos[OptPosInc + r] = i;
+      }
+    for (k = 0; k < 2; k++)
+    {
+      int s = OptSucc[m][k];
+      if (s >= OptNodeCnt)
+        exitLive |= (1u << B32POpRegV0) | OPT_GP_LIVE;
+      else if (s >= 0 && (s < t || s > n))
+        exitLive |= OptIn[s][0];
+    }
+    if (OptTable[m] >= 0)
+      return 0;
+  }
+
+  // Induction variables
+  for (r = 1; r < 16; r++)
+  {
+    i = OptLoopPos[OptPosInc + r];
+    if (defCnt[r] == 1 && r < B32POpRegSp && OptIsAddConst(i, &k) &&
+        OptArgVal[i][0] == r && OptArgVal[i][2] == r && k)
+    {
+      OptIvBase[r] = r;
+      OptIvStep[r] = k;
+    }
+    else
+      OptLoopPos[OptPosInc + r] = -1;
+  }
+
+  OptLoopPos[OptPosPre] = (t > 0) ? OptNodeLine[t - 1] + 1 : 0;
+  OptLoopPos[OptPosLast] = OptNodeLine[n];
+  for (OptLoopPos[OptPosCur] = OptNodeLine[t];
+       OptLoopPos[OptPosCur] < OptLoopPos[OptPosLast];
+       OptLoopPos[OptPosCur]++)
+  {
+    i = OptLoopPos[OptPosCur];
+    if (OptKind[i] != OptKindInstr || OptDeleted[i] ||
+        !OptLineUseDef(i, &use, &def) || !def || (def & (def - 1)) || def >= (1u << B32POpRegSp))
+      continue;
+    for (r = 0; def != 1u << r; r++)
+      ;
+    if (OptIvBase[r] >= 0)
+      continue; // the increment of an induction variable
+    if (OptLineCnt + 8 >= MAX_OPT_LINES)
+      break;
+    changed |= OptLoopHoist(i) || OptLoopReduce(i);
+  }
+
+  for (r = 1; r < 16; r++)
+    if (OptIvBase[r] == r && OptLoopTest(r, exitLive))
+      changed = 1;
+
+  return changed;
+}
+
+// Optimizes the loops of the function, innermost first.
+// Returns 0 if the result can't be analyzed.
+STATIC
+int OptLoops(void)
+{
+  static char* done[MAX_OPT_LINES / 8];
+  int doneCnt = 0;
+  int instrs, words;
+
+  OptCountCode(&instrs, &words);
+  if (words >= 30000) // may push branches out of range
+    return 1;
+
+  for (;;)
+  {
+    int n, best = -1, k;
+    if (!OptFresh())
+      return 0;
+    // Find the smallest loop not looked at yet
+    for (n = 0; n < OptNodeCnt; n++)
+    {
+      int i = OptNodeLine[n], t = OptLoopHead(n);
+      if (t < 0)
+        continue;
+      for (k = 0; k < doneCnt && done[k] != OptLine[i]; k++)
+        ;
+      if (k == doneCnt && (best < 0 || n - t < best - OptLoopHead(best)))
+        best = n;
+    }
+    if (best < 0 || doneCnt == sizeof done / sizeof done[0])
+      break;
+    done[doneCnt++] = OptLine[OptNodeLine[best]];
+    // Clean up after each loop, so the registers it no longer needs are free for the next one
+    if (OptLoopEntered(OptLoopHead(best), best) && OptLoop(OptLoopHead(best), best) && !OptPeephole())
+      return 0;
+  }
+  return 1;
+}
+
+// Inlining (see the top of the file).
+// The bodies of the functions that can be inlined are kept as text: the name of
+// the function, then its instructions, each '\0' terminated.
+
+#define MAX_OPT_INLINE       512
+#define MAX_OPT_INLINE_TEXT  0x10000
+#define MAX_OPT_INLINE_LINES 64
+#define OPT_INLINE_WORDS     6  // size up to which functions are inlined
+#define OPT_INLINE_WORDS_MAX 32 // same for functions declared inline
+
+char OptInlineText[MAX_OPT_INLINE_TEXT];
+int OptInlineTextLen;
+int OptInlineStart[MAX_OPT_INLINE]; // offset of the name in OptInlineText
+int OptInlineLines[MAX_OPT_INLINE];
+int OptInlineCnt;
+int OptInlined; // calls replaced
+
+// Appends a line to OptInlineText
+STATIC
+int OptInlinePut(char* s)
+{
+  int l = strlen(s) + 1;
+  if (OptInlineTextLen + l > MAX_OPT_INLINE_TEXT)
+    return 0;
+  memcpy(OptInlineText + OptInlineTextLen, s, l);
+  OptInlineTextLen += l;
+  return 1;
+}
+
+// Appends the instruction at line i to OptInlineText
+STATIC
+int OptInlinePutInstr(int i)
+{
+  char buf[256];
+  int k, l;
+
+  l = sprintf(buf, " %s", GenInstrName(OptInstr[i]));
+  for (k = 0; k < OptArgCnt[i]; k++)
+  {
+    char* a = OptText + OptArgVal[i][k];
+    if (OptArgType[i][k] == OptArgReg)
+      l += sprintf(buf + l, " r%d", OptArgVal[i][k]);
+    else if (OptArgType[i][k] == OptArgConst)
+      l += sprintf(buf + l, " %d", OptArgVal[i][k]);
+    else if (OptTokenLen(a) < 200)
+      l += sprintf(buf + l, " %.*s", OptTokenLen(a), a);
+    else
+      return 0;
+  }
+  return OptInlinePut(buf);
+}
+
+STATIC
+int OptInlinePutMove(int from, int to)
+{
+  char buf[32];
+  sprintf(buf, " or r0 r%d r%d", from, to);
+  return OptInlinePut(buf);
+}
+
+// Checks whether line i is a comment or an empty line
+STATIC
+int OptIsComment(int i)
+{
+  char* p = OptLine[i];
+  while (OptIsSpace(*p))
+    p++;
+  return *p == '\0' || *p == ';';
+}
+
+// Checks the registers of an instruction that may be inlined: it can't touch
+// the stack, the frame or the return address, and can only change the
+// registers a call may change.
+STATIC
+int OptInlineRegsOk(int i, unsigned use, unsigned def)
+{
+  unsigned frame = (1u << B32POpRegSp) | (1u << B32POpRegFp) | (1u << B32POpRegRa);
+  int instr = OptInstr[i];
+  if (instr == B32PInstrJump || instr == B32PInstrJumpr || OptIsBranch(instr) ||
+      instr == B32PInstrHalt || instr == B32PInstrSavPC)
+    return 0;
+  return !((use | def) & frame) && !(def & ~OPT_CALL_CLOBBERED);
+}
+
+// Drops the body being added
+STATIC
+void OptInlineUndo(int start)
+{
+  OptInlineTextLen = start;
+}
+
+// Ends the body started at start, if it's small enough
+STATIC
+void OptInlineDone(int start, int lines, int words)
+{
+  if (lines > MAX_OPT_INLINE_LINES ||
+      words > (CurFxnInline ? OPT_INLINE_WORDS_MAX : OPT_INLINE_WORDS))
+  {
+    OptInlineUndo(start);
+    return;
+  }
+  OptInlineStart[OptInlineCnt] = start;
+  OptInlineLines[OptInlineCnt++] = lines;
+}
+
+// Keeps the body of an optimized function for inlining if it's straight code
+// that needs no frame and no callee-saved registers
+STATIC
+void OptInlineFxn(void)
+{
+  int i, s, lines = 0, words = 0, start = OptInlineTextLen;
+  unsigned use, def;
+
+  if (IsMain || OptSavedCnt || OptInlineCnt >= MAX_OPT_INLINE || !OptInlinePut(CurFxnName))
+    return;
+
+  // The parameter moves of the prolog
+  for (s = 0; s < OptSlotCnt; s++)
+  {
+    int ofs = OptSlotOfs[s], r = OptSlotReg[s], idx;
+    if (r < 0 || ofs < 2 * SizeOfWord)
+      continue;
+    idx = (ofs - 2 * SizeOfWord) / SizeOfWord;
+    if (idx >= 4)
+    {
+      OptInlineUndo(start);
+      return;
+    }
+    if (r != B32POpRegA0 + idx)
+    {
+      if (!OptInlinePutMove(B32POpRegA0 + idx, r))
+      {
+        OptInlineUndo(start);
+        return;
+      }
+      lines++;
+      words++;
+    }
+  }
+
+  for (i = 0; i < OptLineCnt; i++)
+  {
+    if (OptDeleted[i] || OptKind[i] == OptKindLabel) // no jumps, so no label is used
+      continue;
+    if (OptKind[i] != OptKindInstr)
+    {
+      if (OptIsComment(i))
+        continue;
+      OptInlineUndo(start);
+      return;
+    }
+    if (!OptLineUseDef(i, &use, &def) || !OptInlineRegsOk(i, use, def) || !OptInlinePutInstr(i))
+    {
+      OptInlineUndo(start);
+      return;
+    }
+    lines++;
+    words += OptWords(i);
+  }
+
+  OptInlineDone(start, lines, words);
+}
+
+// Keeps the asm code of a function written as
+//   word retval = 0;
+//   asm("... write -4 r14 rX ...");
+//   return retval;
+// (or a void function with just asm()) for inlining, if it only takes its
+// parameters from r4-r7. The store to retval becomes a move to r2 and the
+// pushes and pops around the code of registers that a call may change anyway
+// are dropped.
+STATIC
+void OptInlineAsm(void)
+{
+  int code[MAX_OPT_INLINE_LINES + 1];
+  int i, k, cnt = 0, pushes = 0, pops, ret = -1, init = 0, returns = 0, after = 0, ok = 1;
+  int lines = 0, words = 0, start = OptInlineTextLen;
+  unsigned use, def;
+
+  if (IsMain || OptInlineCnt >= MAX_OPT_INLINE)
+    return;
+
+  for (i = 0; i < OptLineCnt && ok; i++)
+  {
+    if (OptDeleted[i] || OptIsComment(i))
+      continue;
+    switch (OptKind[i])
+    {
+    case OptKindAsm:
+      OptParseLine(i, 1);
+      if (OptKind[i] == OptKindInstr && OptInstr[i] >= 0 && !after && cnt < MAX_OPT_INLINE_LINES)
+        code[cnt++] = i;
+      else
+        ok = 0;
+      OptKind[i] = OptKindAsm;
+      break;
+    case OptKindInstr:
+      // retval = 0 before the asm code, return retval after it
+      if (OptInstr[i] == B32PInstrWrite && !cnt && !init &&
+          OptArgsAre(i, 3, OptArgConst, OptArgReg, OptArgReg) && OptArgVal[i][0] == -SizeOfWord &&
+          OptArgVal[i][1] == B32POpRegFp && OptArgVal[i][2] == B32POpRegZero)
+        init = 1;
+      else if (GenGlobalPtr && cnt && !returns &&
+               ((OptInstr[i] == B32PInstrAddr2reg && OptArgsAre(i, 2, OptArgSym, OptArgReg, 0) &&
+                 OptArgVal[i][1] == GP_REG && OptNameEqual(OptText + OptArgVal[i][0], "GlobalPtr_Base:")) ||
+                (OptInstr[i] == B32PInstrADD && OptArgsAre(i, 3, OptArgReg, OptArgConst, OptArgReg) &&
+                 OptArgVal[i][0] == GP_REG && OptArgVal[i][2] == GP_REG)))
+        ; // setting the global pointer again after the asm code, it doesn't change it
+      else if (OptInstr[i] == B32PInstrRead && cnt && !returns &&
+               OptArgsAre(i, 3, OptArgConst, OptArgReg, OptArgReg) && OptArgVal[i][0] == -SizeOfWord &&
+               OptArgVal[i][1] == B32POpRegFp && OptArgVal[i][2] == B32POpRegV0)
+        returns = after = 1;
+      else
+        ok = 0;
+      break;
+    case OptKindLabel:
+      after = 1; // the epilog
+      break;
+    default:
+      ok = 0;
+      break;
+    }
+  }
+  if (!ok || !cnt || (returns && !init))
+    return;
+
+  // The pushes at the beginning and the pops at the end
+  while (pushes < cnt && OptInstr[code[pushes]] == B32PInstrPush)
+    pushes++;
+  for (pops = 0; pops < pushes && pops < cnt - pushes; pops++)
+  {
+    int p = code[pops], q = code[cnt - 1 - pops];
+    if (OptInstr[q] != B32PInstrPop || !OptArgsAre(p, 1, OptArgReg, 0, 0) || !OptArgsAre(q, 1, OptArgReg, 0, 0) ||
+        OptArgVal[p][0] != OptArgVal[q][0] || !(OPT_CALL_CLOBBERED & (1u << OptArgVal[p][0])))
+      break;
+  }
+  if (pops != pushes)
+    return;
+
+  for (k = pushes; k < cnt - pops; k++)
+  {
+    i = code[k];
+    if (OptInstr[i] == B32PInstrPush || OptInstr[i] == B32PInstrPop || !OptRegUseDef(i, 0, &use, &def))
+      return;
+    if (OptInstr[i] == B32PInstrWrite && OptArgVal[i][0] == -SizeOfWord && OptArgVal[i][1] == B32POpRegFp)
+    {
+      // The store to retval, nothing may change the value in r2 after it
+      if (ret >= 0 || !returns)
+        return;
+      ret = k;
+      continue;
+    }
+    if (!OptInlineRegsOk(i, use, def) || (ret >= 0 && (def & (1u << B32POpRegV0))))
+      return;
+  }
+
+  if (!OptInlinePut(CurFxnName))
+    return;
+  for (k = pushes; k < cnt - pops; k++)
+  {
+    i = code[k];
+    if (k != ret)
+      ok = OptInlinePutInstr(i);
+    else if (OptArgVal[i][2] != B32POpRegV0)
+      ok = OptInlinePutMove(OptArgVal[i][2], B32POpRegV0);
+    else
+      continue;
+    if (!ok)
+    {
+      OptInlineUndo(start);
+      return;
+    }
+    lines++;
+    words += OptWords(i);
+  }
+  if (returns && ret < 0)
+  {
+    // retval is still 0
+    if (!OptInlinePutMove(B32POpRegZero, B32POpRegV0))
+    {
+      OptInlineUndo(start);
+      return;
+    }
+    lines++;
+    words++;
+  }
+
+  OptInlineDone(start, lines, words);
+}
+
+// Replaces the calls of the functions kept by OptInlineFxn()/OptInlineAsm() with
+// their bodies. Runs on the function as read, before it's analyzed.
+STATIC
+void OptInlineCalls(void)
+{
+  int i, f, k, savpc = 0;
+
+  for (i = 0; i < OptLineCnt; i++)
+  {
+    int jump = i, add, call, p, q, n, l;
+    char* body;
+    if (OptKind[i] != OptKindInstr || OptDeleted[i])
+      continue;
+    if (OptInstr[i] == B32PInstrSavPC)
+      savpc++;
+    if (OptInstr[i] != B32PInstrJump || !OptArgsAre(i, 1, OptArgSym, 0, 0) || !OptIsCall(i))
+      continue;
+    l = OptTokenLen(OptText + OptArgVal[i][0]);
+    for (f = 0; f < OptInlineCnt; f++)
+      if ((int)strlen(OptInlineText + OptInlineStart[f]) == l &&
+          !strncmp(OptText + OptArgVal[i][0], OptInlineText + OptInlineStart[f], l))
+        break;
+    if (f == OptInlineCnt)
+      continue;
+
+    // savpc r15, add r15 3 r15, jump f
+    add = OptPrevInstr(jump);
+    call = OptPrevInstr(add);
+    p = OptPrevInstr(call);
+    n = OptNextInstr(jump);
+    OptDeleted[call] = OptDeleted[add] = OptDeleted[jump] = 1;
+    savpc--;
+    // The space reserved for the parameters isn't needed either
+    if (p >= 0 && n >= 0 && OptInstr[p] == B32PInstrSUB && OptInstr[n] == B32PInstrADD &&
+        OptArgsAre(p, 3, OptArgReg, OptArgConst, OptArgReg) && OptArgsAre(n, 3, OptArgReg, OptArgConst, OptArgReg) &&
+        OptArgVal[p][0] == B32POpRegSp && OptArgVal[p][2] == B32POpRegSp &&
+        OptArgVal[n][0] == B32POpRegSp && OptArgVal[n][2] == B32POpRegSp)
+    {
+      OptDeleted[p] = 1;
+      if ((OptArgVal[n][1] -= OptArgVal[p][1]) == 0)
+        OptDeleted[n] = 1;
+      OptModified[n] = 1;
+    }
+
+    body = OptInlineText + OptInlineStart[f];
+    for (k = 0; k < OptInlineLines[f]; k++)
+    {
+      body += strlen(body) + 1;
+      l = strlen(body) + 1;
+      if (OptTextLen + l > MAX_OPT_TEXT || OptLineCnt >= MAX_OPT_LINES)
+        error("Function is too big for -O\n");
+      memcpy(OptText + OptTextLen, body, l);
+      OptInsertLine(q = jump + 1 + k);
+      OptLine[q] = OptText + OptTextLen;
+      OptTextLen += l;
+      OptParseLine(q, 1);
+    }
+    i += k;
+    OptInlined++;
+  }
+
+  // All calls inlined, the return address doesn't need to be saved
+  if (!savpc && !GenFxnHasAsm)
+    GenLeaf = 1;
+}
+
+// Frameless functions (see the top of the file)
+
+int OptFrameless; // functions without a frame
+
+// Checks whether the function can do without the prolog and the epilog
+STATIC
+int OptNeedsNoFrame(void)
+{
+  unsigned use, def, frame = (1u << B32POpRegSp) | (1u << B32POpRegFp);
+  int i, s;
+
+  if (OptSavedCnt)
+    return 0;
+  // parameters after the 4th are read from the frame by the prolog
+  for (s = 0; s < OptSlotCnt; s++)
+    if (OptSlotReg[s] >= 0 && OptSlotOfs[s] >= 6 * SizeOfWord)
+      return 0;
+  for (i = 0; i < OptLineCnt; i++)
+  {
+    if (OptKind[i] == OptKindAsm)
+      return 0;
+    if (OptKind[i] != OptKindInstr || OptDeleted[i])
+      continue;
+    if (OptInstr[i] == B32PInstrSavPC ||
+        !OptLineUseDef(i, &use, &def) || ((use | def) & frame))
+      return 0;
+  }
+  return 1;
+}
+
+// Tail calls (see the top of the file)
+
+#define MAX_OPT_TAILS 256
+
+int OptTailCalled; // calls turned into jumps
+
+// Checks whether the function may give away an address in its frame
+// (of a local, a parameter or a temporary) that a callee could still use
+STATIC
+int OptFrameEscapes(void)
+{
+  unsigned use, def, frame = (1u << B32POpRegSp) | (1u << B32POpRegFp);
+  int i;
+
+  for (i = 0; i < OptLineCnt; i++)
+  {
+    if (OptKind[i] != OptKindInstr || OptDeleted[i] || OptIsCall(i))
+      continue;
+    if (!OptLineUseDef(i, &use, &def))
+      return 1;
+    if (!(use & frame))
+      continue;
+    // reads and writes of the frame
+    if ((OptInstr[i] == B32PInstrRead || OptInstr[i] == B32PInstrWrite) &&
+        OptArgsAre(i, 3, OptArgConst, OptArgReg, OptArgReg) && !(frame & (1u << OptArgVal[i][2])))
+      continue;
+    // stack adjustments
+    if ((OptInstr[i] == B32PInstrADD || OptInstr[i] == B32PInstrSUB) &&
+        OptArgsAre(i, 3, OptArgReg, OptArgConst, OptArgReg) &&
+        OptArgVal[i][0] == B32POpRegSp && OptArgVal[i][2] == B32POpRegSp)
+      continue;
+    return 1;
+  }
+  return 0;
+}
+
+// Checks whether line i is "op r13 K r13"
+STATIC
+int OptIsStackAdjustBy(int i, int instr, int k)
+{
+  return OptInstr[i] == instr && OptArgsAre(i, 3, OptArgReg, OptArgConst, OptArgReg) &&
+         OptArgVal[i][0] == B32POpRegSp && OptArgVal[i][1] == k && OptArgVal[i][2] == B32POpRegSp;
+}
+
+// Checks whether the code after line i goes to the epilog without doing anything
+STATIC
+int OptReturnsAfter(int i)
+{
+  int steps = 0;
+
+  while (++i < OptLineCnt)
+  {
+    if (++steps > OptLineCnt)
+      return 0; // jumps in a circle
+    if (OptDeleted[i] || OptKind[i] == OptKindLabel)
+      continue;
+    if (OptKind[i] != OptKindInstr)
+    {
+      if (OptIsComment(i))
+        continue;
+      return 0;
+    }
+    if (OptInstr[i] != B32PInstrJump || !OptArgsAre(i, 1, OptArgSym, 0, 0) || (i = OptFindLabel(i, 0)) < 0)
+      return 0;
+  }
+  return 1; // the epilog follows the last line
+}
+
+// Inserts "instr a0 a1 a2" before line i, operand c is a constant, the others are registers
+STATIC
+void OptInsertInstr(int i, int instr, int a0, int a1, int a2, int c)
+{
+  OptInsertLine(i);
+  OptSetRegInstr(i, instr, a0, a1, a2);
+  OptArgType[i][c] = OptArgConst;
+}
+
+// Turns calls whose result is returned right away into jumps to the callee
+// that leave the frame of the function first.
+// The callee then returns straight to the caller of the function.
+STATIC
+void OptTailCalls(int savedOfs)
+{
+  int tails[MAX_OPT_TAILS];
+  int i, k, cnt = 0, savpc = 0;
+
+  // main(), interrupt() and syscall() are jumped to from asm code that doesn't
+  // reserve the space for parameters above r13 that the callee may use
+  if (IsMain || !strcmp(CurFxnName, "interrupt") || !strcmp(CurFxnName, "syscall") ||
+      OptFrameEscapes())
+    return;
+
+  for (i = 0; i < OptLineCnt; i++)
+  {
+    int add, call, p, n;
+    if (OptKind[i] != OptKindInstr || OptDeleted[i])
+      continue;
+    if (OptInstr[i] == B32PInstrSavPC)
+      savpc++;
+    if (!OptIsCall(i))
+      continue;
+
+    // sub r13 16 r13, savpc r15, add r15 3 r15, jump f / jumpr 0 rN, add r13 16 r13
+    // (no parameters passed on the stack)
+    add = OptPrevInstr(i);
+    call = OptPrevInstr(add);
+    p = OptPrevInstr(call);
+    n = OptNextInstr(i);
+    if (cnt == MAX_OPT_TAILS || OptLineCnt + (OptSavedCnt + 3) * (cnt + 1) > MAX_OPT_LINES ||
+        p < 0 || n < 0 ||
+        !OptIsStackAdjustBy(p, B32PInstrSUB, 4 * SizeOfWord) ||
+        !OptIsStackAdjustBy(n, B32PInstrADD, 4 * SizeOfWord) ||
+        !OptReturnsAfter(n))
+      continue;
+    if (OptInstr[i] == B32PInstrJumpr)
+    {
+      // the address must survive restoring the registers
+      int r = OptArgVal[i][1];
+      if (!OptArgsAre(i, 2, OptArgConst, OptArgReg, 0) ||
+          r == B32POpRegSp || r == B32POpRegFp || r == B32POpRegRa || (OPT_CALLEE_SAVED & (1u << r)))
+        continue;
+    }
+
+    OptDeleted[p] = OptDeleted[call] = OptDeleted[add] = OptDeleted[n] = 1;
+    savpc--;
+    tails[cnt++] = i;
+  }
+  if (!cnt)
+    return;
+
+  // Only tail calls, the return address stays in r15
+  if (!savpc)
+    GenLeaf = 1;
+  OptTailCalled += cnt;
+
+  // Without a frame there's nothing to remove
+  if (OptNeedsNoFrame())
+    return;
+
+  // The epilog in front of each jump, last first for the line numbers to stay valid
+  while (cnt--)
+  {
+    i = tails[cnt];
+    for (k = 0; k < OptSavedCnt; k++)
+      OptInsertInstr(i++, B32PInstrRead, savedOfs - SizeOfWord * (k + 1), B32POpRegFp, OptSavedRegs[k], 0);
+    if (!GenLeaf)
+      OptInsertInstr(i++, B32PInstrRead, SizeOfWord, B32POpRegFp, B32POpRegRa, 0);
+    OptInsertInstr(i++, B32PInstrRead, 0, B32POpRegFp, B32POpRegFp, 0);
+    OptInsertInstr(i, B32PInstrADD, B32POpRegSp, 2 * SizeOfWord - CurFxnMinLocalOfs, B32POpRegSp, 1);
+  }
+}
+
+// Scheduling (see the top of the file)
+
+#define MAX_OPT_BLOCK 64 // longer blocks are scheduled in parts
+
+int OptSchedLine[MAX_OPT_BLOCK]; // instruction lines of the block, in program order
+unsigned OptSchedUse[MAX_OPT_BLOCK], OptSchedDef[MAX_OPT_BLOCK];
+int OptSchedHeight[MAX_OPT_BLOCK]; // cycles from the instruction to the end of the block
+int OptSchedOrder[MAX_OPT_BLOCK];
+unsigned char OptSchedDone[MAX_OPT_BLOCK];
+int OptStallsFound; // load-use stalls before scheduling
+int OptStallsRemoved;
+
+// Register that the instruction at line i reads from memory, 0 if none.
+// The next instruction waits a cycle for it if it uses that register.
+STATIC
+int OptLoadedReg(int i)
+{
+  if (i < 0 || OptKind[i] != OptKindInstr || OptDeleted[i])
+    return 0;
+  if (OptInstr[i] == B32PInstrRead && OptArgsAre(i, 3, OptArgConst, OptArgReg, OptArgReg))
+    return OptArgVal[i][2];
+  if (OptInstr[i] == B32PInstrPop && OptArgsAre(i, 1, OptArgReg, 0, 0))
+    return OptArgVal[i][0];
+  return 0;
+}
+
+// Checks whether the instruction at line j waits for the memory read of line i
+STATIC
+int OptStallsAfter(int i, int j)
+{
+  unsigned use, def;
+  int r = OptLoadedReg(i);
+  return r && j >= 0 && OptRegUseDef(j, 0, &use, &def) && (use & (1u << r));
+}
+
+// Counts the instructions that wait for the memory read right before them
+STATIC
+int OptCountStalls(void)
+{
+  int i, prev = -1, cnt = 0;
+  for (i = 0; i < OptLineCnt; i++)
+  {
+    if (OptKind[i] == OptKindAsm)
+      prev = -1;
+    if (OptKind[i] != OptKindInstr || OptDeleted[i])
+      continue;
+    cnt += OptStallsAfter(prev, i);
+    prev = i;
+  }
+  return cnt;
+}
+
+// Checks whether the instruction at line i may change places with its neighbors
+STATIC
+int OptIsMovable(int i, unsigned* use, unsigned* def)
+{
+  if (OptKind[i] != OptKindInstr || OptDeleted[i] || !OptRegUseDef(i, 0, use, def))
+    return 0;
+  switch (OptInstr[i])
+  {
+  case B32PInstrSavPC:
+  case B32PInstrIntID:
+  case B32PInstrJump:
+  case B32PInstrJumpr:
+  case B32PInstrHalt:
+    return 0;
+  }
+  return !OptIsBranch(OptInstr[i]);
+}
+
+STATIC
+int OptIsMemAccess(int i)
+{
+  int instr = OptInstr[i];
+  return instr == B32PInstrRead || instr == B32PInstrWrite ||
+         instr == B32PInstrPush || instr == B32PInstrPop;
+}
+
+// Checks whether block instruction k must stay after block instruction j (j < k)
+STATIC
+int OptSchedDep(int j, int k)
+{
+  return (OptSchedDef[j] & (OptSchedUse[k] | OptSchedDef[k])) ||
+         (OptSchedUse[j] & OptSchedDef[k]) ||
+         // memory may be memory mapped I/O, keep all accesses in order
+         (OptIsMemAccess(OptSchedLine[j]) && OptIsMemAccess(OptSchedLine[k]));
+}
+
+// Reorders the cnt instructions of a block in OptSchedLine[].
+// prev is the instruction line in front of the block and next the one behind it (-1 if none).
+STATIC
+void OptScheduleBlock(int cnt, int prev, int next)
+{
+  int j, k, n, last, stalls = 0, newStalls = 0;
+
+  if (cnt < 2)
+    return;
+
+  // Longest path to the end of the block, a memory read takes 2 cycles for its users
+  for (k = cnt - 1; k >= 0; k--)
+  {
+    int i = OptSchedLine[k];
+    OptSchedHeight[k] = 1 + OptStallsAfter(i, next);
+    for (j = k + 1; j < cnt; j++)
+      if (OptSchedDep(k, j))
+      {
+        int h = 1 + OptStallsAfter(i, OptSchedLine[j]) + OptSchedHeight[j];
+        if (OptSchedHeight[k] < h)
+          OptSchedHeight[k] = h;
+      }
+    OptSchedDone[k] = 0;
+  }
+
+  // List scheduling: of the instructions whose predecessors are placed, take one that
+  // doesn't wait for the previous read, then the one with the longest path, then the first
+  last = prev;
+  for (n = 0; n < cnt; n++)
+  {
+    int best = -1, bestStall = 0;
+    for (k = 0; k < cnt; k++)
+    {
+      int stall;
+      if (OptSchedDone[k])
+        continue;
+      for (j = 0; j < k; j++)
+        if (!OptSchedDone[j] && OptSchedDep(j, k))
+          break;
+      if (j < k)
+        continue;
+      stall = OptStallsAfter(last, OptSchedLine[k]);
+      if (best < 0 || stall < bestStall ||
+          (stall == bestStall && OptSchedHeight[k] > OptSchedHeight[best]))
+      {
+        best = k;
+        bestStall = stall;
+      }
+    }
+    OptSchedOrder[n] = best;
+    OptSchedDone[best] = 1;
+    newStalls += bestStall;
+    last = OptSchedLine[best];
+  }
+  newStalls += OptStallsAfter(last, next);
+
+  last = prev;
+  for (k = 0; k < cnt; k++)
+  {
+    stalls += OptStallsAfter(last, OptSchedLine[k]);
+    last = OptSchedLine[k];
+  }
+  stalls += OptStallsAfter(last, next);
+
+  if (newStalls >= stalls)
+    return;
+
+  // Move the instructions to their new lines, comments stay where they are
+  {
+    char* line[MAX_OPT_BLOCK];
+    unsigned char modified[MAX_OPT_BLOCK];
+    int instr[MAX_OPT_BLOCK], argCnt[MAX_OPT_BLOCK];
+    int argType[MAX_OPT_BLOCK][3], argVal[MAX_OPT_BLOCK][3];
+    for (k = 0; k < cnt; k++)
+    {
+      int i = OptSchedLine[k];
+      line[k] = OptLine[i];
+      modified[k] = OptModified[i];
+      instr[k] = OptInstr[i];
+      argCnt[k] = OptArgCnt[i];
+      memcpy(argType[k], OptArgType[i], sizeof argType[k]);
+      memcpy(argVal[k], OptArgVal[i], sizeof argVal[k]);
+    }
+    for (n = 0; n < cnt; n++)
+    {
+      int i = OptSchedLine[n];
+      k = OptSchedOrder[n];
+      OptLine[i] = line[k];
+      OptModified[i] = modified[k];
+      OptInstr[i] = instr[k];
+      OptArgCnt[i] = argCnt[k];
+      memcpy(OptArgType[i], argType[k], sizeof argType[k]);
+      memcpy(OptArgVal[i], argVal[k], sizeof argVal[k]);
+    }
+  }
+  OptStale = 1;
+}
+
+// Moves independent instructions between memory reads and the instructions that
+// use the read values. Runs last, on the code as it's printed.
+STATIC
+void OptSchedule(void)
+{
+  int i, cnt = 0, prev = -1, skip = 0, before, after;
+  unsigned use, def;
+
+  // Relative branches count on the words they jump over
+  for (i = 0; i < OptLineCnt; i++)
+    if (OptKind[i] == OptKindInstr && !OptDeleted[i] &&
+        (OptInstr[i] == B32PInstrJumpo || OptInstr[i] == B32PInstrJumpro ||
+         (OptIsBranch(OptInstr[i]) && OptArgCnt[i] == 3 &&
+          OptArgType[i][2] == OptArgConst && OptArgVal[i][2] <= 0)))
+      return;
+
+  before = OptCountStalls();
+  for (i = 0; i <= OptLineCnt; i++)
+  {
+    int movable = 0;
+    if (i < OptLineCnt)
+    {
+      if (OptDeleted[i] || (OptKind[i] == OptKindOther && OptIsComment(i)))
+        continue;
+      movable = !skip && cnt < MAX_OPT_BLOCK && OptIsMovable(i, &use, &def);
+    }
+    if (movable)
+    {
+      OptSchedLine[cnt] = i;
+      OptSchedUse[cnt] = use;
+      OptSchedDef[cnt] = def;
+      cnt++;
+      continue;
+    }
+    OptScheduleBlock(cnt, prev, (i < OptLineCnt && OptKind[i] == OptKindInstr) ? i : -1);
+    cnt = 0;
+    if (i >= OptLineCnt)
+      break;
+    if (OptKind[i] == OptKindInstr)
+    {
+      // "bXX rA rB K" skips the instructions in the next K-1 words, they stay in place
+      if (skip)
+        skip -= OptWords(i);
+      if (OptIsBranch(OptInstr[i]) && OptArgType[i][2] == OptArgConst && skip < OptArgVal[i][2] - 1)
+        skip = OptArgVal[i][2] - 1;
+      prev = i;
+    }
+    else if (OptKind[i] == OptKindAsm)
+      prev = -1;
+  }
+
+  after = OptCountStalls();
+  OptStallsFound += before;
+  OptStallsRemoved += before - after;
+  if (verbose && before)
+    printf("  load-use stalls: %d of %d removed\n", before - after, before);
+}
+
+// Prints how much code each rule removed (-O -verbose)
+STATIC
+void OptPrintStats(void)
+{
+  int rule, applied = 0, instrs = 0, words = 0;
+  printf("Peephole rule        applied   instrs    words\n");
+  for (rule = 0; rule < OPT_RULE_CNT; rule++)
+  {
+    printf("%-20s %7d %8d %8d\n",
+           OptRuleName[rule], OptRuleApplied[rule], OptRuleInstrs[rule], OptRuleWords[rule]);
+    applied += OptRuleApplied[rule];
+    instrs += OptRuleInstrs[rule];
+    words += OptRuleWords[rule];
+  }
+  printf("%-20s %7d %8d %8d\n", "total", applied, instrs, words);
+  printf("Loops: %d values hoisted, %d induction variables reduced, %d tests replaced\n",
+         OptLoopHoisted, OptLoopReduced, OptLoopTests);
+  printf("Inlined calls: %d\n", OptInlined);
+  printf("Tail calls: %d\n", OptTailCalled);
+  printf("Frameless functions: %d\n", OptFrameless);
+  printf("Load-use stalls: %d of %d removed\n", OptStallsRemoved, OptStallsFound);
+  if (GenOptimize > 1)
+    printf("Values: %d constants, %d branches decided, %d unreachable instructions, %d recomputations\n",
+           OptSsaConsts, OptSsaBranches, OptSsaUnreached, OptSsaCse);
+}
+
+// Finds the callee-saved registers written by the function
+STATIC
+void OptFindSavedRegs(int analyzed)
+{
+  unsigned regs = 0;
+  int i, n, s;
+
+  if (analyzed)
+  {
+    for (n = 0; n < OptNodeCnt; n++)
+      regs |= OptDef[n][0];
+    for (s = 0; s < OptSlotCnt; s++)
+      if (OptSlotReg[s] >= 0)
+        regs |= 1u << OptSlotReg[s];
+  }
+  else
+  {
+    // Any mention of a register may be a write to it
+    for (i = 0; i < OptLineCnt; i++)
+    {
+      char* p = OptLine[i];
+      int first = 1;
+      if (OptKind[i] != OptKindInstr && OptKind[i] != OptKindAsm)
+        continue;
+      while (*p && *p != ';')
+      {
+        int l, r;
+        while (OptIsSpace(*p))
+          p++;
+        if (!(l = OptTokenLen(p)))
+          break;
+        if ((r = OptRegToken(p, l)) >= 0)
+          regs |= 1u << r;
+        else if (first && OptKind[i] == OptKindAsm && p[l - 1] != ':' &&
+                 ((l == 4 && !strncmp(p, "jump", 4)) ||
+                  (l == 5 && (!strncmp(p, "jumpo", 5) || !strncmp(p, "jumpr", 5) || !strncmp(p, "savpc", 5))) ||
+                  (l == 6 && !strncmp(p, "jumpro", 6))))
+          regs |= OPT_CALLEE_SAVED; // the asm code may run anything
+        if (p[l - 1] != ':')
+          first = 0;
+        p += l;
+      }
+    }
+  }
+
+  regs &= ~OPT_GP_LIVE; // never changed, apart from setting it again after asm()
+
+  OptSavedCnt = 0;
+  for (i = 0; i < 16; i++)
+    if ((regs & OPT_CALLEE_SAVED & (1u << i)))
+      OptSavedRegs[OptSavedCnt++] = i;
+}
+
+STATIC
+void OptPrintLine(int i)
+{
+  int k;
+  if (OptDeleted[i])
+    return;
+  if (!OptModified[i])
+  {
+    puts2(OptLine[i]);
+    return;
+  }
+  GenPrintInstr(OptInstr[i], 0);
+  for (k = 0; k < OptArgCnt[i]; k++)
+  {
+    if (k)
+      GenPrintOperandSeparator();
+    if (OptArgType[i][k] == OptArgReg)
+      printf2("r%d", OptArgVal[i][k]);
+    else if (OptArgType[i][k] == OptArgConst)
+      printf2("%d", OptArgVal[i][k]);
+    else
+    {
+      char* s = OptText + OptArgVal[i][k];
+      printf2("%.*s", OptTokenLen(s), s);
+    }
+  }
+  GenPrintNewLine();
+}
+
+// Register of the slot at ofs, -1 if it's in memory
+STATIC
+int OptSlotRegAt(int ofs)
+{
+  int s = OptFindSlot(ofs);
+  return (s < 0) ? -1 : OptSlotReg[s];
+}
+